@@ -0,0 +1,152 @@
+/**
+ * #FujiNet Benchmarks - ATR write-back
+ *
+ * Compares strict (sync every sector) and write-back modes on a DOS
+ * FORMAT + file copy style workload, counting the writes and syncs that
+ * reach the image. Runs on the host, built by fujinet_pc.cmake with
+ * -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <chrono>
+#include "../lib/media/atari/diskTypeAtr.h"
+#include "../lib/FileSystem/fnFileLocal.h"
+#include "../lib/hardware/fnSystem.h"
+#include "../lib/fuji/fujiHost.h"
+
+#define BENCH_ATR_SECTORS 720
+
+// Workload shape: FORMAT writes every sector, then FILES files of FILE_SECTORS are copied
+#define BENCH_FILES 16
+#define BENCH_FILE_SECTORS 24
+#define BENCH_VTOC_SECTOR 360
+#define BENCH_DIR_SECTOR 361
+
+using namespace std;
+
+/**
+ * The parts of fnSystem and fujiHost the ATR code reaches, without the rest of fujinet.
+ * High score images are never mounted here.
+ */
+SystemManager fnSystem;
+SystemManager::SystemManager() {}
+
+uint64_t SystemManager::millis()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+fnFile *fujiHost::fnfile_open(const char *path, char *fullpath, int fullpathlen, const char *mode)
+{
+    return nullptr;
+}
+
+/**
+ * Local image that counts what reaches it, and syncs on flush as the SD card does
+ */
+class BenchFileHandler : public FileHandlerLocal
+{
+public:
+    unsigned long writes = 0;
+    unsigned long syncs = 0;
+
+    BenchFileHandler(FILE *fh) : FileHandlerLocal(fh) {};
+
+    size_t write(const void *ptr, size_t size, size_t n) override
+    {
+        writes++;
+        return FileHandlerLocal::write(ptr, size, n);
+    }
+
+    int flush() override
+    {
+        syncs++;
+        int ret = FileHandlerLocal::flush();
+        fsync(fileno(_fh));
+        return ret;
+    }
+};
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int write_sector(MediaTypeATR *atr, uint16_t sector, uint8_t fill)
+{
+    memset(atr->_disk_sectorbuff, fill, sizeof(atr->_disk_sectorbuff));
+    return atr->write(sector, false) == false;
+}
+
+/**
+ * Runs the workload, returns number of sectors written
+ */
+static int run_workload(MediaTypeATR *atr)
+{
+    int written = 0;
+
+    // FORMAT: every sector in order
+    for (uint16_t s = 1; s <= BENCH_ATR_SECTORS; s++)
+        written += write_sector(atr, s, 0);
+
+    // Copy: data sectors, then VTOC and directory updated on close, as DOS 2 does
+    uint16_t next = 4;
+    for (int f = 0; f < BENCH_FILES; f++)
+    {
+        for (int i = 0; i < BENCH_FILE_SECTORS; i++)
+        {
+            if (next == BENCH_VTOC_SECTOR)
+                next = BENCH_DIR_SECTOR + 8;
+            written += write_sector(atr, next++, f);
+        }
+        written += write_sector(atr, BENCH_VTOC_SECTOR, f);
+        written += write_sector(atr, BENCH_DIR_SECTOR + f / 8, f);
+    }
+
+    atr->flush();
+    return written;
+}
+
+/**
+ * Strict vs. write-back writes, syncs and sectors/second
+ */
+int main()
+{
+    uint32_t write_back_ms[2] = { 0, 1000 };
+    const char *mode_name[2] = { "strict", "write-back" };
+    unsigned long syncs[2] = { 0, 0 };
+    int expected = BENCH_ATR_SECTORS + BENCH_FILES * (BENCH_FILE_SECTORS + 2);
+
+    for (int m = 0; m < 2; m++)
+    {
+        FILE *fh = tmpfile();
+        if (fh == nullptr)
+            return 1;
+        BenchFileHandler *f = new BenchFileHandler(fh);
+        MediaTypeATR::create(f, 128, BENCH_ATR_SECTORS);
+        f->writes = f->syncs = 0;
+
+        MediaTypeATR *atr = new MediaTypeATR();
+        atr->_write_back_ms = write_back_ms[m];
+        atr->mount(f, BENCH_ATR_SECTORS * 128 + 16);
+
+        uint64_t start = micros();
+        int written = run_workload(atr);
+        uint64_t elapsed = micros() - start;
+
+        printf("ATR %s: %d sectors in %lu us, %lu sectors/s, %lu writes, %lu syncs\n", mode_name[m], written,
+               (unsigned long)elapsed, (unsigned long)(elapsed ? written * 1000000ULL / elapsed : 0),
+               f->writes, f->syncs);
+        syncs[m] = f->syncs;
+
+        // Closes the image
+        delete atr;
+
+        if (written != expected)
+            return 1;
+    }
+
+    return syncs[1] < syncs[0] ? 0 : 1;
+}
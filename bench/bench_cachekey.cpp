@@ -0,0 +1,92 @@
+/**
+ * #FujiNet Benchmarks - Cache key derivation
+ *
+ * Times fnCacheKey against the MD5 + std::bitset base32 derivation it
+ * replaced. Runs on the host, built by fujinet_pc.cmake with
+ * -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <bitset>
+#include <chrono>
+#include <mbedtls/md5.h>
+#include "../lib/FileSystem/fnCacheKey.h"
+
+#define BENCH_ITERATIONS 100000
+
+using namespace std;
+
+static const char *bench_host = "TNFS://tnfs.fujinet.online/";
+static const char *bench_path = "/ATARI/GAMES/Arcade/Donkey Kong (1983)(Atari)(US)[!].atr";
+
+/**
+ * Key derivation as it was done before fnCacheKey
+ */
+static string legacy_encode_base32(const string &data)
+{
+    static const string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+    string binary_string;
+    for (char c : data)
+        binary_string += bitset<8>(c).to_string();
+    int padding = binary_string.length() % 5;
+    if (padding != 0)
+        binary_string.append(5 - padding, '0');
+    string encoded;
+    for (size_t i = 0; i < binary_string.length(); i += 5)
+        encoded += alphabet[stoi(binary_string.substr(i, 5), nullptr, 2)];
+    while (encoded.length() % 8 != 0)
+        encoded += '=';
+    return encoded;
+}
+
+static string legacy_encode_host_path(const char *host, const char *path)
+{
+    unsigned char md5_result[16];
+    string result;
+    mbedtls_md5((const unsigned char *)host, strlen(host), md5_result);
+    result = legacy_encode_base32(string((char *)md5_result, 5)) + '-';
+    mbedtls_md5((const unsigned char *)path, strlen(path), md5_result);
+    result += legacy_encode_base32(string((char *)md5_result, 15));
+    return result;
+}
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * New key derivation against MD5 + bitset base32
+ */
+int main()
+{
+    char key[CACHE_KEY_LEN + 1];
+    string legacy;
+    size_t check = 0;
+
+    uint64_t start = micros();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        cache_key(bench_host, bench_path, key);
+        check += key[i % CACHE_KEY_LEN];
+    }
+    uint64_t new_us = micros() - start;
+
+    start = micros();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        legacy = legacy_encode_host_path(bench_host, bench_path);
+        check += legacy[i % CACHE_KEY_LEN];
+    }
+    uint64_t legacy_us = micros() - start;
+
+    printf("cache key x%d: fnCacheKey %lu us, MD5+bitset %lu us (%zu)\n",
+           BENCH_ITERATIONS, (unsigned long)new_us, (unsigned long)legacy_us, check);
+
+    // Same shape as the names the MD5 implementation produced
+    if (legacy.size() != CACHE_KEY_LEN || strlen(key) != CACHE_KEY_LEN)
+        return 1;
+    return new_us < legacy_us ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/**
+ * #FujiNet Benchmarks - DSK nibblization
+ *
+ * Times the 6-and-2 track encoder and decoder, and a sector write patched
+ * into its track against re-nibblizing the whole track. Runs on the host,
+ * built by fujinet_pc.cmake with -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <chrono>
+#include "../lib/media/apple/mediaTypeDSK.h"
+#include "../lib/hardware/fnSystem.h"
+
+#define BENCH_TRACKS 350
+#define BENCH_SECTORS 5600
+
+using namespace std;
+
+/**
+ * The part of fnSystem the DSK code reaches, without the rest of fujinet
+ */
+SystemManager fnSystem;
+SystemManager::SystemManager() {}
+
+uint64_t SystemManager::millis()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint8_t sectors[16 * 256];
+static uint8_t track[WOZ1_NUM_BLKS * 512];
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Reads the byte starting at a bit position of a track
+ */
+static uint8_t track_byte(const uint8_t *bits, size_t position)
+{
+    size_t shift = position & 7;
+    uint8_t b = bits[position >> 3] << shift;
+    if (shift)
+        b |= bits[(position >> 3) + 1] >> (8 - shift);
+    return b;
+}
+
+/**
+ * Collects the data nibbles of a physical sector
+ */
+static void sector_nibbles(uint8_t *nibbles, const uint8_t *bits, int physical_sector)
+{
+    size_t position = DSK_GAP1_BITS + physical_sector * DSK_SECTOR_BITS + DSK_SECTOR_DATA_BITS;
+    for (int c = 0; c < 343; c++)
+        nibbles[c] = track_byte(bits, position + c * 8);
+}
+
+static void print_rate(const char *what, int count, const char *unit, uint64_t elapsed)
+{
+    printf("DSK %s: %d %s in %lu us, %lu %s/s\n", what, count, unit, (unsigned long)elapsed,
+           (unsigned long)(elapsed ? count * 1000000ULL / elapsed : 0), unit);
+}
+
+/**
+ * Encode, decode and sector write throughput
+ */
+int main()
+{
+    uint8_t nibbles[343];
+    uint8_t decoded[343];
+    uint64_t start, encode_us, patch_us;
+    unsigned check = 0;
+
+    for (size_t i = 0; i < sizeof(sectors); i++)
+        sectors[i] = (uint8_t)(i * 31 + (i >> 8) + 1);
+
+    start = micros();
+    for (int i = 0; i < BENCH_TRACKS; i++)
+        dsk_nibblize_track(track, sectors, i % 35, false);
+    encode_us = micros() - start;
+    print_rate("encode", BENCH_TRACKS, "tracks", encode_us);
+
+    start = micros();
+    for (int i = 0; i < BENCH_SECTORS; i++)
+    {
+        sector_nibbles(nibbles, track, i % 16);
+        check += decode_6_and_2(decoded, nibbles);
+    }
+    print_rate("decode", BENCH_SECTORS, "sectors", micros() - start);
+
+    start = micros();
+    for (int i = 0; i < BENCH_SECTORS; i++)
+        dsk_nibblize_sector(track, &sectors[(i % 16) * 256], i % 16);
+    patch_us = micros() - start;
+    print_rate("sector write", BENCH_SECTORS, "sectors", patch_us);
+
+    // A sector write used to re-nibblize its whole track
+    uint64_t track_per_sector_us = encode_us * BENCH_SECTORS / BENCH_TRACKS;
+    printf("DSK sector write by whole track: ~%lu us (%u)\n", (unsigned long)track_per_sector_us, check);
+
+    return patch_us < track_per_sector_us ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+/**
+ * #FujiNet Benchmarks - Streaming JSON queries
+ *
+ * Memory and time to pull one field out of a large API response, streamed
+ * by FNJSON::parse(true) against the whole cJSON tree, and twenty fields
+ * read one query at a time against one setReadQueries() batch. Runs on
+ * the host, built by fujinet_pc.cmake with -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cJSON.h>
+#include "../lib/fnjson/fnjson.h"
+
+#define BENCH_RECORDS 3000 // About 600 KB
+#define BENCH_CHUNK 1024   // What a protocol typically has waiting
+#define BENCH_ROUNDS 50
+
+using namespace std;
+
+/**
+ * Protocol serving a JSON document generated record by record in fixed
+ * size reads, so the whole thing never exists
+ */
+class jsonProtocol : public NetworkProtocol
+{
+private:
+    string pending;
+    size_t records = 0;
+    size_t next_record = 0;
+    size_t chunk;
+
+    void refill();
+
+public:
+    size_t sent = 0;
+
+    jsonProtocol(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, string *sp_buf, size_t chunk_size)
+        : NetworkProtocol(rx_buf, tx_buf, sp_buf), chunk(chunk_size) {}
+
+    void serve_records(size_t count) { records = count; }
+
+    bool read(unsigned short len) override
+    {
+        refill();
+        receiveBuffer->append(pending.data(), len);
+        pending.erase(0, len);
+        sent += len;
+        return false;
+    }
+
+    bool status(NetworkStatus *status) override
+    {
+        refill();
+        status->rxBytesWaiting = pending.size() < chunk ? pending.size() : chunk;
+        status->connected = !pending.empty();
+        status->error = 0;
+        return false;
+    }
+};
+
+/**
+ * One entry of a station list, like a typical paged REST API returns
+ */
+static string api_record(size_t n)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "%s{\"id\":%u,\"name\":\"Station %u\",\"active\":%s,\"score\":%u.%02u,"
+             "\"tags\":[\"weather\",\"zone-%u\"],\"location\":{\"lat\":%d.%04u,\"lon\":%d.%04u},"
+             "\"description\":\"Reading %u with \\\"quoted\\\" text, a \\u00e9 and a \\/ slash.\"}",
+             n == 0 ? "" : ",", (unsigned)n, (unsigned)n, n % 3 ? "true" : "false",
+             (unsigned)(n % 100), (unsigned)(n * 7 % 100), (unsigned)(n % 16),
+             (int)(n % 90), (unsigned)(n * 31 % 10000), -(int)(n % 180), (unsigned)(n * 17 % 10000),
+             (unsigned)n);
+    return buf;
+}
+
+void jsonProtocol::refill()
+{
+    if (records == 0 || pending.size() >= chunk)
+        return;
+
+    if (next_record == 0)
+        pending += "{\"status\":\"ok\",\"count\":" + to_string(records) + ",\"results\":[";
+    while (next_record < records && pending.size() < chunk)
+        pending += api_record(next_record++);
+    if (next_record == records)
+    {
+        pending += "],\"next\":\"https://api.example.com/stations?page=2\"}";
+        records = 0;
+    }
+}
+
+/**
+ * cJSON allocations, with the size kept in front so free can count it
+ */
+static size_t cjson_bytes;
+static size_t cjson_peak;
+
+static void *counting_malloc(size_t size)
+{
+    size_t *p = (size_t *)malloc(size + sizeof(size_t));
+    if (p == nullptr)
+        return nullptr;
+    *p = size;
+    cjson_bytes += size;
+    if (cjson_bytes > cjson_peak)
+        cjson_peak = cjson_bytes;
+    return p + 1;
+}
+
+static void counting_free(void *ptr)
+{
+    if (ptr == nullptr)
+        return;
+    size_t *p = (size_t *)ptr - 1;
+    cjson_bytes -= *p;
+    free(p);
+}
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Parse BENCH_RECORDS generated records and read query, streaming for it if stream is set
+ */
+static void bench_query(const char *query, bool stream, string &value, size_t &doc_size, uint64_t &us)
+{
+    NetworkBuffer rx;
+    NetworkBuffer tx;
+    string sp;
+    jsonProtocol protocol(&rx, &tx, &sp, BENCH_CHUNK);
+    protocol.serve_records(BENCH_RECORDS);
+
+    FNJSON json;
+    json.setLineEnding("\n");
+    json.setProtocol(&protocol);
+    json.setReadQuery(query, 0);
+
+    uint64_t start = micros();
+    json.parse(stream);
+    json.setReadQuery(query, 0);
+    us = micros() - start;
+
+    value.assign(json.json_bytes_remaining, '\0');
+    json.readValue((uint8_t *)&value[0], value.size());
+    doc_size = protocol.sent;
+}
+
+/**
+ * One field out of a large API response, streamed and as a tree.
+ * Returns false if streaming got a different value or used more memory.
+ */
+static bool bench_stream()
+{
+    const char *queries[] = {"/results/1200/location", "/next"};
+    bool ok = true;
+
+    cJSON_Hooks hooks = {counting_malloc, counting_free};
+    cJSON_InitHooks(&hooks);
+
+    for (const char *query : queries)
+    {
+        string tree_value, stream_value;
+        size_t tree_size, stream_size;
+        uint64_t tree_us, stream_us;
+
+        cjson_bytes = cjson_peak = 0;
+        bench_query(query, false, tree_value, tree_size, tree_us);
+        size_t tree_peak = cjson_peak;
+
+        cjson_bytes = cjson_peak = 0;
+        bench_query(query, true, stream_value, stream_size, stream_us);
+        size_t stream_peak = cjson_peak;
+
+        // The tree also needs the whole document in the parse buffer
+        printf("JSON %s from %u KB: tree %u KB + %u KB text, %lu us; streamed %u bytes, %lu us\n",
+               query, (unsigned)(tree_size / 1024), (unsigned)(tree_peak / 1024), (unsigned)(tree_size / 1024),
+               (unsigned long)tree_us, (unsigned)stream_peak, (unsigned long)stream_us);
+
+        ok = ok && !tree_value.empty() && tree_value == stream_value && stream_peak < tree_peak;
+    }
+
+    cJSON_InitHooks(nullptr);
+    return ok;
+}
+
+/**
+ * Split a setReadQueries() record into its values, "<none>" where the length is 0
+ */
+static vector<string> unpack_values(FNJSON &json)
+{
+    string record(json.json_bytes_remaining, '\0');
+    json.readValue((uint8_t *)&record[0], record.size());
+
+    vector<string> values;
+    size_t pos = 1;
+    for (int i = 0; i < (uint8_t)record[0] && pos + 2 <= record.size(); i++)
+    {
+        size_t len = (uint8_t)record[pos] | ((uint8_t)record[pos + 1] << 8);
+        values.push_back(len == 0 ? "<none>" : record.substr(pos + 2, len));
+        pos += 2 + len;
+    }
+    return values;
+}
+
+/**
+ * Twenty fields near the end of a large API response, one query at a time and as a batch.
+ * Returns false if the batch got different values or took longer.
+ */
+static bool bench_multiple_queries()
+{
+    const char *fields[] = {"id", "name", "active", "score", "tags/0", "tags/1", "location/lat", "location/lon",
+                            "description", "location"};
+    vector<string> queries;
+    for (int record = BENCH_RECORDS - 2; record < BENCH_RECORDS; record++)
+        for (const char *field : fields)
+            queries.push_back("/results/" + to_string(record) + "/" + field);
+
+    NetworkBuffer rx;
+    NetworkBuffer tx;
+    string sp;
+    jsonProtocol protocol(&rx, &tx, &sp, BENCH_CHUNK);
+    protocol.serve_records(BENCH_RECORDS);
+    FNJSON json;
+    json.setLineEnding("\n");
+    json.setProtocol(&protocol);
+    if (!json.parse())
+        return false;
+
+    vector<string> single;
+    uint64_t start = micros();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        single.clear();
+        for (const string &query : queries)
+        {
+            json.setReadQuery(query, 0);
+            string value(json.json_bytes_remaining, '\0');
+            json.readValue((uint8_t *)&value[0], value.size());
+            single.push_back(value);
+        }
+    }
+    uint64_t single_us = micros() - start;
+
+    vector<string> batch;
+    start = micros();
+    for (int r = 0; r < BENCH_ROUNDS; r++)
+    {
+        json.setReadQueries(queries, 0);
+        batch = unpack_values(json);
+    }
+    uint64_t batch_us = micros() - start;
+
+    // Each query is a set and a read on the bus, the batch is one of each
+    printf("JSON %u queries x %d: one at a time %lu us, %u bus transactions; batch %lu us, 2\n",
+           (unsigned)queries.size(), BENCH_ROUNDS, (unsigned long)single_us, (unsigned)queries.size() * 2,
+           (unsigned long)batch_us);
+
+    return single == batch && batch_us < single_us;
+}
+
+/**
+ * Streamed against tree, batch against single queries
+ */
+int main()
+{
+    bool stream_ok = bench_stream();
+    bool batch_ok = bench_multiple_queries();
+    return stream_ok && batch_ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+/**
+ * #FujiNet Benchmarks - HTTP Range file handler
+ *
+ * What mounting a large image from a web server and reading a few sectors
+ * costs with FileHandlerHTTPRange, against downloading all of it first.
+ * Runs on the host, built by fujinet_pc.cmake with -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "../lib/FileSystem/fnFileHTTPRange.h"
+#include "../lib/hardware/fnSystem.h"
+
+#define BENCH_IMAGE_SIZE (16 * 1024 * 1024)
+#define BENCH_SECTORS 64
+
+using namespace std;
+
+/**
+ * The parts of fnSystem and the HTTP client the Range code reaches, without
+ * the rest of fujinet. The requests never get to the client here.
+ */
+SystemManager fnSystem;
+SystemManager::SystemManager() {}
+
+void SystemManager::delay(uint32_t ms) {}
+
+bool mgHttpClient::set_url(const char *url) { return false; }
+void mgHttpClient::close() {}
+void mgHttpClient::create_empty_stored_headers(const std::vector<std::string> &headerKeys) {}
+bool mgHttpClient::set_header(const char *header_key, const char *header_value) { return false; }
+int mgHttpClient::GET() { return -1; }
+const std::string mgHttpClient::get_header(const char *header) { return std::string(); }
+int mgHttpClient::available() { return 0; }
+int mgHttpClient::read(uint8_t *dest_buffer, int dest_bufflen) { return -1; }
+
+/**
+ * Handler answering Range requests from a file made up on the fly, in
+ * place of a web server
+ */
+class rangeFile : public FileHandlerHTTPRange
+{
+private:
+    long file_size;
+    long next = 0;
+    long stop = 0;
+
+protected:
+    int request(long first, long last, long *total) override
+    {
+        requests++;
+        *total = -1;
+        if (first >= file_size)
+            return 416;
+        if (last >= file_size)
+            last = file_size - 1;
+        next = first;
+        stop = last + 1;
+        *total = file_size;
+        return 206;
+    }
+
+    int receive(uint8_t *dest, int len) override
+    {
+        int n = 0;
+        while (n < len && next < stop)
+            dest[n++] = byte_at(next++);
+        fetched += n;
+        return n;
+    }
+
+public:
+    int requests = 0;
+    long fetched = 0;
+
+    rangeFile(long size) : FileHandlerHTTPRange(nullptr, "http://localhost/disk.img"), file_size(size) {}
+
+    static uint8_t byte_at(long offset) { return (uint8_t)(offset * 7 + offset / 4093); }
+};
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Bytes fetched to open a 16 MB image and read a few sectors
+ */
+int main()
+{
+    uint8_t buf[512];
+    bool match = true;
+
+    uint64_t start = micros();
+    rangeFile *f = new rangeFile(BENCH_IMAGE_SIZE);
+    if (!f->open())
+        return 1;
+    long mount_fetched = f->fetched;
+
+    srand(2);
+    for (int i = 0; i < BENCH_SECTORS; i++)
+    {
+        long offset = (rand() % (BENCH_IMAGE_SIZE / sizeof(buf))) * sizeof(buf);
+        f->seek(offset, SEEK_SET);
+        match = match && f->read(buf, sizeof(buf), 1) == 1 && buf[0] == rangeFile::byte_at(offset) &&
+                buf[sizeof(buf) - 1] == rangeFile::byte_at(offset + sizeof(buf) - 1);
+    }
+    uint64_t elapsed = micros() - start;
+
+    printf("HTTP Range %d MB image: mount fetched %ld bytes, %d sectors %ld bytes in %d requests, %lu us\n",
+           BENCH_IMAGE_SIZE / (1024 * 1024), mount_fetched, BENCH_SECTORS, f->fetched, f->requests,
+           (unsigned long)elapsed);
+
+    // Against the whole image before the first sector
+    long fetched = f->fetched;
+    f->close();
+    return match && fetched < BENCH_IMAGE_SIZE / 32 ? 0 : 1;
+}
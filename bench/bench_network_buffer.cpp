@@ -0,0 +1,96 @@
+/**
+ * #FujiNet Benchmarks - Network protocol buffer
+ *
+ * Streams a download through NetworkBuffer as NetworkProtocolFS::read_file
+ * and the bus use it, filling with prepare()/commit() and taking bus sized
+ * frames with consume(), against the std::string erased from the front
+ * that the buses used before. Runs on the host, built by fujinet_pc.cmake
+ * with -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "../lib/network-protocol/NetworkBuffer.h"
+
+#define BENCH_HTTP_SIZE (4 * 1024 * 1024)
+#define BENCH_HTTP_CHUNK 65535 // Most NetworkProtocolHTTP::status_file() reports waiting
+#define BENCH_BUS_FRAME 512    // What the computer asks for per read
+
+using namespace std;
+
+/**
+ * Byte n of the download
+ */
+static inline uint8_t pattern(size_t n)
+{
+    return (uint8_t)((n * 7) ^ (n >> 9));
+}
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Download through NetworkBuffer against std::string
+ */
+int main()
+{
+    uint8_t frame[BENCH_BUS_FRAME];
+    bool match = true;
+
+    // The protocol fills the buffer whenever it runs dry, the bus takes it a frame at a time
+    NetworkBuffer rx_buf;
+    size_t delivered = 0;
+    size_t sent = 0;
+    uint64_t start = micros();
+    while (delivered < BENCH_HTTP_SIZE)
+    {
+        if (rx_buf.empty())
+        {
+            uint8_t *buf = (uint8_t *)rx_buf.prepare(BENCH_HTTP_CHUNK);
+            for (size_t i = 0; i < BENCH_HTTP_CHUNK; i++)
+                buf[i] = pattern(sent + i);
+            rx_buf.commit(BENCH_HTTP_CHUNK);
+            sent += BENCH_HTTP_CHUNK;
+        }
+        size_t len = rx_buf.size() < BENCH_BUS_FRAME ? rx_buf.size() : BENCH_BUS_FRAME;
+        memcpy(frame, rx_buf.data(), len);
+        rx_buf.consume(len);
+        match = match && frame[0] == pattern(delivered) && frame[len - 1] == pattern(delivered + len - 1);
+        delivered += len;
+    }
+    uint64_t elapsed = micros() - start;
+
+    // The same traffic through a std::string erased from the front, as the buses used to
+    string old_buf;
+    vector<uint8_t> chunk;
+    size_t old_delivered = 0;
+    start = micros();
+    while (old_delivered < BENCH_HTTP_SIZE)
+    {
+        if (old_buf.empty())
+        {
+            chunk = vector<uint8_t>(BENCH_HTTP_CHUNK);
+            for (size_t i = 0; i < BENCH_HTTP_CHUNK; i++)
+                chunk[i] = pattern(old_delivered + i);
+            old_buf.insert(old_buf.end(), chunk.begin(), chunk.end());
+        }
+        size_t len = old_buf.size() < BENCH_BUS_FRAME ? old_buf.size() : BENCH_BUS_FRAME;
+        memcpy(frame, old_buf.data(), len);
+        old_buf.erase(0, len);
+        old_buf.shrink_to_fit();
+        old_delivered += len;
+    }
+    uint64_t old_elapsed = micros() - start;
+
+    printf("HTTP read %u KB in %u byte frames: %lu us (std::string %lu us)\n", BENCH_HTTP_SIZE / 1024,
+           BENCH_BUS_FRAME, (unsigned long)elapsed, (unsigned long)old_elapsed);
+
+    if (!match)
+        return 1;
+    return elapsed < old_elapsed ? 0 : 1;
+}
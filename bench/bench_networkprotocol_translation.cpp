@@ -0,0 +1,167 @@
+/**
+ * #FujiNet Benchmarks - NetworkProtocol translation
+ *
+ * CR/LF translation of a large text download in protocol sized chunks,
+ * through the NetworkProtocol base class against the find/replace
+ * translation it used to do. Runs on the host, built by fujinet_pc.cmake
+ * with -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <chrono>
+#include "../lib/network-protocol/Protocol.h"
+#include "utils.h"
+
+#define BENCH_SIZE (8 * 1024 * 1024)
+#define BENCH_CHUNK 4096 // A large protocol read
+
+using namespace std;
+
+/**
+ * The base class translates on read but leaves write to the protocols,
+ * so writes here just translate
+ */
+class translationProtocol : public NetworkProtocol
+{
+public:
+    translationProtocol(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, string *sp_buf)
+        : NetworkProtocol(rx_buf, tx_buf, sp_buf) {}
+
+    bool write(unsigned short len) override
+    {
+        translate_transmit_buffer();
+        return false;
+    }
+};
+
+/**
+ * The find/replace translation NetworkProtocol used to do, for comparison
+ */
+#ifdef BUILD_APPLE
+#define REF_EOL "\x0d"
+#else
+#define REF_EOL "\x9b"
+#endif
+
+static void reference_rx(string &buf, int mode)
+{
+#ifdef BUILD_ATARI
+    replace(buf.begin(), buf.end(), '\x07', '\xfd');
+    replace(buf.begin(), buf.end(), '\x08', '\x7e');
+    replace(buf.begin(), buf.end(), '\x09', '\x7f');
+#endif
+    if (mode == 1)
+        replace(buf.begin(), buf.end(), '\x0d', REF_EOL[0]);
+    else if (mode == 2)
+        replace(buf.begin(), buf.end(), '\x0a', REF_EOL[0]);
+    else if (mode == 3)
+    {
+        replace(buf.begin(), buf.end(), '\x0d', REF_EOL[0]);
+        buf.erase(remove(buf.begin(), buf.end(), '\n'), buf.end());
+    }
+}
+
+static void reference_tx(string &buf, int mode)
+{
+#ifdef BUILD_ATARI
+    util_replaceAll(buf, "\xfd", "\x07");
+    util_replaceAll(buf, "\x7e", "\x08");
+    util_replaceAll(buf, "\x7f", "\x09");
+#endif
+    if (mode == 1)
+        util_replaceAll(buf, REF_EOL, "\x0d");
+    else if (mode == 2)
+        util_replaceAll(buf, REF_EOL, "\x0a");
+    else if (mode == 3)
+        util_replaceAll(buf, REF_EOL, "\x0d\x0a");
+}
+
+/**
+ * Text with short lines, CR/LF endings and the odd control character
+ */
+static string make_text(size_t len)
+{
+    string text;
+    text.reserve(len);
+    srand(1);
+    while (text.size() < len)
+    {
+        int words = 3 + rand() % 12;
+        for (int w = 0; w < words; w++)
+        {
+            text.append(1 + rand() % 8, 'a' + rand() % 26);
+            text += (rand() % 20 == 0) ? '\t' : ' ';
+        }
+        text += "\x0d\x0a";
+    }
+    text.resize(len);
+    return text;
+}
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * CR/LF translation both ways against find/replace
+ */
+int main()
+{
+    string text = make_text(BENCH_SIZE);
+    string eol_text = text;
+    reference_rx(eol_text, 3);
+
+    NetworkBuffer rx;
+    NetworkBuffer tx;
+    string sp;
+    translationProtocol p(&rx, &tx, &sp);
+    cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x03, 0xFF};
+    p.open(nullptr, &cmdFrame);
+
+    // Each chunk is copied into the buffer as a protocol read would
+    uint64_t start = micros();
+    for (size_t pos = 0; pos < text.size(); pos += BENCH_CHUNK)
+    {
+        rx.clear();
+        rx.append(text.data() + pos, min((size_t)BENCH_CHUNK, text.size() - pos));
+        p.read(rx.size());
+    }
+    uint64_t rx_us = micros() - start;
+
+    start = micros();
+    for (size_t pos = 0; pos < eol_text.size(); pos += BENCH_CHUNK)
+    {
+        tx.clear();
+        tx.append(eol_text.data() + pos, min((size_t)BENCH_CHUNK, eol_text.size() - pos));
+        p.write(tx.size());
+    }
+    uint64_t tx_us = micros() - start;
+
+    start = micros();
+    for (size_t pos = 0; pos < text.size(); pos += BENCH_CHUNK)
+    {
+        string chunk = text.substr(pos, BENCH_CHUNK);
+        reference_rx(chunk, 3);
+    }
+    uint64_t ref_rx_us = micros() - start;
+
+    start = micros();
+    for (size_t pos = 0; pos < eol_text.size(); pos += BENCH_CHUNK)
+    {
+        string chunk = eol_text.substr(pos, BENCH_CHUNK);
+        reference_tx(chunk, 3);
+    }
+    uint64_t ref_tx_us = micros() - start;
+
+    printf("CR/LF translation of %u KB: rx %lu us (find/replace %lu), tx %lu us (find/replace %lu)\n",
+           BENCH_SIZE / 1024, (unsigned long)rx_us, (unsigned long)ref_rx_us,
+           (unsigned long)tx_us, (unsigned long)ref_tx_us);
+
+    // Text has few enough EOLs that find/replace keeps up on transmit, receive has to come out ahead
+    return rx_us < ref_rx_us ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/**
+ * #FujiNet Benchmarks - PNG printer compression
+ *
+ * Compressed size against the stored blocks the printer used to write,
+ * and encode time, per screen dump. Runs on the host, built by
+ * fujinet_pc.cmake with -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "../lib/printer-emulator/deflate_stream.h"
+
+#define BENCH_SCREEN_WIDTH 320
+#define BENCH_SCREEN_HEIGHT 192
+#define BENCH_SCREEN_SIZE ((BENCH_SCREEN_WIDTH + 1) * BENCH_SCREEN_HEIGHT)
+#define BENCH_SCREENS 10
+
+using namespace std;
+
+static uint8_t screen[BENCH_SCREEN_SIZE];
+static size_t compressed_len;
+
+static void collect(void *arg, const uint8_t *data, size_t len)
+{
+    compressed_len += len;
+}
+
+static uint64_t micros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Fills the screen with filter type 0 lines: 0 = text on a plain background,
+ * 1 = bars and a filled circle, 2 = noise
+ */
+static void fill_screen(int kind)
+{
+    srand(1);
+    for (int y = 0; y < BENCH_SCREEN_HEIGHT; y++)
+    {
+        uint8_t *line = &screen[y * (BENCH_SCREEN_WIDTH + 1)];
+        line[0] = 0;
+        for (int x = 0; x < BENCH_SCREEN_WIDTH; x++)
+        {
+            uint8_t v;
+            if (kind == 0)
+            {
+                int glyph = ((x / 8) * 7 + (y / 8) * 13) % 96;
+                bool ink = ((glyph >> ((x + y) & 3)) & 1) && (x % 8 < 7) && (y % 8 < 7) && ((y / 8) % 3 != 2);
+                v = ink ? 0x0E : 0x94;
+            }
+            else if (kind == 1)
+            {
+                v = (uint8_t)(((x / 20) << 4) | ((y / 12) & 0x0F));
+                if ((x - 160) * (x - 160) + (y - 96) * (y - 96) < 3600)
+                    v = (uint8_t)(0x40 + ((x + y) >> 3));
+            }
+            else
+                v = (uint8_t)rand();
+            line[1 + x] = v;
+        }
+    }
+}
+
+/**
+ * Compresses the screen a line at a time, as the printer receives it
+ */
+static bool compress_screen()
+{
+    deflateStream d;
+    compressed_len = 0;
+    if (!d.begin(collect, nullptr))
+        return false;
+    for (size_t pos = 0; pos < BENCH_SCREEN_SIZE; pos += BENCH_SCREEN_WIDTH + 1)
+        d.write(&screen[pos], BENCH_SCREEN_WIDTH + 1);
+    d.finish();
+    return true;
+}
+
+/**
+ * Size and time per screen for each kind of screen
+ */
+int main()
+{
+    static const char *kinds[] = {"text", "graphics", "noise"};
+    // What the printer used to write: zlib header, 5 bytes per 64K stored block, Adler-32
+    const size_t stored = 2 + 5 * ((BENCH_SCREEN_SIZE + 0xFFFE) / 0xFFFF) + BENCH_SCREEN_SIZE + 4;
+    size_t sizes[3];
+
+    for (int kind = 0; kind < 3; kind++)
+    {
+        fill_screen(kind);
+        uint64_t start = micros();
+        for (int i = 0; i < BENCH_SCREENS; i++)
+            if (!compress_screen())
+                return 1;
+        uint64_t elapsed = micros() - start;
+        sizes[kind] = compressed_len;
+
+        printf("PNG %s screen: %lu bytes (stored %lu), %lu us per screen\n", kinds[kind],
+               (unsigned long)compressed_len, (unsigned long)stored, (unsigned long)(elapsed / BENCH_SCREENS));
+    }
+
+    // Plain screens have to come out smaller, noise no more than a little bigger
+    return sizes[0] < stored && sizes[1] < stored && sizes[2] < stored + stored / 8 ? 0 : 1;
+}
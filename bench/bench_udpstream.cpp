@@ -0,0 +1,225 @@
+/**
+ * #FujiNet Benchmarks - UDP stream batching and jitter buffer
+ *
+ * Simulates 30 s of a MIDIMaze style stream: a burst from the Atari every
+ * frame at 31250 baud, 10 ms +0..12 ms one way delay, 1% loss and 1%
+ * duplication. Runs on the host, built by fujinet_pc.cmake with
+ * -DFUJINET_BENCHMARKS=ON.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include "../lib/tcpip/fnUDPStream.h"
+
+#define BENCH_SECONDS 30
+#define BENCH_STEP 100           // us
+#define BENCH_FRAME 16667        // a burst from the Atari every frame
+#define BENCH_BYTE_TIME 320      // us per byte at 31250 baud
+#define BENCH_NET_DELAY 10000    // us one way
+#define BENCH_NET_JITTER 12000   // us on top, at random
+#define BENCH_OLD_PAUSE 5000     // the old UDPSTREAM_PACKET_TIMEOUT
+
+/**
+ * Simple network: every datagram is delayed, a few are dropped or doubled
+ */
+struct sim_datagram
+{
+    uint32_t arrives;
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> bytes; // index of each data byte in the stream
+};
+
+struct sim_result
+{
+    std::vector<uint32_t> latency;
+    uint32_t packets = 0;
+    uint32_t out_of_order = 0;
+    uint32_t missing = 0;
+    uint32_t overflows = 0; // batches that filled up before the pause
+};
+
+static uint32_t sim_rand_state;
+
+static uint32_t sim_rand()
+{
+    sim_rand_state = sim_rand_state * 1103515245 + 12345;
+    return (sim_rand_state >> 16) & 0x7FFF;
+}
+
+static void sim_send(std::vector<sim_datagram> &net, uint32_t now, const uint8_t *data, size_t len,
+                     const std::vector<uint32_t> &bytes)
+{
+    int copies = 1;
+    uint32_t r = sim_rand() % 100;
+    if (r == 0)
+        copies = 0; // 1% lost
+    else if (r == 1)
+        copies = 2; // 1% doubled
+    for (int c = 0; c < copies; c++)
+    {
+        sim_datagram d;
+        d.arrives = now + BENCH_NET_DELAY + sim_rand() % BENCH_NET_JITTER;
+        d.data.assign(data, data + len);
+        d.bytes = bytes;
+        net.push_back(d);
+    }
+}
+
+/**
+ * Runs the same bursts of bytes through the old handling, a fixed pause
+ * and writing packets out as they arrive, or through the batch and jitter
+ * buffer. Latency is from a byte coming off the bus at one end to it going
+ * out on the bus at the other.
+ */
+static void sim_run(bool engine, sim_result &res)
+{
+    static UDPStreamBatch batch;
+    static UDPStreamJitter jitter;
+    std::vector<sim_datagram> net;
+    std::vector<uint32_t> sent_at; // per stream byte
+    std::vector<uint32_t> pending; // stream bytes in the batch
+    std::vector<std::vector<uint32_t>> seq_bytes(65536);
+    uint32_t last_out = 0;
+    bool any_out = false;
+    uint32_t next_burst = 0;
+    uint32_t burst_left = 0;
+    uint32_t next_byte = 0;
+    uint32_t old_last = 0;
+    std::vector<uint8_t> old_buf;
+
+    sim_rand_state = 1;
+    batch.begin(true);
+    jitter.reset();
+    jitter.stats = {};
+
+    for (uint32_t now = BENCH_STEP; now < BENCH_SECONDS * 1000000U; now += BENCH_STEP)
+    {
+        // Bytes from the Atari
+        if (burst_left == 0 && now >= next_burst)
+        {
+            burst_left = 4 + sim_rand() % 21;
+            next_byte = now;
+            next_burst += BENCH_FRAME;
+        }
+        while (burst_left > 0 && now >= next_byte)
+        {
+            uint8_t b = sent_at.size() & 0xFF;
+            pending.push_back(sent_at.size());
+            sent_at.push_back(now);
+            burst_left--;
+            next_byte += BENCH_BYTE_TIME;
+            if (engine)
+            {
+                if (batch.add(b, now))
+                    res.overflows++;
+            }
+            else
+            {
+                old_buf.push_back(b);
+                old_last = now;
+            }
+        }
+
+        // Out to the network
+        if (engine && batch.due(now))
+        {
+            seq_bytes[batch.seq()] = pending;
+            sim_send(net, now, batch.packet(), batch.length(), pending);
+            batch.sent();
+            pending.clear();
+            res.packets++;
+        }
+        else if (!engine && !old_buf.empty() && now - old_last >= BENCH_OLD_PAUSE)
+        {
+            sim_send(net, now, old_buf.data(), old_buf.size(), pending);
+            old_buf.clear();
+            pending.clear();
+            res.packets++;
+        }
+
+        // In from the network and out on the bus
+        for (size_t i = 0; i < net.size();)
+        {
+            if (net[i].arrives > now)
+            {
+                i++;
+                continue;
+            }
+            std::vector<uint32_t> bytes;
+            if (engine)
+            {
+                memcpy(jitter.buffer(), net[i].data.data(), net[i].data.size());
+                jitter.put(net[i].data.size(), now);
+            }
+            else
+                bytes = net[i].bytes;
+            net.erase(net.begin() + i);
+
+            for (uint32_t b : bytes)
+            {
+                res.latency.push_back(now - sent_at[b]);
+                if (any_out && b <= last_out)
+                    res.out_of_order++;
+                last_out = b;
+                any_out = true;
+            }
+        }
+        if (engine)
+        {
+            const uint8_t *data;
+            size_t len;
+            while ((data = jitter.get(&len, now)) != nullptr)
+            {
+                // The sequence number is still in front of the data
+                uint16_t seq = data[-2] | (data[-1] << 8);
+                for (uint32_t b : seq_bytes[seq])
+                {
+                    res.latency.push_back(now - sent_at[b]);
+                    if (any_out && b <= last_out)
+                        res.out_of_order++;
+                    last_out = b;
+                    any_out = true;
+                }
+            }
+        }
+    }
+
+    std::sort(res.latency.begin(), res.latency.end());
+    res.missing = sent_at.size() > res.latency.size() ? sent_at.size() - res.latency.size() : 0;
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &v, int p)
+{
+    if (v.empty())
+        return 0;
+    return v[(v.size() - 1) * p / 100];
+}
+
+/**
+ * Byte latency percentiles through a jittery network, old handling against new
+ */
+int main()
+{
+    sim_result old_res, new_res;
+
+    sim_run(false, old_res);
+    sim_run(true, new_res);
+
+    printf("UDP stream old: %u packets, latency p50 %u p90 %u p99 %u us, %u bytes out of order\n",
+           old_res.packets, percentile(old_res.latency, 50), percentile(old_res.latency, 90),
+           percentile(old_res.latency, 99), old_res.out_of_order);
+    printf("UDP stream new: %u packets, latency p50 %u p90 %u p99 %u us, %u bytes out of order, %u missing\n",
+           new_res.packets, percentile(new_res.latency, 50), percentile(new_res.latency, 90),
+           percentile(new_res.latency, 99), new_res.out_of_order, new_res.missing);
+
+    // Nothing out of order and the pause costs less than before
+    if (new_res.overflows > 0 || new_res.out_of_order > 0 ||
+        percentile(new_res.latency, 50) >= percentile(old_res.latency, 50))
+    {
+        printf("UDP stream new handling is no better than the old\n");
+        return 1;
+    }
+    return 0;
+}
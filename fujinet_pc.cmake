@@ -166,6 +166,7 @@ set(SOURCES src/main.cpp
     lib/hardware/fnUARTUnix.cpp lib/hardware/fnUARTWindows.cpp
     lib/hardware/fnSystem.h lib/hardware/fnSystem.cpp lib/hardware/fnSystemNet.cpp
     lib/FileSystem/fnDirCache.h lib/FileSystem/fnDirCache.cpp
+    lib/FileSystem/fnCacheKey.h lib/FileSystem/fnCacheKey.cpp
     lib/FileSystem/fnFileCache.h lib/FileSystem/fnFileCache.cpp
     lib/FileSystem/fnFS.h lib/FileSystem/fnFS.cpp
     lib/FileSystem/fnFsSPIFFS.h lib/FileSystem/fnFsSPIFFS.cpp
@@ -179,17 +180,21 @@ set(SOURCES src/main.cpp
     lib/FileSystem/fnFileTNFS.h lib/FileSystem/fnFileTNFS.cpp
     lib/FileSystem/fnFileSMB.h lib/FileSystem/fnFileSMB.cpp
     lib/FileSystem/fnFileMem.h lib/FileSystem/fnFileMem.cpp
+    lib/FileSystem/fnFileHTTPRange.h lib/FileSystem/fnFileHTTPRange.cpp
     lib/FileSystem/fnio.h lib/FileSystem/fnio.cpp
     lib/tcpip/fnDNS.h lib/tcpip/fnDNS.cpp
     lib/tcpip/fnUDP.h lib/tcpip/fnUDP.cpp
+    lib/tcpip/fnUDPStream.h lib/tcpip/fnUDPStream.cpp
     lib/tcpip/fnTcpClient.h lib/tcpip/fnTcpClient.cpp
     lib/tcpip/fnTcpServer.h lib/tcpip/fnTcpServer.cpp
     lib/ftp/fnFTP.h lib/ftp/fnFTP.cpp
     lib/TNFSlib/tnfslibMountInfo.h lib/TNFSlib/tnfslibMountInfo.cpp
+    lib/TNFSlib/tnfslibConnection.h lib/TNFSlib/tnfslibConnection.cpp
     lib/TNFSlib/tnfslib.h lib/TNFSlib/tnfslib.cpp
     lib/TNFSlib/tnfslib_udp.h lib/TNFSlib/tnfslib_udp_testing.cpp
     lib/telnet/libtelnet.h lib/telnet/libtelnet.c
     lib/fnjson/fnjson.h lib/fnjson/fnjson.cpp
+    lib/fnjson/fnjsonstream.h lib/fnjson/fnjsonstream.cpp
     components_pc/mongoose/mongoose.h components_pc/mongoose/mongoose.c
     lib/webdav/WebDAV.h lib/webdav/WebDAV.cpp
     lib/webdav/IndexParser.h lib/webdav/IndexParser.cpp
@@ -209,6 +214,7 @@ set(SOURCES src/main.cpp
     lib/printer-emulator/atari_825.h lib/printer-emulator/atari_825.cpp
     lib/printer-emulator/atari_xdm121.h lib/printer-emulator/atari_xdm121.cpp
     lib/printer-emulator/atari_xmm801.h lib/printer-emulator/atari_xmm801.cpp
+    lib/printer-emulator/deflate_stream.h lib/printer-emulator/deflate_stream.cpp
     lib/printer-emulator/epson_80.h lib/printer-emulator/epson_80.cpp
     lib/printer-emulator/epson_tps.h
     lib/printer-emulator/file_printer.h lib/printer-emulator/file_printer.cpp
@@ -221,6 +227,7 @@ set(SOURCES src/main.cpp
     lib/network-protocol/NetworkProtocolFactory.h
     lib/network-protocol/network_data.h
     lib/network-protocol/networkStatus.h lib/network-protocol/status_error_codes.h
+    lib/network-protocol/NetworkBuffer.h lib/network-protocol/NetworkBuffer.cpp
     lib/network-protocol/Protocol.h lib/network-protocol/Protocol.cpp
     lib/network-protocol/ProtocolParser.h lib/network-protocol/ProtocolParser.cpp
     lib/network-protocol/Test.h lib/network-protocol/Test.cpp
@@ -236,7 +243,10 @@ set(SOURCES src/main.cpp
     lib/network-protocol/SD.h lib/network-protocol/SD.cpp
     lib/fuji/fujiCmd.h
     lib/fuji/fujiHost.h lib/fuji/fujiHost.cpp
+    lib/fuji/fujiHostSessions.h lib/fuji/fujiHostSessions.cpp
     lib/fuji/fujiDisk.h lib/fuji/fujiDisk.cpp
+    lib/fuji/fujiCopy.h lib/fuji/fujiCopy.cpp
+    lib/fuji/fujiDirPage.h lib/fuji/fujiDirPage.cpp
     lib/bus/bus.h
     lib/device/device.h
     lib/device/disk.h
@@ -267,6 +277,7 @@ if(FUJINET_TARGET STREQUAL "ATARI")
     lib/bus/sio/siocom/netsio.h lib/bus/sio/siocom/netsio.cpp
     lib/bus/sio/siocom/fnSioCom.h lib/bus/sio/siocom/fnSioCom.cpp
     lib/media/atari/diskType.h lib/media/atari/diskType.cpp
+    lib/media/atari/diskCache.h lib/media/atari/diskCache.cpp
     lib/media/atari/diskTypeAtr.h lib/media/atari/diskTypeAtr.cpp
     lib/media/atari/diskTypeAtx.h lib/media/atari/diskTypeAtx.cpp
     lib/media/atari/diskTypeXex.h lib/media/atari/diskTypeXex.cpp
@@ -317,6 +328,7 @@ if(FUJINET_TARGET STREQUAL "APPLE")
     lib/media/apple/mediaTypeDSK.h lib/media/apple/mediaTypeDSK.cpp
     lib/media/apple/mediaTypePO.h lib/media/apple/mediaTypePO.cpp
     lib/media/apple/mediaTypeWOZ.h lib/media/apple/mediaTypeWOZ.cpp
+    lib/media/apple/trackCache.h lib/media/apple/trackCache.cpp
 
     lib/device/iwm/disk.h lib/device/iwm/disk.cpp
     lib/device/iwm/disk2.h lib/device/iwm/disk2.cpp
@@ -463,6 +475,64 @@ if(CMAKE_SYSTEM_NAME STREQUAL "Windows")
     target_link_libraries(fujinet ws2_32 bcrypt)
 endif()
 
+# Host benchmarks, not part of fujinet or the unit tests
+option(FUJINET_BENCHMARKS "Build the host benchmarks" OFF)
+if(FUJINET_BENCHMARKS)
+    add_executable(bench_udpstream bench/bench_udpstream.cpp lib/tcpip/fnUDPStream.cpp)
+    target_include_directories(bench_udpstream PRIVATE include)
+    target_compile_definitions(bench_udpstream PRIVATE UNIT_TESTS)
+
+    add_executable(bench_cachekey bench/bench_cachekey.cpp lib/FileSystem/fnCacheKey.cpp)
+    target_include_directories(bench_cachekey PRIVATE ${MBEDTLS_INCLUDE_DIR})
+    target_link_libraries(bench_cachekey ${CRYPTO_LIBS})
+
+    add_executable(bench_png_deflate bench/bench_png_deflate.cpp lib/printer-emulator/deflate_stream.cpp)
+    target_include_directories(bench_png_deflate PRIVATE include)
+    target_compile_definitions(bench_png_deflate PRIVATE UNIT_TESTS)
+
+    add_executable(bench_network_buffer bench/bench_network_buffer.cpp lib/network-protocol/NetworkBuffer.cpp)
+    target_include_directories(bench_network_buffer PRIVATE include)
+    target_compile_definitions(bench_network_buffer PRIVATE UNIT_TESTS)
+
+    add_executable(bench_networkprotocol_translation bench/bench_networkprotocol_translation.cpp
+        lib/network-protocol/Protocol.cpp lib/network-protocol/NetworkBuffer.cpp
+        lib/utils/utils.cpp lib/utils/string_utils.cpp lib/utils/U8Char.cpp lib/utils/punycode.cpp
+        lib/utils/peoples_url_parser.cpp lib/compat/strlcpy.c lib/compat/strlcat.c lib/compat/compat_gettimeofday.c)
+    target_include_directories(bench_networkprotocol_translation PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR})
+    target_compile_definitions(bench_networkprotocol_translation PRIVATE UNIT_TESTS)
+    target_link_libraries(bench_networkprotocol_translation ${CRYPTO_LIBS})
+
+    add_executable(bench_fnjson_stream bench/bench_fnjson_stream.cpp
+        lib/fnjson/fnjson.cpp lib/fnjson/fnjsonstream.cpp
+        lib/network-protocol/Protocol.cpp lib/network-protocol/NetworkBuffer.cpp
+        lib/utils/utils.cpp lib/utils/string_utils.cpp lib/utils/U8Char.cpp lib/utils/punycode.cpp
+        lib/utils/peoples_url_parser.cpp lib/compat/strlcpy.c lib/compat/strlcat.c lib/compat/compat_gettimeofday.c)
+    target_include_directories(bench_fnjson_stream PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR})
+    target_compile_definitions(bench_fnjson_stream PRIVATE UNIT_TESTS)
+    target_link_libraries(bench_fnjson_stream cjson cjson_utils ${CRYPTO_LIBS})
+
+    add_executable(bench_http_range bench/bench_http_range.cpp
+        lib/FileSystem/fnFileHTTPRange.cpp lib/FileSystem/fnFile.cpp)
+    target_include_directories(bench_http_range PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR})
+    target_compile_definitions(bench_http_range PRIVATE UNIT_TESTS)
+
+    if(FUJINET_TARGET STREQUAL "ATARI")
+        add_executable(bench_atr_writeback bench/bench_atr_writeback.cpp
+            lib/media/atari/diskTypeAtr.cpp lib/media/atari/diskType.cpp lib/media/atari/diskCache.cpp
+            lib/FileSystem/fnFile.cpp lib/FileSystem/fnFileLocal.cpp)
+        target_include_directories(bench_atr_writeback PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR})
+        target_compile_definitions(bench_atr_writeback PRIVATE UNIT_TESTS)
+    endif()
+
+    if(FUJINET_TARGET STREQUAL "APPLE")
+        add_executable(bench_dsk_nibble bench/bench_dsk_nibble.cpp
+            lib/media/apple/mediaTypeDSK.cpp lib/media/apple/mediaTypeWOZ.cpp
+            lib/media/apple/trackCache.cpp lib/media/apple/mediaType.cpp)
+        target_include_directories(bench_dsk_nibble PRIVATE ${INCLUDE_DIRS} ${MBEDTLS_INCLUDE_DIR})
+        target_compile_definitions(bench_dsk_nibble PRIVATE UNIT_TESTS)
+    endif()
+endif()
+
 # Version file
 # run build_version_pc.py to generate ${CMAKE_BINARY_DIR}/include/build_version.h
 add_custom_command(
@@ -0,0 +1,156 @@
+#include "fnCacheKey.h"
+
+#include <cstring>
+
+
+static const char BASE32_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+static inline uint32_t rotl32(uint32_t x, int8_t r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t fmix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint32_t getblock32(const uint8_t *p)
+{
+    // Byte-wise little-endian read: input is a string, so it is not necessarily aligned
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// MurmurHash3_x86_128 by Austin Appleby, placed in the public domain
+void cache_hash128(const void *data, size_t len, uint32_t seed, uint8_t out[16])
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    const size_t nblocks = len / 16;
+
+    uint32_t h1 = seed;
+    uint32_t h2 = seed;
+    uint32_t h3 = seed;
+    uint32_t h4 = seed;
+
+    const uint32_t c1 = 0x239b961b;
+    const uint32_t c2 = 0xab0e9789;
+    const uint32_t c3 = 0x38b34ae5;
+    const uint32_t c4 = 0xa1e38b93;
+
+    // body
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        const uint8_t *block = bytes + i * 16;
+        uint32_t k1 = getblock32(block);
+        uint32_t k2 = getblock32(block + 4);
+        uint32_t k3 = getblock32(block + 8);
+        uint32_t k4 = getblock32(block + 12);
+
+        k1 *= c1; k1 = rotl32(k1, 15); k1 *= c2; h1 ^= k1;
+        h1 = rotl32(h1, 19); h1 += h2; h1 = h1 * 5 + 0x561ccd1b;
+
+        k2 *= c2; k2 = rotl32(k2, 16); k2 *= c3; h2 ^= k2;
+        h2 = rotl32(h2, 17); h2 += h3; h2 = h2 * 5 + 0x0bcaa747;
+
+        k3 *= c3; k3 = rotl32(k3, 17); k3 *= c4; h3 ^= k3;
+        h3 = rotl32(h3, 15); h3 += h4; h3 = h3 * 5 + 0x96cd1c35;
+
+        k4 *= c4; k4 = rotl32(k4, 18); k4 *= c1; h4 ^= k4;
+        h4 = rotl32(h4, 13); h4 += h1; h4 = h4 * 5 + 0x32ac3b17;
+    }
+
+    // tail
+    const uint8_t *tail = bytes + nblocks * 16;
+    uint32_t k1 = 0;
+    uint32_t k2 = 0;
+    uint32_t k3 = 0;
+    uint32_t k4 = 0;
+
+    switch (len & 15)
+    {
+    case 15: k4 ^= tail[14] << 16; [[fallthrough]];
+    case 14: k4 ^= tail[13] << 8; [[fallthrough]];
+    case 13: k4 ^= tail[12] << 0;
+             k4 *= c4; k4 = rotl32(k4, 18); k4 *= c1; h4 ^= k4; [[fallthrough]];
+    case 12: k3 ^= (uint32_t)tail[11] << 24; [[fallthrough]];
+    case 11: k3 ^= tail[10] << 16; [[fallthrough]];
+    case 10: k3 ^= tail[9] << 8; [[fallthrough]];
+    case 9:  k3 ^= tail[8] << 0;
+             k3 *= c3; k3 = rotl32(k3, 17); k3 *= c4; h3 ^= k3; [[fallthrough]];
+    case 8:  k2 ^= (uint32_t)tail[7] << 24; [[fallthrough]];
+    case 7:  k2 ^= tail[6] << 16; [[fallthrough]];
+    case 6:  k2 ^= tail[5] << 8; [[fallthrough]];
+    case 5:  k2 ^= tail[4] << 0;
+             k2 *= c2; k2 = rotl32(k2, 16); k2 *= c3; h2 ^= k2; [[fallthrough]];
+    case 4:  k1 ^= (uint32_t)tail[3] << 24; [[fallthrough]];
+    case 3:  k1 ^= tail[2] << 16; [[fallthrough]];
+    case 2:  k1 ^= tail[1] << 8; [[fallthrough]];
+    case 1:  k1 ^= tail[0] << 0;
+             k1 *= c1; k1 = rotl32(k1, 15); k1 *= c2; h1 ^= k1;
+    }
+
+    // finalization
+    h1 ^= len; h2 ^= len; h3 ^= len; h4 ^= len;
+
+    h1 += h2; h1 += h3; h1 += h4;
+    h2 += h1; h3 += h1; h4 += h1;
+
+    h1 = fmix32(h1);
+    h2 = fmix32(h2);
+    h3 = fmix32(h3);
+    h4 = fmix32(h4);
+
+    h1 += h2; h1 += h3; h1 += h4;
+    h2 += h1; h3 += h1; h4 += h1;
+
+    uint32_t h[4] = { h1, h2, h3, h4 };
+    for (int i = 0; i < 4; i++)
+    {
+        out[i * 4 + 0] = h[i] & 0xFF;
+        out[i * 4 + 1] = (h[i] >> 8) & 0xFF;
+        out[i * 4 + 2] = (h[i] >> 16) & 0xFF;
+        out[i * 4 + 3] = (h[i] >> 24) & 0xFF;
+    }
+}
+
+size_t cache_base32(const uint8_t *data, size_t len, char *out)
+{
+    size_t n = 0;
+    uint32_t buffer = 0;
+    int bits = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        buffer = (buffer << 8) | data[i];
+        bits += 8;
+        while (bits >= 5)
+        {
+            bits -= 5;
+            out[n++] = BASE32_ALPHABET[(buffer >> bits) & 0x1F];
+        }
+    }
+    if (bits > 0)
+        out[n++] = BASE32_ALPHABET[(buffer << (5 - bits)) & 0x1F];
+
+    out[n] = '\0';
+    return n;
+}
+
+void cache_key(const char *host, const char *path, char out[CACHE_KEY_LEN + 1])
+{
+    uint8_t hash[16];
+
+    // host part: 40 bits -> 8 chars
+    cache_hash128(host, strlen(host), 0, hash);
+    size_t n = cache_base32(hash, 5, out);
+    out[n++] = '-';
+
+    // path part: 120 bits -> 24 chars
+    cache_hash128(path, strlen(path), 0, hash);
+    cache_base32(hash, 15, out + n);
+}
@@ -0,0 +1,38 @@
+#ifndef FN_CACHEKEY_H
+#define FN_CACHEKEY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Length of a cache key string, without the terminating zero:
+// 8 base32 chars for the host, '-', 24 base32 chars for the path
+#define CACHE_KEY_LEN 33
+
+/**
+ * @brief 128-bit non-cryptographic hash (MurmurHash3 x86_128)
+ * Uses only 32-bit arithmetic so it is equally fast on ESP32 and PC.
+ * @param data bytes to hash
+ * @param len number of bytes
+ * @param seed hash seed
+ * @param out 16 byte result
+ */
+void cache_hash128(const void *data, size_t len, uint32_t seed, uint8_t out[16]);
+
+/**
+ * @brief Encode bytes as unpadded RFC 4648 base32 using a lookup table
+ * @param data bytes to encode
+ * @param len number of bytes
+ * @param out destination, must hold (len * 8 + 4) / 5 chars plus a terminating zero
+ * @return number of chars written, not counting the terminating zero
+ */
+size_t cache_base32(const uint8_t *data, size_t len, char *out);
+
+/**
+ * @brief Derive the SD cache file name for a host and path without heap allocation
+ * @param host name from host slot
+ * @param path file path from device slot
+ * @param out destination, must hold CACHE_KEY_LEN + 1 chars
+ */
+void cache_key(const char *host, const char *path, char out[CACHE_KEY_LEN + 1]);
+
+#endif // FN_CACHEKEY_H
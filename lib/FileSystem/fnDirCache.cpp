@@ -1,116 +1,180 @@
-
 #include "fnDirCache.h"
 
 #include <cstring>
+#include <cctype>
 #include <algorithm>
 #include "compat_string.h"
 
-#include "utils.h"
-
+#include "../../include/debug.h"
 
-bool _fsdir_sort_name_ascend(fsdir_entry &left, fsdir_entry &right)
-{
-    if (left.isDir == right.isDir)
-        return strcasecmp(left.filename, right.filename) < 0;
-    else
-        return left.isDir;
-}
+#include "utils.h"
 
-bool _fsdir_sort_name_descend(fsdir_entry &left, fsdir_entry &right)
-{
-    if (left.isDir == right.isDir)
-        return strcasecmp(left.filename, right.filename) > 0;
-    else
-        return left.isDir;
-}
 
-bool _fsdir_sort_time_ascend(fsdir_entry &left, fsdir_entry &right)
+void DirCache::clear()
 {
-    if (left.isDir == right.isDir)
-        return left.modified_time > right.modified_time;
-    else
-        return left.isDir;
+    // Swap with empty vectors so a big listing gives its memory back
+    std::vector<char>().swap(_names);
+    std::vector<dircache_record>().swap(_records);
+    std::vector<uint16_t>().swap(_sorted);
+    std::vector<uint16_t>().swap(_filtered);
+    _current = 0;
+    _sort_valid = false;
+    _filter_valid = false;
+    _pattern.clear();
+    _mtime = 0;
 }
 
-bool _fsdir_sort_time_descend(fsdir_entry &left, fsdir_entry &right)
+void DirCache::add_entry(const char *filename, bool isDir, uint32_t size, time_t modified_time)
 {
-    if (left.isDir == right.isDir)
-        return left.modified_time < right.modified_time;
-    else
-        return left.isDir;
-}
+    if (_records.size() >= DIRCACHE_MAX_ENTRIES)
+    {
+        Debug_printf("DirCache::add_entry - too many entries, skipping \"%s\"\n", filename);
+        return;
+    }
 
-typedef bool (*sort_fn_t)(fsdir_entry &left, fsdir_entry &right);
+    dircache_record r;
+    r.name = _names.size();
+    r.key = 0;
+    r.size = size;
+    r.modified_time = modified_time;
+    r.isDir = isDir;
 
+    // Shorter names pad with 0 so they sort first, as strcasecmp does
+    for (int i = 0; i < 4; i++)
+    {
+        r.key <<= 8;
+        if (filename[i] == '\0')
+        {
+            r.key <<= 8 * (3 - i);
+            break;
+        }
+        r.key |= (uint8_t)tolower((unsigned char)filename[i]);
+    }
 
-void DirCache::clear()
-{
-    _entries.clear();
-    _entries_filtered.clear();
-    _current = 0;
+    _names.insert(_names.end(), filename, filename + strlen(filename) + 1);
+    _records.push_back(r);
+    _sort_valid = false;
+    _filter_valid = false;
 }
 
-fsdir_entry &DirCache::new_entry()
+fsdir_entry *DirCache::get_entry(uint16_t index)
 {
-    _entries.push_back(fsdir_entry());
-    return _entries.back();
+    const dircache_record &r = _records[index];
+    strlcpy(_entry.filename, &_names[r.name], sizeof(_entry.filename));
+    _entry.isDir = r.isDir;
+    _entry.size = r.size;
+    _entry.modified_time = r.modified_time;
+    return &_entry;
 }
 
-void DirCache::apply_filter(const char *pattern, uint16_t diropts)
+// Look up an unfiltered entry by name, nullptr if not found
+const fsdir_entry *DirCache::find(const char *filename)
 {
-	char realpat[MAX_PATHLEN];
-	//char *thepat = nullptr;
-    bool have_pattern = pattern != nullptr && pattern[0] != '\0';
-	bool filter_dirs = have_pattern && pattern[strlen(pattern)-1] == '/';
-	if (filter_dirs) {
-		strlcpy (realpat, pattern, sizeof (realpat));
-		realpat[strlen(realpat)-1] = '\0';
-	}
-	//thepat = filter_dirs ? realpat : (char *)pattern;
-    fsdir_entry entry;
-
-    // Filter directory entries
-    _entries_filtered.clear();
-    for (unsigned i=0; i<_entries.size(); ++i)
+    for (uint16_t i = 0; i < _records.size(); ++i)
     {
-        entry = _entries[i];
-        // Skip this entry if we have a search filter and it doesn't match it
-		// HCGIII: Include directory filtering if specified
-        if(have_pattern && (
-			!entry.isDir || (entry.isDir && filter_dirs)
-		) && util_wildcard_match(entry.filename, pattern) == false)
-            continue;
-        _entries_filtered.push_back(entry);
+        if (strcmp(&_names[_records[i].name], filename) == 0)
+            return get_entry(i);
     }
+    return nullptr;
+}
+
+/*
+  Orders all records for the given DIR_OPTION_ sort options: directories
+  first, then by name or by time. "Ascending" by time is newest first.
+*/
+void DirCache::sort(uint16_t sort_opts)
+{
+    if (_sort_valid && sort_opts == _sort_opts)
+        return;
+
+    _sorted.resize(_records.size());
+    for (uint16_t i = 0; i < _sorted.size(); ++i)
+        _sorted[i] = i;
+
+    const dircache_record *recs = _records.data();
+    const char *names = _names.data();
+    bool descending = sort_opts & DIR_OPTION_DESCENDING;
 
-    // Choose the appropriate sorting function
-    sort_fn_t sortfn;
-    if (diropts & DIR_OPTION_FILEDATE)
+    if (sort_opts & DIR_OPTION_FILEDATE)
     {
-        sortfn = (diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_time_descend : _fsdir_sort_time_ascend;
+        std::sort(_sorted.begin(), _sorted.end(), [recs, descending](uint16_t l, uint16_t r) {
+            const dircache_record &left = recs[l];
+            const dircache_record &right = recs[r];
+            if (left.isDir != right.isDir)
+                return left.isDir;
+            return descending ? left.modified_time < right.modified_time
+                              : left.modified_time > right.modified_time;
+        });
     }
     else
     {
-        sortfn = (diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_name_descend : _fsdir_sort_name_ascend;
+        std::sort(_sorted.begin(), _sorted.end(), [recs, names, descending](uint16_t l, uint16_t r) {
+            const dircache_record &left = recs[l];
+            const dircache_record &right = recs[r];
+            if (left.isDir != right.isDir)
+                return left.isDir;
+            int cmp;
+            if (left.key != right.key)
+                cmp = left.key < right.key ? -1 : 1;
+            else
+                cmp = strcasecmp(names + left.name, names + right.name);
+            return descending ? cmp > 0 : cmp < 0;
+        });
     }
 
-    // Sort directory entries
-    std::sort(_entries_filtered.begin(), _entries_filtered.end(), sortfn);
+    _sort_opts = sort_opts;
+    _sort_valid = true;
+    _filter_valid = false;
+}
+
+void DirCache::apply_filter(const char *pattern, uint16_t diropts)
+{
     // rewind read cursor
     _current = 0;
+
+    sort(diropts & (DIR_OPTION_DESCENDING | DIR_OPTION_FILEDATE));
+
+    if (pattern == nullptr)
+        pattern = "";
+    if (_filter_valid && _pattern == pattern)
+        return;
+
+    // A pattern ending in '/' applies to directories too
+    char realpat[MAX_PATHLEN];
+    strlcpy(realpat, pattern, sizeof(realpat));
+    size_t patlen = strlen(realpat);
+    bool have_pattern = patlen > 0;
+    bool filter_dirs = have_pattern && realpat[patlen - 1] == '/';
+    if (filter_dirs)
+        realpat[patlen - 1] = '\0';
+
+    // Walking the sorted order keeps the filtered list sorted
+    _filtered.clear();
+    _filtered.reserve(_sorted.size());
+    for (uint16_t i : _sorted)
+    {
+        const dircache_record &r = _records[i];
+        // Skip this entry if we have a search filter and it doesn't match it
+        if (have_pattern && (!r.isDir || filter_dirs) && util_wildcard_match(&_names[r.name], realpat) == false)
+            continue;
+        _filtered.push_back(i);
+    }
+
+    _pattern = pattern;
+    _filter_valid = true;
 }
 
 fsdir_entry *DirCache::read()
 {
-    if(_current < _entries_filtered.size())
-        return &_entries_filtered[_current++];
+    if(_current < _filtered.size())
+        return get_entry(_filtered[_current++]);
     else
         return nullptr;
 }
 
 uint16_t DirCache::tell()
 {
-    if(_entries_filtered.empty())
+    if(_filtered.empty())
         return FNFS_INVALID_DIRPOS;
     else
         return _current;
@@ -118,7 +182,7 @@ uint16_t DirCache::tell()
 
 bool DirCache::seek(uint16_t pos)
 {
-    if(pos <= _entries_filtered.size())
+    if(pos <= _filtered.size())
     {
         _current = pos;
         return true;
@@ -1,30 +1,73 @@
 #ifndef FN_DIRCACHE_H
 #define FN_DIRCACHE_H
 
+#include <string>
 #include <vector>
 
 #include "fnFS.h"
 
+/*
+  Directory listing kept as fixed-size records with all the names packed
+  back to back in one pool, so an entry costs its name plus a few words
+  instead of a whole fsdir_entry.
+
+  Each record carries a sort key made from the first bytes of its name,
+  case-folded once when it's added; most comparisons never touch the names.
+  The sorted order for the last sort option is kept, and filtering walks it
+  to build the list of record numbers that read() steps through, so a new
+  pattern doesn't sort again and reopening with the same pattern and options
+  doesn't filter again either.
+
+  Entries returned by read() and find() are filled into one fsdir_entry in
+  the cache and stay valid until the next call to either.
+*/
+
+#define DIRCACHE_MAX_ENTRIES 0xFFFE // Positions are 16 bits and 0xFFFF is FNFS_INVALID_DIRPOS
+
 class DirCache
 {
 private:
-    std::vector<fsdir_entry> _entries;
-    std::vector<fsdir_entry> _entries_filtered;
+    struct dircache_record
+    {
+        uint32_t name;          // Offset of the NUL terminated name in _names
+        uint32_t key;           // First 4 bytes of the name, lower case, big endian
+        uint32_t size;
+        time_t modified_time;
+        bool isDir;
+    };
+
+    std::vector<char> _names;
+    std::vector<dircache_record> _records;
+    std::vector<uint16_t> _sorted;   // All records, in _sort_opts order
+    std::vector<uint16_t> _filtered; // Matching records, in _sort_opts order
     uint16_t _current = 0;
 
-public:
-    // DirCache();
-    // ~DirCache();
+    uint16_t _sort_opts = 0;
+    bool _sort_valid = false;
+    std::string _pattern;
+    bool _filter_valid = false;
+
+    time_t _mtime = 0;
+    fsdir_entry _entry;
+
+    fsdir_entry *get_entry(uint16_t index);
+    void sort(uint16_t sort_opts);
 
+public:
     void clear();
-    fsdir_entry &new_entry();
+    void add_entry(const char *filename, bool isDir, uint32_t size, time_t modified_time);
     void apply_filter(const char *pattern, uint16_t diropts);
 
-    bool empty() {return _entries.empty();}
+    bool empty() {return _records.empty();}
+    const fsdir_entry *find(const char *filename);
+
+    // Modified time of the directory the entries came from, 0 if unknown
+    time_t mtime() {return _mtime;}
+    void set_mtime(time_t mtime) {_mtime = mtime;}
 
     fsdir_entry *read();
     uint16_t tell();
     bool seek(uint16_t pos);
 };
 
-#endif // FN_DIRCACHE_H
\ No newline at end of file
+#endif // FN_DIRCACHE_H
@@ -75,6 +75,9 @@ public:
     virtual bool is_global() { return false; };
 
     virtual bool running() { return _started; };
+    // Exchange something with the server so an idle session isn't dropped.
+    // False if the session is gone and has to be started again.
+    virtual bool keep_alive() { return running(); };
     virtual const char * basepath() { return _basepath; };
     
     virtual fsType type()=0;
@@ -2,15 +2,13 @@
 
 #ifndef FNIO_IS_STDIO
 
+#include <climits>
 #include <cstring>
 
-#include <iostream>
-#include <bitset>
 #include <string>
+#include <vector>
 #include <algorithm>
-
-// TODO: Replace MD5 with some simple non-crypto hash function producing 128+ bit hash ...
-#include <mbedtls/md5.h>
+#include <mutex>
 
 #include "../../include/debug.h"
 
@@ -20,92 +18,344 @@
 #include "compat_gettimeofday.h"
 #endif
 
+#include "fnCacheKey.h"
 #include "fnFileMem.h"
 #include "fnFsSD.h"
 
 
 // Directory on SD card used as file cache
 #define FILE_CACHE_DIRECTORY    "/FujiNet/cache"
-// Files in SD cache older than this value (second since mtime) are considered as expired
+// Index of cached files, one tab separated line per entry
+#define FILE_CACHE_INDEX        FILE_CACHE_DIRECTORY "/INDEX"
+// Files in SD cache older than this value (second since mtime) are considered as expired,
+// used only if the server did not give us anything to revalidate against
 #define CACHE_FILE_MAX_AGE      10800
+// Access times changed by cache hits are written to the index at most this often (seconds)
+#define INDEX_SAVE_INTERVAL     60
+// Default budget for all files in SD cache
+#define DEFAULT_CACHE_MAX_SIZE  (64ULL * 1024 * 1024)
 // Files over this size are changed from in memory to SD
 #define DEFAULT_PERSISTENT_THRESHOLD  204800
 #define COPY_BLK_SIZE           4096
 
 
-static const std::string BASE32_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+/**
+ * @brief Encode host and path into string suitable for file name
+ */
+static std::string encode_host_path(const char *host, const char *path)
+{
+    char key[CACHE_KEY_LEN + 1];
+    cache_key(host, path, key);
+    return std::string(key, CACHE_KEY_LEN);
+}
+
+static std::string get_file_path(const std::string &name)
+{
+    return std::string(FILE_CACHE_DIRECTORY) + '/' + name;
+}
 
-static std::string encode_base32(const std::string& data) 
+// What we know about each file in the SD cache
+struct fc_index_entry
 {
-    std::string binary_string;
-    for (char c : data) 
+    std::string name;       // cache file name, derived from host and path
+    uint32_t size;          // cache file size
+    long created;           // when the file was cached
+    long last_access;       // last cache hit, used for LRU eviction
+    uint32_t remote_size;   // size reported by the server when cached, 0 if unknown
+    std::string remote_tag; // mtime/ETag/Last-Modified reported by the server, empty if unknown
+    std::string host;
+    std::string path;
+    int open = 0;           // handles given out and not closed yet, never evicted while > 0
+};
+
+// Open files are read from the bus task and copied from background copy tasks
+static std::mutex _index_mutex; // Guards everything below
+static std::vector<fc_index_entry> _index;
+static bool _index_loaded = false;
+static long _index_saved = 0;
+static uint64_t _max_size = DEFAULT_CACHE_MAX_SIZE;
+static fc_stats _stats = {};
+
+/**
+ * @brief SD cache file handed out by FileCache, counted as open in the index until it's closed
+ */
+class FileHandlerCacheEntry : public FileHandler
+{
+private:
+    FileHandler *_fh;
+    std::string _name;
+
+public:
+    FileHandlerCacheEntry(FileHandler *fh, const std::string &name) : _fh(fh), _name(name) {}
+    virtual ~FileHandlerCacheEntry() override { if (_fh != nullptr) close(false); }
+
+    virtual int close(bool destroy=true) override;
+    virtual int seek(long int off, int whence) override { return _fh->seek(off, whence); }
+    virtual long int tell() override { return _fh->tell(); }
+    virtual size_t read(void *ptr, size_t size, size_t n) override { return _fh->read(ptr, size, n); }
+    virtual size_t write(const void *ptr, size_t size, size_t n) override { return _fh->write(ptr, size, n); }
+    virtual int flush() override { return _fh->flush(); }
+    virtual int eof() override { return _fh->eof(); }
+};
+
+static long now_sec()
+{
+    struct timeval now;
+#ifdef ESP_PLATFORM
+    gettimeofday(&now, nullptr);
+#else
+    compat_gettimeofday(&now, nullptr);
+#endif
+    return now.tv_sec;
+}
+
+static void index_save()
+{
+    FILE *f = fnSDFAT.file_open(FILE_CACHE_INDEX, "wb");
+    if (f == nullptr)
     {
-        binary_string += std::bitset<8>(c).to_string();
+        Debug_println("FileCache - failed to write index");
+        return;
     }
-    int padding = binary_string.length() % 5;
-    if (padding != 0) binary_string.append(5 - padding, '0');
-    std::string encoded;
-    for (size_t i = 0; i < binary_string.length(); i += 5) 
+    for (const fc_index_entry &e : _index)
     {
-        encoded += BASE32_ALPHABET[std::stoi(binary_string.substr(i, 5), nullptr, 2)];
+        fprintf(f, "%s\t%lu\t%ld\t%ld\t%lu\t%s\t%s\t%s\n", e.name.c_str(),
+                (unsigned long)e.size, e.created, e.last_access, (unsigned long)e.remote_size,
+                e.remote_tag.c_str(), e.host.c_str(), e.path.c_str());
     }
-    while (encoded.length() % 8 != 0) encoded += '=';
-    return encoded;
+    fclose(f);
+    _index_saved = now_sec();
 }
 
-/**
- * @brief Encode host and path into string suitable for file name
- */
-static std::string encode_host_path(const char *host, const char *path)
+// Only access times changed: save once in a while rather than on every hit
+static void index_touched()
+{
+    if (now_sec() - _index_saved >= INDEX_SAVE_INTERVAL)
+        index_save();
+}
+
+static void index_load()
+{
+    if (_index_loaded)
+        return;
+    _index_loaded = true;
+    _index.clear();
+    _stats.bytes_used = 0;
+
+    FILE *f = fnSDFAT.file_open(FILE_CACHE_INDEX, "rb");
+    if (f != nullptr)
+    {
+        char line[1024];
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+            // name, size, created, last access, remote size, remote tag, host, path
+            char *fields[8];
+            int n = 0;
+            char *p = line;
+            while (n < 8)
+            {
+                fields[n++] = p;
+                p = strpbrk(p, "\t\r\n");
+                if (p == nullptr || *p != '\t')
+                {
+                    if (p != nullptr)
+                        *p = '\0';
+                    break;
+                }
+                *p++ = '\0';
+            }
+            if (n < 8 || fields[0][0] == '\0')
+                continue;
+
+            fc_index_entry e;
+            e.name = fields[0];
+            e.size = strtoul(fields[1], nullptr, 10);
+            e.created = strtol(fields[2], nullptr, 10);
+            e.last_access = strtol(fields[3], nullptr, 10);
+            e.remote_size = strtoul(fields[4], nullptr, 10);
+            e.remote_tag = fields[5];
+            e.host = fields[6];
+            e.path = fields[7];
+            _stats.bytes_used += e.size;
+            _index.push_back(std::move(e));
+        }
+        fclose(f);
+        Debug_printf("FileCache - loaded index with %u entries, %llu bytes\n",
+                     (unsigned)_index.size(), (unsigned long long)_stats.bytes_used);
+        return;
+    }
+
+    // No index yet - adopt files left by earlier firmware so they count against the budget
+    if (!fnSDFAT.dir_open(FILE_CACHE_DIRECTORY, nullptr, 0))
+        return;
+    fsdir_entry *de;
+    while ((de = fnSDFAT.dir_read()) != nullptr)
+    {
+        if (de->isDir)
+            continue;
+        fc_index_entry e;
+        e.name = de->filename;
+        e.size = de->size;
+        e.created = e.last_access = de->modified_time;
+        e.remote_size = 0;
+        _stats.bytes_used += e.size;
+        _index.push_back(std::move(e));
+    }
+    fnSDFAT.dir_close();
+    if (!_index.empty())
+        index_save();
+}
+
+static std::vector<fc_index_entry>::iterator index_find(const std::string &name)
+{
+    return std::find_if(_index.begin(), _index.end(),
+                        [&name](const fc_index_entry &e) { return e.name == name; });
+}
+
+static bool index_is_open(const std::string &name)
+{
+    auto it = index_find(name);
+    return it != _index.end() && it->open > 0;
+}
+
+// Count a handle to the entry as open, wrapping it so closing it counts it closed
+static FileHandler *index_open(std::vector<fc_index_entry>::iterator it, FileHandler *fh)
+{
+    if (fh == nullptr)
+        return nullptr;
+    it->open++;
+    return new FileHandlerCacheEntry(fh, it->name);
+}
+
+int FileHandlerCacheEntry::close(bool destroy)
 {
-    unsigned char md5_result[16];
-    std::string result;
-    // host part
-    mbedtls_md5((const unsigned char *)host, strlen(host), md5_result);
-    result = encode_base32(std::string((char *)md5_result, 5)) + '-';
-    // path part
-    mbedtls_md5((const unsigned char *)path, strlen(path), md5_result);
-    result += encode_base32(std::string((char *)md5_result, 15));
+    int result = 0;
+    if (_fh != nullptr)
+    {
+        result = _fh->close();
+        _fh = nullptr;
+
+        std::lock_guard<std::mutex> lock(_index_mutex);
+        auto it = index_find(_name);
+        if (it != _index.end() && it->open > 0)
+            it->open--;
+    }
+    if (destroy) delete this;
     return result;
 }
 
-static std::string get_file_path(const std::string &name)
+static void index_drop(std::vector<fc_index_entry>::iterator it)
 {
-    return std::string(FILE_CACHE_DIRECTORY) + '/' + name;
+    fnSDFAT.remove(get_file_path(it->name).c_str());
+    _stats.bytes_used -= it->size;
+    _index.erase(it);
+}
+
+// Evict least recently used files until the cache fits the budget, never evicting 'keep'
+// or a file that is open, e.g. a mounted disk image
+static void index_enforce_budget(const std::string &keep)
+{
+    while (_stats.bytes_used > _max_size && _index.size() > 1)
+    {
+        auto lru = _index.end();
+        for (auto it = _index.begin(); it != _index.end(); ++it)
+        {
+            if (it->name != keep && it->open == 0 && (lru == _index.end() || it->last_access < lru->last_access))
+                lru = it;
+        }
+        if (lru == _index.end())
+            break;
+        Debug_printf("FileCache - evicting %s (%lu bytes)\n", lru->name.c_str(), (unsigned long)lru->size);
+        _stats.evictions++;
+        _stats.bytes_evicted += lru->size;
+        index_drop(lru);
+    }
+}
+
+void FileCache::set_max_size(uint64_t max_bytes)
+{
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    _max_size = max_bytes;
+}
+
+fc_stats FileCache::get_stats()
+{
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    return _stats;
+}
+
+bool FileCache::cached(const char *host, const char *path)
+{
+    if (!fnSDFAT.running())
+        return false;
+
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    index_load();
+    return index_find(encode_host_path(host, path)) != _index.end();
 }
 
-FileHandler *FileCache::open(const char *host, const char *path, const char *mode)
+FileHandler *FileCache::open(const char *host, const char *path, const char *mode,
+                             uint32_t remote_size, const char *remote_tag)
 {
     FileHandler *fh = nullptr;
 
     if (!fnSDFAT.running())
         return nullptr;
 
-    std::string cache_path(get_file_path(encode_host_path(host, path)));
+    std::lock_guard<std::mutex> lock(_index_mutex);
+    index_load();
 
-    // test file age, do not use old/expired
-    struct timeval now;
-#ifdef ESP_PLATFORM
-    gettimeofday(&now, nullptr);
-#else
-	compat_gettimeofday(&now, nullptr);
-#endif
-    if (now.tv_sec - fnSDFAT.mtime(cache_path.c_str()) < CACHE_FILE_MAX_AGE)
+    std::string name(encode_host_path(host, path));
+    auto it = index_find(name);
+    if (it == _index.end())
+    {
+        _stats.misses++;
+        return nullptr;
+    }
+
+    // Revalidate against what the server reports, falling back to the age limit if it told us nothing
+    bool valid;
+    bool have_tag = remote_tag != nullptr && remote_tag[0] != '\0';
+    if (remote_size != 0 || have_tag)
+    {
+        valid = (remote_size == 0 || remote_size == it->remote_size) &&
+                (!have_tag || it->remote_tag == remote_tag);
+    }
+    else
+    {
+        valid = now_sec() - it->created < CACHE_FILE_MAX_AGE;
+    }
+
+    if (valid)
     {
         // open SD file
-        fh = fnSDFAT.filehandler_open(cache_path.c_str(), mode);
+        fh = fnSDFAT.filehandler_open(get_file_path(name).c_str(), mode);
     }
 
-    if (fh != nullptr)
+    if (fh == nullptr)
     {
-        // Cache hit
-        Debug_printf("Using SD cache file: %s\n", cache_path.c_str());
+        _stats.stale++;
+        _stats.misses++;
+        // Still in use, e.g. mounted: it goes once it's closed and found stale again
+        if (it->open > 0)
+            return nullptr;
+        Debug_printf("Dropping stale SD cache file: %s\n", name.c_str());
+        index_drop(it);
+        index_save();
+        return nullptr;
     }
 
-    return fh;
+    // Cache hit
+    Debug_printf("Using SD cache file: %s\n", name.c_str());
+    _stats.hits++;
+    it->last_access = now_sec();
+    index_touched();
+
+    return index_open(it, fh);
 }
 
-fc_handle *FileCache::create(const char *host, const char *path, int threshold, int max_size)
+fc_handle *FileCache::create(const char *host, const char *path, int threshold, int max_size,
+                             uint32_t remote_size, const char *remote_tag)
 {
     fc_handle *fc;
 
@@ -133,6 +383,8 @@ fc_handle *FileCache::create(const char *host, const char *path, int threshold,
     fc->host = std::string(host);
     fc->path = std::string(path);
     fc->name = encode_host_path(host, path);
+    fc->remote_size = remote_size;
+    fc->remote_tag = remote_tag == nullptr ? "" : remote_tag;
 
     return fc;
 }
@@ -164,6 +416,18 @@ size_t FileCache::write(fc_handle *fc, const void *data, size_t len)
 
         Debug_printf("Writing SD cache file: %s\n", get_file_path(fc->name).c_str());
 
+        // A stale copy still open keeps its file, this one stays in memory
+        {
+            std::lock_guard<std::mutex> lock(_index_mutex);
+            index_load();
+            if (index_is_open(fc->name))
+            {
+                Debug_printf("FileCache::write - %s is open, keeping the new copy in memory\n", fc->name.c_str());
+                fc->threshold = INT_MAX;
+                return result;
+            }
+        }
+
         // Ensure cache directory exists
         fnSDFAT.create_path(FILE_CACHE_DIRECTORY);
 
@@ -190,11 +454,6 @@ size_t FileCache::write(fc_handle *fc, const void *data, size_t len)
         fc->fh->close();
         fc->fh = fh_sd;
         fc->persistent = true;
-        // Write some info into file (optional, not used by anything)
-        fh_sd = fnSDFAT.filehandler_open((get_file_path(fc->name) + ".TXT").c_str(), "wb+");
-        std::string info("Host: "+ fc->host +"\r\nFile: "+ fc->path+ "\r\nCache: "+ fc->name +"\r\n");
-        fh_sd->write(info.c_str(), 1, info.size());
-        fh_sd->close();
         //Debug_println("Changed to SD");
     }
     return result;
@@ -213,7 +472,30 @@ FileHandler *FileCache::reopen(fc_handle *fc, const char *mode)
         // reopen SD cache file
         fc->fh->flush();
         fc->fh->close();
-        fh = fnSDFAT.filehandler_open(get_file_path(fc->name).c_str(), mode);
+
+        // Record the completed file in the index and make room for it
+        std::lock_guard<std::mutex> lock(_index_mutex);
+        index_load();
+        auto it = index_find(fc->name);
+        if (it != _index.end())
+        {
+            _stats.bytes_used -= it->size;
+            _index.erase(it);
+        }
+        fc_index_entry e;
+        e.name = fc->name;
+        e.size = fc->size;
+        e.created = e.last_access = now_sec();
+        e.remote_size = fc->remote_size;
+        e.remote_tag = fc->remote_tag;
+        e.host = fc->host;
+        e.path = fc->path;
+        _stats.bytes_used += e.size;
+        _index.push_back(std::move(e));
+        index_enforce_budget(fc->name);
+        index_save();
+
+        fh = index_open(index_find(fc->name), fnSDFAT.filehandler_open(get_file_path(fc->name).c_str(), mode));
     }
     else
     {
@@ -236,7 +518,15 @@ void FileCache::remove(fc_handle *fc)
     {
         // remove SD cache file
         fnSDFAT.remove(get_file_path(fc->name).c_str());
-        fnSDFAT.remove((get_file_path(fc->name) + ".TXT").c_str());
+        std::lock_guard<std::mutex> lock(_index_mutex);
+        index_load();
+        auto it = index_find(fc->name);
+        if (it != _index.end())
+        {
+            _stats.bytes_used -= it->size;
+            _index.erase(it);
+            index_save();
+        }
     }
     delete fc;
 }
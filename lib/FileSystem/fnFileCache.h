@@ -17,8 +17,20 @@ typedef struct fc_handle
     std::string host;
     std::string path;
     std::string name;
+    uint32_t remote_size;
+    std::string remote_tag;
 } fc_handle;
 
+typedef struct fc_stats
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t stale;         // entries dropped because the server copy changed or they expired
+    uint32_t evictions;     // entries dropped to stay within the size budget
+    uint64_t bytes_evicted;
+    uint64_t bytes_used;    // current size of all indexed cache files
+} fc_stats;
+
 
 class FileCache
 {
@@ -26,12 +38,27 @@ public:
 
    /**
     * @brief Open existing SD cache file
+    * If the server reported size and/or tag (e.g. mtime, HTTP ETag or Last-Modified) are given,
+    * the cached copy is used only if they match what was recorded when it was cached.
+    * Without them, entries expire by age.
     * @param host name from host slot
     * @param path file path from device slot
     * @param mode open mode
+    * @param remote_size size reported by the server, 0 if unknown
+    * @param remote_tag validator reported by the server, nullptr or "" if unknown
     * @return pointer to file handler to use or nullptr on error
     */
-    static FileHandler *open(const char *host, const char *path, const char *mode);
+    static FileHandler *open(const char *host, const char *path, const char *mode,
+                             uint32_t remote_size=0, const char *remote_tag=nullptr);
+
+   /**
+    * @brief Check for an SD cache file without opening it or counting a hit or miss,
+    * e.g. to decide whether asking the server for validators is worth it
+    * @param host name from host slot
+    * @param path file path from device slot
+    * @return true if a cached copy is indexed
+    */
+    static bool cached(const char *host, const char *path);
 
    /**
     * @brief Create new empty cache file, ready for writes, file is created in memory
@@ -39,9 +66,12 @@ public:
     * @param path file path from device slot
     * @param threshold size threshold when in memory file is changed to SD file, < 0 to use default threshold, 0 to start on SD
     * @param max_size maximum file size, < 0 for unlimited
+    * @param remote_size size reported by the server, recorded for later revalidation
+    * @param remote_tag validator reported by the server, recorded for later revalidation
     * @return pointer to fc_handle structure or nullptr on error
     */
-    static fc_handle *create(const char *host, const char *path, int threshold=-1, int max_size=-1);
+    static fc_handle *create(const char *host, const char *path, int threshold=-1, int max_size=-1,
+                             uint32_t remote_size=0, const char *remote_tag=nullptr);
 
    /** 
     * @brief Write data to cache file
@@ -64,6 +94,17 @@ public:
     * fc_handle is deleted and cannot be used anymore.
     */
    static void remove(fc_handle *fc);
+
+   /**
+    * @brief Set the byte budget for all files in the SD cache.
+    * Least recently used files are evicted when a new file would exceed it.
+    */
+   static void set_max_size(uint64_t max_bytes);
+
+   /**
+    * @brief Cache hit/miss/eviction counters since boot
+    */
+   static fc_stats get_stats();
 };
 
 #endif //!FNIO_IS_STDIO
@@ -0,0 +1,302 @@
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "fnFileHTTPRange.h"
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+
+// ms without data before a response is given up on
+#define HTTPRANGE_TIMEOUT 20000
+
+
+FileHandlerHTTPRange::FileHandlerHTTPRange(std::shared_ptr<HTTP_CLIENT_CLASS> http, const std::string &url)
+{
+    Debug_println("new FileHandlerHTTPRange");
+    _http = std::move(http);
+    _url = url;
+    for (int i = 0; i < HTTPRANGE_CACHE_BLOCKS; i++)
+    {
+        _block[i] = -1;
+        _used[i] = 0;
+    }
+}
+
+
+FileHandlerHTTPRange::~FileHandlerHTTPRange()
+{
+    Debug_println("delete FileHandlerHTTPRange");
+    if (_http != nullptr || _cache != nullptr) close(false);
+}
+
+
+bool FileHandlerHTTPRange::open()
+{
+    Debug_printf("FileHandlerHTTPRange::open \"%s\"\n", _url.c_str());
+
+    _cache = (uint8_t *)malloc(HTTPRANGE_CACHE_BLOCKS * HTTPRANGE_BLOCK_SIZE);
+    if (_cache == nullptr)
+    {
+        Debug_println("FileHandlerHTTPRange::open - failed to allocate cache");
+        return false;
+    }
+
+    // The size isn't known until the first answer, which load() takes it from
+    _size = -1;
+    _last_block = -1;
+    return load(0) >= 0;
+}
+
+
+int FileHandlerHTTPRange::request(long first, long last, long *total)
+{
+    char range[40];
+
+    *total = -1;
+    // Another file may have used the client since
+    if (!_http->set_url(_url.c_str()))
+        return -1;
+    snprintf(range, sizeof(range), "bytes=%ld-%ld", first, last);
+    _http->create_empty_stored_headers({"Content-Range"});
+    _http->set_header("Range", range);
+
+    int status = _http->GET();
+    if (status == 206)
+    {
+        // Content-Range: bytes <first>-<last>/<total>
+        std::string content_range = _http->get_header("Content-Range");
+        size_t slash = content_range.rfind('/');
+        if (slash != std::string::npos && content_range[slash + 1] != '*')
+            *total = atol(content_range.c_str() + slash + 1);
+    }
+    return status;
+}
+
+
+int FileHandlerHTTPRange::receive(uint8_t *dest, int len)
+{
+    int tmout_counter = 1 + HTTPRANGE_TIMEOUT / 50;
+    int got = 0;
+
+    while (got < len)
+    {
+        int result = _http->read(dest + got, len - got);
+        if (result < 0)
+            return -1;
+        if (result > 0)
+        {
+            got += result;
+            tmout_counter = 1 + HTTPRANGE_TIMEOUT / 50;
+            continue;
+        }
+        // Whole body read
+        if (_http->available() == 0)
+            break;
+        if (--tmout_counter == 0)
+        {
+            Debug_println("FileHandlerHTTPRange::receive - Timeout");
+            return -1;
+        }
+        fnSystem.delay(50);
+    }
+    return got;
+}
+
+
+int FileHandlerHTTPRange::find_slot(long block)
+{
+    for (int i = 0; i < HTTPRANGE_CACHE_BLOCKS; i++)
+    {
+        if (_block[i] == block)
+            return i;
+    }
+    return -1;
+}
+
+
+/*
+ * Fetch block into the cache, dropping the connection if that fails part way
+ * so the next request doesn't start in the middle of this response.
+ * Returns the slot holding block, -1 on error.
+ */
+int FileHandlerHTTPRange::load(long block)
+{
+    int slot = fetch(block);
+    if (slot < 0 && _http != nullptr)
+        _http->close();
+    return slot;
+}
+
+
+/*
+ * Fetch block into the cache, with the blocks after it if the reads have been
+ * going forward. Returns the slot holding block, -1 on error.
+ */
+int FileHandlerHTTPRange::fetch(long block)
+{
+    bool probing = _size < 0;
+    long last_block = probing ? HTTPRANGE_READAHEAD_BLOCKS - 1 : (_size - 1) / HTTPRANGE_BLOCK_SIZE;
+    long count = 1;
+
+    // Read ahead up to the next block we already have
+    if (block == _last_block + 1)
+    {
+        while (count < HTTPRANGE_READAHEAD_BLOCKS && block + count <= last_block &&
+               find_slot(block + count) < 0)
+            count++;
+    }
+
+    long first = block * HTTPRANGE_BLOCK_SIZE;
+    long end = (block + count) * HTTPRANGE_BLOCK_SIZE;
+    if (!probing && end > _size)
+        end = _size;
+
+    Debug_printf("FileHandlerHTTPRange::load bytes %ld-%ld\n", first, end - 1);
+
+    long total;
+    int status = request(first, end - 1, &total);
+    if (status != 206)
+    {
+        Debug_printf("FileHandlerHTTPRange::load - HTTP status %d\n", status);
+        return -1;
+    }
+
+    if (probing)
+    {
+        if (total <= 0)
+        {
+            Debug_println("FileHandlerHTTPRange::load - no file size in Content-Range");
+            return -1;
+        }
+        _size = total;
+        if (end > _size)
+            end = _size;
+    }
+    else if (total >= 0 && total != _size)
+    {
+        Debug_printf("FileHandlerHTTPRange::load - file size changed from %ld to %ld\n", _size, total);
+        return -1;
+    }
+
+    int first_slot = -1;
+    for (long offset = first; offset < end; offset += HTTPRANGE_BLOCK_SIZE)
+    {
+        // Replace the least recently used block
+        int slot = 0;
+        for (int i = 1; i < HTTPRANGE_CACHE_BLOCKS; i++)
+        {
+            if (_used[i] < _used[slot])
+                slot = i;
+        }
+
+        int len = (end - offset) < HTTPRANGE_BLOCK_SIZE ? (int)(end - offset) : HTTPRANGE_BLOCK_SIZE;
+        _block[slot] = -1;
+        if (receive(_cache + slot * HTTPRANGE_BLOCK_SIZE, len) != len)
+        {
+            Debug_println("FileHandlerHTTPRange::load - short response");
+            return -1;
+        }
+        _block[slot] = offset / HTTPRANGE_BLOCK_SIZE;
+        _used[slot] = ++_clock;
+        if (first_slot < 0)
+            first_slot = slot;
+    }
+    return first_slot;
+}
+
+
+int FileHandlerHTTPRange::close(bool destroy)
+{
+    Debug_println("FileHandlerHTTPRange::close");
+    // The connection stays open for the other files using the client
+    _http.reset();
+    free(_cache);
+    _cache = nullptr;
+    if (destroy) delete this;
+    return 0;
+}
+
+
+int FileHandlerHTTPRange::seek(long int off, int whence)
+{
+    long new_pos;
+    switch (whence)
+    {
+    case SEEK_SET:
+        new_pos = off;
+        break;
+    case SEEK_CUR:
+        new_pos = _pos + off;
+        break;
+    case SEEK_END:
+        new_pos = _size + off;
+        break;
+    default:
+        return -1;
+    }
+    if (new_pos < 0)
+        return -1;
+    _pos = new_pos;
+    return 0;
+}
+
+
+long int FileHandlerHTTPRange::tell()
+{
+    return _pos;
+}
+
+
+size_t FileHandlerHTTPRange::read(void *ptr, size_t size, size_t count)
+{
+    if (_cache == nullptr || size == 0 || _pos >= _size)
+        return 0;
+
+    size_t bytes_remaining = size * count;
+    if (bytes_remaining > (size_t)(_size - _pos))
+        bytes_remaining = _size - _pos;
+
+    size_t bytes_read = 0;
+    while (bytes_remaining > 0)
+    {
+        long block = _pos / HTTPRANGE_BLOCK_SIZE;
+        int slot = find_slot(block);
+        if (slot < 0 && (slot = load(block)) < 0)
+            break;
+        _used[slot] = ++_clock;
+        _last_block = block;
+
+        size_t offset = _pos % HTTPRANGE_BLOCK_SIZE;
+        size_t len = HTTPRANGE_BLOCK_SIZE - offset;
+        if (len > bytes_remaining)
+            len = bytes_remaining;
+        memcpy((uint8_t *)ptr + bytes_read, _cache + slot * HTTPRANGE_BLOCK_SIZE + offset, len);
+
+        _pos += len;
+        bytes_read += len;
+        bytes_remaining -= len;
+    }
+
+    return bytes_read / size;
+}
+
+
+size_t FileHandlerHTTPRange::write(const void *ptr, size_t size, size_t count)
+{
+    Debug_println("FileHandlerHTTPRange::write - read-only");
+    return 0;
+}
+
+
+int FileHandlerHTTPRange::flush()
+{
+    return 0;
+}
+
+
+int FileHandlerHTTPRange::eof()
+{
+    return _pos >= _size ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+#ifndef FN_FILEHTTPRANGE_H
+#define FN_FILEHTTPRANGE_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#ifdef ESP_PLATFORM
+#include "fnHttpClient.h"
+#define HTTP_CLIENT_CLASS fnHttpClient
+#else
+#include "mgHttpClient.h"
+#define HTTP_CLIENT_CLASS mgHttpClient
+#endif
+
+#include "fnFile.h"
+
+#define HTTPRANGE_BLOCK_SIZE 4096
+#define HTTPRANGE_CACHE_BLOCKS 8
+// Blocks asked for in one request when reading sequentially
+#define HTTPRANGE_READAHEAD_BLOCKS 4
+
+/*
+ * Read-only FileHandler for a file on a web server, fetched a few blocks at
+ * a time with Range requests instead of downloading the whole file first.
+ * The last HTTPRANGE_CACHE_BLOCKS blocks used are kept, least recently used
+ * replaced first. All requests go through the one client so its connection
+ * can be kept alive between them, and the files of a filesystem can share
+ * that client.
+ */
+class FileHandlerHTTPRange : public FileHandler
+{
+protected:
+    std::shared_ptr<HTTP_CLIENT_CLASS> _http;
+    std::string _url;
+    long _size = -1;
+    long _pos = 0;
+
+    uint8_t *_cache = nullptr;
+    long _block[HTTPRANGE_CACHE_BLOCKS];   // block number held by each slot, -1 if none
+    uint32_t _used[HTTPRANGE_CACHE_BLOCKS]; // _clock when the slot was last used
+    uint32_t _clock = 0;
+    long _last_block = -1; // last block read, to spot sequential access
+
+    int find_slot(long block);
+    int load(long block);
+    int fetch(long block);
+
+    /*
+     * Ask for bytes first to last of the file, pointing the client at it first.
+     * Returns the HTTP status, total is set to the file size from Content-Range or -1
+     */
+    virtual int request(long first, long last, long *total);
+
+    /*
+     * Read the next len bytes of the response body.
+     * Returns the number of bytes read, less at the end of the body, -1 on error
+     */
+    virtual int receive(uint8_t *dest, int len);
+
+public:
+    // http has to have been started with begin(), any URL will do
+    FileHandlerHTTPRange(std::shared_ptr<HTTP_CLIENT_CLASS> http, const std::string &url);
+    virtual ~FileHandlerHTTPRange() override;
+
+    /*
+     * Fetch the first blocks, which tells the file size and whether the server
+     * honors Range at all. Returns false if it doesn't.
+     */
+    bool open();
+
+    long size() { return _size; }
+
+    virtual int close(bool destroy=true) override;
+    virtual int seek(long int off, int whence) override;
+    virtual long int tell() override;
+    virtual size_t read(void *ptr, size_t size, size_t count) override;
+    virtual size_t write(const void *ptr, size_t size, size_t count) override;
+    virtual int flush() override;
+    virtual int eof() override;
+};
+
+
+#endif // FN_FILEHTTPRANGE_H
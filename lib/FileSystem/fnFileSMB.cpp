@@ -1,15 +1,92 @@
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#define poll WSAPoll
+#else
+#include <poll.h>
+#endif
 
 #include "fnFileSMB.h"
 #include "../../include/debug.h"
 
+#include "fnSystem.h"
+
+
+// READ in flight; freed by the callback if the handler gave up on it
+struct smb_read_request
+{
+    FileHandlerSMB *handler;
+    uint8_t *data;
+    bool done;
+    int status;
+};
 
-FileHandlerSMB::FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle)
+// WRITEs in flight for one flush; freed by the last callback if the handler gave up on them
+struct smb_write_batch
+{
+    FileHandlerSMB *handler;
+    uint8_t *data;
+    int outstanding;
+    int status;
+};
+
+static void read_cb(struct smb2_context *smb2, int status, void *command_data, void *cb_data)
+{
+    smb_read_request *req = (smb_read_request *)cb_data;
+    if (req->handler == nullptr)
+    {
+        free(req->data);
+        delete req;
+        return;
+    }
+    req->status = status;
+    req->done = true;
+}
+
+static void write_cb(struct smb2_context *smb2, int status, void *command_data, void *cb_data)
+{
+    smb_write_batch *batch = (smb_write_batch *)cb_data;
+    struct smb2_write_cb_data *wr = (struct smb2_write_cb_data *)command_data;
+
+    if (status < 0)
+        batch->status = status;
+    else if (wr != nullptr && (uint32_t)status != wr->count)
+        batch->status = -EIO;
+
+    if (--batch->outstanding == 0 && batch->handler == nullptr)
+    {
+        free(batch->data);
+        delete batch;
+    }
+}
+
+
+FileHandlerSMB::FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle, bool append, uint32_t block_size)
 {
     Debug_println("new FileHandlerSMB");
     _smb = smb;
     _handle = handle;
+    _append = append;
+
+    _block_size = block_size;
+    uint32_t max_read = smb2_get_max_read_size(smb);
+    if (max_read > 0 && max_read < _block_size)
+        _block_size = max_read;
+    _max_write = smb2_get_max_write_size(smb);
+    if (_max_write == 0 || _max_write > SMB_WRITE_BUFFER)
+        _max_write = SMB_WRITE_BUFFER;
+
+    struct smb2_stat_64 st;
+    if (smb2_fstat(smb, handle, &st) == 0)
+        _size = (long)st.smb2_size;
+    else
+        Debug_printf("%s\n", smb2_get_error(smb));
+    if (_append)
+        _pos = _size;
 };
 
 
@@ -24,11 +101,23 @@ int FileHandlerSMB::close(bool destroy)
 {
     Debug_println("FileHandlerSMB::close");
     int result = 0;
-    if (_handle != nullptr) 
+    if (_handle != nullptr)
     {
-        result = smb2_close(_smb, _handle);
+        if (flush_writes() < 0)
+            result = -1;
+        cancel_reads();
+
+        if (smb2_close(_smb, _handle) < 0)
+            result = -1;
         _handle = nullptr;
         _smb = nullptr;
+        _wbuf.clear();
+    }
+    for (int i = 0; i < SMB_CACHE_BLOCKS; i++)
+    {
+        free(_cache[i].data);
+        _cache[i].data = nullptr;
+        _cache[i].block = -1;
     }
     if (destroy) delete this;
     return result;
@@ -37,94 +126,352 @@ int FileHandlerSMB::close(bool destroy)
 
 int FileHandlerSMB::seek(long int off, int whence)
 {
-    Debug_println("FileHandlerSMB::seek");
-    uint64_t new_pos;
-    if (smb2_lseek(_smb, _handle, off, whence, &new_pos) < 0)
+    long new_pos;
+    switch (whence)
     {
-        Debug_printf("%s\n", smb2_get_error(_smb));
+    case SEEK_SET:
+        new_pos = off;
+        break;
+    case SEEK_CUR:
+        new_pos = _pos + off;
+        break;
+    case SEEK_END:
+        new_pos = _size + off;
+        break;
+    default:
         return -1;
     }
-    Debug_printf("new pos is %llu\n", new_pos);
+    if (new_pos < 0)
+        return -1;
+    _pos = new_pos;
     return 0;
 }
 
 
 long int FileHandlerSMB::tell()
 {
-    Debug_println("FileHandlerSMB::tell");
-    uint64_t pos;
-    if (smb2_lseek(_smb, _handle, 0, SEEK_CUR, &pos) < 0)
+    return _pos;
+}
+
+
+int FileHandlerSMB::eof()
+{
+    return _pos >= _size ? 1 : 0;
+}
+
+
+/*
+ * Wait up to 100 ms for the server and handle what it sent.
+ * Returns false on a connection error or once SMB_IO_TIMEOUT has passed since started.
+ */
+bool FileHandlerSMB::service(uint64_t started)
+{
+    if (fnSystem.millis() - started > SMB_IO_TIMEOUT)
+    {
+        Debug_println("FileHandlerSMB - timeout");
+        return false;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = smb2_get_fd(_smb);
+    pfd.events = smb2_which_events(_smb);
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, 100) < 0)
+    {
+        Debug_println("FileHandlerSMB - poll failed");
+        return false;
+    }
+    if (pfd.revents != 0 && smb2_service(_smb, pfd.revents) < 0)
     {
         Debug_printf("%s\n", smb2_get_error(_smb));
-        return -1;
+        return false;
+    }
+    return true;
+}
+
+
+FileHandlerSMB::cache_block *FileHandlerSMB::find_block(long block)
+{
+    for (int i = 0; i < SMB_CACHE_BLOCKS; i++)
+    {
+        if (_cache[i].block == block)
+            return &_cache[i];
+    }
+    return nullptr;
+}
+
+
+/*
+ * Send a READ for block into the least recently used slot.
+ * Returns nullptr if nothing could be sent.
+ */
+FileHandlerSMB::cache_block *FileHandlerSMB::request_block(long block)
+{
+    // The server has to see earlier writes before it's read from
+    if (!_wbuf.empty() && flush_writes() < 0)
+        return nullptr;
+
+    cache_block *cb = &_cache[0];
+    for (int i = 1; i < SMB_CACHE_BLOCKS; i++)
+    {
+        if (_cache[i].used < cb->used)
+            cb = &_cache[i];
+    }
+    // A read-ahead nobody came for, most likely done by now
+    if (cb->pending != nullptr)
+        wait_block(cb);
+
+    if (cb->data == nullptr && (cb->data = (uint8_t *)malloc(_block_size)) == nullptr)
+    {
+        Debug_println("FileHandlerSMB - failed to allocate cache block");
+        return nullptr;
+    }
+
+    long offset = block * _block_size;
+    uint32_t len = (_size - offset) < (long)_block_size ? (uint32_t)(_size - offset) : _block_size;
+
+    smb_read_request *req = new smb_read_request{this, cb->data, false, 0};
+    int rc = smb2_pread_async(_smb, _handle, cb->data, len, offset, read_cb, req);
+    if (rc < 0)
+    {
+        Debug_printf("%s\n", smb2_get_error(_smb));
+        delete req;
+        cb->block = -1;
+        return nullptr;
+    }
+
+    cb->block = block;
+    cb->length = 0;
+    cb->used = ++_clock;
+    cb->pending = req;
+    return cb;
+}
+
+
+/*
+ * Wait for the READ into cb to finish. Gives up on all of them if the server
+ * doesn't answer.
+ */
+bool FileHandlerSMB::wait_block(cache_block *cb)
+{
+    smb_read_request *req = cb->pending;
+    if (req == nullptr)
+        return true;
+
+    uint64_t started = fnSystem.millis();
+    while (!req->done)
+    {
+        if (!service(started))
+        {
+            cancel_reads();
+            return false;
+        }
+    }
+
+    cb->pending = nullptr;
+    if (req->status < 0)
+    {
+        Debug_printf("FileHandlerSMB - read failed: %s\n", smb2_get_error(_smb));
+        cb->block = -1;
+    }
+    else
+        cb->length = req->status;
+    delete req;
+    return cb->block != -1;
+}
+
+
+/*
+ * Leave the READs in flight to free themselves, as their buffers can't be
+ * used until they're done
+ */
+void FileHandlerSMB::cancel_reads()
+{
+    for (int i = 0; i < SMB_CACHE_BLOCKS; i++)
+    {
+        cache_block &cb = _cache[i];
+        if (cb.pending == nullptr)
+            continue;
+        if (cb.pending->done)
+        {
+            delete cb.pending;
+        }
+        else
+        {
+            cb.pending->handler = nullptr;
+            cb.data = nullptr;
+        }
+        cb.pending = nullptr;
+        cb.block = -1;
     }
-    return (long)pos;
 }
 
 
 size_t FileHandlerSMB::read(void *ptr, size_t size, size_t count)
 {
-    Debug_println("FileHandlerSMB::read");
+    if (_handle == nullptr || size == 0 || _pos >= _size)
+        return 0;
 
     size_t bytes_remaining = size * count;
+    if (bytes_remaining > (size_t)(_size - _pos))
+        bytes_remaining = _size - _pos;
+
     size_t bytes_read = 0;
-    int result;
     while (bytes_remaining > 0)
     {
-        result = smb2_read(_smb, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
+        long block = _pos / _block_size;
+        cache_block *cb = find_block(block);
+
+        if (cb != nullptr)
+            cb->used = ++_clock;
+        else if ((cb = request_block(block)) == nullptr)
+            break;
+
+        // Keep the next blocks coming while reading forward
+        if (block == _last_block + 1)
         {
-            if (errno == EAGAIN)
-                continue;
-            else
+            long last_block = (_size - 1) / _block_size;
+            for (long next = block + 1; next <= block + SMB_READAHEAD_BLOCKS && next <= last_block; next++)
             {
-                Debug_printf("%s\n", smb2_get_error(_smb));
-                break;
+                if (find_block(next) == nullptr && request_block(next) == nullptr)
+                    break;
             }
         }
-        else if (result == 0)
+        _last_block = block;
+
+        if (!wait_block(cb))
+            break;
+
+        size_t offset = _pos - block * _block_size;
+        if ((size_t)cb->length <= offset)
+            break; // file is shorter than it was
+        size_t len = cb->length - offset;
+        if (len > bytes_remaining)
+            len = bytes_remaining;
+        memcpy((uint8_t *)ptr + bytes_read, cb->data + offset, len);
+
+        _pos += len;
+        bytes_read += len;
+        bytes_remaining -= len;
+    }
+
+    return bytes_read / size;
+}
+
+
+/*
+ * Send the collected writes, up to the server's max write size per WRITE, all
+ * in flight together. Returns 0 once all are done, -1 on error. The writes
+ * stay collected until they all succeed, so a later flush sends them again.
+ */
+int FileHandlerSMB::flush_writes()
+{
+    if (_wbuf.empty())
+        return 0;
+
+    smb_write_batch *batch = new smb_write_batch{this, nullptr, 0, 0};
+    batch->data = (uint8_t *)malloc(_wbuf.size());
+    if (batch->data == nullptr)
+    {
+        Debug_println("FileHandlerSMB - failed to allocate write buffer");
+        delete batch;
+        return -1;
+    }
+    memcpy(batch->data, _wbuf.data(), _wbuf.size());
+
+    size_t total = _wbuf.size();
+    long offset = _wbuf_offset;
+
+    for (size_t sent = 0; sent < total; sent += _max_write)
+    {
+        uint32_t len = (total - sent) < _max_write ? (uint32_t)(total - sent) : _max_write;
+        if (smb2_pwrite_async(_smb, _handle, batch->data + sent, len, offset + sent, write_cb, batch) < 0)
         {
-            break; // EOF
+            Debug_printf("%s\n", smb2_get_error(_smb));
+            batch->status = -EIO;
+            break;
         }
-        else
+        batch->outstanding++;
+    }
+
+    uint64_t started = fnSystem.millis();
+    while (batch->outstanding > 0)
+    {
+        if (!service(started))
         {
-            bytes_read += result;
-            bytes_remaining -= result;
+            // The last callback frees it
+            batch->handler = nullptr;
+            return -1;
         }
     }
 
-    return (size_t)(size * count == bytes_read ? count : bytes_read / size);
+    int result = batch->status < 0 ? -1 : 0;
+    free(batch->data);
+    delete batch;
+    if (result == 0)
+        _wbuf.clear();
+    return result;
 }
 
 
 size_t FileHandlerSMB::write(const void *ptr, size_t size, size_t count)
 {
-    Debug_println("FileHandlerSMB::write");
+    if (_handle == nullptr || size == 0)
+        return 0;
 
-    size_t bytes_remaining = size * count;
-    size_t bytes_written = 0;
-    int result;
-    while (bytes_remaining > 0)
+    size_t len = size * count;
+    if (_append)
+        _pos = _size;
+
+    // Only a write carrying on from the last one joins it
+    if (!_wbuf.empty() && (_pos != _wbuf_offset + (long)_wbuf.size() || _wbuf.size() + len > SMB_WRITE_BUFFER))
     {
-        result = smb2_write(_smb, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
-        {
-            if (errno == EAGAIN)
-                continue;
-            else
-            {
-                Debug_printf("%s\n", smb2_get_error(_smb));
-                break;
-            }
-        }
-        else
+        if (flush_writes() < 0)
+            return 0;
+    }
+    if (_wbuf.empty())
+        _wbuf_offset = _pos;
+    _wbuf.insert(_wbuf.end(), (const uint8_t *)ptr, (const uint8_t *)ptr + len);
+
+    if (_wbuf.size() >= SMB_WRITE_BUFFER && flush_writes() < 0)
+    {
+        // Not written, what was collected before is still there
+        _wbuf.resize(_wbuf.size() - len);
+        return 0;
+    }
+
+    // Bring cached copies up to date
+    long end = _pos + (long)len;
+    for (int i = 0; i < SMB_CACHE_BLOCKS; i++)
+    {
+        cache_block &cb = _cache[i];
+        if (cb.block < 0)
+            continue;
+        long block_start = cb.block * _block_size;
+        if (block_start >= end || block_start + (long)_block_size <= _pos)
+            continue;
+        if (!wait_block(&cb))
+            continue;
+
+        long from = _pos > block_start ? _pos - block_start : 0;
+        long to = end < block_start + (long)_block_size ? end - block_start : _block_size;
+        if (from > cb.length)
         {
-            bytes_written += result;
-            bytes_remaining -= result;
+            // Leaves a gap, let the server fill it in
+            cb.block = -1;
+            continue;
         }
+        memcpy(cb.data + from, (const uint8_t *)ptr + (block_start + from - _pos), to - from);
+        if (to > cb.length)
+            cb.length = to;
     }
 
-    return (size_t)(size * count == bytes_written ? count : bytes_written / size);
+    _pos = end;
+    if (_pos > _size)
+        _size = _pos;
+
+    return count;
 }
 
 
@@ -132,6 +479,8 @@ int FileHandlerSMB::flush()
 {
     Debug_println("FileHandlerSMB::flush");
     int result;
+    if (flush_writes() < 0)
+        return -1;
     if ((result = smb2_fsync(_smb, _handle)) != 0)
     {
         Debug_printf("%s\n", smb2_get_error(_smb));
@@ -3,18 +3,69 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <vector>
 #include <smb2/libsmb2.h>
 
 #include "fnFile.h"
 
+// Largest block read at once, less if the server's max read size is smaller
+#define SMB_BLOCK_SIZE 4096
+#define SMB_CACHE_BLOCKS 8
+// Blocks kept in flight ahead of a sequential reader
+#define SMB_READAHEAD_BLOCKS 3
+// Writes next to each other are sent together once this much has built up
+#define SMB_WRITE_BUFFER (4 * SMB_BLOCK_SIZE)
+// ms to wait for the server to answer
+#define SMB_IO_TIMEOUT 20000
 
+struct smb_read_request;
+struct smb_write_batch;
+
+/*
+ * Reads go through a small cache of blocks filled with async READs: a block
+ * missed is asked for together with the next few when reading forward, so
+ * those are on their way while the first is used. Writes next to each other
+ * are collected and sent as a batch of WRITEs in flight together, on flush(),
+ * close() or before anything more is read from the server. Opened for
+ * append, every write goes to the end of the file, as with fopen("a").
+ */
 class FileHandlerSMB : public FileHandler
 {
 protected:
+    struct cache_block
+    {
+        long block = -1;
+        uint32_t used = 0;
+        int length = 0; // bytes valid
+        uint8_t *data = nullptr;
+        smb_read_request *pending = nullptr; // READ in flight into data
+    };
+
     struct smb2_context *_smb;
     struct smb2fh *_handle;
+    long _size = 0;
+    long _pos = 0;
+    bool _append;
+    uint32_t _block_size;
+
+    cache_block _cache[SMB_CACHE_BLOCKS];
+    uint32_t _clock = 0;
+    long _last_block = -1; // last block read, to spot sequential access
+
+    std::vector<uint8_t> _wbuf; // writes not sent yet, from _wbuf_offset
+    long _wbuf_offset = 0;
+    uint32_t _max_write;
+
+    cache_block *find_block(long block);
+    cache_block *request_block(long block);
+    bool wait_block(cache_block *cb);
+    void cancel_reads();
+    bool service(uint64_t started);
+    int flush_writes();
+
 public:
-    FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle);
+    FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle, bool append = false,
+                   uint32_t block_size = SMB_BLOCK_SIZE);
     virtual ~FileHandlerSMB() override;
 
     virtual int close(bool destroy=true) override;
@@ -23,6 +74,7 @@ public:
     virtual size_t read(void *ptr, size_t size, size_t count) override;
     virtual size_t write(const void *ptr, size_t size, size_t count) override;
     virtual int flush() override;
+    virtual int eof() override;
 };
 
 
@@ -78,6 +78,11 @@ bool FileSystemFTP::start(const char *url, const char *user, const char *passwor
     return true;
 }
 
+bool FileSystemFTP::keep_alive()
+{
+    return _started && !_ftp->noop();
+}
+
 bool FileSystemFTP::exists(const char *path)
 {
     // TODO
@@ -111,13 +116,31 @@ FileHandler *FileSystemFTP::filehandler_open(const char *path, const char *mode)
 // Return FileHandler* on success (memory or SD file), nullptr on error
 FileHandler *FileSystemFTP::cache_file(const char *path, const char *mode)
 {
+    // If the file is in the last listed directory, use its size and time to revalidate a cached copy
+    uint32_t remote_size = 0;
+    std::string remote_tag;
+    const char *fname = strrchr(path, '/');
+    if (fname != nullptr)
+    {
+        std::string dir(path, fname - path);
+        std::string last_dir(_last_dir);
+        while (!last_dir.empty() && last_dir.back() == '/')
+            last_dir.pop_back();
+        const fsdir_entry *de = (dir == last_dir) ? _dircache.find(fname + 1) : nullptr;
+        if (de != nullptr)
+        {
+            remote_size = de->size;
+            remote_tag = std::to_string((long long)de->modified_time);
+        }
+    }
+
     // Try SD cache first
-    FileHandler *fh = FileCache::open(_url->mRawUrl.c_str(), path, mode);
+    FileHandler *fh = FileCache::open(_url->mRawUrl.c_str(), path, mode, remote_size, remote_tag.c_str());
     if (fh != nullptr)
         return fh; // cache hit, done
 
     // Create new cache file (starts in memory)
-    fc_handle *fc = FileCache::create(_url->mRawUrl.c_str(), path);
+    fc_handle *fc = FileCache::create(_url->mRawUrl.c_str(), path, -1, -1, remote_size, remote_tag.c_str());
     if (fc == nullptr)
         return nullptr;
 
@@ -258,7 +281,6 @@ bool FileSystemFTP::dir_open(const char  *path, const char *pattern, uint16_t di
         string filename;
         long filesz;
         bool is_dir;
-        fsdir_entry *fs_de;
 
         // get first directory entry
         res = _ftp->read_directory(filename, filesz, is_dir);
@@ -269,13 +291,7 @@ bool FileSystemFTP::dir_open(const char  *path, const char *pattern, uint16_t di
                 continue;
 
             // new dir entry
-            fs_de = &_dircache.new_entry();
-
-            // set entry members
-            strlcpy(fs_de->filename, filename.c_str(), sizeof(fs_de->filename));
-            fs_de->isDir = is_dir;
-            fs_de->size = (uint32_t)filesz;
-            fs_de->modified_time = 0; // TODO
+            _dircache.add_entry(filename.c_str(), is_dir, (uint32_t)filesz, 0); // TODO modified time
 
             // get next
             res = _ftp->read_directory(filename, filesz, is_dir);
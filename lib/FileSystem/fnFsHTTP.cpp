@@ -95,6 +95,30 @@ FILE  *FileSystemHTTP::file_open(const char *path, const char *mode)
 #ifndef FNIO_IS_STDIO
 FileHandler *FileSystemHTTP::filehandler_open(const char *path, const char *mode)
 {
+    // Read-only files are fetched as they're read if the server allows Range requests,
+    // unless the file cache already has a copy
+    if (mode[0] == 'r' && strchr(mode, '+') == nullptr && !FileCache::cached(_url->mRawUrl.c_str(), path))
+    {
+        std::string url = _url->url + mstr::urlEncode(path);
+        if (_range_http == nullptr)
+        {
+            _range_http = std::make_shared<HTTP_CLIENT_CLASS>();
+            if (!_range_http->begin(url))
+            {
+                Debug_println("FileSystemHTTP::filehandler_open - failed to start HTTP client");
+                _range_http.reset();
+            }
+        }
+        if (_range_http != nullptr)
+        {
+            FileHandlerHTTPRange *rfh = new FileHandlerHTTPRange(_range_http, url);
+            if (rfh->open())
+                return rfh;
+            Debug_println("FileSystemHTTP::filehandler_open - no Range support, caching whole file");
+            rfh->close();
+        }
+    }
+
     FileHandler *fh = cache_file(path, mode);
     return fh;
 }
@@ -103,28 +127,54 @@ FileHandler *FileSystemHTTP::filehandler_open(const char *path, const char *mode
 // Return FileHandler* on success (memory or SD file), nullptr on error
 FileHandler *FileSystemHTTP::cache_file(const char *path, const char *mode)
 {
-    // Try SD cache first
-    FileHandler *fh = FileCache::open(_url->mRawUrl.c_str(), path, mode);
-    if (fh != nullptr)
-        return fh; // cache hit, done
-
-    // Create new cache file (starts in memory)
-    fc_handle *fc = FileCache::create(_url->mRawUrl.c_str(), path);
-    if (fc == nullptr)
-        return nullptr;
-
     // Setup HTTP client
 	if (!_http->begin(_url->url + mstr::urlEncode(path)))
     {
         Debug_println("FileSystemHTTP::cache_file - failed to start HTTP client");
-        return nullptr;
+        // Without the server, a cached copy is only good until it expires by age
+        return FileCache::open(_url->mRawUrl.c_str(), path, mode);
 	}
+    _http->create_empty_stored_headers({"Content-Length", "ETag", "Last-Modified"});
+
+    // Ask the server for validators only if there's a cached copy to check against
+    uint32_t remote_size = 0;
+    std::string remote_tag;
+    if (FileCache::cached(_url->mRawUrl.c_str(), path) && _http->HEAD() < 400)
+    {
+        remote_size = (uint32_t)atol(_http->get_header("Content-Length").c_str());
+        remote_tag = _http->get_header("ETag");
+        if (remote_tag.empty())
+            remote_tag = _http->get_header("Last-Modified");
+    }
+
+    // Try SD cache first
+    FileHandler *fh = FileCache::open(_url->mRawUrl.c_str(), path, mode, remote_size, remote_tag.c_str());
+    if (fh != nullptr)
+    {
+        _http->close();
+        return fh; // cache hit, done
+    }
 
     // GET request
     Debug_println("Initiating GET request");
     if (_http->GET() > 399)
     {
         Debug_println("FileSystemHTTP::cache_file - GET failed");
+        _http->close();
+        return nullptr;
+    }
+
+    // Record what the server sent so the copy can be revalidated next time
+    remote_size = (uint32_t)atol(_http->get_header("Content-Length").c_str());
+    remote_tag = _http->get_header("ETag");
+    if (remote_tag.empty())
+        remote_tag = _http->get_header("Last-Modified");
+
+    // Create new cache file (starts in memory)
+    fc_handle *fc = FileCache::create(_url->mRawUrl.c_str(), path, -1, -1, remote_size, remote_tag.c_str());
+    if (fc == nullptr)
+    {
+        _http->close();
         return nullptr;
     }
 
@@ -373,20 +423,14 @@ bool FileSystemHTTP::dir_open(const char  *path, const char *pattern, uint16_t d
         _parser.end_parser();
 
         // Parsed entries to dircache
-        fsdir_entry *fs_de;
         std::vector<IndexParser::IndexEntry>::iterator dirEntryCursor = _parser.rewind();
         struct tm tm;
         while (dirEntryCursor != _parser.entries.end())
         {
-            // new dir entry
-            fs_de = &_dircache.new_entry();
-
-            // set entry members
-            strlcpy(fs_de->filename, mstr::urlDecode(dirEntryCursor->filename).c_str(), sizeof(fs_de->filename));
-            fs_de->isDir = dirEntryCursor->isDir;
-            fs_de->size = (uint32_t)atoi(dirEntryCursor->fileSize.c_str());
+            std::string filename = mstr::urlDecode(dirEntryCursor->filename);
+            uint32_t size = (uint32_t)atoi(dirEntryCursor->fileSize.c_str());
             // attempt to get file modification time
-            fs_de->modified_time = 0;
+            time_t modified_time = 0;
             memset(&tm, 0, sizeof(struct tm));
             // strptime is not available on Windows ... grh
             // if (strptime(dirEntryCursor->mTime.c_str(), "%d-%b-%Y %H:%M", &tm) != nullptr)
@@ -396,16 +440,19 @@ bool FileSystemHTTP::dir_open(const char  *path, const char *pattern, uint16_t d
             if (!ss.fail()) 
             {
                 tm.tm_isdst = -1;
-                fs_de->modified_time = mktime(&tm);
+                modified_time = mktime(&tm);
             }
 
-            if (fs_de->isDir)
+            // new dir entry
+            _dircache.add_entry(filename.c_str(), dirEntryCursor->isDir, size, modified_time);
+
+            if (dirEntryCursor->isDir)
             {
-                Debug_printf(" add entry: \"%s\"\tDIR\n", fs_de->filename);
+                Debug_printf(" add entry: \"%s\"\tDIR\n", filename.c_str());
             }
             else
             {
-                Debug_printf(" add entry: \"%s\"\t%lu\n", fs_de->filename, fs_de->size);
+                Debug_printf(" add entry: \"%s\"\t%lu\n", filename.c_str(), (unsigned long)size);
             }
 
             dirEntryCursor++;
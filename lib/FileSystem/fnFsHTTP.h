@@ -5,16 +5,9 @@
 #include <memory>
 #include <stdint.h>
 
-#ifdef ESP_PLATFORM
-#include "fnHttpClient.h"
-#define HTTP_CLIENT_CLASS fnHttpClient
-#else
-#include "mgHttpClient.h"
-#define HTTP_CLIENT_CLASS mgHttpClient
-#endif
-
 #include "peoples_url_parser.h"
 #include "fnFS.h"
+#include "fnFileHTTPRange.h"
 #include "fnDirCache.h"
 #include "IndexParser.h"
 
@@ -28,6 +21,9 @@ private:
     // HTTP client
     HTTP_CLIENT_CLASS *_http;
 
+    // HTTP client shared by the files read with Range requests, kept alive between them
+    std::shared_ptr<HTTP_CLIENT_CLASS> _range_http;
+
     // directory index parser
     IndexParser _parser;
 
@@ -8,6 +8,7 @@
 #include <stdio.h>
 
 #include "fnFS.h"
+#include "fnDirCache.h"
 
 class FileSystemSDFAT : public FileSystem
 {
@@ -18,6 +19,7 @@ private:
     DIR * _dir;
 #endif
     uint64_t _card_capacity = 0;
+    DirCache _dircache;
 public:
 #ifdef ESP_PLATFORM
     bool start();
@@ -82,6 +82,11 @@ bool FileSystemSMB::start(const char *url, const char *user, const char *passwor
     return true;
 }
 
+bool FileSystemSMB::keep_alive()
+{
+    return _started && smb2_echo(_smb) == 0;
+}
+
 bool FileSystemSMB::exists(const char *path)
 {
     smb2_stat_64 st;
@@ -136,40 +141,31 @@ FileHandler *FileSystemSMB::filehandler_open(const char *path, const char *mode)
         smb_path += 1;
 
     struct smb2fh *fh;
-    int open_flags = 0;
+    int open_flags;
+    bool update = strchr(mode, '+') != nullptr;
+    bool append = mode[0] == 'a';
 
-    // TODO check/fix open mode translation
-    for (const char *m = mode; *m != '\0'; m++)
+    // As fopen(): "w" empties the file, "w" and "a" create it if it isn't there
+    switch (mode[0])
     {
-        switch (*m)
-        {
-        case 'r':
-            open_flags = O_RDONLY;
-            break;
-        case 'w':
-            open_flags = O_WRONLY | O_CREAT;
-            break;
-        case 'a':
-            open_flags = O_WRONLY;
-            break;
-        case '+':
-            // TODO
-            if (open_flags == O_RDONLY) // "r+""
-                open_flags = O_RDWR;
-            else if (open_flags == (O_WRONLY | O_CREAT)) // "w+"
-                open_flags = O_RDWR | O_CREAT;
-            else if (open_flags == O_WRONLY) // "a+"
-                open_flags = O_RDWR | O_CREAT;
-            break;
-        }
+    case 'w':
+        open_flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+        break;
+    case 'a':
+        open_flags = (update ? O_RDWR : O_WRONLY) | O_CREAT;
+        break;
+    default:
+        open_flags = update ? O_RDWR : O_RDONLY;
+        break;
     }
 
-    if ((fh = smb2_open(_smb, smb_path, O_RDONLY)) == nullptr) // TODO use open_flags
+    if ((fh = smb2_open(_smb, smb_path, open_flags)) == nullptr)
     {
+        Debug_printf("%s\n", smb2_get_error(_smb));
         return nullptr;
     }
 
-    return new FileHandlerSMB(_smb, fh);
+    return new FileHandlerSMB(_smb, fh, append);
 }
 #endif
 
@@ -193,7 +189,13 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
     if (smb_path != nullptr && smb_path[0] == '/')
         smb_path += 1;
 
-    if (strcmp(_last_dir, smb_path) == 0)
+    // Entries added, removed or renamed change the directory's modified time
+    smb2_stat_64 st;
+    time_t dir_mtime = 0;
+    if (smb2_stat(_smb, smb_path, &st) == 0)
+        dir_mtime = (time_t)st.smb2_mtime;
+
+    if (strcmp(_last_dir, smb_path) == 0 && dir_mtime == _dircache.mtime())
     {
         Debug_printf("Use directory cache\n");
     }
@@ -221,7 +223,6 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
 
         // Populate directory cache with entries
         smb2dirent *smb_de;
-        fsdir_entry *fs_de;
 
         while ((smb_de = smb2_readdir(_smb, smb_dir)) != nullptr)
         {
@@ -234,24 +235,20 @@ bool FileSystemSMB::dir_open(const char  *path, const char *pattern, uint16_t di
                 continue;
 
             // new dir entry
-            fs_de = &_dircache.new_entry();
-
-            // set entry members
-            strlcpy(fs_de->filename, smb_de->name, sizeof(fs_de->filename));
-            fs_de->isDir = smb_de->st.smb2_type == SMB2_TYPE_DIRECTORY;
-            fs_de->size = (uint32_t)smb_de->st.smb2_size;
-            fs_de->modified_time = (time_t)smb_de->st.smb2_mtime;
+            bool is_dir = smb_de->st.smb2_type == SMB2_TYPE_DIRECTORY;
+            _dircache.add_entry(smb_de->name, is_dir, (uint32_t)smb_de->st.smb2_size, (time_t)smb_de->st.smb2_mtime);
 
-            if (fs_de->isDir)
+            if (is_dir)
             {
-                Debug_printf(" add entry: \"%s\"\tDIR\n", fs_de->filename);
+                Debug_printf(" add entry: \"%s\"\tDIR\n", smb_de->name);
             }
             else
             {
-                Debug_printf(" add entry: \"%s\"\t%lu\n", fs_de->filename, fs_de->size);
+                Debug_printf(" add entry: \"%s\"\t%lu\n", smb_de->name, (unsigned long)smb_de->st.smb2_size);
             }
         }
         smb2_closedir(_smb, smb_dir);
+        _dircache.set_mtime(dir_mtime);
     }
 
     // Apply pattern matching filter and sort entries
@@ -25,6 +25,8 @@ public:
 
     bool start(const char *url, const char *user=nullptr, const char *password=nullptr);
 
+    bool keep_alive() override;
+
     fsType type() override { return FSTYPE_SMB; };
     const char *typestring() override { return type_to_string(FSTYPE_SMB); };
 
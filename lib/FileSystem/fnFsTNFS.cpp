@@ -144,6 +144,25 @@ bool FileSystemTNFS::exists(const char* path)
     return result == TNFS_RESULT_SUCCESS;
 }
 
+bool FileSystemTNFS::keep_alive()
+{
+    if (!_started)
+        return false;
+
+    // Nobody is using this session, let go of a directory listing that can't be reused
+    if (!_mountinfo.dir_open && !_mountinfo.dir_snapshot.fresh())
+        _mountinfo.dir_snapshot.release();
+
+#ifdef ESP_PLATFORM
+    // keepAliveTNFS already pings the server from its timer, and a second
+    // request at the same time would share _mountinfo with it
+    return true;
+#else
+    tnfsStat tstat;
+    return tnfs_stat(&_mountinfo, &tstat, "/") == TNFS_RESULT_SUCCESS;
+#endif
+}
+
 bool FileSystemTNFS::remove(const char* path)
 {
     if(path == nullptr)
@@ -25,6 +25,8 @@ public:
 
     bool start(const char *host, uint16_t port=TNFS_DEFAULT_PORT, const char * mountpath=nullptr, const char * userid=nullptr, const char * password=nullptr);
 
+    bool keep_alive() override;
+
     fsType type() override { return FSTYPE_TNFS; };
     const char * typestring() override { return type_to_string(FSTYPE_TNFS); };
 
@@ -12,7 +12,7 @@
 #include "fnSystem.h"
 #include "bus.h"
 #include "fnUDP.h"
-#include "fnTcpClient.h"
+#include "tnfslibConnection.h"
 #include "tnfslib_udp.h"
 
 #include "utils.h"
@@ -47,9 +47,12 @@ typedef enum
 
 bool _tnfs_transaction(tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t datalen);
 bool _tnfs_send(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_size);
-int _tnfs_recv(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt);
+int _tnfs_recv(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt, uint8_t sequence_num);
 bool _tnfs_tcp_send(tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_size);
-int _tnfs_tcp_recv(tnfsMountInfo *m_info, tnfsPacket &pkt);
+int _tnfs_tcp_recv(tnfsMountInfo *m_info, tnfsPacket &pkt, uint8_t sequence_num);
+uint8_t _tnfs_next_sequence(tnfsMountInfo *m_info);
+void _tnfs_end_sequence(tnfsMountInfo *m_info, uint8_t sequence_num);
+void _tnfs_fallback_udp(tnfsMountInfo *m_info);
 _tnfs_send_recv_result _tnfs_send_recv(fnUDP &udp, tnfsMountInfo *m_info, tnfsPacket &req_pkt, uint16_t payload_size, tnfsPacket &res_pkt);
 _tnfs_recv_result _tnfs_recv_and_validate(fnUDP &udp, tnfsMountInfo *m_info, tnfsPacket &req_pkt, uint16_t payload_size, tnfsPacket &res_pkt);
 uint8_t _tnfs_session_recovery(tnfsMountInfo *m_info, uint8_t command);
@@ -193,6 +196,10 @@ int tnfs_open(tnfsMountInfo *m_info, const char *filepath, uint16_t open_mode, u
         }
     }
 
+    // Writing may change sizes or add entries in a cached listing
+    if (open_mode & TNFS_OPENMODE_WRITE)
+        m_info->dir_snapshot.expire();
+
     // Done with STAT - now try to actually open the file
     tnfsPacket packet;
     packet.command = TNFS_CMD_OPEN;
@@ -380,7 +387,7 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
     pFHI->cache_start = pFHI->file_position;
 
     // How many bytes until we finish loading the cache
-    uint32_t bytes_remaining_to_load = sizeof(pFHI->cache);
+    uint32_t bytes_remaining_to_load = TNFS_FILE_CACHE_SIZE;
 
     // Keep making TNFS READ calls as long as we still have bytes to read
     while (bytes_remaining_to_load > 0)
@@ -407,7 +414,7 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
                 // Copy the actual number of bytes returned to us into our cache
                 // (offset by how many bytes we've already put in the cache)
                 uint16_t bytes_read = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 1);
-                memcpy(pFHI->cache + (sizeof(pFHI->cache) - bytes_remaining_to_load),
+                memcpy(pFHI->cache + (TNFS_FILE_CACHE_SIZE - bytes_remaining_to_load),
                        packet.payload + 3, bytes_read);
 
                 // Keep track of our file position
@@ -450,12 +457,12 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
 #ifdef ESP_PLATFORM
     if (error == 0)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
+        pFHI->cache_available = TNFS_FILE_CACHE_SIZE - bytes_remaining_to_load;
 #else
 // TODO review EOF handling
     if (error == 0 || error == TNFS_RESULT_END_OF_FILE)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
+        pFHI->cache_available = TNFS_FILE_CACHE_SIZE - bytes_remaining_to_load;
         if (pFHI->cache_available > 0) error = 0; // neutralize EOF
 #endif
 #ifdef DEBUG
@@ -466,6 +473,231 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
     return error;
 }
 
+/*
+ Makes sure the handle's cache buffer can hold the requested number of read-ahead blocks.
+ The window is allocated once at the mount's maximum size so it's never reallocated mid-stream.
+ Returns the number of blocks that actually fit.
+*/
+uint8_t _tnfs_reserve_window(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, uint8_t blocks)
+{
+    if (blocks * TNFS_FILE_CACHE_SIZE <= pFHI->cache_size)
+        return blocks;
+
+    uint32_t window_size = m_info->readahead_max_blocks * TNFS_FILE_CACHE_SIZE;
+    uint8_t *window = (uint8_t *)malloc(window_size);
+    if (window == nullptr)
+    {
+        Debug_printf("_tnfs_reserve_window failed to allocate %lu bytes\r\n", window_size);
+        return pFHI->cache_size / TNFS_FILE_CACHE_SIZE;
+    }
+
+    // Whatever is in the current cache is about to be replaced, so there's nothing to copy
+    if (pFHI->cache != pFHI->cache_block)
+        free(pFHI->cache);
+    pFHI->cache = window;
+    pFHI->cache_size = window_size;
+    pFHI->cache_available = 0;
+
+    return blocks;
+}
+
+/*
+ Fills the read-ahead window with up to 'blocks' TNFS_FILE_CACHE_SIZE blocks, keeping up to
+ tnfsMountInfo.readahead_inflight READ requests outstanding at once. Each request carries its own
+ sequence number and responses are reassembled into the window in request order. Over TCP the
+ sequence numbers come from the shared connection, so they need not be consecutive.
+
+ TNFS READ has no offset - the server reads from its current file position in the order requests
+ arrive - so any lost, reordered or failed response makes the window untrustworthy. In that case
+ the window is discarded and, if the server's position is no longer known, we seek back to where
+ the window started.
+
+ Returns: true if the window now holds data; false if the caller should fall back to _tnfs_fill_cache
+*/
+bool _tnfs_fill_window(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, uint8_t blocks)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_info->transaction_mutex);
+
+    if (m_info->protocol != TNFS_PROTOCOL_TCP && m_info->protocol != TNFS_PROTOCOL_UDP)
+        return false;
+
+    #ifdef VERBOSE_TNFS
+    Debug_printf("_tnfs_fill_window fh=%d, file_position=%lu, blocks=%u\r\n", pFHI->handle_id, pFHI->file_position, blocks);
+    #endif
+
+    fnUDP udp;
+
+    uint32_t window_start = pFHI->file_position;
+    pFHI->cache_available = 0;
+    pFHI->cache_start = window_start;
+
+    uint16_t block_len[TNFS_READAHEAD_MAX_BLOCKS] = { 0 };
+    uint8_t block_seq[TNFS_READAHEAD_MAX_BLOCKS] = { 0 };
+    uint8_t sent = 0;
+    uint8_t received = 0;
+    bool reached_eof = false;
+    bool valid = true;
+
+    tnfsPacket req;
+    req.session_idl = TNFS_LOBYTE_FROM_UINT16(m_info->session);
+    req.session_idh = TNFS_HIBYTE_FROM_UINT16(m_info->session);
+    req.command = TNFS_CMD_READ;
+    req.payload[0] = pFHI->handle_id;
+    req.payload[1] = TNFS_LOBYTE_FROM_UINT16(TNFS_FILE_CACHE_SIZE);
+    req.payload[2] = TNFS_HIBYTE_FROM_UINT16(TNFS_FILE_CACHE_SIZE);
+
+    tnfsPacket res;
+
+    uint64_t ms_last = fnSystem.millis();
+    while (valid && received < blocks)
+    {
+        // Top up the pipeline
+        while (sent < blocks && (sent - received) < m_info->readahead_inflight)
+        {
+            req.sequence_num = block_seq[sent] = _tnfs_next_sequence(m_info);
+            if (!_tnfs_send(&udp, m_info, req, 3))
+            {
+                Debug_println("_tnfs_fill_window failed to send request");
+                valid = false;
+                break;
+            }
+            sent++;
+        }
+        if (!valid)
+            break;
+
+        if (SYSTEM_BUS.getShuttingDown())
+        {
+            valid = false;
+            break;
+        }
+
+        int len = m_info->protocol == TNFS_PROTOCOL_TCP ?
+            _tnfs_tcp_recv(m_info, res, block_seq[received]) : _tnfs_udp_recv(&udp, m_info, res);
+        if (len < 0)
+        {
+            if (len < -1 || (fnSystem.millis() - ms_last) >= (uint64_t)m_info->timeout_ms)
+            {
+                Debug_printf("_tnfs_fill_window gave up waiting after %u of %u responses\r\n", received, sent);
+                valid = false;
+                break;
+            }
+#ifdef ESP_PLATFORM
+            fnSystem.yield();
+#else
+            fnSystem.delay_microseconds(1000);
+#endif
+            continue;
+        }
+        ms_last = fnSystem.millis();
+
+        uint8_t index = received;
+        while (index < sent && block_seq[index] != res.sequence_num)
+            index++;
+        if (index >= sent)
+        {
+            // Stale response from an earlier transaction or a duplicate - ignore it
+            continue;
+        }
+        if (index != received)
+        {
+            Debug_printf("_tnfs_fill_window out of order response %u, expected %u\r\n", index, received);
+            valid = false;
+            break;
+        }
+        received++;
+
+        if (res.payload[0] == TNFS_RESULT_SUCCESS)
+        {
+            uint16_t bytes_read = TNFS_UINT16_FROM_LOHI_BYTEPTR(res.payload + 1);
+            if (bytes_read > TNFS_FILE_CACHE_SIZE || reached_eof)
+            {
+                valid = false;
+                break;
+            }
+            memcpy(pFHI->cache + pFHI->cache_available, res.payload + 3, bytes_read);
+            pFHI->cache_available += bytes_read;
+            block_len[index] = bytes_read;
+        }
+        else if (res.payload[0] == TNFS_RESULT_END_OF_FILE)
+        {
+            reached_eof = true;
+        }
+        else
+        {
+            // Let the regular transaction path deal with retries and session recovery
+            Debug_printf("_tnfs_fill_window unexpected result: %u\r\n", res.payload[0]);
+            valid = false;
+        }
+    }
+
+    for (int i = 0; i < sent; i++)
+        _tnfs_end_sequence(m_info, block_seq[i]);
+
+    // Blocks must be contiguous: only the last block holding data may come back short
+    for (int i = 0; valid && i + 1 < received; i++)
+        if (block_len[i] < TNFS_FILE_CACHE_SIZE && block_len[i + 1] > 0)
+            valid = false;
+
+    if (!valid)
+    {
+        pFHI->cache_available = 0;
+        // Any READ that reached the server has moved its file position - put it back where we started
+        if (sent > 0)
+            tnfs_lseek(m_info, pFHI->handle_id, window_start, SEEK_SET, nullptr, true);
+        return false;
+    }
+
+    pFHI->file_position = window_start + pFHI->cache_available;
+
+    #ifdef VERBOSE_TNFS
+    Debug_printf("_tnfs_fill_window got %lu bytes in %u requests\r\n", pFHI->cache_available, received);
+    #endif
+
+    return pFHI->cache_available > 0;
+}
+
+/*
+ Refills the cache for a read, choosing the read-ahead window size.
+ Reads that pick up exactly where the previous window ended are treated as sequential and
+ double the window (up to tnfsMountInfo.readahead_max_blocks); anything else drops back to a
+ single block so random access doesn't pay for data it won't use.
+ Returns: 0: success; -1: failed to deliver/receive packet; other: TNFS error result code
+*/
+int _tnfs_fill_cache_readahead(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
+{
+    bool sequential = pFHI->cache_available > 0 &&
+                      pFHI->cached_pos == pFHI->cache_start + pFHI->cache_available;
+
+    uint8_t blocks = 1;
+    if (sequential && m_info->readahead_max_blocks > 1)
+    {
+        blocks = pFHI->readahead_blocks * 2;
+        if (blocks > m_info->readahead_max_blocks)
+            blocks = m_info->readahead_max_blocks;
+        if (blocks > TNFS_READAHEAD_MAX_BLOCKS)
+            blocks = TNFS_READAHEAD_MAX_BLOCKS;
+    }
+
+    // No point asking for blocks past what we know to be the end of the file
+    uint32_t remaining = pFHI->file_size > pFHI->file_position ? pFHI->file_size - pFHI->file_position : 0;
+    uint32_t blocks_left = (remaining + TNFS_FILE_CACHE_SIZE - 1) / TNFS_FILE_CACHE_SIZE;
+    if (blocks_left < blocks)
+        blocks = blocks_left > 1 ? blocks_left : 1;
+
+    pFHI->readahead_blocks = blocks;
+
+    if (blocks > 1)
+    {
+        blocks = _tnfs_reserve_window(m_info, pFHI, blocks);
+        if (blocks > 1 && _tnfs_fill_window(m_info, pFHI, blocks))
+            return 0;
+        pFHI->readahead_blocks = 1;
+    }
+
+    return _tnfs_fill_cache(m_info, pFHI);
+}
+
 /*
  Reads from an open file.
  Max bufflen is TNFS_PAYLOAD_SIZE - 3; any larger size will return an error
@@ -494,7 +726,7 @@ int tnfs_read(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint1
     while ((result = _tnfs_read_from_cache(pFileInf, buffer, bufflen, resultlen)) != 0 && result != TNFS_RESULT_END_OF_FILE)
     {
         // Reload the cache if we couldn't fulfill the request
-        result = _tnfs_fill_cache(m_info, pFileInf);
+        result = _tnfs_fill_cache_readahead(m_info, pFileInf);
         if (result != 0)
         {
 #ifndef ESP_PLATFORM
@@ -685,18 +917,12 @@ int tnfs_lseek(tnfsMountInfo *m_info, int16_t file_handle, int32_t position, uin
 }
 
 /*
-    Opens directory and stores directory handle in tnfsMountInfo.dir_handle
-    sortopts = zero or more TNFS_DIRSORT flags
-    diropts = zero or more TNFS_DIROPT flags
-    pattern = zero-terminated wildcard pattern string
-    maxresults = max number of results to return or zero for unlimited
+    Sends OPENDIRX for the listing described by tnfsMountInfo.dir_snapshot and stores the
+    directory handle in tnfsMountInfo.dir_handle
     Returns: 0: success, -1: failed to send/receive packet, other: TNFS server response
 */
-int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts, uint8_t diropts, const char *pattern, uint16_t maxresults)
+int _tnfs_opendirx_server(tnfsMountInfo *m_info)
 {
-    if (m_info == nullptr || directory == nullptr)
-        return -1;
-
 #define OFFSET_OPENDIRX_DIROPT 0
 #define OFFSET_OPENDIRX_SORTOPT 1
 #define OFFSET_OPENDIRX_MAXRESULTS 2
@@ -705,32 +931,29 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
 // Number of bytes before the two null-terminated strings start
 #define OPENDIRX_HEADERBYTES 4
 
-    // Throw out any existing cached directory entries
-    m_info->empty_dircache();
+    tnfsDirSnapshot &snap = m_info->dir_snapshot;
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_OPENDIRX;
 
-    packet.payload[OFFSET_OPENDIRX_DIROPT] = diropts;
-    packet.payload[OFFSET_OPENDIRX_SORTOPT] = sortopts;
+    packet.payload[OFFSET_OPENDIRX_DIROPT] = snap.diropts;
+    packet.payload[OFFSET_OPENDIRX_SORTOPT] = snap.sortopts;
 
-    packet.payload[OFFSET_OPENDIRX_MAXRESULTS] = TNFS_LOBYTE_FROM_UINT16(maxresults);
-    packet.payload[OFFSET_OPENDIRX_MAXRESULTS + 1] = TNFS_HIBYTE_FROM_UINT16(maxresults);
+    packet.payload[OFFSET_OPENDIRX_MAXRESULTS] = TNFS_LOBYTE_FROM_UINT16(snap.maxresults);
+    packet.payload[OFFSET_OPENDIRX_MAXRESULTS + 1] = TNFS_HIBYTE_FROM_UINT16(snap.maxresults);
 
     // Copy the pattern or an empty string
-    strlcpy((char *)(packet.payload + OFFSET_OPENDIRX_PATTERN),
-        pattern == nullptr ? "" : pattern,
+    strlcpy((char *)(packet.payload + OFFSET_OPENDIRX_PATTERN), snap.pattern,
         sizeof(packet.payload) - OPENDIRX_HEADERBYTES - 1);
 
     // Calculate the new offset to the path taking the pattern string into account
     int pathoffset = strlen((char *)(packet.payload + OFFSET_OPENDIRX_PATTERN)) + OPENDIRX_HEADERBYTES + 1;
 
-    // Copy the directory into the right spot in the packet and get its string len
-    int pathlen = _tnfs_adjust_with_full_path(m_info,
-        (char *)(packet.payload + pathoffset), directory, sizeof(packet.payload) - pathoffset);
+    // The snapshot already holds the full path
+    int pathlen = strlcpy((char *)(packet.payload + pathoffset), snap.path, sizeof(packet.payload) - pathoffset);
 
     Debug_printf("TNFS open directory: sortopts=0x%02x diropts=0x%02x maxresults=0x%04x pattern=\"%s\" path=\"%s\"\r\n",
-     sortopts, diropts, maxresults, (char *)(packet.payload + OFFSET_OPENDIRX_PATTERN), (char *)(packet.payload + pathoffset));
+     snap.sortopts, snap.diropts, snap.maxresults, (char *)(packet.payload + OFFSET_OPENDIRX_PATTERN), (char *)(packet.payload + pathoffset));
 
     if (_tnfs_transaction(m_info, packet, pathoffset + pathlen + 1))
     {
@@ -738,6 +961,7 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
         {
             m_info->dir_handle = packet.payload[1];
             m_info->dir_entries = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 2);
+            m_info->dir_server_position = 0;
             Debug_printf("Directory opened, handle ID: %hd, entries: %u\r\n", m_info->dir_handle, m_info->dir_entries);
         }
         return packet.payload[0];
@@ -745,7 +969,62 @@ int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts
     return -1;
 }
 
-void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
+/*
+    Opens directory. The listing is kept in tnfsMountInfo.dir_snapshot; opening the same
+    directory with the same options again within TNFS_DIRSNAPSHOT_TTL_MS is served from
+    there, and the server is only asked if reading goes past what the snapshot holds.
+    sortopts = zero or more TNFS_DIRSORT flags
+    diropts = zero or more TNFS_DIROPT flags
+    pattern = zero-terminated wildcard pattern string
+    maxresults = max number of results to return or zero for unlimited
+    Returns: 0: success, -1: failed to send/receive packet, other: TNFS server response
+*/
+int tnfs_opendirx(tnfsMountInfo *m_info, const char *directory, uint8_t sortopts, uint8_t diropts, const char *pattern, uint16_t maxresults)
+{
+    if (m_info == nullptr || directory == nullptr)
+        return -1;
+
+    char fullpath[TNFS_MAX_FILELEN];
+    if (_tnfs_adjust_with_full_path(m_info, fullpath, directory, sizeof(fullpath)) < 0)
+        return -1;
+    if (pattern == nullptr)
+        pattern = "";
+
+    // Close anything left open
+    if (m_info->dir_open)
+        tnfs_closedir(m_info);
+
+    tnfsDirSnapshot &snap = m_info->dir_snapshot;
+    if (snap.matches(fullpath, pattern, sortopts, diropts, maxresults) && snap.fresh() && snap.base() == 0)
+    {
+        Debug_printf("TNFS open directory \"%s\" from snapshot, %u entries%s\r\n",
+            fullpath, snap.count(), snap.eof ? "" : " so far");
+        m_info->dir_entries = snap.entries;
+        m_info->dir_position = 0;
+        m_info->dir_open = true;
+        return TNFS_RESULT_SUCCESS;
+    }
+
+    snap.clear();
+    strlcpy(snap.path, fullpath, sizeof(snap.path));
+    strlcpy(snap.pattern, pattern, sizeof(snap.pattern));
+    snap.sortopts = sortopts;
+    snap.diropts = diropts;
+    snap.maxresults = maxresults;
+
+    int result = _tnfs_opendirx_server(m_info);
+    if (result != TNFS_RESULT_SUCCESS)
+        return result;
+
+    snap.valid = true;
+    snap.entries = m_info->dir_entries;
+    snap.loaded_ms = fnSystem.millis();
+    m_info->dir_position = 0;
+    m_info->dir_open = true;
+    return result;
+}
+
+void _readdirx_fill_response(tnfsDirSnapshot &snap, const tnfsDirSnapshotEntry *pCached, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
 {
     filestat->isDir = pCached->flags & TNFS_READDIRX_DIR ? true : false;
     filestat->filesize = pCached->filesize;
@@ -753,7 +1032,7 @@ void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, cha
     filestat->c_time = pCached->c_time;
     filestat->a_time = 0;
 
-    strlcpy(dir_entry, pCached->entryname, dir_entry_len);
+    strlcpy(dir_entry, snap.name(pCached), dir_entry_len);
 
 #ifdef DEBUG
     {
@@ -772,36 +1051,38 @@ void _readdirx_fill_response(tnfsDirCacheEntry *pCached, tnfsStat *filestat, cha
 }
 
 /*
-    Reads next available file using open directory handle specified in
-    tnfsMountInfo.dir_handle
-    dir_entry filled with filename up to dir_entry_len
- returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+    Loads the next batch of entries starting at tnfsMountInfo.dir_position into the snapshot,
+    opening and positioning the directory on the server first if needed.
+    Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
 */
-int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
+int _tnfs_readdirx_fetch(tnfsMountInfo *m_info)
 {
-    // Check for a valid open handle ID
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
-        return -1;
+    tnfsDirSnapshot &snap = m_info->dir_snapshot;
+    int result;
 
-    // See if we have an entry in our directory cache to return first
-    tnfsDirCacheEntry *pCached = m_info->next_dircache_entry();
-    if(pCached != nullptr)
+    // Listing came from the snapshot so far
+    if (false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
     {
-        Debug_print("tnfs_readdirx responding from cached entry\r\n");
-        _readdirx_fill_response(pCached, filestat, dir_entry, dir_entry_len);
-        return 0;
+        result = _tnfs_opendirx_server(m_info);
+        if (result != TNFS_RESULT_SUCCESS)
+            return result;
     }
 
-    // If the cache was empty and the EOF flag was set, just respond with an EOF error
-    if(m_info->get_dircache_eof() == true)
+    if (m_info->dir_server_position != m_info->dir_position)
     {
-        Debug_print("tnfs_readdirx returning EOF based on cached value\r\n");
-        return TNFS_RESULT_END_OF_FILE;
+        tnfsPacket packet;
+        packet.command = TNFS_CMD_SEEKDIR;
+        packet.payload[0] = m_info->dir_handle;
+        uint32_t pos = m_info->dir_position;
+        TNFS_UINT32_TO_LOHI_BYTEPTR(pos, packet.payload + 1);
+
+        if (!_tnfs_transaction(m_info, packet, 5))
+            return -1;
+        if (packet.payload[0] != TNFS_RESULT_SUCCESS)
+            return packet.payload[0];
+        m_info->dir_server_position = m_info->dir_position;
     }
 
-    // Invalidate the cache before loading more
-    m_info->empty_dircache();
-
 #define OFFSET_READDIRX_FLAGS 0
 #define OFFSET_READDIRX_SIZE 1
 #define OFFSET_READDIRX_MTIME 5
@@ -812,148 +1093,148 @@ int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, in
     packet.command = TNFS_CMD_READDIRX;
     packet.payload[0] = m_info->dir_handle;
     // Number of responses to read
-    packet.payload[1] = TNFS_MAX_DIRCACHE_ENTRIES;
+    packet.payload[1] = TNFS_READDIRX_MAX_ENTRIES;
+
+    if (!_tnfs_transaction(m_info, packet, 2))
+        return -1;
 
-    if (_tnfs_transaction(m_info, packet, 2))
+    if (packet.payload[0] == TNFS_RESULT_END_OF_FILE)
     {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+        if (snap.count() == 0 || m_info->dir_position == snap.base() + snap.count())
+            snap.eof = true;
+        return TNFS_RESULT_SUCCESS;
+    }
+    if (packet.payload[0] != TNFS_RESULT_SUCCESS)
+        return packet.payload[0];
+
+    uint8_t response_count = packet.payload[1];
+    uint8_t response_status = packet.payload[2];
+    uint16_t dirpos = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 3);
+
+    Debug_printf("tnfs_readdirx resp_count=%hu, dirpos=%hu, status=%hu\r\n", response_count, dirpos, response_status);
+
+    // Add the returned entries to the snapshot
+    int current_offset = 5;
+    for (int i = 0; i < response_count; i++)
+    {
+        const char *name = (const char *)packet.payload + current_offset + OFFSET_READDIRX_PATH;
+        if (!snap.add(dirpos + i,
+                packet.payload[current_offset + OFFSET_READDIRX_FLAGS],
+                TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_SIZE),
+                TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_MTIME),
+                TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_CTIME),
+                name))
         {
-            uint8_t response_count = packet.payload[1];
-            uint8_t response_status = packet.payload[2];
-            uint16_t dirpos = TNFS_UINT16_FROM_LOHI_BYTEPTR(packet.payload + 3);
+            Debug_print("tnfs_readdirx Failed to allocate directory snapshot entry!\r\n");
+            break;
+        }
 
-            // Set our EOF flag if the server tells us there's no more after this
-            if(response_status & TNFS_READDIRX_STATUS_EOF)
-                m_info->set_dircache_eof();
+        /*
+         Adjust our offset to point to the next entry within the packet
+         flags (1) + size (4) + mtime (4) + ctime (4) + null (1) = 14
+        */
+        current_offset += 14 + strlen(name);
+    }
+    m_info->dir_server_position = dirpos + response_count;
 
-            Debug_printf("tnfs_readdirx resp_count=%hu, dirpos=%hu, status=%hu\r\n", response_count, dirpos, response_status);
+    // Set our EOF flag if the server tells us there's no more after this
+    snap.eof = (response_status & TNFS_READDIRX_STATUS_EOF) != 0;
 
-            // Fill our directory cache using the returned values
-            int current_offset = 5;
-            for(int i = 0; i < response_count; i++)
-            {
-                tnfsDirCacheEntry *pEntry = m_info->new_dircache_entry();
-                if(pEntry != nullptr)
-                {
-                    pEntry->dirpos = dirpos + i;
-                    pEntry->flags =
-                        packet.payload[current_offset + OFFSET_READDIRX_FLAGS];
-                    pEntry->filesize =
-                        TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_SIZE);
-                    pEntry->m_time =
-                        TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_MTIME);
-                    pEntry->c_time =
-                        TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + current_offset + OFFSET_READDIRX_CTIME);
-
-                    int name_len = strlcpy(pEntry->entryname,
-                        (char *)packet.payload + current_offset + OFFSET_READDIRX_PATH, sizeof(pEntry->entryname));
-
-                    /*
-                     Adjust our offset to point to the next entry within the packet
-                     flags (1) + size (4) + mtime (4) + ctime (4) + null (1) = 14
-                    */
-                    current_offset += 14 + name_len;
-                }
-                else
-                {
-                    Debug_print("tnfs_readdirx Failed to allocate new dircache entry!\r\n");
-                    break;
-                }
-            }
+    Debug_printf("tnfs_readdirx snapshot holds %u entries from %u\r\n", snap.count(), snap.base());
+    return TNFS_RESULT_SUCCESS;
+}
 
-            int loaded = m_info->count_dircache();
-            Debug_printf("tnfs_readdirx cached %d entries\r\n", loaded);
-            // Now that we've cached our entries, return the first one
-            if(loaded > 0)
-                _readdirx_fill_response(m_info->next_dircache_entry(), filestat, dir_entry, dir_entry_len);
+/*
+    Reads next available file in the open directory
+    dir_entry filled with filename up to dir_entry_len
+ returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+*/
+int tnfs_readdirx(tnfsMountInfo *m_info, tnfsStat *filestat, char *dir_entry, int dir_entry_len)
+{
+    // Check for an open directory
+    if (m_info == nullptr || !m_info->dir_open)
+        return -1;
 
+    tnfsDirSnapshot &snap = m_info->dir_snapshot;
+
+    if (!snap.contains(m_info->dir_position))
+    {
+        // If the snapshot ends before here, just respond with an EOF error
+        if (snap.eof && m_info->dir_position >= snap.base() + snap.count())
+        {
+            Debug_print("tnfs_readdirx returning EOF based on cached value\r\n");
+            return TNFS_RESULT_END_OF_FILE;
         }
-        return packet.payload[0];
+
+        int result = _tnfs_readdirx_fetch(m_info);
+        if (result != TNFS_RESULT_SUCCESS)
+            return result;
+        if (!snap.contains(m_info->dir_position))
+            return TNFS_RESULT_END_OF_FILE;
     }
-    return -1;
+
+    _readdirx_fill_response(snap, snap.get(m_info->dir_position), filestat, dir_entry, dir_entry_len);
+    m_info->dir_position++;
+    return 0;
 }
 
 /*
     TELLDIR
+    Position is tracked locally
 */
 int tnfs_telldir(tnfsMountInfo *m_info, uint16_t *position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr || !m_info->dir_open)
         return -1;
 
     if(position == nullptr)
         return -1;
 
-    // First see if we're pointing at a currently-cached directory entry and return that
-    int cached = m_info->tell_dircache_entry();
-    if (cached > -1)
-    {
-        *position = cached;
-        return 0;
-    }
-
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_TELLDIR;
-    packet.payload[0] = m_info->dir_handle;
-
-    if (_tnfs_transaction(m_info, packet, 1))
-    {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
-        {
-            *position = TNFS_UINT32_FROM_LOHI_BYTEPTR(packet.payload + 1);
-        }
-        return packet.payload[0];
-    }
-    return -1;
+    *position = m_info->dir_position;
+    return 0;
 }
 
 /*
     SEEKDIR
+    Served from the snapshot if it holds the position, otherwise the server is
+    repositioned on the next tnfs_readdirx
 */
 int tnfs_seekdir(tnfsMountInfo *m_info, uint16_t position)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr || !m_info->dir_open)
         return -1;
 
-    // A SEEKDIR will always invalidate our directory cache
-    m_info->empty_dircache();
-
-    tnfsPacket packet;
-    packet.command = TNFS_CMD_SEEKDIR;
-    packet.payload[0] = m_info->dir_handle;
-    uint32_t pos = position;
-    TNFS_UINT32_TO_LOHI_BYTEPTR(pos, packet.payload + 1);
-
-    if (_tnfs_transaction(m_info, packet, 5))
-        return packet.payload[0];
-
-    return -1;
+    m_info->dir_position = position;
+    return 0;
 }
 
 /*
-    Closes current directory handle specificed in tnfsMountInfo
+    Closes the open directory. The snapshot of its listing is kept for reuse.
     Returns: 0: success, -1: failed to send/receive packet, other: TNFS server response
 */
 int tnfs_closedir(tnfsMountInfo *m_info)
 {
-    if (m_info == nullptr || false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+    if (m_info == nullptr || !m_info->dir_open)
         return -1;
 
-    // Throw out any existing cached directory entries
-    m_info->empty_dircache();
+    m_info->dir_open = false;
+
+    // Only a listing that can be served from the top again is worth the memory
+    tnfsDirSnapshot &snap = m_info->dir_snapshot;
+    if (!snap.fresh() || snap.base() != 0)
+        snap.release();
+
+    // Nothing to close on the server if everything came from the snapshot
+    if (false == TNFS_VALID_AS_UINT8(m_info->dir_handle))
+        return TNFS_RESULT_SUCCESS;
 
     tnfsPacket packet;
     packet.command = TNFS_CMD_CLOSEDIR;
     packet.payload[0] = m_info->dir_handle;
+    m_info->dir_handle = TNFS_INVALID_HANDLE;
 
     if (_tnfs_transaction(m_info, packet, 1))
-    {
-        if (packet.payload[0] == TNFS_RESULT_SUCCESS)
-        {
-            m_info->dir_handle = TNFS_INVALID_HANDLE;
-        }
         return packet.payload[0];
-    }
     return -1;
 }
 
@@ -966,6 +1247,9 @@ int tnfs_mkdir(tnfsMountInfo *m_info, const char *directory)
     if (m_info == nullptr || directory == nullptr)
         return -1;
 
+    // Cached listings may no longer be accurate
+    m_info->dir_snapshot.expire();
+
     tnfsPacket packet;
     packet.command = TNFS_CMD_MKDIR;
 
@@ -989,6 +1273,9 @@ int tnfs_rmdir(tnfsMountInfo *m_info, const char *directory)
     if (m_info == nullptr || directory == nullptr)
         return -1;
 
+    // Cached listings may no longer be accurate
+    m_info->dir_snapshot.expire();
+
     tnfsPacket packet;
     packet.command = TNFS_CMD_RMDIR;
 
@@ -1066,6 +1353,9 @@ int tnfs_unlink(tnfsMountInfo *m_info, const char *filepath)
     if (m_info == nullptr || filepath == nullptr)
         return -1;
 
+    // Cached listings may no longer be accurate
+    m_info->dir_snapshot.expire();
+
     tnfsPacket packet;
     packet.command = TNFS_CMD_UNLINK;
 
@@ -1090,6 +1380,9 @@ int tnfs_rename(tnfsMountInfo *m_info, const char *old_filepath, const char *new
     if (m_info == nullptr || old_filepath == nullptr || new_filepath == nullptr)
         return -1;
 
+    // Cached listings may no longer be accurate
+    m_info->dir_snapshot.expire();
+
     tnfsPacket packet;
     packet.command = TNFS_CMD_RENAME;
 
@@ -1262,7 +1555,7 @@ bool _tnfs_send(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t pay
         if (!success)
         {
             Debug_println("Can't connect to the TCP server; falling back to UDP.");
-            m_info->protocol = TNFS_PROTOCOL_UDP;
+            _tnfs_fallback_udp(m_info);
             return _tnfs_udp_send(udp, m_info, pkt, payload_size);
         }
         return success;
@@ -1279,22 +1572,43 @@ bool _tnfs_send(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t pay
 
 bool _tnfs_tcp_send(tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_size)
 {
-    fnTcpClient *tcp = &m_info->tcp_client;
-    if (!tcp->connected())
-    {
-        bool success = false;
-        if (m_info->host_ip != IPADDR_NONE)
-            success = tcp->connect(m_info->host_ip, m_info->port, TNFS_TIMEOUT);
-        else
-            success = tcp->connect(m_info->hostname, m_info->port, TNFS_TIMEOUT);
-        if (!success)
-        {
-            Debug_println("Can't connect to the TCP server");
-            return false;
-        }
-    }
-    int l = tcp->write(pkt.rawData, payload_size + TNFS_HEADER_SIZE);
-    return l == payload_size + TNFS_HEADER_SIZE;
+    if (m_info->tcp_connection == nullptr)
+        m_info->tcp_connection = tnfsConnection::acquire(m_info->hostname, m_info->host_ip, m_info->port);
+    return m_info->tcp_connection->send(pkt, payload_size, TNFS_TIMEOUT);
+}
+
+/*
+    Sequence number for a new request. Over TCP (or while still finding out whether the server
+    supports it) this comes from the connection shared with other mounts, so requests from all
+    of them can be in flight together.
+*/
+uint8_t _tnfs_next_sequence(tnfsMountInfo *m_info)
+{
+    if (m_info->protocol == TNFS_PROTOCOL_UDP)
+        return m_info->current_sequence_num++;
+
+    if (m_info->tcp_connection == nullptr)
+        m_info->tcp_connection = tnfsConnection::acquire(m_info->hostname, m_info->host_ip, m_info->port);
+
+    uint8_t seq = m_info->tcp_connection->next_sequence(m_info->current_sequence_num - 1);
+    m_info->current_sequence_num = seq + 1;
+    return seq;
+}
+
+/*
+    Done with the request - any response still to come for it is discarded
+*/
+void _tnfs_end_sequence(tnfsMountInfo *m_info, uint8_t sequence_num)
+{
+    if (m_info->tcp_connection != nullptr)
+        m_info->tcp_connection->forget(sequence_num);
+}
+
+void _tnfs_fallback_udp(tnfsMountInfo *m_info)
+{
+    m_info->protocol = TNFS_PROTOCOL_UDP;
+    tnfsConnection::release(m_info->tcp_connection);
+    m_info->tcp_connection = nullptr;
 }
 
 #ifndef TNFS_UDP_SIMULATE_POOR_CONNECTION
@@ -1325,12 +1639,13 @@ bool _tnfs_udp_do_send(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt, uint1
     Receive the packet, using UDP or TCP, depending on the m_info.
     Return the number of received bytes or an negative value if the
     packet is not available or an error occurred.
+    Over TCP only the response to sequence_num is returned; -2 means it will never arrive.
 */
-int _tnfs_recv(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt)
+int _tnfs_recv(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt, uint8_t sequence_num)
 {
     if (m_info->protocol == TNFS_PROTOCOL_TCP || m_info->protocol == TNFS_PROTOCOL_UNKNOWN)
     {
-        return _tnfs_tcp_recv(m_info, pkt);
+        return _tnfs_tcp_recv(m_info, pkt, sequence_num);
     }
     else
     {
@@ -1338,18 +1653,11 @@ int _tnfs_recv(fnUDP *udp, tnfsMountInfo *m_info, tnfsPacket &pkt)
     }
 }
 
-int _tnfs_tcp_recv(tnfsMountInfo *m_info, tnfsPacket &pkt)
+int _tnfs_tcp_recv(tnfsMountInfo *m_info, tnfsPacket &pkt, uint8_t sequence_num)
 {
-    fnTcpClient *tcp = &m_info->tcp_client;
-    if (!tcp->connected())
-    {
-        return -1;
-    }
-    if (!tcp->available())
-    {
-        return -1;
-    }
-    return tcp->read(pkt.rawData, sizeof(pkt.rawData));
+    if (m_info->tcp_connection == nullptr)
+        return -2;
+    return m_info->tcp_connection->recv(sequence_num, pkt);
 }
 
 #ifndef TNFS_UDP_SIMULATE_POOR_CONNECTION
@@ -1389,7 +1697,7 @@ bool _tnfs_transaction(tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_
     reqPkt.session_idh = TNFS_HIBYTE_FROM_UINT16(m_info->session);
 
     // Set sequence number before the transaction loop
-    reqPkt.sequence_num = m_info->current_sequence_num++;
+    reqPkt.sequence_num = _tnfs_next_sequence(m_info);
 
     // Start a new retry sequence
     for (int retry = 0; retry < m_info->max_retries; retry++)
@@ -1397,6 +1705,7 @@ bool _tnfs_transaction(tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_
         switch(_tnfs_send_recv(udp, m_info, reqPkt, payload_size, pkt))
         {
             case SUCCESS:
+            _tnfs_end_sequence(m_info, reqPkt.sequence_num);
             return true;
 
             case RESET:
@@ -1414,6 +1723,7 @@ bool _tnfs_transaction(tnfsMountInfo *m_info, tnfsPacket &pkt, uint16_t payload_
     }
 
     Debug_printf("Retry attempts failed for host: %s, path: %s, cwd: %s\r\n", m_info->hostname, m_info->mountpath, m_info->current_working_directory);
+    _tnfs_end_sequence(m_info, reqPkt.sequence_num);
 
     return false;
 }
@@ -1482,7 +1792,8 @@ _tnfs_send_recv_result _tnfs_send_recv(fnUDP &udp, tnfsMountInfo *m_info, tnfsPa
         // to any commands. We should fall back to UDP too and don't count this iteration
         // in the retry counter.
         Debug_println("No response to TCP mount request; falling back to UDP.");
-        m_info->protocol = TNFS_PROTOCOL_UDP;
+        _tnfs_end_sequence(m_info, req_pkt.sequence_num);
+        _tnfs_fallback_udp(m_info);
         return RESET;
     }
     
@@ -1495,7 +1806,12 @@ _tnfs_recv_result _tnfs_recv_and_validate(fnUDP &udp, tnfsMountInfo *m_info, tnf
 #ifndef ESP_PLATFORM
     fnSystem.delay_microseconds(2000); // wait short time for (local) data to arrive
 #endif
-    int l = _tnfs_recv(&udp, m_info, res_pkt);
+    int l = _tnfs_recv(&udp, m_info, res_pkt, req_pkt.sequence_num);
+    if (l < -1)
+    {
+        // Connection dropped, the request has to be sent again
+        return RESP_INVALID;
+    }
     if (l < 0)
     {
         return NO_RESP;
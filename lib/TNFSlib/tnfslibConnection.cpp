@@ -0,0 +1,425 @@
+#include "tnfslibConnection.h"
+
+#include <cstring>
+#include <vector>
+
+#include "compat_string.h"
+
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+
+
+static std::vector<tnfsConnection *> _tnfs_connections;
+static std::mutex _tnfs_connections_mutex;
+
+tnfsConnection::tnfsConnection(const char *hostname, in_addr_t host_ip, uint16_t port)
+    : _host_ip(host_ip)
+    , _port(port)
+{
+    if (hostname != nullptr)
+        strlcpy(_hostname, hostname, sizeof(_hostname));
+}
+
+tnfsConnection *tnfsConnection::acquire(const char *hostname, in_addr_t host_ip, uint16_t port)
+{
+    std::lock_guard<std::mutex> lock(_tnfs_connections_mutex);
+
+    for (tnfsConnection *c : _tnfs_connections)
+    {
+        if (c->_port != port)
+            continue;
+        if (host_ip != IPADDR_NONE ? c->_host_ip == host_ip : strcasecmp(c->_hostname, hostname) == 0)
+        {
+            c->_refs++;
+            return c;
+        }
+    }
+
+    tnfsConnection *c = new tnfsConnection(hostname, host_ip, port);
+    c->_refs = 1;
+    _tnfs_connections.push_back(c);
+    return c;
+}
+
+void tnfsConnection::release(tnfsConnection *conn)
+{
+    if (conn == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock(_tnfs_connections_mutex);
+
+    if (--conn->_refs > 0)
+        return;
+
+    for (auto it = _tnfs_connections.begin(); it != _tnfs_connections.end(); ++it)
+    {
+        if (*it == conn)
+        {
+            _tnfs_connections.erase(it);
+            break;
+        }
+    }
+    conn->_tcp.stop();
+    delete conn;
+}
+
+bool tnfsConnection::connected()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_connecting && _tcp.connected();
+}
+
+tnfsConnection::inflight *tnfsConnection::find(uint8_t sequence_num)
+{
+    for (int i = 0; i < TNFS_TCP_MAX_INFLIGHT; i++)
+        if (_inflight[i].used && _inflight[i].sequence_num == sequence_num)
+            return &_inflight[i];
+    return nullptr;
+}
+
+uint8_t tnfsConnection::next_sequence(uint8_t avoid)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // The server replays its last response when a session repeats a sequence number,
+    // so skip the one the mount used last as well as any still in flight
+    uint8_t seq;
+    do
+        seq = _next_sequence++;
+    while (seq == avoid || find(seq) != nullptr);
+    return seq;
+}
+
+/*
+ Connection lost or the stream can't be parsed any more - close it and fail everything in flight.
+ Owners see -2 from recv() and retry, which reconnects.
+*/
+void tnfsConnection::drop()
+{
+    Debug_printf("TNFS connection to %s:%hu dropped with %u requests in flight\r\n",
+                 _host_ip != IPADDR_NONE ? compat_inet_ntoa(_host_ip) : _hostname, _port, _inflight_count);
+    _tcp.stop();
+    for (int i = 0; i < TNFS_TCP_MAX_INFLIGHT; i++)
+        _inflight[i].used = false;
+    _inflight_count = 0;
+    _exclusive = false;
+    _rx_fill = 0;
+}
+
+/*
+ The response to an unframeable request couldn't be parsed. It was the only one in flight, so
+ discard what has arrived and fail just that request; the stream is in step again once the rest
+ of the response has been discarded, which send() does before the next request.
+*/
+void tnfsConnection::fail(inflight *slot)
+{
+    Debug_printf("TNFS can't frame response seq=0x%02x, cmd=0x%02x\r\n", _rx.sequence_num, _rx.command);
+    uint8_t discard[64];
+    while (_tcp.available() > 0 && _tcp.read(discard, sizeof(discard)) > 0)
+        ;
+    slot->used = false;
+    _inflight_count--;
+    _exclusive = false;
+    _rx_fill = 0;
+}
+
+bool tnfsConnection::send(const tnfsPacket &pkt, uint16_t payload_size, int timeout_ms)
+{
+    bool exclusive = !_tnfs_tcp_can_frame(pkt.command);
+    uint64_t ms_start = fnSystem.millis();
+
+    while (true)
+    {
+        bool connect = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if (_connecting)
+            {
+                // Another caller is connecting, wait for it
+            }
+            else if (!_tcp.connected())
+            {
+                // Nothing in flight on a lost connection will be answered
+                if (_inflight_count > 0)
+                    drop();
+                _connecting = true;
+                connect = true;
+            }
+            else
+            {
+                inflight *slot = find(pkt.sequence_num);
+                bool ready = slot != nullptr ||
+                             (!_exclusive && (!exclusive || _inflight_count == 0) && _inflight_count < TNFS_TCP_MAX_INFLIGHT);
+                if (ready)
+                {
+                    // Anything on the stream while nothing is expected is left over from a
+                    // response that was given up on
+                    if (_inflight_count == 0 && _rx_fill == 0)
+                    {
+                        uint8_t discard[64];
+                        while (_tcp.available() > 0 && _tcp.read(discard, sizeof(discard)) > 0)
+                            ;
+                    }
+
+                    if (slot == nullptr)
+                    {
+                        for (int i = 0; i < TNFS_TCP_MAX_INFLIGHT; i++)
+                        {
+                            if (!_inflight[i].used)
+                            {
+                                slot = &_inflight[i];
+                                break;
+                            }
+                        }
+                        slot->used = true;
+                        slot->sequence_num = pkt.sequence_num;
+                        slot->command = pkt.command;
+                        _inflight_count++;
+                        if (exclusive)
+                            _exclusive = true;
+                    }
+                    slot->done = false;
+
+                    // One write per request; the server expects each request to arrive whole
+                    size_t len = payload_size + TNFS_HEADER_SIZE;
+                    if (_tcp.write(pkt.rawData, len) == len)
+                        return true;
+
+                    drop();
+                    return false;
+                }
+            }
+        }
+
+        if (connect)
+        {
+            // _connecting keeps everyone else off _tcp while the lock is released
+            bool success;
+            if (_host_ip != IPADDR_NONE)
+                success = _tcp.connect(_host_ip, _port, timeout_ms);
+            else
+                success = _tcp.connect(_hostname, _port, timeout_ms);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _connecting = false;
+            if (!success)
+            {
+                Debug_println("Can't connect to the TCP server");
+                return false;
+            }
+            // Requests are small and latency bound
+            _tcp.setNoDelay(true);
+            _rx_fill = 0;
+            continue;
+        }
+
+        // Wait for the connection to free up, collecting responses meanwhile
+        if ((fnSystem.millis() - ms_start) >= (uint64_t)timeout_ms)
+        {
+            Debug_println("TNFS connection busy, giving up on send");
+            return false;
+        }
+        pump();
+        fnSystem.delay_microseconds(1000);
+    }
+}
+
+/*
+ Pulls whatever has arrived off the stream and files complete responses under their sequence
+ numbers. Responses nobody waits for any more are discarded.
+*/
+void tnfsConnection::pump()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_connecting)
+        return;
+
+    while (_tcp.connected())
+    {
+        int need = TNFS_HEADER_SIZE + 1;
+        if (_rx_fill >= need)
+        {
+            need = _tnfs_tcp_response_length(_rx, _rx_fill);
+            if (need < 0)
+            {
+                // Only the exclusive request should produce this, and only it has to fail
+                inflight *slot = find(_rx.sequence_num);
+                if (!_exclusive || slot == nullptr || slot->command != _rx.command)
+                {
+                    drop();
+                    return;
+                }
+                fail(slot);
+                return;
+            }
+            if (need > (int)sizeof(_rx.rawData))
+            {
+                Debug_printf("TNFS response too long (%d), cmd=0x%02x\r\n", need, _rx.command);
+                drop();
+                return;
+            }
+        }
+
+        if (_rx_fill >= need)
+        {
+            inflight *slot = find(_rx.sequence_num);
+            if (slot != nullptr && slot->command == _rx.command)
+            {
+                memcpy(slot->response.rawData, _rx.rawData, need);
+                slot->len = need;
+                slot->done = true;
+            }
+            else
+            {
+                Debug_printf("TNFS discarding response seq=0x%02x, cmd=0x%02x\r\n", _rx.sequence_num, _rx.command);
+            }
+            _rx_fill = 0;
+            continue;
+        }
+
+        if (_tcp.available() <= 0)
+            return;
+        int l = _tcp.read(_rx.rawData + _rx_fill, need - _rx_fill);
+        if (l <= 0)
+            return;
+        _rx_fill += l;
+    }
+
+    if (_inflight_count > 0)
+        drop();
+}
+
+int tnfsConnection::recv(uint8_t sequence_num, tnfsPacket &pkt)
+{
+    pump();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    inflight *slot = find(sequence_num);
+    if (slot == nullptr)
+        return -2;
+    if (!slot->done)
+        return -1;
+
+    memcpy(pkt.rawData, slot->response.rawData, slot->len);
+    slot->done = false;
+    return slot->len;
+}
+
+void tnfsConnection::forget(uint8_t sequence_num)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    inflight *slot = find(sequence_num);
+    if (slot == nullptr)
+        return;
+    if (!_tnfs_tcp_can_frame(slot->command))
+        _exclusive = false;
+    slot->used = false;
+    _inflight_count--;
+}
+
+/*
+ Works out how long a response is from its header and as much of it as has arrived.
+ Returns the full length if it is known (it may be more than 'fill'), at least fill + 1 while a
+ variable length part is still incomplete, or -1 if the end can't be told from the data.
+*/
+int _tnfs_tcp_response_length(const tnfsPacket &pkt, int fill)
+{
+    const int base = TNFS_HEADER_SIZE + 1; // header and result code
+    if (fill < base)
+        return base;
+
+    uint8_t result = pkt.payload[0];
+
+    // Server asks us to back off, a 16 bit delay follows
+    if (result == TNFS_RESULT_TRY_AGAIN)
+        return base + 2;
+
+    if (result != TNFS_RESULT_SUCCESS)
+        return pkt.command == TNFS_CMD_MOUNT ? base + 2 : base; // failed MOUNT still gives the version
+
+    switch (pkt.command)
+    {
+    case TNFS_CMD_MOUNT:
+        return base + 4; // version, min retry
+
+    case TNFS_CMD_UNMOUNT:
+    case TNFS_CMD_CLOSEDIR:
+    case TNFS_CMD_MKDIR:
+    case TNFS_CMD_RMDIR:
+    case TNFS_CMD_SEEKDIR:
+    case TNFS_CMD_CLOSE:
+    case TNFS_CMD_UNLINK:
+    case TNFS_CMD_CHMOD:
+    case TNFS_CMD_RENAME:
+        return base;
+
+    case TNFS_CMD_OPENDIR:
+    case TNFS_CMD_OPEN:
+        return base + 1; // handle
+
+    case TNFS_CMD_OPENDIRX:
+        return base + 3; // handle, entry count
+
+    case TNFS_CMD_TELLDIR:
+    case TNFS_CMD_LSEEK:
+    case TNFS_CMD_SIZE:
+    case TNFS_CMD_FREE:
+        return base + 4;
+
+    case TNFS_CMD_WRITE:
+        return base + 2;
+
+    case TNFS_CMD_READ:
+        if (fill < base + 2)
+            return base + 2;
+        return base + 2 + TNFS_UINT16_FROM_LOHI_BYTEPTR(pkt.payload + 1);
+
+    case TNFS_CMD_READDIR:
+        // NULL terminated name
+        for (int i = base; i < fill; i++)
+            if (pkt.rawData[i] == '\0')
+                return i + 1;
+        return fill + 1;
+
+    case TNFS_CMD_READDIRX:
+    {
+        // count, status, dirpos, then count * (flags, size, mtime, ctime, NULL terminated name)
+        int pos = base + 4;
+        if (fill < pos)
+            return pos;
+        uint8_t count = pkt.payload[1];
+        for (int e = 0; e < count; e++)
+        {
+            pos += 13;
+            if (fill < pos)
+                return pos;
+            while (pos < fill && pkt.rawData[pos] != '\0')
+                pos++;
+            if (pos >= fill)
+                return fill + 1;
+            pos++;
+        }
+        return pos;
+    }
+
+    case TNFS_CMD_STAT:
+        return base + 22; // mode, uid, gid, size, atime, mtime, ctime
+
+    default:
+        return -1;
+    }
+}
+
+bool _tnfs_tcp_can_frame(uint8_t command)
+{
+    // A successful response is the one with a command specific layout
+    tnfsPacket pkt;
+    pkt.command = command;
+    pkt.payload[0] = TNFS_RESULT_SUCCESS;
+    return _tnfs_tcp_response_length(pkt, TNFS_HEADER_SIZE + 1) >= 0;
+}
@@ -0,0 +1,86 @@
+#ifndef _TNFSLIB_CONNECTION_H
+#define _TNFSLIB_CONNECTION_H
+
+#include <mutex>
+
+#include "tnfslib.h"
+#include "fnTcpClient.h"
+
+#define TNFS_TCP_MAX_INFLIGHT 16 // Requests outstanding on one connection, across all mounts sharing it
+
+/*
+ A TCP connection to one TNFS server (host:port), shared by every tnfsMountInfo talking to it.
+
+ Requests from different mounts go out on the same stream without waiting for each other; the
+ responses are pulled off the stream by whichever caller is polling, framed by command and parked
+ under their sequence number until the owner collects them. Sequence numbers are therefore
+ allocated per connection rather than per mount.
+
+ A command whose response can't be framed only goes out while nothing else is in flight and holds
+ the connection until answered; if the response can't be parsed only that request fails.
+
+ Connecting is done without holding the lock, other callers wait for it in send() meanwhile.
+*/
+class tnfsConnection
+{
+private:
+    struct inflight
+    {
+        bool used = false;
+        bool done = false;
+        uint8_t sequence_num = 0;
+        uint8_t command = 0;
+        int len = 0;
+        tnfsPacket response;
+    };
+
+    char _hostname[64] = { '\0' };
+    in_addr_t _host_ip = IPADDR_NONE;
+    uint16_t _port = 0;
+    int _refs = 0;
+
+    fnTcpClient _tcp;
+    std::mutex _mutex; // Guards the socket and everything below
+    inflight _inflight[TNFS_TCP_MAX_INFLIGHT];
+    uint8_t _inflight_count = 0;
+    bool _exclusive = false; // An unframeable request is outstanding
+    bool _connecting = false; // _tcp is being connected without the lock held
+    uint8_t _next_sequence = 0;
+
+    tnfsPacket _rx; // Response being reassembled from the stream
+    int _rx_fill = 0;
+
+    inflight *find(uint8_t sequence_num);
+    void pump();
+    void drop();
+    void fail(inflight *slot);
+
+    tnfsConnection(const char *hostname, in_addr_t host_ip, uint16_t port);
+
+public:
+    // Returns the pooled connection for the server, creating it (unconnected) if needed
+    static tnfsConnection *acquire(const char *hostname, in_addr_t host_ip, uint16_t port);
+    // Drops a reference; the last one closes the connection
+    static void release(tnfsConnection *conn);
+
+    // Next sequence number not in flight on this connection and different from 'avoid'
+    uint8_t next_sequence(uint8_t avoid);
+
+    // Sends a request, connecting first if necessary. Resending a sequence number that is
+    // already in flight (a retry) keeps its slot.
+    bool send(const tnfsPacket &pkt, uint16_t payload_size, int timeout_ms);
+    // Returns the response length if the response to sequence_num has arrived, -1 if not yet,
+    // or -2 if the request is no longer in flight (e.g. the connection was lost)
+    int recv(uint8_t sequence_num, tnfsPacket &pkt);
+    // Stop waiting for a response
+    void forget(uint8_t sequence_num);
+
+    bool connected();
+};
+
+// Length of a complete response given the first 'fill' bytes of it, or -1 if it can't be framed
+int _tnfs_tcp_response_length(const tnfsPacket &pkt, int fill);
+// Whether responses to the command can be framed on the stream
+bool _tnfs_tcp_can_frame(uint8_t command);
+
+#endif // _TNFSLIB_CONNECTION_H
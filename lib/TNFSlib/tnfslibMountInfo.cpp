@@ -1,7 +1,11 @@
 
 #include "tnfslibMountInfo.h"
+#include "tnfslibConnection.h"
+
+#include <cstring>
 
 #include "compat_string.h"
+#include "fnSystem.h"
 
 
 tnfsMountInfo::tnfsMountInfo(const char *host_name, uint16_t host_port)
@@ -28,63 +32,138 @@ tnfsMountInfo::~tnfsMountInfo()
             _file_handles[i] = nullptr;
         }
     }
-    // Delete any remaining directory cache entries
-    empty_dircache();
+    tnfsConnection::release(tcp_connection);
 }
 
-// Empty the current contents of the directory cache
-void tnfsMountInfo::empty_dircache()
+tnfsDirSnapshot::~tnfsDirSnapshot()
 {
-    for (int i = 0; i < TNFS_MAX_DIRCACHE_ENTRIES; i++)
-    {
-        if (_dir_cache[i] != nullptr)
-        {
-            delete _dir_cache[i];
-            _dir_cache[i] = nullptr;
-        }
-    }
-    _dir_cache_current = 0;
-    _dir_cache_count = 0;
-    _dir_cache_eof = false;
+    free(_entries);
+    free(_names);
 }
 
-/*
- Add a new entry to the directory cache and return a pointer to it
- Null is returned if we've reached TNFS_MAX_DIRCACHE_ENTRIES
-*/
-tnfsDirCacheEntry * tnfsMountInfo::new_dircache_entry()
+// Forget the listing and its key
+void tnfsDirSnapshot::clear()
 {
-    if(_dir_cache_count >= TNFS_MAX_DIRCACHE_ENTRIES)
-        return nullptr;
+    _base = 0;
+    _count = 0;
+    _names_used = 0;
+    valid = false;
+    eof = false;
+    expired = false;
+}
 
-    _dir_cache[_dir_cache_count] = new tnfsDirCacheEntry();
-    _dir_cache_count ++;
-    return _dir_cache[_dir_cache_count - 1];
+void tnfsDirSnapshot::release()
+{
+    clear();
+    free(_entries);
+    free(_names);
+    _entries = nullptr;
+    _names = nullptr;
+    _entries_size = 0;
+    _names_size = 0;
+}
+
+bool tnfsDirSnapshot::matches(const char *dirpath, const char *dirpattern, uint8_t sort, uint8_t opts, uint16_t max)
+{
+    return valid && sortopts == sort && diropts == opts && maxresults == max &&
+           strcmp(path, dirpath) == 0 && strcmp(pattern, dirpattern) == 0;
+}
+
+bool tnfsDirSnapshot::fresh()
+{
+    return valid && !expired && fnSystem.millis() - loaded_ms < TNFS_DIRSNAPSHOT_TTL_MS;
 }
 
 /*
- Return a pointer to the next unread directory cache entry
- Returns null if there are no cache entries left to read
+ Makes room for the given number of entries and name bytes in total, growing by doubling.
+ Returns false if that would go over TNFS_DIRSNAPSHOT_MAX_BYTES or memory runs out.
 */
-tnfsDirCacheEntry * tnfsMountInfo::next_dircache_entry()
+bool tnfsDirSnapshot::reserve(uint32_t entries, uint32_t name_bytes)
 {
-    if(_dir_cache_current >= _dir_cache_count)
-        return nullptr;
-
-    _dir_cache_current++;
-    return _dir_cache[_dir_cache_current - 1];
+    uint32_t entries_size = _entries_size;
+    while (entries_size < entries)
+        entries_size = entries_size ? entries_size * 2 : 64;
+    uint32_t names_size = _names_size;
+    while (names_size < name_bytes)
+        names_size = names_size ? names_size * 2 : 1024;
+
+    if (entries_size == _entries_size && names_size == _names_size)
+        return true;
+    if (entries_size * sizeof(tnfsDirSnapshotEntry) + names_size > TNFS_DIRSNAPSHOT_MAX_BYTES)
+        return false;
+
+    if (entries_size != _entries_size)
+    {
+        tnfsDirSnapshotEntry *e = (tnfsDirSnapshotEntry *)realloc(_entries, entries_size * sizeof(tnfsDirSnapshotEntry));
+        if (e == nullptr)
+            return false;
+        _entries = e;
+        _entries_size = entries_size;
+    }
+    if (names_size != _names_size)
+    {
+        char *n = (char *)realloc(_names, names_size);
+        if (n == nullptr)
+            return false;
+        _names = n;
+        _names_size = names_size;
+    }
+    return true;
 }
 
 /*
- Returns the directory position of the currently cached directory
- entry as provided by the server.
- Returns -1 if there is no currently cached entry.
+ Drops the oldest half of the entries, or more until one more entry with name_bytes fits in the
+ buffers already allocated. Returns false if it can't fit even in an empty window.
 */
-int tnfsMountInfo::tell_dircache_entry()
+bool tnfsDirSnapshot::evict(uint32_t name_bytes)
 {
-    if(_dir_cache_current >= _dir_cache_count)
-        return -1;
-    return _dir_cache[_dir_cache_current]->dirpos;
+    if (_entries_size == 0 || name_bytes > _names_size)
+        return false;
+
+    uint16_t drop = _count / 2;
+    if (drop == 0)
+        drop = _count;
+    while (drop < _count &&
+           ((uint32_t)(_count - drop + 1) > _entries_size || _names_used - _entries[drop].name_offset + name_bytes > _names_size))
+        drop++;
+
+    uint32_t names_dropped = drop < _count ? _entries[drop].name_offset : _names_used;
+    memmove(_names, _names + names_dropped, _names_used - names_dropped);
+    memmove(_entries, _entries + drop, (_count - drop) * sizeof(tnfsDirSnapshotEntry));
+    _base += drop;
+    _count -= drop;
+    _names_used -= names_dropped;
+    for (uint16_t i = 0; i < _count; i++)
+        _entries[i].name_offset -= names_dropped;
+    return true;
+}
+
+bool tnfsDirSnapshot::add(uint16_t dirpos, uint8_t flags, uint32_t filesize, uint32_t m_time, uint32_t c_time, const char *name)
+{
+    uint32_t name_len = strlen(name) + 1;
+
+    // Entries must be contiguous; anything else starts a new window
+    if (_count == 0 || dirpos != _base + _count)
+    {
+        _base = dirpos;
+        _count = 0;
+        _names_used = 0;
+    }
+
+    // When full, make room by dropping from the front so the window still starts
+    // where the current read began
+    if (!reserve(_count + 1, _names_used + name_len) && !evict(name_len))
+        return false;
+
+    tnfsDirSnapshotEntry *e = &_entries[_count++];
+    e->name_offset = _names_used;
+    e->filesize = filesize;
+    e->m_time = m_time;
+    e->c_time = c_time;
+    e->flags = flags;
+    memcpy(_names + _names_used, name, name_len);
+    _names_used += name_len;
+    return true;
 }
 
 /*
@@ -2,10 +2,10 @@
 #define _TNFSLIB_MOUNTINFO_H
 
 #include <cstdint>
+#include <cstdlib>
 #include <mutex>
 
 #include "fnDNS.h"
-#include "fnTcpClient.h"
 
 
 #define TNFS_DEFAULT_PORT 16384
@@ -18,10 +18,23 @@
 
 #define TNFS_FILE_CACHE_SIZE 512 // 4 * 128 fits in a single packet when TNFS_MAX_READWRITE_PAYLOAD is 512
 
+#define TNFS_READAHEAD_MAX_BLOCKS 8 // Largest read-ahead window, in TNFS_FILE_CACHE_SIZE blocks (1 disables read-ahead)
+#ifdef ESP_PLATFORM
+#define TNFS_READAHEAD_INFLIGHT 4 // Max READ requests outstanding at once; keep below lwIP's UDP receive mailbox size
+#else
+#define TNFS_READAHEAD_INFLIGHT 8
+#endif
+
 #define TNFS_INVALID_HANDLE -1
 #define TNFS_INVALID_SESSION 0 // We're assuming a '0' is never a valid session ID
 
-#define TNFS_MAX_DIRCACHE_ENTRIES 32 // Max number of directory cache entries we'll store
+#define TNFS_READDIRX_MAX_ENTRIES 255 // Entries asked for per READDIRX; the server caps it to what fits in a response
+#define TNFS_DIRSNAPSHOT_TTL_MS 30000 // How long a directory listing is reused without asking the server again
+#ifdef ESP_PLATFORM
+#define TNFS_DIRSNAPSHOT_MAX_BYTES 32768 // Memory a directory snapshot may use before it turns into a sliding window
+#else
+#define TNFS_DIRSNAPSHOT_MAX_BYTES 1048576
+#endif
 
 #define TNFS_PROTOCOL_UNKNOWN 0
 #define TNFS_PROTOCOL_TCP 1
@@ -52,30 +65,102 @@ struct tnfsFileHandleInfo
 
     bool cache_modified = false; // Notes if we've written to the cache
 
-    uint8_t cache[TNFS_FILE_CACHE_SIZE];
+    uint8_t *cache = cache_block; // Either cache_block or a heap-allocated read-ahead window
+    uint32_t cache_size = TNFS_FILE_CACHE_SIZE; // Capacity of the buffer cache points to
+    uint8_t readahead_blocks = 1; // Current read-ahead window in TNFS_FILE_CACHE_SIZE blocks; grows on sequential reads
+
+    uint8_t cache_block[TNFS_FILE_CACHE_SIZE];
     char filename[TNFS_MAX_FILELEN];
+
+    tnfsFileHandleInfo() = default;
+    ~tnfsFileHandleInfo() { if (cache != cache_block) free(cache); };
+
+    // Owns cache, which may also point into itself
+    tnfsFileHandleInfo(const tnfsFileHandleInfo &) = delete;
+    tnfsFileHandleInfo &operator=(const tnfsFileHandleInfo &) = delete;
 };
 
-// A place to store each directory entry we cache from a response to TNFS_READDIRX
-struct tnfsDirCacheEntry
+// A directory entry from a response to TNFS_READDIRX; the name lives in the snapshot's name arena
+struct tnfsDirSnapshotEntry
 {
-    uint16_t dirpos;
-    uint8_t flags;
+    uint32_t name_offset;
     uint32_t filesize;
     uint32_t m_time;
     uint32_t c_time;
-    char entryname[TNFS_MAX_FILELEN];
+    uint8_t flags;
+};
+
+/*
+ Directory listing as returned by READDIRX, kept after the directory is closed so that
+ re-opening it with the same path, pattern and options within TNFS_DIRSNAPSHOT_TTL_MS
+ is served without asking the server.
+
+ Entries are contiguous by dirpos starting at base(). Names are packed back to back in
+ one buffer. If the listing outgrows TNFS_DIRSNAPSHOT_MAX_BYTES the oldest entries are
+ dropped, so it keeps working as a window but can't be reused from the top.
+
+ The buffers are freed when the directory is closed unless the snapshot can be reused,
+ and once it is past TNFS_DIRSNAPSHOT_TTL_MS.
+*/
+class tnfsDirSnapshot
+{
+private:
+    tnfsDirSnapshotEntry *_entries = nullptr;
+    uint32_t _entries_size = 0; // capacity in entries
+    char *_names = nullptr;
+    uint32_t _names_used = 0;
+    uint32_t _names_size = 0;
+    uint16_t _base = 0; // dirpos of the first entry
+    uint16_t _count = 0;
+
+    bool reserve(uint32_t entries, uint32_t name_bytes);
+    bool evict(uint32_t name_bytes);
+
+public:
+    ~tnfsDirSnapshot();
+
+    // What the listing was opened with
+    char path[TNFS_MAX_FILELEN] = { '\0' };
+    char pattern[TNFS_MAX_FILELEN] = { '\0' };
+    uint8_t sortopts = 0;
+    uint8_t diropts = 0;
+    uint16_t maxresults = 0;
+    uint16_t entries = 0; // As reported by OPENDIRX
+
+    bool valid = false; // Key fields are set
+    bool eof = false; // Snapshot holds the end of the listing
+    bool expired = false; // Something on the server changed through this mount
+    uint64_t loaded_ms = 0; // When the listing was opened on the server
+
+    bool matches(const char *path, const char *pattern, uint8_t sortopts, uint8_t diropts, uint16_t maxresults);
+    bool fresh();
+    void clear();
+    // Clears and frees the buffers
+    void release();
+    // Keeps the listing usable by an open directory, but not for the next open
+    void expire() { expired = true; };
+
+    // Appends an entry which must follow the last one; restarts the window if it is not contiguous
+    // and drops entries from the front if it is full
+    bool add(uint16_t dirpos, uint8_t flags, uint32_t filesize, uint32_t m_time, uint32_t c_time, const char *name);
+
+    uint16_t base() { return _base; };
+    uint16_t count() { return _count; };
+    bool contains(uint16_t dirpos) { return dirpos >= _base && dirpos - _base < _count; };
+    // True if the whole listing from the top is here
+    bool complete() { return eof && _base == 0; };
+
+    const tnfsDirSnapshotEntry *get(uint16_t dirpos) { return &_entries[dirpos - _base]; };
+    const char *name(const tnfsDirSnapshotEntry *entry) { return _names + entry->name_offset; };
 };
 
+class tnfsConnection;
+
 // Everything we need to know about and keep track of for the server we're talking to
 class tnfsMountInfo
 {
 private:
     tnfsFileHandleInfo * _file_handles[TNFS_MAX_FILE_HANDLES] = { nullptr }; // Stored from server's responses to TNFS_OPEN
-    tnfsDirCacheEntry * _dir_cache[TNFS_MAX_DIRCACHE_ENTRIES] = { nullptr };
-    uint16_t _dir_cache_current = 0;
-    uint16_t _dir_cache_count = 0;
-    bool _dir_cache_eof = false;
 
 public:
     ~tnfsMountInfo();
@@ -89,17 +174,8 @@ public:
     void delete_filehandleinfo(uint8_t filehandle);
     void delete_filehandleinfo(tnfsFileHandleInfo * pFilehandle);
 
-    tnfsDirCacheEntry * new_dircache_entry();
-    tnfsDirCacheEntry * next_dircache_entry();
-
-    int tell_dircache_entry();
-    void empty_dircache();
-    uint16_t count_dircache() { return _dir_cache_count; };
-    void set_dircache_eof() { _dir_cache_eof = true; };
-    bool get_dircache_eof() { return _dir_cache_eof; };
-
     uint8_t protocol = TNFS_PROTOCOL_UNKNOWN;
-    fnTcpClient tcp_client;
+    tnfsConnection *tcp_connection = nullptr; // Pooled, shared with other mounts of the same server
 
     // These char[] sizes are abitrary...
     char hostname[64] = { '\0' };
@@ -114,10 +190,16 @@ public:
     uint16_t server_version = 0;  // Stored from server's response to TNFS_MOUNT
     uint8_t max_retries = TNFS_RETRIES;
     int timeout_ms = TNFS_TIMEOUT;
-    uint8_t current_sequence_num = 0; // Updated with each transaction to the server
+    uint8_t readahead_max_blocks = TNFS_READAHEAD_MAX_BLOCKS; // Set to 1 to disable pipelined read-ahead
+    uint8_t readahead_inflight = TNFS_READAHEAD_INFLIGHT;
+    uint8_t current_sequence_num = 0; // Updated with each transaction to the server (comes from tcp_connection over TCP)
 
     int16_t dir_handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIR
     uint16_t dir_entries = 0; // Stored from server's response to TNFS_OPENDIRX
+    bool dir_open = false; // A directory is open, possibly served from dir_snapshot alone
+    uint16_t dir_position = 0; // dirpos of the next entry tnfs_readdirx returns
+    uint16_t dir_server_position = 0; // Where the server's read position is when dir_handle is valid
+    tnfsDirSnapshot dir_snapshot;
     std::recursive_mutex transaction_mutex;
 
 #ifdef TNFS_UDP_SIMULATE_RECV_TWICE
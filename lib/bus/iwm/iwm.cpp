@@ -582,6 +582,7 @@ bool IRAM_ATTR iwmBus::serviceDiskII()
 
   case iwm_enable_state_t::on:
     diskii_xface.d2_enable_seen |= diskii_xface.iwm_enable_states();
+    IWM_ACTIVE_DISK2->refresh_track();
 #ifdef DEBUG
     new_track = IWM_ACTIVE_DISK2->get_track_pos();
     if (old_track != new_track)
@@ -615,7 +616,11 @@ bool IRAM_ATTR iwmBus::serviceDiskIIWrite()
 
 
   if (!xQueueReceive(diskii_xface.iwm_write_queue, &item, 0))
+  {
+    for (int i = 0; i < MAX_DISK2_DEVICES; i++)
+      ((iwmDisk2 *)theFuji.get_disk_dev(MAX_SP_DEVICES + i))->idle();
     return false;
+  }
 
   Debug_printf("\r\nDisk II iwm queue receive %u %u %u %u",
 	       item.length, item.track_begin, item.track_end, item.track_numbits);
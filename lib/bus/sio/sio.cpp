@@ -51,6 +51,7 @@ void virtualDevice::bus_to_computer(uint8_t *buf, uint16_t len, bool err)
     Debug_print("\n");
 #endif
 
+#ifdef ESP_PLATFORM
     // Write ERROR or COMPLETE status
     if (err == true)
         sio_error();
@@ -58,7 +59,6 @@ void virtualDevice::bus_to_computer(uint8_t *buf, uint16_t len, bool err)
         sio_complete();
 
     // Write data frame
-#ifdef ESP_PLATFORM
     UARTManager *uart = sio_get_bus().uart;
     uart->write(buf, len);
     // Write checksum
@@ -66,9 +66,11 @@ void virtualDevice::bus_to_computer(uint8_t *buf, uint16_t len, bool err)
 
     uart->flush();
 #else
-    fnSioCom.write(buf, len);
-    // Write checksum
-    fnSioCom.write(sio_checksum(buf, len));
+    // Write ERROR or COMPLETE status, data frame and checksum in one go,
+    // NetSIO batches them into a single datagram
+    fnSystem.delay_microseconds(DELAY_T5);
+    fnSioCom.write_frame(err ? 'E' : 'C', buf, len, sio_checksum(buf, len));
+    Debug_println(err ? "ERROR!" : "COMPLETE!");
 
     fnSioCom.flush();
 #endif
@@ -479,6 +481,8 @@ void systemBus::service()
         }
     }
 
+    bool bus_idle = true;
+
     // Go process a command frame if the SIO CMD line is asserted
 #ifdef ESP_PLATFORM
     if (fnSystem.digital_read(PIN_CMD) == DIGI_LOW)
@@ -489,6 +493,7 @@ void systemBus::service()
 #ifndef ESP_PLATFORM
         unsigned long startms = fnSystem.millis();
 #endif
+        bus_idle = false;
         _sio_process_cmd();
 #ifndef ESP_PLATFORM
         unsigned long endms = fnSystem.millis();
@@ -515,6 +520,10 @@ void systemBus::service()
 #endif
     }
 
+    // Disks holding written sectors flush them once the bus has been quiet for a while
+    if (bus_idle)
+        _fujiDev->idle_disks();
+
     // Handle interrupts from network protocols
     for (int i = 0; i < 8; i++)
     {
@@ -115,6 +115,12 @@ ssize_t SioCom::write(const uint8_t *buffer, size_t size)
     return _sioPort->write(buffer, size);
 }
 
+// write status byte, data frame and checksum
+ssize_t SioCom::write_frame(uint8_t status, const uint8_t *buffer, size_t size, uint8_t checksum)
+{
+    return _sioPort->write_frame(status, buffer, size, checksum);
+}
+
 // write C-string
 ssize_t SioCom::write(const char *str)
 {
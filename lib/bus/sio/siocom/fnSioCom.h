@@ -62,6 +62,8 @@ public:
     ssize_t write(uint8_t b);
     // write buffer
     ssize_t write(const uint8_t *buffer, size_t size);
+    // write status byte, data frame and checksum
+    ssize_t write_frame(uint8_t status, const uint8_t *buffer, size_t size, uint8_t checksum);
     // write C-string
     ssize_t write(const char *str);
 
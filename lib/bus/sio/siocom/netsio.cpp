@@ -13,6 +13,9 @@
 #include <unistd.h> // write(), read(), close()
 #include <errno.h> // Error integer and strerror() function
 #include <fcntl.h> // Contains file controls like O_RDWR
+#if !defined(_WIN32)
+#include <sys/uio.h> // sendmsg(), struct iovec
+#endif
 
 #include "../../include/debug.h"
 
@@ -49,7 +52,8 @@ NetSioPort::NetSioPort() :
     _sync_request_num(-1),
     _sync_write_size(-1),
     _errcount(0),
-    _credit(3)
+    _credit(3),
+    _stats{}
 {}
 
 NetSioPort::~NetSioPort()
@@ -143,6 +147,7 @@ void NetSioPort::begin(int baud)
     send(_fd, (char *)&connect, 1, 0);
 
     _alive_request = _alive_time = fnSystem.millis();
+    memset(&_stats, 0, sizeof(_stats));
 
     Debug_printf("### NetSIO initialized ###\n");
     // Set initialized.
@@ -161,6 +166,9 @@ void NetSioPort::end()
         _fd  = -1;
         fnSystem.delay(50); // wait a while, otherwise wifi may turn off too quickly (during shutdown)
         Debug_printf("### NetSIO stopped ###\n");
+        Debug_printf("NetSIO stats: %u datagrams sent, %u rx overruns, %u credit stalls (%u ms total, %u ms max)\n",
+            _stats.tx_datagrams, _stats.rx_overruns, _stats.credit_stalls,
+            _stats.credit_stall_ms, _stats.credit_stall_max_ms);
     }
     _initialized = false;
 }
@@ -256,6 +264,38 @@ bool NetSioPort::rxbuffer_put(uint8_t b)
     return false;
 }
 
+/* Appends a block to the ring, returns true if older data was overwritten
+*/
+bool NetSioPort::rxbuffer_put(const uint8_t *buffer, size_t length)
+{
+    bool overrun = false;
+
+    // only the newest sizeof(_rxbuf) bytes can be kept
+    if (length > sizeof(_rxbuf))
+    {
+        buffer += length - sizeof(_rxbuf);
+        length = sizeof(_rxbuf);
+        overrun = true;
+    }
+    if (length == 0)
+        return false;
+
+    overrun = overrun || (length > sizeof(_rxbuf) - rxbuffer_available());
+
+    // copy in at most two contiguous spans
+    size_t span = sizeof(_rxbuf) - _rxhead;
+    if (span > length)
+        span = length;
+    memcpy(_rxbuf + _rxhead, buffer, span);
+    memcpy(_rxbuf, buffer + span, length - span);
+    _rxhead = (_rxhead + length) % sizeof(_rxbuf);
+
+    if (overrun)
+        _rxtail = _rxhead; // oldest bytes were overwritten / lost
+    _rxfull = (_rxhead == _rxtail);
+    return overrun;
+}
+
 int NetSioPort::rxbuffer_get() 
 {
     int b;
@@ -267,6 +307,26 @@ int NetSioPort::rxbuffer_get()
     return b;
 }
 
+/* Copies up to length bytes out of the ring, returns number of bytes copied
+*/
+size_t NetSioPort::rxbuffer_get(uint8_t *buffer, size_t length)
+{
+    size_t avail = rxbuffer_available();
+    if (length > avail)
+        length = avail;
+    if (length == 0)
+        return 0;
+
+    size_t span = sizeof(_rxbuf) - _rxtail;
+    if (span > length)
+        span = length;
+    memcpy(buffer, _rxbuf + _rxtail, span);
+    memcpy(buffer + span, _rxbuf, length - span);
+    _rxtail = (_rxtail + length) % sizeof(_rxbuf);
+    _rxfull = false;
+    return length;
+}
+
 int  NetSioPort::rxbuffer_available() 
 {
     int avail = _rxhead - _rxtail;
@@ -365,20 +425,25 @@ int NetSioPort::handle_netsio()
                 if (_baud_peer < _baud * 90 / 100 || _baud_peer > _baud * 110 / 100)
                     b ^= (uint8_t)_baud_peer ^ (uint8_t)_baud; // corrupt byte
                 if (rxbuffer_put(b))
+                {
+                    _stats.rx_overruns++;
                     Debug_println("NetSIO rxbuffer overrun");
+                }
                 break;
 
             case NETSIO_DATA_BLOCK:
                 if (received >= 2)
                 {
-                    for (int i = 1; i < received-1; i++) // TODO received-1, to test packet SNs
-                    // for (int i = 1; i < received; i++)
+                    // last byte is packet sequence number, not data
+                    if (_baud_peer < _baud * 90 / 100 || _baud_peer > _baud * 110 / 100)
+                    {
+                        for (int i = 1; i < received-1; i++)
+                            rxbuf[i] ^= (uint8_t)_baud_peer ^ (uint8_t)_baud; // corrupt byte
+                    }
+                    if (rxbuffer_put(rxbuf + 1, received - 2))
                     {
-                        b = rxbuf[i];
-                        if (_baud_peer < _baud * 90 / 100 || _baud_peer > _baud * 110 / 100)
-                            b ^= (uint8_t)_baud_peer ^ (uint8_t)_baud; // corrupt byte
-                        if (rxbuffer_put(b))
-                            Debug_println("NetSIO rxbuffer overrun");
+                        _stats.rx_overruns++;
+                        Debug_println("NetSIO rxbuffer overrun");
                     }
                 }
                 break;
@@ -538,18 +603,67 @@ bool NetSioPort::wait_sock_writable(uint32_t timeout_ms)
 
 ssize_t NetSioPort::write_sock(const uint8_t *buffer, size_t size, uint32_t timeout_ms)
 {
-    if (!wait_sock_writable(timeout_ms))
-    {
-        Debug_println("NetSIO write_sock() TIMEOUT");
+    netsio_iov iov = { buffer, size };
+    return write_sockv(&iov, 1, timeout_ms);
+}
+
+/* Sends the scattered pieces as a single datagram (one NetSIO message).
+   The socket is non-blocking, select() is only used if the send would block.
+*/
+ssize_t NetSioPort::write_sockv(const netsio_iov *iov, int iovcnt, uint32_t timeout_ms)
+{
+#if defined(_WIN32)
+    WSABUF bufs[8];
+#else
+    struct iovec bufs[8];
+#endif
+    if (iovcnt > (int)(sizeof(bufs) / sizeof(bufs[0])))
         return -1;
+
+    for (int i = 0; i < iovcnt; i++)
+    {
+#if defined(_WIN32)
+        bufs[i].buf = (char *)iov[i].base;
+        bufs[i].len = (ULONG)iov[i].len;
+#else
+        bufs[i].iov_base = (void *)iov[i].base;
+        bufs[i].iov_len = iov[i].len;
+#endif
+    }
+
+    ssize_t result;
+    for (bool waited = false; ; waited = true)
+    {
+#if defined(_WIN32)
+        DWORD sent = 0;
+        result = WSASend(_fd, bufs, iovcnt, &sent, 0, nullptr, nullptr) == 0 ? (ssize_t)sent : -1;
+        bool would_block = result < 0 && compat_getsockerr() == WSAEWOULDBLOCK;
+#else
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = bufs;
+        msg.msg_iovlen = iovcnt;
+        result = sendmsg(_fd, &msg, 0);
+        bool would_block = result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+        if (!would_block || waited)
+            break;
+        if (!wait_sock_writable(timeout_ms))
+        {
+            Debug_println("NetSIO write_sock() TIMEOUT");
+            return -1;
+        }
     }
 
-    ssize_t result = send(_fd, (char *)buffer, size, 0);
     if (result < 0)
     {
         Debug_printf("NetSIO write_sock() send error %d: %s\n", 
             compat_getsockerr(), compat_sockstrerror(compat_getsockerr()));
     }
+    else
+    {
+        _stats.tx_datagrams++;
+    }
     return result;
 }
 
@@ -573,15 +687,27 @@ bool NetSioPort::wait_for_credit(int needed)
     txbuf[1] = (uint8_t)_credit;
 
     // wait for credit
-    while (needed > _credit)
+    if (needed > _credit)
     {
-        if (!_initialized) 
-            return false; // disconnected
-        // inform HUB we need more credit
-        send(_fd, (char *)txbuf, sizeof(txbuf), 0);
-        //Debug_printf("waiting for credit %d\n", _credit);
-        wait_sock_readable(500);
-        handle_netsio();
+        uint64_t t = fnSystem.millis();
+        while (needed > _credit)
+        {
+            if (!_initialized) 
+                return false; // disconnected
+            // inform HUB we need more credit
+            send(_fd, (char *)txbuf, sizeof(txbuf), 0);
+            //Debug_printf("waiting for credit %d\n", _credit);
+            wait_sock_readable(500);
+            handle_netsio();
+        }
+        uint32_t stall_ms = (uint32_t)(fnSystem.millis() - t);
+        _stats.credit_stalls++;
+        _stats.credit_stall_ms += stall_ms;
+        if (stall_ms > _stats.credit_stall_max_ms)
+            _stats.credit_stall_max_ms = stall_ms;
+#ifdef VERBOSE_SIO
+        Debug_printf("NetSIO credit stall %u ms\n", stall_ms);
+#endif
     }
     // consume credit
     _credit -= needed;
@@ -736,26 +862,16 @@ size_t NetSioPort::read(uint8_t *buffer, size_t length)
         // 850 us pre-ACK delay will be added by netsio.atdevice
     }
 
-    int result;
-    int rxbytes;
-    for (rxbytes=0; rxbytes<length;)
+    // copy whatever is buffered, then wait for more
+    size_t rxbytes = 0;
+    while (rxbytes < length)
     {
-        result = read();
-        // Debug_printf("read: %d\n", result);
-        if (result < 0)
+        if (!wait_for_data(500))
         {
+            Debug_println("NetSIO read() - TIMEOUT");
             break;
         }
-        else
-        {
-            buffer[rxbytes++] = (uint8_t)result;
-        }
-
-        if (rxbytes == length)
-        {
-            // done
-            break;
-        }
+        rxbytes += rxbuffer_get(buffer + rxbytes, length - rxbytes);
     }
     return rxbytes;
 }
@@ -802,24 +918,23 @@ ssize_t NetSioPort::write(uint8_t c)
 
 ssize_t NetSioPort::write(const uint8_t *buffer, size_t size)
 {
-    int result;
-    int to_send;
-    int txbytes = 0;
-    uint8_t txbuf[513];
+    ssize_t result;
+    size_t to_send;
+    size_t txbytes = 0;
+    const uint8_t cmd = NETSIO_DATA_BLOCK;
 
     if (!_initialized)
         return 0;
 
     while (txbytes < size)
     {
-        // send block
-        to_send = ((size-txbytes) > sizeof(txbuf)-1) ? sizeof(txbuf)-1 : (size-txbytes);
-        txbuf[0] = NETSIO_DATA_BLOCK;
-        memcpy(txbuf+1, buffer+txbytes, to_send);
+        // send block, message header and data gathered straight from the caller's buffer
+        to_send = (size - txbytes > NETSIO_BLOCK_SIZE) ? NETSIO_BLOCK_SIZE : (size - txbytes);
+        netsio_iov iov[2] = { { &cmd, 1 }, { buffer + txbytes, to_send } };
         // ? calculate credit based on amount of data ?
         if (!wait_for_credit(1))
             break;
-        result = write_sock(txbuf, to_send+1);
+        result = write_sockv(iov, 2);
         if (result > 0)
             txbytes += result-1;
         else if (result < 0)
@@ -828,6 +943,62 @@ ssize_t NetSioPort::write(const uint8_t *buffer, size_t size)
     return txbytes;
 }
 
+/* Sends status byte, data frame and checksum as NETSIO_DATA_BLOCK messages.
+   A sector of up to NETSIO_BLOCK_SIZE-2 bytes goes out as a single datagram
+   costing one credit, instead of three separate messages.
+*/
+ssize_t NetSioPort::write_frame(uint8_t status, const uint8_t *buffer, size_t size, uint8_t checksum)
+{
+    if (!_initialized)
+        return 0;
+
+    // a pending sync request must carry the first byte, use the plain path
+    if (_sync_request_num >= 0)
+        return SioPort::write_frame(status, buffer, size, checksum);
+
+    const uint8_t cmd = NETSIO_DATA_BLOCK;
+    size_t txbytes = 0;
+    bool first = true;
+
+    while (first || txbytes < size)
+    {
+        netsio_iov iov[4];
+        int n = 0;
+        size_t room = NETSIO_BLOCK_SIZE;
+
+        iov[n++] = { &cmd, 1 };
+        if (first)
+        {
+            iov[n++] = { &status, 1 };
+            room--;
+        }
+        size_t to_send = (size - txbytes > room) ? room : (size - txbytes);
+        if (to_send > 0)
+            iov[n++] = { buffer + txbytes, to_send };
+        bool last = (txbytes + to_send == size) && (to_send < room);
+        if (last)
+            iov[n++] = { &checksum, 1 };
+
+        if (!wait_for_credit(1))
+            break;
+        if (write_sockv(iov, n) < 0)
+            break;
+
+        txbytes += to_send;
+        first = false;
+        if (last)
+            return size;
+    }
+
+    if (txbytes < size)
+        return txbytes;
+
+    // data filled the last block exactly, checksum goes on its own
+    if (write(checksum) != 1)
+        return txbytes;
+    return size;
+}
+
 // specific to NetSioPort
 void NetSioPort::set_host(const char *host, int port)
 {
@@ -5,6 +5,28 @@
 #include "sioport.h"
 #include "fnDNS.h"
 
+// receive ring, large enough to absorb several full data blocks at the highest HSIO index
+#define NETSIO_RXBUF_SIZE   8192
+// max. payload of one NETSIO_DATA_BLOCK message
+#define NETSIO_BLOCK_SIZE   512
+
+// scatter/gather element for write_sockv()
+struct netsio_iov
+{
+    const uint8_t *base;
+    size_t len;
+};
+
+// transfer statistics, logged when the connection is closed
+struct netsio_stats
+{
+    uint32_t tx_datagrams;
+    uint32_t rx_overruns;
+    uint32_t credit_stalls;   // times a send had to wait for credit
+    uint32_t credit_stall_ms; // total time spent waiting for credit
+    uint32_t credit_stall_max_ms;
+};
+
 class NetSioPort : public SioPort
 {
 private:
@@ -19,7 +41,7 @@ private:
     bool _command_asserted;
     bool _motor_asserted;
 
-    uint8_t _rxbuf[1024];
+    uint8_t _rxbuf[NETSIO_RXBUF_SIZE];
     int _rxhead;
     int _rxtail;
     bool _rxfull;
@@ -35,6 +57,7 @@ private:
     uint64_t _alive_request; // when last ALIVE request was sent
     // flow control
     int _credit;
+    netsio_stats _stats;
 
 protected:
     void suspend(int ms=5000);
@@ -50,10 +73,13 @@ protected:
 
     bool wait_sock_writable(uint32_t timeout_ms);
     ssize_t write_sock(const uint8_t *buffer, size_t size, uint32_t timeout_ms=500);
+    ssize_t write_sockv(const netsio_iov *iov, int iovcnt, uint32_t timeout_ms=500);
 
     bool rxbuffer_empty();
     bool rxbuffer_put(uint8_t b);
+    bool rxbuffer_put(const uint8_t *buffer, size_t length);
     int rxbuffer_get();
+    size_t rxbuffer_get(uint8_t *buffer, size_t length);
     int rxbuffer_available();
     void rxbuffer_flush();
 
@@ -87,6 +113,8 @@ public:
     virtual ssize_t write(uint8_t b) override;
     // write buffer
     virtual ssize_t write(const uint8_t *buffer, size_t size) override;
+    // write status byte + data frame + checksum, batched into as few datagrams as possible
+    virtual ssize_t write_frame(uint8_t status, const uint8_t *buffer, size_t size, uint8_t checksum) override;
 
     // specific to NetSioPort
     void set_host(const char *host, int port);
@@ -97,6 +125,8 @@ public:
     void set_sync_write_size(int write_size);
     ssize_t send_sync_response(uint8_t response_type, uint8_t ack_byte=0, uint16_t sync_write_size=0);
     void send_empty_sync();
+
+    const netsio_stats &get_stats() { return _stats; };
 };
 
 #endif // NETSIO_H
@@ -4,6 +4,19 @@
 
 #include "sioport.h"
 
+/* Default frame write, ports which can batch the frame override this
+*/
+ssize_t SioPort::write_frame(uint8_t status, const uint8_t *buffer, size_t size, uint8_t checksum)
+{
+    if (write(status) != 1)
+        return 0;
+    ssize_t result = write(buffer, size);
+    if (result < 0 || (size_t)result != size)
+        return result < 0 ? 0 : result;
+    write(checksum);
+    return size;
+}
+
 #endif // BUILD_ATARI
 
 #endif // !ESP_PLATFORM
\ No newline at end of file
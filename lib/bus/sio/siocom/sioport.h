@@ -37,6 +37,8 @@ public:
 
     virtual ssize_t write(uint8_t b) = 0; // write single byte
     virtual ssize_t write(const uint8_t *buffer, size_t size) = 0; // write buffer
+    // write status byte (C/E), data frame and its checksum
+    virtual ssize_t write_frame(uint8_t status, const uint8_t *buffer, size_t size, uint8_t checksum);
 };
 
 #endif // SIOPORT_H
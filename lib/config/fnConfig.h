@@ -128,6 +128,12 @@ public:
     void store_general_fnconfig_spifs(bool fnconfig_spifs);
     bool get_general_status_wait_enabled() { return _general.status_wait_enabled; }
     void store_general_status_wait_enabled(bool status_wait_enabled);
+    int get_general_filecache_max_kb() { return _general.filecache_max_kb; }
+    void store_general_filecache_max_kb(int max_kb);
+    int get_general_disk_cache_kb() { return _general.disk_cache_kb; }
+    void store_general_disk_cache_kb(int cache_kb);
+    int get_general_disk_writeback_ms() { return _general.disk_writeback_ms; }
+    void store_general_disk_writeback_ms(int writeback_ms);
     void store_general_encrypt_passphrase(bool encrypt_passphrase);
     bool get_general_encrypt_passphrase();
 
@@ -445,6 +451,13 @@ private:
         int boot_mode = 0;
         bool fnconfig_spifs = true;
         bool status_wait_enabled = true;
+        int filecache_max_kb = 65536; // SD budget for files cached from HTTP/FTP hosts
+#ifdef ESP_PLATFORM
+        int disk_cache_kb = 16; // RAM sector cache per mounted disk image, 0 disables
+#else
+        int disk_cache_kb = 256;
+#endif
+        int disk_writeback_ms = 0; // Flush disk writes after this much bus idle time, 0 = sync every sector
         bool encrypt_passphrase = false;
 #ifdef BUILD_ADAM
         bool printer_enabled = false; // Not by default.
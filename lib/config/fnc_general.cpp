@@ -72,6 +72,33 @@ void fnConfig::store_general_status_wait_enabled(bool status_wait_enabled)
     _dirty = true;
 }
 
+void fnConfig::store_general_filecache_max_kb(int max_kb)
+{
+    if (_general.filecache_max_kb == max_kb)
+        return;
+
+    _general.filecache_max_kb = max_kb;
+    _dirty = true;
+}
+
+void fnConfig::store_general_disk_cache_kb(int cache_kb)
+{
+    if (_general.disk_cache_kb == cache_kb)
+        return;
+
+    _general.disk_cache_kb = cache_kb;
+    _dirty = true;
+}
+
+void fnConfig::store_general_disk_writeback_ms(int writeback_ms)
+{
+    if (_general.disk_writeback_ms == writeback_ms)
+        return;
+
+    _general.disk_writeback_ms = writeback_ms;
+    _dirty = true;
+}
+
 void fnConfig::store_general_encrypt_passphrase(bool encrypt_passphrase)
 {
     if (_general.encrypt_passphrase == encrypt_passphrase)
@@ -237,6 +264,24 @@ void fnConfig::_read_section_general(std::stringstream &ss)
             {
                 _general.printer_enabled = util_string_value_is_true(value);
             }
+            else if (strcasecmp(name.c_str(), "filecache_max_kb") == 0)
+            {
+                int max_kb = atoi(value.c_str());
+                if (max_kb > 0)
+                    _general.filecache_max_kb = max_kb;
+            }
+            else if (strcasecmp(name.c_str(), "disk_cache_kb") == 0)
+            {
+                int cache_kb = atoi(value.c_str());
+                if (cache_kb >= 0)
+                    _general.disk_cache_kb = cache_kb;
+            }
+            else if (strcasecmp(name.c_str(), "disk_writeback_ms") == 0)
+            {
+                int writeback_ms = atoi(value.c_str());
+                if (writeback_ms >= 0)
+                    _general.disk_writeback_ms = writeback_ms;
+            }
             else if (strcasecmp(name.c_str(), "encrypt_passphrase") == 0)
             {
                 _general.encrypt_passphrase = util_string_value_is_true(value);
@@ -45,6 +45,9 @@ void fnConfig::save()
     ss << "fnconfig_on_spifs=" << _general.fnconfig_spifs << LINETERM;
     ss << "status_wait_enabled=" << _general.status_wait_enabled << LINETERM;
     ss << "printer_enabled=" << _general.printer_enabled << LINETERM;
+    ss << "filecache_max_kb=" << _general.filecache_max_kb << LINETERM;
+    ss << "disk_cache_kb=" << _general.disk_cache_kb << LINETERM;
+    ss << "disk_writeback_ms=" << _general.disk_writeback_ms << LINETERM;
     ss << "encrypt_passphrase=" << _general.encrypt_passphrase << LINETERM;
 
     // ss << LINETERM;
@@ -10,6 +10,7 @@
 
 #include "fnSystem.h"
 #include "fnConfig.h"
+#include "fujiCopy.h"
 #include "fnWiFi.h"
 #include "fsFlash.h"
 #include "led.h"
@@ -19,8 +20,6 @@
 
 #define ADDITIONAL_DETAILS_BYTES 12
 
-#define COPY_SIZE 532
-
 adamFuji theFuji;         // global fuji device object
 adamNetwork *theNetwork;  // global network device object (temporary)
 adamNetwork *theNetwork2; // another network device
@@ -350,12 +349,8 @@ void adamFuji::adamnet_copy_file()
     string sourcePath;
     string destPath;
     uint8_t ck;
-    FILE *sourceFile;
-    FILE *destFile;
-    char *dataBuf;
     unsigned char sourceSlot;
     unsigned char destSlot;
-    unsigned long total = 0;
 
     Debug_printf("ADAMNET COPY FILE\n");
 
@@ -370,8 +365,6 @@ void adamFuji::adamnet_copy_file()
     fnUartBUS.write(0x9f); // ACK.
     fnUartBUS.flush();
 
-    dataBuf = (char *)malloc(COPY_SIZE);
-
     copySpec = string((char *)csBuf);
 
     Debug_printf("copySpec: %s\n", copySpec.c_str());
@@ -388,31 +381,17 @@ void adamFuji::adamnet_copy_file()
         destPath += sourceFilename;
     }
 
-    // Mount hosts, if needed.
-    _fnHosts[sourceSlot].mount();
-    _fnHosts[destSlot].mount();
-
-    // Open files...
-    sourceFile = _fnHosts[sourceSlot].file_open(sourcePath.c_str(), (char *)sourcePath.c_str(), sourcePath.size() + 1, "r");
-    destFile = _fnHosts[destSlot].file_open(destPath.c_str(), (char *)destPath.c_str(), destPath.size() + 1, "w");
-
-    size_t count = 0;
-
-    while (!(ferror(sourceFile) || feof(sourceFile)))
+    if (sourceSlot >= MAX_HOSTS || destSlot >= MAX_HOSTS ||
+        !fnCopy.start(&_fnHosts[sourceSlot], sourcePath.c_str(), &_fnHosts[destSlot], destPath.c_str()))
     {
-        count = fread(dataBuf, 1, COPY_SIZE, sourceFile);
-        fwrite(dataBuf, 1, count, destFile);
-        total += count;
-        Debug_printf("Copied: %lu bytes %u %u\n", total, feof(sourceFile), ferror(sourceFile));
-        taskYIELD();
+        Debug_printf("Copy File: could not start copy\n");
+        return;
     }
 
-    // copyEnd:
-    fclose(sourceFile);
-    fclose(destFile);
-    free(dataBuf);
-
-    Debug_printf("COPY DONE\n");
+    if (!fnCopy.wait())
+        Debug_printf("Copy File: failed\n");
+    else
+        Debug_printf("COPY DONE\n");
 }
 
 // Set boot mode
@@ -747,39 +726,12 @@ void adamFuji::adamnet_read_directory_entry()
         {
             Debug_printf("::read_direntry \"%s\"\n", f->filename);
 
-            int bufsize = sizeof(dirpath);
-            char *filenamedest = dirpath;
-
             // If 0x80 is set on AUX2, send back additional information
             if (addtl & 0x80)
-            {
-                _set_additional_direntry_details(f, (uint8_t *)dirpath, maxlen);
-                // Adjust remaining size of buffer and file path destination
-                bufsize = sizeof(dirpath) - ADDITIONAL_DETAILS_BYTES;
-                filenamedest = dirpath + ADDITIONAL_DETAILS_BYTES;
-            }
+                fujiDirPage::format_entry(f, dirpath, sizeof(dirpath) - ADDITIONAL_DETAILS_BYTES, maxlen,
+                                          _set_additional_direntry_details, ADDITIONAL_DETAILS_BYTES, maxlen < 128);
             else
-            {
-                bufsize = maxlen;
-            }
-
-            int filelen;
-            // int filelen = strlcpy(filenamedest, f->filename, bufsize);
-            if (maxlen < 128)
-            {
-                filelen = util_ellipsize(f->filename, filenamedest, bufsize - 1);
-            }
-            else
-            {
-                filelen = strlcpy(filenamedest, f->filename, bufsize);
-            }
-
-            // Add a slash at the end of directory entries
-            if (f->isDir && filelen < (bufsize - 2))
-            {
-                dirpath[filelen] = '/';
-                dirpath[filelen + 1] = '\0';
-            }
+                fujiDirPage::format_entry(f, dirpath, maxlen, maxlen, nullptr, 0, maxlen < 128);
         }
 
         // Hack-o-rama to add file type character to beginning of path.
@@ -37,8 +37,8 @@ adamNetwork::adamNetwork()
     status_response[2] = 0x04; // 1024 bytes
     status_response[3] = 0x00; // Character device
 
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -258,7 +258,7 @@ void adamNetwork::write(uint16_t num_bytes)
     AdamNet.start_time = esp_timer_get_time();
     adamnet_response_ack();
 
-    *transmitBuffer += string((char *)response, num_bytes);
+    transmitBuffer->append(response, num_bytes);
     err = adamnet_write_channel(num_bytes);
 }
 
@@ -893,7 +893,7 @@ inline void adamNetwork::adamnet_control_receive_channel_protocol()
         statusByte.bits.client_error = 0;
         statusByte.bits.client_data_available = response_len > 0;
         memcpy(response, receiveBuffer->data(), response_len);
-        receiveBuffer->erase(0, response_len);
+        receiveBuffer->consume(response_len);
     }
 }
 
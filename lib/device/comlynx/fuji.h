@@ -10,6 +10,7 @@
 #include "fujiHost.h"
 #include "fujiDisk.h"
 #include "fujiCmd.h"
+#include "fujiDirPage.h"
 
 #define MAX_HOSTS 8
 #define MAX_DISK_DEVICES 8
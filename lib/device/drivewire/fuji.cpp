@@ -882,32 +882,12 @@ void drivewireFuji::read_directory_entry()
     {
         Debug_printf("::read_direntry \"%s\"\n", f->filename);
 
-        int bufsize = sizeof(current_entry);
-        int fno=0;
-
         // If 0x80 is set on AUX2, send back additional information
         if (addtl & 0x80)
-        {
-            Debug_printf("Add additional info.\n");
-            _set_additional_direntry_details(f, (uint8_t *)current_entry, maxlen);
-            // Adjust remaining size of buffer and file path destination
-            bufsize = sizeof(dirpath) - ADDITIONAL_DETAILS_BYTES;
-            fno += ADDITIONAL_DETAILS_BYTES;
-        }
+            fujiDirPage::format_entry(f, current_entry, sizeof(current_entry) - ADDITIONAL_DETAILS_BYTES, maxlen,
+                                      _set_additional_direntry_details, ADDITIONAL_DETAILS_BYTES);
         else
-        {
-            bufsize = maxlen;
-        }
-
-        // int filelen = strlcpy(filenamedest, f->filename, bufsize);
-        int filelen = util_ellipsize(f->filename, &current_entry[fno], bufsize);
-
-        // Add a slash at the end of directory entries
-        if (f->isDir && filelen < (bufsize - 2))
-        {
-            current_entry[filelen] = '/';
-            current_entry[filelen + 1] = '\0';
-        }
+            fujiDirPage::format_entry(f, current_entry, maxlen, maxlen, nullptr, 0);
     }
 
     response.clear();
@@ -12,6 +12,7 @@
 #include "fujiHost.h"
 #include "fujiDisk.h"
 #include "fujiCmd.h"
+#include "fujiDirPage.h"
 
 #include "hash.h"
 
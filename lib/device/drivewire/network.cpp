@@ -47,8 +47,8 @@ void onTimer(void *info)
  */
 drivewireNetwork::drivewireNetwork()
 {
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -315,11 +315,10 @@ void drivewireNetwork::read()
     read_channel(num_bytes);
 
     // And set response buffer.
-    response += *receiveBuffer;
+    response.append(receiveBuffer->data(), receiveBuffer->size());
  
-    // Remove from receive buffer and shrink.
-    receiveBuffer->erase(0, num_bytes);
-    receiveBuffer->shrink_to_fit();
+    // Remove from receive buffer.
+    receiveBuffer->consume(num_bytes);
 }
 
 /**
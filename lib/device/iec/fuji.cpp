@@ -2431,20 +2431,16 @@ std::string iecFuji::process_directory_entry(uint8_t maxlen, uint8_t addtlopts)
 
     Debug_printf("::read_direntry \"%s\"\r\n", f->filename);
 
-    std::string entry;
-    if (addtlopts & 0x80) {
-        uint8_t extra[10];
-        _set_additional_direntry_details(f, extra, maxlen);
-        entry.append(reinterpret_cast<char*>(extra), sizeof(extra));
-    }
-
-    size_t maxFilenameSize = maxlen - entry.size() - (f->isDir ? 1 : 0); // Reserve space for '/' if directory
-    std::string ellipsizedFilename = util_ellipsize_string(f->filename, maxFilenameSize);
-
-    entry += ellipsizedFilename;
-    if (f->isDir) entry += '/';
+    // The name and its slash take what's left of maxlen, plus one for the terminator
+    char entry[256 + ADDITIONAL_DETAILS_BYTES];
+    int len;
+    if (addtlopts & 0x80)
+        len = fujiDirPage::format_entry(f, entry, maxlen - ADDITIONAL_DETAILS_BYTES + 1, maxlen,
+                                        _set_additional_direntry_details, ADDITIONAL_DETAILS_BYTES);
+    else
+        len = fujiDirPage::format_entry(f, entry, maxlen + 1, maxlen, nullptr, 0);
 
-    return entry;
+    return std::string(entry, len);
 }
 
 std::string iecFuji::read_directory_entry(uint8_t maxlen, uint8_t addtlopts) {
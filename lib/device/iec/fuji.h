@@ -13,6 +13,7 @@
 #include "../fuji/fujiHost.h"
 #include "../fuji/fujiDisk.h"
 #include "../fuji/fujiCmd.h"
+#include "../fuji/fujiDirPage.h"
 
 #include "hash.h"
 
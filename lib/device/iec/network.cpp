@@ -307,7 +307,7 @@ void iecNetwork::query_json()
     size_t len = channel_data.json->readValueLen();
     std::vector<uint8_t> buffer(len);
     channel_data.json->readValue(buffer.data(), buffer.size());
-    channel_data.receiveBuffer += std::string(buffer.begin(), buffer.end());
+    channel_data.receiveBuffer.append(buffer.data(), buffer.size());
 
     snprintf(reply, 80, "query set to %s", s.c_str());
     iecStatus.error = NETWORK_ERROR_SUCCESS;
@@ -349,11 +349,12 @@ void iecNetwork::parse_bite()
     //mstr::replaceAll(*receiveBuffer[channel], ":", "\":\"");
     //mstr::replaceAll(*receiveBuffer[channel], "\r", "\"\r\"");
     //mstr::replaceAll(*receiveBuffer[channel], "\"", "\"\"");
-    mstr::replaceAll(channel_data.receiveBuffer, "\"", "");
+    std::string rx = channel_data.receiveBuffer.str();
+    mstr::replaceAll(rx, "\"", "");
 
     // break up receiveBuffer[channel] into bites less than bite_size bytes
     std::string bites = "\"";
-    bites.reserve(channel_data.receiveBuffer.size() + (channel_data.receiveBuffer.size() / bite_size));
+    bites.reserve(rx.size() + (rx.size() / bite_size));
 
     int start = 0;
     int end = 0;
@@ -364,18 +365,18 @@ void iecNetwork::parse_bite()
         start = end;
 
         // Set remaining length
-        len = channel_data.receiveBuffer.size() - start;
+        len = rx.size() - start;
         if ( len > bite_size )
             len = bite_size;
 
         // Don't make extra bites!
-        end = channel_data.receiveBuffer.find('\r', start);
+        end = rx.find('\r', start);
         if ( end == std::string::npos )
             end = start + len; // None found so set end
 
         // Take a bite
         Debug_printv("start[%d] end[%d] len[%d] bite_size[%d]", start, end, len, bite_size);
-        std::string bite = channel_data.receiveBuffer.substr(start, len);
+        std::string bite = rx.substr(start, len);
         bites += bite;
         Debug_printv("bite[%s]", bite.c_str());
 
@@ -384,11 +385,11 @@ void iecNetwork::parse_bite()
              bites += "\r\"";
 
         count++;
-    } while ( end < channel_data.receiveBuffer.size() );
+    } while ( end < rx.size() );
  
     //bites += "\"";
     //Debug_printv("[%s]", bites.c_str());
-    channel_data.receiveBuffer = mstr::toPETSCII2(bites);
+    channel_data.receiveBuffer.assign(mstr::toPETSCII2(bites));
 }
 
 void iecNetwork::set_translation_mode()
@@ -1020,7 +1021,9 @@ bool iecNetwork::transmit(NetworkData &channel_data)
   
   // force incoming data from HOST to fixed ascii
   // Debug_printv("[1] DATA: >%s< [%s]", channel_data.transmitBuffer.c_str(), mstr::toHex(channel_data.transmitBuffer).c_str());
-  clean_transform_petscii_to_ascii(channel_data.transmitBuffer);
+  std::string tx = channel_data.transmitBuffer.str();
+  clean_transform_petscii_to_ascii(tx);
+  channel_data.transmitBuffer.assign(tx);
   // Debug_printv("[2] DATA: >%s< [%s]", channel_data.transmitBuffer.c_str(), mstr::toHex(channel_data.transmitBuffer).c_str());
   
   Debug_printf("Received %u bytes. Transmitting.", channel_data.transmitBuffer.length());
@@ -1079,7 +1082,8 @@ uint8_t iecNetwork::write(uint8_t channel, uint8_t *buffer, uint8_t bufferSize,
   int channelId = commanddata.channel;
   auto& channel_data = network_data_map[channelId];
 
-  channel_data.transmitBuffer = string((char *) buffer, bufferSize);
+  channel_data.transmitBuffer.clear();
+  channel_data.transmitBuffer.append(buffer, bufferSize);
   return transmit(channel_data) ? bufferSize : 0;
 }
 
@@ -1095,7 +1099,7 @@ uint8_t iecNetwork::read(uint8_t channel, uint8_t *buffer, uint8_t bufferSize, b
 
   uint8_t n = std::min((int) channel_data.receiveBuffer.size(), (int) bufferSize);
   memcpy(buffer, channel_data.receiveBuffer.data(), n);
-  channel_data.receiveBuffer.erase(0, n);
+  channel_data.receiveBuffer.consume(n);
 
   //if( n>0 ) Debug_printv("iecNetwork::read(#%d, %d, %d)", m_devnr, channel, bufferSize);
   return n;
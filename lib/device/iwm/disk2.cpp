@@ -4,6 +4,7 @@
 #include "disk2.h"
 
 #include "fnSystem.h"
+#include "fnConfig.h"
 #include "fuji.h"
 #ifdef ESP_PLATFORM
 #include "fnHardwareTimer.h"
@@ -70,6 +71,7 @@ mediatype_t iwmDisk2::mount_file(fnFile *f, uint32_t disksize, mediatype_t disk_
         _disk = new MediaTypeDSK();
         _disk->_mediatype = disk_type;
         mt = ((MediaTypeDSK *)_disk)->mount(f, disksize);
+        ((MediaTypeDSK *)_disk)->_write_back_ms = Config.get_general_disk_writeback_ms();
         break;
     default:
         Debug_printf("\r\nUnsupported Media Type for DiskII");
@@ -142,10 +144,12 @@ void IRAM_ATTR iwmDisk2::change_track(int indicator)
 #ifndef DEV_RELAY_SLIP
   // need to tell diskii_xface the number of bits in the track
   // and where the track data is located so it can convert it
-  if (((MediaTypeWOZ *)_disk)->trackmap(track_pos) != 255)
+  // get_track() gives nothing for a blank track, or one that hasn't been loaded yet
+  uint8_t *track = ((MediaTypeWOZ *)_disk)->get_track(track_pos);
+  if (track != nullptr)
   {
     diskii_xface.copy_track(
-        ((MediaTypeWOZ *)_disk)->get_track(track_pos),
+        track,
         ((MediaTypeWOZ *)_disk)->track_len(track_pos),
         ((MediaTypeWOZ *)_disk)->num_bits(track_pos),
         NS_PER_BIT_TIME * ((MediaTypeWOZ *)_disk)->optimal_bit_timing);
@@ -161,6 +165,22 @@ void IRAM_ATTR iwmDisk2::change_track(int indicator)
   // Since the empty track has no data, and therefore no length, using a fake length of 51,200 bits (6400 bytes) works very well.
 }
 
+/* Copies in the track under the head if it wasn't loaded when the head got there
+*/
+void iwmDisk2::refresh_track()
+{
+  if (device_active && _disk != nullptr && ((MediaTypeWOZ *)_disk)->track_pending())
+    change_track(0);
+}
+
+/* Lets the image write out held sectors while the drive isn't being written to
+*/
+void iwmDisk2::idle()
+{
+  if (device_active && _disk != nullptr)
+    ((MediaTypeWOZ *)_disk)->idle();
+}
+
 bool iwmDisk2::write_sector(int track, int sector, uint8_t* buffer)
 {
   return _disk->write_sector(track, sector, buffer);
@@ -37,6 +37,8 @@ public:
     bool phases_valid(uint8_t phases);
     bool move_head();
     void change_track(int indicator);
+    void refresh_track();
+    void idle();
     void disableD2() { 
         enabledD2 = false;
 #ifndef DEV_RELAY_SLIP
@@ -11,6 +11,7 @@
 #include "fuji.h"
 
 #include "fujiCmd.h"
+#include "fujiCopy.h"
 #include "httpService.h"
 #include "fnSystem.h"
 #include "fnConfig.h"
@@ -428,9 +429,6 @@ void iwmFuji::iwm_ctrl_copy_file()
 	std::string copySpec;
 	std::string sourcePath;
 	std::string destPath;
-	fnFile *sourceFile;
-	fnFile *destFile;
-	char *dataBuf;
 	unsigned char sourceSlot;
 	unsigned char destSlot;
 
@@ -451,26 +449,15 @@ void iwmFuji::iwm_ctrl_copy_file()
 		destPath += sourceFilename;
 	}
 
-	// Mount hosts, if needed.
-	_fnHosts[sourceSlot].mount();
-	_fnHosts[destSlot].mount();
-
-	// Open files...
-	sourceFile = _fnHosts[sourceSlot].fnfile_open(sourcePath.c_str(), (char *)sourcePath.c_str(), sourcePath.size() + 1, "rb");
-	destFile = _fnHosts[destSlot].fnfile_open(destPath.c_str(), (char *)destPath.c_str(), destPath.size() + 1, "wb");
-
-	dataBuf = (char *)malloc(532);
-	size_t count = 0;
-	do
+	if (sourceSlot >= MAX_HOSTS || destSlot >= MAX_HOSTS ||
+		!fnCopy.start(&_fnHosts[sourceSlot], sourcePath.c_str(), &_fnHosts[destSlot], destPath.c_str()))
 	{
-		count = fnio::fread(dataBuf, 1, 532, sourceFile);
-		fnio::fwrite(dataBuf, 1, count, destFile);
-	} while (count > 0);
-
-	// copyEnd:
-	fnio::fclose(sourceFile);
-	fnio::fclose(destFile);
-	free(dataBuf);
+		Debug_printf("Copy File: could not start copy\n");
+		return;
+	}
+
+	if (!fnCopy.wait())
+		Debug_printf("Copy File: failed\n");
 }
 
 // Mount all
@@ -780,40 +767,12 @@ void iwmFuji::iwm_ctrl_read_directory_entry()
 	{
 		Debug_printf("::read_direntry \"%s\"\n", f->filename);
 
-		int bufsize = sizeof(dirpath);
-		char *filenamedest = dirpath;
-
 		// If 0x80 is set on AUX2, send back additional information
 		if (addtl & 0x80)
-		{
-			_set_additional_direntry_details(f, (uint8_t *)dirpath, maxlen);
-			// Adjust remaining size of buffer and file path destination
-			bufsize = sizeof(dirpath) - ADDITIONAL_DETAILS_BYTES;
-			filenamedest = dirpath + ADDITIONAL_DETAILS_BYTES;
-		}
+			fujiDirPage::format_entry(f, dirpath, sizeof(dirpath) - ADDITIONAL_DETAILS_BYTES, maxlen,
+			                          _set_additional_direntry_details, ADDITIONAL_DETAILS_BYTES, maxlen < 128);
 		else
-		{
-			bufsize = maxlen;
-		}
-
-		int filelen;
-		// int filelen = strlcpy(filenamedest, f->filename, bufsize);
-		if (maxlen < 128)
-		{
-			filelen = util_ellipsize(f->filename, filenamedest, bufsize - 1);
-		}
-		else
-		{
-			filelen = strlcpy(filenamedest, f->filename, bufsize);
-		}
-
-		// Add a slash at the end of directory entries
-		if (f->isDir && filelen < (bufsize - 2))
-		{
-			dirpath[filelen] = '/';
-			dirpath[filelen + 1] = '\0';
-			Debug_printf("::entry is dir - %s\n", dirpath);
-		}
+			fujiDirPage::format_entry(f, dirpath, maxlen, maxlen, nullptr, 0, maxlen < 128);
 		// Hack-o-rama to add file type character to beginning of path. - this was for Adam, but must keep for CONFIG compatability
 		// in Apple 2 config will somehow have to work around these extra char's
 		if (maxlen == DIR_MAX_LEN)
@@ -19,6 +19,7 @@
 #include "../fuji/fujiHost.h"
 #include "../fuji/fujiDisk.h"
 #include "../fuji/fujiCmd.h"
+#include "../fuji/fujiDirPage.h"
 
 #include "hash.h"
 #include "../../qrcode/qrmanager.h"
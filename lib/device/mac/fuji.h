@@ -16,6 +16,7 @@
 #include "../fuji/fujiHost.h"
 #include "../fuji/fujiDisk.h"
 #include "../fuji/fujiCmd.h"
+#include "../fuji/fujiDirPage.h"
 
 #define MAX_HOSTS 8
 #define MAX_DISK_DEVICES 5 // 4 DCD devices + 1 floppy devices
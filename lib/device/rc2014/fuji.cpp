@@ -527,39 +527,12 @@ void rc2014Fuji::rc2014_read_directory_entry()
     {
         Debug_printf("::read_direntry \"%s\"\n", f->filename);
 
-        int bufsize = sizeof(dirpath);
-        char *filenamedest = dirpath;
-
         // If 0x80 is set on AUX2, send back additional information
         if (addtl & 0x80)
-        {
-            _set_additional_direntry_details(f, (uint8_t *)dirpath, maxlen);
-            // Adjust remaining size of buffer and file path destination
-            bufsize = sizeof(dirpath) - ADDITIONAL_DETAILS_BYTES;
-            filenamedest = dirpath + ADDITIONAL_DETAILS_BYTES;
-        }
-        else
-        {
-            bufsize = maxlen;
-        }
-
-        int filelen;
-        // int filelen = strlcpy(filenamedest, f->filename, bufsize);
-        if (maxlen < 128)
-        {
-            filelen = util_ellipsize(f->filename, filenamedest, bufsize - 1);
-        }
+            fujiDirPage::format_entry(f, dirpath, sizeof(dirpath) - ADDITIONAL_DETAILS_BYTES, maxlen,
+                                      _set_additional_direntry_details, ADDITIONAL_DETAILS_BYTES, maxlen < 128);
         else
-        {
-            filelen = strlcpy(filenamedest, f->filename, bufsize);
-        }
-
-        // Add a slash at the end of directory entries
-        if (f->isDir && filelen < (bufsize - 2))
-        {
-            filenamedest[filelen] = '/';
-            filenamedest[filelen + 1] = '\0';
-        }
+            fujiDirPage::format_entry(f, dirpath, maxlen, maxlen, nullptr, 0, maxlen < 128);
     }
 
     memset(response, 0, sizeof(response));
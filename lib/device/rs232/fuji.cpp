@@ -11,6 +11,7 @@
 
 #include "fnSystem.h"
 #include "fnConfig.h"
+#include "fujiCopy.h"
 #include "fsFlash.h"
 #include "fnWiFi.h"
 
@@ -338,20 +339,9 @@ void rs232Fuji::rs232_copy_file()
     std::string sourcePath;
     std::string destPath;
     uint8_t ck;
-    FILE *sourceFile;
-    FILE *destFile;
-    char *dataBuf;
     unsigned char sourceSlot;
     unsigned char destSlot;
 
-    dataBuf = (char *)malloc(532);
-
-    if (dataBuf == nullptr)
-    {
-        rs232_error();
-        return;
-    }
-
     memset(&csBuf, 0, sizeof(csBuf));
 
     ck = bus_to_peripheral(csBuf, sizeof(csBuf));
@@ -359,7 +349,6 @@ void rs232Fuji::rs232_copy_file()
     if (ck != rs232_checksum(csBuf, sizeof(csBuf)))
     {
         rs232_error();
-        free(dataBuf);
         return;
     }
 
@@ -371,21 +360,18 @@ void rs232Fuji::rs232_copy_file()
     if (copySpec.empty() || copySpec.find_first_of("|") == std::string::npos)
     {
         rs232_error();
-        free(dataBuf);
         return;
     }
 
     if (cmdFrame.aux1 < 1 || cmdFrame.aux1 > 8)
     {
         rs232_error();
-        free(dataBuf);
         return;
     }
 
     if (cmdFrame.aux2 < 1 || cmdFrame.aux2 > 8)
     {
         rs232_error();
-        free(dataBuf);
         return;
     }
 
@@ -406,43 +392,19 @@ void rs232Fuji::rs232_copy_file()
         destPath += sourceFilename;
     }
 
-    // Mount hosts, if needed.
-    _fnHosts[sourceSlot].mount();
-    _fnHosts[destSlot].mount();
-
-    // Open files...
-    sourceFile = _fnHosts[sourceSlot].file_open(sourcePath.c_str(), (char *)sourcePath.c_str(), sourcePath.size() + 1, "r");
-
-    if (sourceFile == nullptr)
+    if (!fnCopy.start(&_fnHosts[sourceSlot], sourcePath.c_str(), &_fnHosts[destSlot], destPath.c_str()))
     {
         rs232_error();
-        free(dataBuf);
         return;
     }
 
-    destFile = _fnHosts[destSlot].file_open(destPath.c_str(), (char *)destPath.c_str(), destPath.size() + 1, "w");
-
-    if (destFile == nullptr)
+    if (!fnCopy.wait())
     {
         rs232_error();
-        fclose(sourceFile);
-        free(dataBuf);
         return;
     }
 
-    size_t count = 0;
-    do
-    {
-        count = fread(dataBuf, 1, 532, sourceFile);
-        fwrite(dataBuf, 1, count, destFile);
-    } while (count > 0);
-
     rs232_complete();
-
-    // copyEnd:
-    fclose(sourceFile);
-    fclose(destFile);
-    free(dataBuf);
 }
 
 // Mount all
@@ -892,32 +854,13 @@ void rs232Fuji::rs232_read_directory_entry()
     {
         Debug_printf("::read_direntry \"%s\"\n", f->filename);
 
-        int bufsize = sizeof(current_entry);
-        char *filenamedest = current_entry;
-
 #define ADDITIONAL_DETAILS_BYTES 10
         // If 0x80 is set on AUX2, send back additional information
         if (cmdFrame.aux2 & 0x80)
-        {
-            _set_additional_direntry_details(f, (uint8_t *)current_entry, maxlen);
-            // Adjust remaining size of buffer and file path destination
-            bufsize = sizeof(current_entry) - ADDITIONAL_DETAILS_BYTES;
-            filenamedest = current_entry + ADDITIONAL_DETAILS_BYTES;
-        }
+            fujiDirPage::format_entry(f, current_entry, sizeof(current_entry) - ADDITIONAL_DETAILS_BYTES, maxlen,
+                                      _set_additional_direntry_details, ADDITIONAL_DETAILS_BYTES);
         else
-        {
-            bufsize = maxlen;
-        }
-
-        //int filelen = strlcpy(filenamedest, f->filename, bufsize);
-        int filelen = util_ellipsize(f->filename, filenamedest, bufsize);
-
-        // Add a slash at the end of directory entries
-        if (f->isDir && filelen < (bufsize - 2))
-        {
-            current_entry[filelen] = '/';
-            current_entry[filelen + 1] = '\0';
-        }
+            fujiDirPage::format_entry(f, current_entry, maxlen, maxlen, nullptr, 0);
     }
 
     bus_to_computer((uint8_t *)current_entry, maxlen, false);
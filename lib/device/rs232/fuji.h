@@ -10,6 +10,7 @@
 
 #include "fujiHost.h"
 #include "fujiDisk.h"
+#include "fujiDirPage.h"
 #include "fujiCmd.h"
 
 #define MAX_HOSTS 8
@@ -37,8 +37,8 @@ s100spiNetwork::s100spiNetwork()
     status_response[2] = 0x04; // 1024 bytes
     status_response[3] = 0x00; // Character device
 
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -213,7 +213,7 @@ void s100spiNetwork::write(uint16_t num_bytes)
     
     s100spi_response_ack();
 
-    *transmitBuffer += string((char *)response, num_bytes);
+    transmitBuffer->append(response, num_bytes);
     err = s100spiNetwork_write_channel(num_bytes);
 }
 
@@ -755,7 +755,7 @@ void s100spiNetwork::s100spi_control_receive_channel()
         {
             Debug_printf("%c", response[i]);
         }
-        receiveBuffer->erase(0, response_len);
+        receiveBuffer->consume(response_len);
     }
 }
 
@@ -8,6 +8,7 @@
 #include "../../include/debug.h"
 
 #include "fuji.h"
+#include "fnConfig.h"
 #include "utils.h"
 
 #define SIO_DISKCMD_FORMAT 0x21
@@ -267,6 +268,8 @@ mediatype_t sioDisk::mount(fnFile *f, const char *filename, uint32_t disksize, m
     default:
         device_active = true;
         _disk = new MediaTypeATR();
+        _disk->_cache_budget = Config.get_general_disk_cache_kb() * 1024;
+        _disk->_write_back_ms = Config.get_general_disk_writeback_ms();
         if (host != nullptr)
         {
             _disk->_disk_host = host;
@@ -286,6 +289,13 @@ sioDisk::~sioDisk()
     }
 }
 
+// Let the image write back held sectors while the bus is quiet
+void sioDisk::idle()
+{
+    if (_disk != nullptr)
+        _disk->idle();
+}
+
 // Unmount disk file
 void sioDisk::unmount()
 {
@@ -26,9 +26,11 @@ public:
     fujiHost *host;
     mediatype_t mount(fnFile *f, const char *filename, uint32_t disksize, mediatype_t disk_type = MEDIATYPE_UNKNOWN);
     void unmount();
+    void idle();
     bool write_blank(fnFile *f, uint16_t sectorSize, uint16_t numSectors);
 
     mediatype_t disktype() { return _disk == nullptr ? MEDIATYPE_UNKNOWN : _disk->_disktype; };
+    MediaType *media() { return _disk; };
 
     ~sioDisk();
 };
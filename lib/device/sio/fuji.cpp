@@ -21,6 +21,7 @@
 #include "../../../include/debug.h"
 
 #include "fujiCmd.h"
+#include "fujiCopy.h"
 #include "httpService.h"
 #include "fnSystem.h"
 #include "fnConfig.h"
@@ -37,6 +38,7 @@
 #include "../../qrcode/qrmanager.h"
 
 #define ADDITIONAL_DETAILS_BYTES 10
+#define HASH_FILE_BUFSIZE 4096
 
 sioFuji theFuji; // global fuji device object
 
@@ -484,6 +486,14 @@ void sioFuji::sio_set_boot_config()
 }
 
 // Do SIO copy
+/*
+ Copy a file between host slots using the shared copy engine.
+ aux1 = source slot (1-8), aux2 = destination slot (1-8),
+ data frame = "source|destination".
+ If bit 7 of aux2 is set the copy continues in the background and
+ this command completes immediately; progress is then read with
+ COPY FILE STATUS and the copy can be stopped with COPY FILE CANCEL.
+*/
 void sioFuji::sio_copy_file()
 {
     uint8_t csBuf[256];
@@ -491,22 +501,10 @@ void sioFuji::sio_copy_file()
     std::string sourcePath;
     std::string destPath;
     uint8_t ck;
-    fnFile *sourceFile;
-    fnFile *destFile;
-    char *dataBuf;
     unsigned char sourceSlot;
     unsigned char destSlot;
-#ifndef ESP_PLATFORM
-    uint64_t poll_ts = fnSystem.millis();
-#endif
-
-    dataBuf = (char *)malloc(532);
-
-    if (dataBuf == nullptr)
-    {
-        sio_error();
-        return;
-    }
+    bool background = (cmdFrame.aux2 & 0x80) != 0;
+    uint8_t destAux = cmdFrame.aux2 & 0x7F;
 
     memset(&csBuf, 0, sizeof(csBuf));
 
@@ -515,10 +513,10 @@ void sioFuji::sio_copy_file()
     if (ck != sio_checksum(csBuf, sizeof(csBuf)))
     {
         sio_error();
-        free(dataBuf);
         return;
     }
 
+    csBuf[sizeof(csBuf) - 1] = '\0';
     copySpec = std::string((char *)csBuf);
 
     Debug_printf("copySpec: %s\n", copySpec.c_str());
@@ -527,26 +525,23 @@ void sioFuji::sio_copy_file()
     if (copySpec.empty() || copySpec.find_first_of("|") == std::string::npos)
     {
         sio_error();
-        free(dataBuf);
         return;
     }
 
     if (cmdFrame.aux1 < 1 || cmdFrame.aux1 > 8)
     {
         sio_error();
-        free(dataBuf);
         return;
     }
 
-    if (cmdFrame.aux2 < 1 || cmdFrame.aux2 > 8)
+    if (destAux < 1 || destAux > 8)
     {
         sio_error();
-        free(dataBuf);
         return;
     }
 
     sourceSlot = cmdFrame.aux1 - 1;
-    destSlot = cmdFrame.aux2 - 1;
+    destSlot = destAux - 1;
 
     // All good, after this point...
 
@@ -555,85 +550,65 @@ void sioFuji::sio_copy_file()
     destPath = copySpec.substr(copySpec.find_first_of("|") + 1);
 
     // At this point, if last part of dest path is / then copy filename from source.
-    if (destPath.back() == '/')
+    if (destPath.empty() || destPath.back() == '/')
     {
         Debug_printf("append source file\n");
         std::string sourceFilename = sourcePath.substr(sourcePath.find_last_of("/") + 1);
         destPath += sourceFilename;
     }
 
-    // Mount hosts, if needed.
-    _fnHosts[sourceSlot].mount();
-    _fnHosts[destSlot].mount();
-
-    // Open files...
-    sourceFile = _fnHosts[sourceSlot].fnfile_open(sourcePath.c_str(), (char *)sourcePath.c_str(), sourcePath.size() + 1, FILE_READ);
-
-    if (sourceFile == nullptr)
+    if (!fnCopy.start(&_fnHosts[sourceSlot], sourcePath.c_str(), &_fnHosts[destSlot], destPath.c_str()))
     {
         sio_error();
-        free(dataBuf);
         return;
     }
 
-    destFile = _fnHosts[destSlot].fnfile_open(destPath.c_str(), (char *)destPath.c_str(), destPath.size() + 1, FILE_WRITE);
-
-    if (destFile == nullptr)
+    if (background)
     {
-        sio_error();
-        fnio::fclose(sourceFile);
-        free(dataBuf);
+        sio_complete();
         return;
     }
 
-    size_t readCount = 0;
-    size_t readTotal = 0;
-    size_t writeCount = 0;
-    size_t expected = _fnHosts[sourceSlot].file_size(sourceFile); // get the filesize
-    bool err = false;
-    do
+#ifdef ESP_PLATFORM
+    bool ok = fnCopy.wait();
+#else
+    uint64_t poll_ts = fnSystem.millis();
+    while (fnCopy.running())
     {
-#ifndef ESP_PLATFORM
         if (fnSioCom.get_sio_mode() == SioCom::sio_mode::NETSIO && fnSystem.millis() - poll_ts > 1000)
         {
             fnSioCom.poll(1);
             poll_ts = fnSystem.millis();
         }
+        fnSystem.delay(10);
+    }
+    bool ok = fnCopy.state() == COPY_STATE_DONE;
 #endif
-        readCount = fnio::fread(dataBuf, 1, 532, sourceFile);
-        readTotal += readCount;
-        // Check if we got enough bytes on the read
-        if (readCount < 532 && readTotal != expected)
-        {
-            err = true;
-            break;
-        }
-        writeCount = fnio::fwrite(dataBuf, 1, readCount, destFile);
-        // Check if we sent enough bytes on the write
-        if (writeCount != readCount)
-        {
-            err = true;
-            break;
-        }
-        Debug_printf("Copy File: %d bytes of %d\n", readTotal, expected);
-    } while (readTotal < expected);
 
-    if (err == true)
-    {
-        // Remove the destination file and error
-        _fnHosts[destSlot].file_remove((char *)destPath.c_str());
-        sio_error();
-        Debug_printf("Copy File Error! wCount: %d, rCount: %d, rTotal: %d, Expect: %d\n", writeCount, readCount, readTotal, expected);
-    }
-    else
-    {
+    if (ok)
         sio_complete();
-    }
+    else
+        sio_error();
+}
+
+/*
+ Report progress of the last COPY FILE: a fujiCopyStatus struct,
+ state (0 idle, 1 running, 2 done, 3 error, 4 cancelled), percent,
+ then total and copied byte counts as 32-bit little-endian values.
+*/
+void sioFuji::sio_copy_file_status()
+{
+    fujiCopyStatus status;
 
-    // copyEnd:
-    fnio::fclose(sourceFile);
-    fnio::fclose(destFile);
-    free(dataBuf);
+    fnCopy.get_status(&status);
+    bus_to_computer((uint8_t *)&status, sizeof(status), false);
+}
+
+void sioFuji::sio_copy_file_cancel()
+{
+    Debug_println("Fuji cmd: COPY FILE CANCEL");
+    fnCopy.cancel();
+    sio_complete();
 }
 
 // Mount all
@@ -1048,6 +1023,13 @@ void sioFuji::image_rotate()
     }
 }
 
+// Called from the bus service loop while no command is being processed
+void sioFuji::idle_disks()
+{
+    for (int i = 0; i < MAX_DISK_DEVICES; i++)
+        _fnDisks[i].disk_dev.idle();
+}
+
 // This gets called when we're about to shutdown/reboot
 void sioFuji::shutdown()
 {
@@ -1143,7 +1125,6 @@ void _set_additional_direntry_details(fsdir_entry_t *f, uint8_t *dest, uint8_t m
     dest[9] = MediaType::discover_disktype(f->filename);
 }
 
-// TODO: VERIFY THIS CODE. THE STASH SEEMED CORRUPT
 void sioFuji::sio_read_directory_block()
 {
     // aux1 holds entry size for each record
@@ -1160,12 +1141,6 @@ void sioFuji::sio_read_directory_block()
 
     Debug_printf("Fuji cmd: READ DIRECTORY BLOCK (pages=%d, maxlen=%d, extended: %d)\n", pages, maxlen, is_extended);
 
-    std::vector<uint8_t> response;
-    std::vector<uint8_t> start_offsets; // holds all the offsets for each dir entry in the response
-    std::vector<uint8_t> data_block;    // the data for each dir entry. no terminator char needed as we track the offsets. Double 0x7f is end of dir, and no more entries will come
-
-    uint16_t response_max = pages * 256;
-
     if (_current_open_directory_slot == -1)
     {
         Debug_print("No currently open directory\n");
@@ -1173,152 +1148,12 @@ void sioFuji::sio_read_directory_block()
         return;
     }
 
-    bool is_eod = false;
-    char current_entry[256];
-    uint16_t num_entries = 0;
-    uint16_t total_size = 9; // header bytes
-
-    uint16_t initial_pos = _fnHosts[_current_open_directory_slot].dir_tell();
-
-    // keep filling buffers up until it can't fit another maxlen (plus header bytes etc)
-    // or we hit end of dir
-    while ( !is_eod && num_entries < 256 )
-    {
-        uint16_t additional_size = 0;
-        uint16_t pos_before_next = _fnHosts[_current_open_directory_slot].dir_tell();
-        fsdir_entry_t *f = _fnHosts[_current_open_directory_slot].dir_nextfile();
-        if (f == nullptr)
-        {
-            // reached end of dir
-            is_eod = true;
-            current_entry[0] = 0x7F;
-            current_entry[1] = 0x7F;
-            current_entry[2] = 0;
-            additional_size = 2;
-        }
-        else
-        {
-            Debug_printf("::read_direntry \"%s\"\n", f->filename);
-
-            int bufsize;
-            char *filenamedest = current_entry;
-
-            // If 0x80 is set on AUX2, send back additional information
-            if (is_extended)
-            {
-                _set_additional_direntry_details(f, (uint8_t *)current_entry, maxlen);
-                // Adjust remaining size of buffer and file path destination
-                bufsize = sizeof(current_entry) - ADDITIONAL_DETAILS_BYTES;
-                filenamedest = current_entry + ADDITIONAL_DETAILS_BYTES;
-            }
-            else
-            {
-                bufsize = maxlen;
-            }
-
-            int filelen = util_ellipsize(f->filename, filenamedest, bufsize);
-            additional_size = filelen + (is_extended ? ADDITIONAL_DETAILS_BYTES : 0);
-
-            // Add a slash at the end of directory entries
-            if (f->isDir && filelen < (bufsize - 2))
-            {
-                current_entry[filelen] = '/';
-                current_entry[filelen + 1] = '\0';
-                additional_size++;
-            }
-
-        }
-
-        // would this take us over the limit? 2 for start_offset bytes.
-        uint16_t new_size = total_size + 2 + additional_size;
-
-        if (new_size > response_max) {
-            Debug_printf("skipping add, would have taken us to %d size. additional was: %d\n", new_size, additional_size);
-            // reset to previous pos, and exit loop
-            _fnHosts[_current_open_directory_slot].dir_seek(pos_before_next);
-            break;
-        } else {
-            Debug_printf("adding additional entry with size: %d\n", additional_size);
-        }
-
-
-        start_offsets.push_back(static_cast<uint8_t>(data_block.size() & 0xFF)); // lo byte of current size (which is same as offset)
-        start_offsets.push_back(static_cast<uint8_t>((data_block.size() >> 8) & 0xFF)); // high byte
-
-        // add the string to the data block without the terminating null
-        if (is_extended)
-        {
-            // strlen doesn't work as we have prepended some additional information
-            // add the additional bytes first
-            for(int i=0; i < ADDITIONAL_DETAILS_BYTES; i++)
-            {
-                data_block.push_back(static_cast<uint8_t>(current_entry[i]));
-            }
-            // Then add the string part
-            //int s_len = std::strlen(current_entry + ADDITIONAL_DETAILS_BYTES);
-            data_block.insert(data_block.end(), current_entry + ADDITIONAL_DETAILS_BYTES, current_entry + ADDITIONAL_DETAILS_BYTES + std::strlen(current_entry + ADDITIONAL_DETAILS_BYTES));
-        } else {
-            data_block.insert(data_block.end(), current_entry, current_entry + std::strlen(current_entry));
-        }
-
-        total_size = 9 + data_block.size() + start_offsets.size();
-        Debug_printf("current sizes, data: %d, offsets: %d, total: %d\n", data_block.size(), start_offsets.size(), data_block.size() + start_offsets.size());
-
-
-        num_entries++;
-    }
-
-    // ###################################################################
-    // CREATE THE RESPONSE BLOCK:
-    // ###################################################################
-    // byte 0-1 = "MF" (Multi-File, take your pick :D )
-    // byte 2   = Flags (currently 0x80 = Extended Information)
-    // byte 3   = Max Size Per Entry (maxlen from input)
-    // byte 4   = Num Entries in block (max 255)
-    // byte 5-6 = Total size of block (i.e. size without padding)
-    // byte 7-8 = First Position in block (i.e. dir pos value at start), allows up to 64k entries over all blocks
-    // Num Entries x 2 = Offsets in Data for each entry
-    // Data x Num Entries = data for each dir.
-    //
-    // All above is < pages x 256 in size
-
-    // HEADER BYTES
-    std::string headerBytes = "MF";
-    response.insert(response.end(), headerBytes.begin(), headerBytes.end());
-
-    // FLAGS
-    uint8_t header_flags = is_extended ? 0x80 : 0;  // more flags may come
-    response.push_back(header_flags);
-
-    // MAX SIZE PER ENTRY
-    response.push_back(maxlen);
-
-    // NUM ENTRIES
-    response.push_back(static_cast<uint8_t>(num_entries));
-
-    // Total size
-    int final_size = 9 + data_block.size() + start_offsets.size();
-    response.push_back(static_cast<uint8_t>(final_size & 0xFF));
-    response.push_back(static_cast<uint8_t>((final_size >> 8) & 0xFF));
-
-    // INITIAL POS VALUE
-    response.push_back(static_cast<uint8_t>(initial_pos & 0xFF));
-    response.push_back(static_cast<uint8_t>((initial_pos >> 8) & 0xFF));
-
-    // OFFSETS
-    response.insert(response.end(), start_offsets.begin(), start_offsets.end());
-
-    // DATA
-    response.insert(response.end(), data_block.begin(), data_block.end());
-
-    Debug_printf("Actual data size: %d to atari\n", response.size());
-    std::string s = util_hexdump(response.data(), response.size());
-    Debug_printf("dump: \n%s\n", s.c_str());
-
-    // buffer with 0s to requested size
-    response.resize(response_max, 0);
+    uint16_t response_max = pages * 256;
+    uint8_t *response = _dir_page.render_block(_fnHosts[_current_open_directory_slot], response_max, maxlen,
+                                               is_extended ? _set_additional_direntry_details : nullptr,
+                                               ADDITIONAL_DETAILS_BYTES);
 
-    bus_to_computer(response.data(), response_max, false);
+    bus_to_computer(response, response_max, false);
 }
 
 void sioFuji::sio_read_directory_entry()
@@ -1354,31 +1189,12 @@ void sioFuji::sio_read_directory_entry()
     {
         Debug_printf("::read_direntry \"%s\"\n", f->filename);
 
-        int bufsize = sizeof(current_entry);
-        char *filenamedest = current_entry;
-
         // If 0x80 is set on AUX2, send back additional information
         if (cmdFrame.aux2 & 0x80)
-        {
-            _set_additional_direntry_details(f, (uint8_t *)current_entry, maxlen);
-            // Adjust remaining size of buffer and file path destination
-            bufsize = maxlen - ADDITIONAL_DETAILS_BYTES;
-            filenamedest = current_entry + ADDITIONAL_DETAILS_BYTES;
-        }
+            fujiDirPage::format_entry(f, current_entry, maxlen - ADDITIONAL_DETAILS_BYTES, maxlen,
+                                      _set_additional_direntry_details, ADDITIONAL_DETAILS_BYTES);
         else
-        {
-            bufsize = maxlen;
-        }
-
-        // int filelen = strlcpy(filenamedest, f->filename, bufsize);
-        int filelen = util_ellipsize(f->filename, filenamedest, bufsize);
-
-        // Add a slash at the end of directory entries
-        if (f->isDir && filelen < (bufsize - 2))
-        {
-            current_entry[filelen] = '/';
-            current_entry[filelen + 1] = '\0';
-        }
+            fujiDirPage::format_entry(f, current_entry, maxlen, maxlen, nullptr, 0);
     }
 
     bus_to_computer((uint8_t *)current_entry, maxlen, false);
@@ -2525,6 +2341,97 @@ void sioFuji::sio_hash_clear()
     sio_complete();
 }
 
+/*
+ Hash a file on a host slot without sending its contents over SIO.
+ aux1 = host slot, aux2 = algorithm, data frame = 256 byte path.
+ The result is read back with HASH LENGTH / HASH OUTPUT as usual.
+*/
+void sioFuji::sio_hash_file()
+{
+    char path[256];
+    uint8_t hostSlot = cmdFrame.aux1;
+#ifndef ESP_PLATFORM
+    uint64_t poll_ts = fnSystem.millis();
+#endif
+
+    Debug_printf("FUJI: HASH FILE\n");
+
+    uint8_t ck = bus_to_peripheral((uint8_t *)path, sizeof(path));
+
+    if (sio_checksum((uint8_t *)path, sizeof(path)) != ck)
+    {
+        sio_error();
+        return;
+    }
+
+    algorithm = Hash::to_algorithm(cmdFrame.aux2);
+
+    if (!_validate_host_slot(hostSlot) || algorithm == Hash::Algorithm::UNKNOWN)
+    {
+        sio_error();
+        return;
+    }
+
+    path[sizeof(path) - 1] = '\0';
+
+    if (!_fnHosts[hostSlot].mount())
+    {
+        sio_error();
+        return;
+    }
+
+    fnFile *f = _fnHosts[hostSlot].fnfile_open(path, path, sizeof(path), FILE_READ);
+
+    if (f == nullptr)
+    {
+        sio_error();
+        return;
+    }
+
+    uint8_t *buf = (uint8_t *)malloc(HASH_FILE_BUFSIZE);
+
+    if (buf == nullptr)
+    {
+        fnio::fclose(f);
+        sio_error();
+        return;
+    }
+
+    size_t expected = _fnHosts[hostSlot].file_size(f);
+    size_t total = 0;
+    size_t count;
+
+    hasher.begin(algorithm);
+
+    while ((count = fnio::fread(buf, 1, HASH_FILE_BUFSIZE, f)) > 0)
+    {
+#ifndef ESP_PLATFORM
+        if (fnSioCom.get_sio_mode() == SioCom::sio_mode::NETSIO && fnSystem.millis() - poll_ts > 1000)
+        {
+            fnSioCom.poll(1);
+            poll_ts = fnSystem.millis();
+        }
+#endif
+        hasher.add_data(buf, count);
+        total += count;
+    }
+
+    free(buf);
+    fnio::fclose(f);
+
+    if (total != expected)
+    {
+        Debug_printf("Hash File Error! read %u of %u bytes\n", (unsigned)total, (unsigned)expected);
+        hasher.clear();
+        sio_error();
+        return;
+    }
+
+    // Clearing puts the hasher back to updating all algorithms for HASH INPUT
+    hasher.compute(algorithm, true);
+    sio_complete();
+}
+
 void sioFuji::sio_process(uint32_t commanddata, uint8_t checksum)
 {
     cmdFrame.commanddata = commanddata;
@@ -2766,6 +2673,18 @@ void sioFuji::sio_process(uint32_t commanddata, uint8_t checksum)
         sio_ack();
         sio_hash_clear();
         break;
+    case FUJICMD_HASH_FILE:
+        sio_late_ack();
+        sio_hash_file();
+        break;
+    case FUJICMD_COPY_FILE_STATUS:
+        sio_ack();
+        sio_copy_file_status();
+        break;
+    case FUJICMD_COPY_FILE_CANCEL:
+        sio_ack();
+        sio_copy_file_cancel();
+        break;
     case FUJICMD_RANDOM_NUMBER:
         sio_ack();
         sio_random_number();
@@ -17,6 +17,7 @@
 
 #include "fujiHost.h"
 #include "fujiDisk.h"
+#include "fujiDirPage.h"
 #include "fujiCmd.h"
 
 #include "hash.h"
@@ -94,6 +95,7 @@ private:
     sioCassette _cassetteDev;
 
     int _current_open_directory_slot = -1;
+    fujiDirPage _dir_page; // READ DIRECTORY BLOCK responses are built here
 
     sioDisk _bootDisk; // special disk drive just for configuration
 
@@ -177,6 +179,9 @@ protected:
     void sio_hash_output();            // 0xC5
     void sio_get_adapter_config_extended(); // 0xC4
     void sio_hash_clear();             // 0xC2
+    void sio_hash_file();              // 0xC1
+    void sio_copy_file_status();       // 0xC0
+    void sio_copy_file_cancel();       // 0xBA
     void sio_qrcode_input();           // 0xBC
     void sio_qrcode_encode();          // 0xBD
     void sio_qrcode_length();          // OxBE
@@ -214,6 +219,7 @@ public:
     void setup(systemBus *siobus);
 
     void image_rotate();
+    void idle_disks();
     int get_disk_id(int drive_slot);
     std::string get_host_prefix(int host_slot);
 
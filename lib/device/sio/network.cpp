@@ -57,8 +57,8 @@ void onTimer(void *info)
  */
 sioNetwork::sioNetwork()
 {
-    receiveBuffer = new string();
-    transmitBuffer = new string();
+    receiveBuffer = new NetworkBuffer();
+    transmitBuffer = new NetworkBuffer();
     specialBuffer = new string();
 
     receiveBuffer->clear();
@@ -309,8 +309,7 @@ void sioNetwork::sio_read()
 
     // And send off to the computer
     bus_to_computer((uint8_t *)receiveBuffer->data(), num_bytes, err);
-    receiveBuffer->erase(0, num_bytes);
-    receiveBuffer->shrink_to_fit();
+    receiveBuffer->consume(num_bytes);
 }
 
 /**
@@ -381,7 +380,7 @@ void sioNetwork::sio_write()
 
     // Get the data from the Atari
     bus_to_peripheral(newData.data(), num_bytes); // TODO test checksum
-    *transmitBuffer += string((char *)newData.data(), num_bytes);
+    transmitBuffer->append(newData.data(), num_bytes);
 
     // Do the channel write
     err = sio_write_channel(num_bytes);
@@ -791,6 +790,10 @@ void sioNetwork::do_inquiry(unsigned char inq_cmd)
             if (channelMode == JSON)
                 inq_dstats = 0x80;
             break;
+        case 'M': // JSON Multiple queries
+            if (channelMode == JSON)
+                inq_dstats = 0x80;
+            break;
         default:
             inq_dstats = 0xFF; // not supported
             break;
@@ -852,9 +855,11 @@ void sioNetwork::sio_special_40()
         return;
     }
 
-    bus_to_computer((uint8_t *)receiveBuffer->data(),
+    // Room after any pending data, so the special payload doesn't overwrite it
+    uint8_t *sp_buf = (uint8_t *)receiveBuffer->prepare(SPECIAL_BUFFER_SIZE);
+    bus_to_computer(sp_buf,
                     SPECIAL_BUFFER_SIZE,
-                    protocol->special_40((uint8_t *)receiveBuffer->data(), SPECIAL_BUFFER_SIZE, &cmdFrame));
+                    protocol->special_40(sp_buf, SPECIAL_BUFFER_SIZE, &cmdFrame));
 }
 
 /**
@@ -885,6 +890,10 @@ void sioNetwork::sio_special_80()
         if (channelMode == JSON)
             sio_set_json_query();
         return;
+    case 'M':
+        if (channelMode == JSON)
+            sio_set_json_queries();
+        return;
     case 0xFD: // LOGIN
         sio_set_login();
         return;
@@ -1184,7 +1193,8 @@ void sioNetwork::sio_set_translation()
 
 void sioNetwork::sio_parse_json()
 {
-    json->parse();
+    // AUX1=1 keeps only the value of the query already set with 'Q'
+    json->parse(cmdFrame.aux1 == 1);
     sio_complete();
 }
 
@@ -1231,6 +1241,63 @@ void sioNetwork::sio_set_json_query()
     sio_complete();
 }
 
+void sioNetwork::sio_set_json_queries()
+{
+    // aux1  | aux2    |    meaning
+    // n     | 0/1/2   |  n pages of 256 bytes of queries (0 = 1), query param as for 'Q'
+    uint8_t pages = cmdFrame.aux1 == 0 ? 1 : cmdFrame.aux1;
+    if (pages > JSON_QUERIES_MAX_PAGES)
+    {
+        sio_error();
+        return;
+    }
+
+    std::vector<uint8_t> in(pages * 256 + 1, 0);
+    bus_to_peripheral(in.data(), pages * 256);
+
+    // One query per line, a NUL ends the list
+    std::vector<std::string> queries;
+    std::string query;
+    for (uint8_t c : in)
+    {
+        if (c == 0x00 || c == 0x0A || c == 0x0D || c == 0x9b)
+        {
+            // Skip a device spec in front of the query
+            size_t colon_pos = query.find(':');
+            if (colon_pos != std::string::npos && colon_pos < query.find('/'))
+                query.erase(0, colon_pos + 1);
+            if (!query.empty())
+                queries.push_back(query);
+            query.clear();
+            if (c == 0x00)
+                break;
+        }
+        else
+            query += (char)c;
+    }
+
+    if (queries.size() > 255)
+    {
+        sio_error();
+        return;
+    }
+
+    if (!json->setReadQueries(queries, cmdFrame.aux2))
+    {
+        json_bytes_remaining = 0;
+        sio_error();
+        return;
+    }
+    json_bytes_remaining = json->json_bytes_remaining;
+
+    std::vector<uint8_t> tmp(json_bytes_remaining);
+    json->readValue(tmp.data(), json_bytes_remaining);
+    receiveBuffer->append(tmp.data(), tmp.size());
+
+    Debug_printf("%u queries set, %u bytes of values\r\n", (unsigned)queries.size(), json_bytes_remaining);
+    sio_complete();
+}
+
 void sioNetwork::sio_set_json_parameters()
 {
     // aux1  | aux2    |    meaning
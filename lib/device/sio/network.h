@@ -30,6 +30,11 @@
 #define OUTPUT_BUFFER_SIZE 65535
 #define SPECIAL_BUFFER_SIZE 256
 
+/**
+ * The most 256 byte pages of JSON queries in one multiple query command
+ */
+#define JSON_QUERIES_MAX_PAGES 4
+
 #define NEWDATA_SIZE 65535
 
 class sioNetwork : public virtualDevice
@@ -148,12 +153,12 @@ private:
     /**
      * The Receive buffer for this N: device
      */
-    std::string *receiveBuffer = nullptr;
+    NetworkBuffer *receiveBuffer = nullptr;
 
     /**
      * The transmit buffer for this N: device
      */
-    std::string *transmitBuffer = nullptr;
+    NetworkBuffer *transmitBuffer = nullptr;
 
     /**
      * The special buffer for this N: device
@@ -412,6 +417,12 @@ private:
      */
     void sio_set_json_query();
 
+    /**
+     * @brief Set several JSON queries, one per line, and return all of their
+     * values in one length prefixed record. (must be in JSON channelMode)
+     */
+    void sio_set_json_queries();
+
     /**
      * @brief Set JSON parameters. (must be in JSON channelMode)
      * Used to affect values on the JSON object
@@ -60,21 +60,23 @@ void sioUDPStream::sio_enable_udpstream()
         // Register with the server
         Debug_println("UDPSTREAM registering with server");
         const char* str = "REGISTER";
-        memcpy(buf_stream, str, strlen(str));
         udpStream.beginPacket(udpstream_host_ip, udpstream_port); // remote IP and port
-        udpStream.write(buf_stream, strlen(str));
+        udpStream.write((const uint8_t *)str, strlen(str));
         udpStream.endPacket();
-        // number the outgoing packet for the server to handle sequencing
-        packet_seq = 0;
-        buf_stream_index = 0;
-        packet_seq += 1;
-        *(uint16_t *)buf_stream = packet_seq;
-        buf_stream_index += 2;
     }
+    // number the outgoing packets for the server to handle sequencing
+    batch_out.begin(udpstreamIsServer);
+    // incoming packets are passed on as they are until the server says it numbers them
+    udpstreamSequenced = false;
+    jitter_in.reset();
+    jitter_in.stats = {};
 }
 
 void sioUDPStream::sio_disable_udpstream()
 {
+    // Don't lose what the Atari sent just before
+    if (udpstreamActive && !batch_out.empty())
+        send_batch();
     udpStream.stop();
     if (udpstream_port == MIDI_PORT)
     {
@@ -89,30 +91,82 @@ void sioUDPStream::sio_disable_udpstream()
     fnSystem.digital_write(PIN_CKI, DIGI_HIGH);
 #endif
     udpstreamActive = false;
+    Debug_printf("UDPSTREAM sent %u packets, %u bytes\n", batch_out.packets, batch_out.bytes);
+    if (udpstreamSequenced)
+    {
+        const udpstream_stats &st = jitter_in.stats;
+        Debug_printf("UDPSTREAM received %u packets: %u delivered, %u reordered, %u duplicate, %u late, %u lost\n",
+                     st.packets_in, st.delivered, st.reordered, st.duplicates, st.late, st.lost);
+    }
     udpstreamIsServer = false;
+    udpstreamSequenced = false;
     Debug_println("UDPSTREAM mode DISABLED");
 }
 
+void sioUDPStream::send_batch()
+{
+    udpStream.beginPacket(udpstream_host_ip, udpstream_port); // remote IP and port
+    udpStream.write(batch_out.packet(), batch_out.length());
+    udpStream.endPacket();
+
+#ifdef DEBUG_UDPSTREAM
+    Debug_print("UDP-OUT: ");
+    util_dump_bytes(batch_out.packet(), batch_out.length());
+#endif
+    batch_out.sent();
+}
+
 void sioUDPStream::sio_handle_udpstream()
 {
-    // if there’s data available, read a packet
-    int packetSize = udpStream.parsePacket();
-    if (packetSize > 0)
+    uint32_t now = (uint32_t)fnSystem.micros();
+
+    // if there’s data available, read the packets
+    int packetSize;
+    while ((packetSize = udpStream.parsePacket()) > 0)
     {
-        udpStream.read(buf_net, UDPSTREAM_BUFFER_SIZE);
-        // Send to Atari UART
-        FN_BUS_LINK.write(buf_net, packetSize);
-#ifdef ESP_PLATFORM
+        // Straight into the jitter buffer's free slot
+        uint8_t *packet = jitter_in.buffer();
+        packetSize = udpStream.read(packet, UDPSTREAM_MAX_PACKET);
+        if (packetSize <= 0)
+            break;
+#ifdef DEBUG_UDPSTREAM
+        Debug_print("UDP-IN: ");
+        util_dump_bytes(packet, packetSize);
+#endif
         if (udpstreamIsServer)
         {
+#ifdef ESP_PLATFORM
             // Reset the timer
             start = (uint32_t)esp_timer_get_time();
-        }
-#endif
-#ifdef DEBUG_UDPSTREAM
-        Debug_print("UDP-IN: ");
-        util_dump_bytes(buf_net, packetSize);
 #endif
+            if (!udpstreamSequenced && packetSize == (int)strlen(UDPSTREAM_SEQUENCED_REPLY)
+                && memcmp(packet, UDPSTREAM_SEQUENCED_REPLY, packetSize) == 0)
+            {
+                Debug_println("UDPSTREAM server numbers its packets, putting them in order");
+                udpstreamSequenced = true;
+                jitter_in.reset();
+                continue;
+            }
+        }
+        if (udpstreamSequenced)
+            jitter_in.put(packetSize, now);
+        else
+        {
+            // Send to Atari UART
+            FN_BUS_LINK.write(packet, packetSize);
+        }
+    }
+
+    if (udpstreamSequenced)
+    {
+        // Send to Atari UART, in order
+        const uint8_t *data;
+        size_t len;
+        while ((data = jitter_in.get(&len, now)) != nullptr)
+        {
+            if (len > 0)
+                FN_BUS_LINK.write(data, len);
+        }
     }
 
 #ifdef ESP_PLATFORM
@@ -127,55 +181,17 @@ void sioUDPStream::sio_handle_udpstream()
 */
 #endif
 
-    // Read the data until there's a pause in the incoming stream
-    if (FN_BUS_LINK.available() > 0)
+    // Collect what the Atari has sent. The bus checks COMMAND between calls,
+    // so this returns rather than waiting for a pause in the stream.
+    while (FN_BUS_LINK.available() > 0)
     {
-        while (true)
-        {
-            // Break out of UDPStream mode if COMMAND is asserted
-#ifdef ESP_PLATFORM
-            if (fnSystem.digital_read(PIN_CMD) == DIGI_LOW)
-#else
-            if (FN_BUS_LINK.command_asserted())
-#endif
-            {
-                Debug_println("CMD Asserted in LOOP, stopping UDPStream");
-                sio_disable_udpstream();
-                return;
-            }
-            if (FN_BUS_LINK.available() > 0)
-            {
-                // Collect bytes read in our buffer
-                buf_stream[buf_stream_index] = (unsigned char)FN_BUS_LINK.read(); // TODO apc: check for error first
-                if (buf_stream_index < UDPSTREAM_BUFFER_SIZE - 1)
-                    buf_stream_index++;
-            }
-            else
-            {
-                fnSystem.delay_microseconds(UDPSTREAM_PACKET_TIMEOUT);
-                if (FN_BUS_LINK.available() <= 0)
-                    break;
-            }
-        }
-
-        // Send what we've collected
-        udpStream.beginPacket(udpstream_host_ip, udpstream_port); // remote IP and port
-        udpStream.write(buf_stream, buf_stream_index);
-        udpStream.endPacket();
-
-#ifdef DEBUG_UDPSTREAM
-        Debug_print("UDP-OUT: ");
-        util_dump_bytes(buf_stream, buf_stream_index);
-#endif
-        buf_stream_index = 0;
-        if (udpstreamIsServer)
-        {
-            // number the outgoing packet for the server to handle sequencing
-            packet_seq += 1;
-            *(uint16_t *)buf_stream = packet_seq;
-            buf_stream_index += 2;
-        }
+        if (batch_out.add((uint8_t)FN_BUS_LINK.read(), now)) // TODO apc: check for error first
+            send_batch();
     }
+
+    // Send once the Atari stops for a few byte times
+    if (batch_out.due((uint32_t)fnSystem.micros()))
+        send_batch();
 }
 
 void sioUDPStream::sio_status()
@@ -9,6 +9,7 @@
 #include "bus.h"
 
 #include "fnUDP.h"
+#include "fnUDPStream.h"
 
 #define LEDC_TIMER_RESOLUTION  LEDC_TIMER_1_BIT
 
@@ -20,32 +21,33 @@
 #endif
 #endif
 
-#define UDPSTREAM_BUFFER_SIZE 8192
-#define UDPSTREAM_PACKET_TIMEOUT 5000
 #define UDPSTREAM_KEEPALIVE_TIMEOUT 250000      // MIDI Keep Alive is 300ms
 #define MIDI_PORT 5004
 #define MIDI_BAUDRATE 31250
+// A server that relays packets with the sender's sequence number in front answers REGISTER with this
+#define UDPSTREAM_SEQUENCED_REPLY "SEQUENCED"
 
 class sioUDPStream : public virtualDevice
 {
 private:
     fnUDP udpStream;
 
-    uint8_t buf_net[UDPSTREAM_BUFFER_SIZE];
-    uint8_t buf_stream[UDPSTREAM_BUFFER_SIZE];
-
-    uint8_t buf_stream_index=0;
-
-    uint16_t packet_seq = 0;
+    // Bytes from the Atari on their way out, numbered in server mode
+    UDPStreamBatch batch_out;
+    // Numbered packets from a sequenced server put back in order
+    UDPStreamJitter jitter_in;
 #ifdef ESP_PLATFORM
     uint32_t start = (uint32_t)esp_timer_get_time(); // Keep alive timer
 #endif
+    void send_batch();
+
     void sio_status() override;
     void sio_process(uint32_t commanddata, uint8_t checksum) override;
 
 public:
     bool udpstreamActive = false; // If we are in udpstream mode or not
     bool udpstreamIsServer = false; // If we are connecting to a server
+    bool udpstreamSequenced = false; // If the server numbers what it relays, so the jitter buffer can be used
     in_addr_t udpstream_host_ip = IPADDR_NONE;
     int udpstream_port;
 
@@ -5,10 +5,22 @@
 
 Hash hasher;
 
-Hash::Hash() {}
+#define HASH_BIT(a) (1 << static_cast<int>(a))
+#define HASH_ALL (HASH_BIT(Algorithm::MD5) | HASH_BIT(Algorithm::SHA1) | HASH_BIT(Algorithm::SHA256) | HASH_BIT(Algorithm::SHA512))
+
+Hash::Hash() {
+    mbedtls_md5_init(&md5_ctx);
+    mbedtls_sha1_init(&sha1_ctx);
+    mbedtls_sha256_init(&sha256_ctx);
+    mbedtls_sha512_init(&sha512_ctx);
+    start(HASH_ALL);
+}
 
 Hash::~Hash() {
-    clear();
+    mbedtls_md5_free(&md5_ctx);
+    mbedtls_sha1_free(&sha1_ctx);
+    mbedtls_sha256_free(&sha256_ctx);
+    mbedtls_sha512_free(&sha512_ctx);
 }
 
 Hash::Algorithm Hash::to_algorithm(uint8_t value) {
@@ -41,16 +53,47 @@ Hash::Algorithm Hash::from_string(std::string hash_name)
     }
 }
 
+void Hash::start(uint8_t mask) {
+    active = mask;
+    if (active & HASH_BIT(Algorithm::MD5))
+        mbedtls_md5_starts(&md5_ctx);
+    if (active & HASH_BIT(Algorithm::SHA1))
+        mbedtls_sha1_starts(&sha1_ctx);
+    if (active & HASH_BIT(Algorithm::SHA256))
+        mbedtls_sha256_starts(&sha256_ctx, 0);
+    if (active & HASH_BIT(Algorithm::SHA512))
+        mbedtls_sha512_starts(&sha512_ctx, 0);
+}
+
+// Restart hashing, updating only the given algorithm until the next clear()
+void Hash::begin(Algorithm algorithm) {
+    hash_output.clear();
+    start(algorithm == Algorithm::UNKNOWN ? HASH_ALL : HASH_BIT(algorithm));
+}
+
+void Hash::add_data(const uint8_t *data, size_t len) {
+    if (len == 0)
+        return;
+    if (active & HASH_BIT(Algorithm::MD5))
+        mbedtls_md5_update(&md5_ctx, data, len);
+    if (active & HASH_BIT(Algorithm::SHA1))
+        mbedtls_sha1_update(&sha1_ctx, data, len);
+    if (active & HASH_BIT(Algorithm::SHA256))
+        mbedtls_sha256_update(&sha256_ctx, data, len);
+    if (active & HASH_BIT(Algorithm::SHA512))
+        mbedtls_sha512_update(&sha512_ctx, data, len);
+}
+
 void Hash::add_data(const std::vector<uint8_t>& data) {
-    accumulated_data.insert(accumulated_data.end(), data.begin(), data.end());
+    add_data(data.data(), data.size());
 }
 
 void Hash::add_data(const std::string& data) {
-    accumulated_data.insert(accumulated_data.end(), data.begin(), data.end());
+    add_data(reinterpret_cast<const uint8_t *>(data.data()), data.size());
 }
 
 void Hash::clear() {
-    accumulated_data.clear();
+    start(HASH_ALL);
 }
 
 size_t Hash::hash_length(Algorithm algorithm, bool is_hex) const {
@@ -76,7 +119,16 @@ size_t Hash::hash_length(Algorithm algorithm, bool is_hex) const {
 
 void Hash::compute(Algorithm algorithm, bool clear_data) {
     hash_output.clear();
+    if (algorithm == Algorithm::UNKNOWN || !(active & HASH_BIT(algorithm))) {
+        if (clear_data) {
+            clear();
+        }
+        return;
+    }
     switch (algorithm) {
+        case Algorithm::MD5:
+            compute_md5();
+            break;
         case Algorithm::SHA1:
             compute_sha1();
             break;
@@ -102,11 +154,22 @@ std::string Hash::output_hex() const {
     return bytes_to_hex(hash_output);
 }
 
+// Each compute_* finishes a copy of the running context, so more data can
+// still be added afterwards when compute() is called without clearing.
+
+void Hash::compute_md5() {
+    mbedtls_md5_context ctx;
+    mbedtls_md5_init(&ctx);
+    mbedtls_md5_clone(&ctx, &md5_ctx);
+    hash_output.resize(16);
+    mbedtls_md5_finish(&ctx, hash_output.data());
+    mbedtls_md5_free(&ctx);
+}
+
 void Hash::compute_sha1() {
     mbedtls_sha1_context ctx;
     mbedtls_sha1_init(&ctx);
-    mbedtls_sha1_starts(&ctx);
-    mbedtls_sha1_update(&ctx, accumulated_data.data(), accumulated_data.size());
+    mbedtls_sha1_clone(&ctx, &sha1_ctx);
     hash_output.resize(20);
     mbedtls_sha1_finish(&ctx, hash_output.data());
     mbedtls_sha1_free(&ctx);
@@ -115,8 +178,7 @@ void Hash::compute_sha1() {
 void Hash::compute_sha256() {
     mbedtls_sha256_context ctx;
     mbedtls_sha256_init(&ctx);
-    mbedtls_sha256_starts(&ctx, 0);
-    mbedtls_sha256_update(&ctx, accumulated_data.data(), accumulated_data.size());
+    mbedtls_sha256_clone(&ctx, &sha256_ctx);
     hash_output.resize(32);
     mbedtls_sha256_finish(&ctx, hash_output.data());
     mbedtls_sha256_free(&ctx);
@@ -125,8 +187,7 @@ void Hash::compute_sha256() {
 void Hash::compute_sha512() {
     mbedtls_sha512_context ctx;
     mbedtls_sha512_init(&ctx);
-    mbedtls_sha512_starts(&ctx, 0);
-    mbedtls_sha512_update(&ctx, accumulated_data.data(), accumulated_data.size());
+    mbedtls_sha512_clone(&ctx, &sha512_ctx);
     hash_output.resize(64);
     mbedtls_sha512_finish(&ctx, hash_output.data());
     mbedtls_sha512_free(&ctx);
@@ -8,6 +8,14 @@
 #include <mbedtls/sha256.h>
 #include <mbedtls/sha512.h>
 
+/*
+ * Incremental hasher. Input is fed straight into the mbedtls contexts as
+ * it arrives, so memory use does not depend on the amount of data hashed.
+ *
+ * Because the bus protocol only names the algorithm at compute time, all
+ * algorithms are updated by default. Callers that know the algorithm up
+ * front (e.g. hashing a host file) can use begin() to update just one.
+ */
 class Hash {
 public:
     enum class Algorithm {
@@ -17,6 +25,8 @@ public:
     Hash();
     ~Hash();
 
+    void begin(Algorithm algorithm);
+    void add_data(const uint8_t *data, size_t len);
     void add_data(const std::vector<uint8_t>& data);
     void add_data(const std::string& data);
     void clear();
@@ -29,9 +39,18 @@ public:
     static Hash::Algorithm from_string(std::string hash_name);
 
 private:
-    std::vector<uint8_t> accumulated_data;
+    mbedtls_md5_context md5_ctx;
+    mbedtls_sha1_context sha1_ctx;
+    mbedtls_sha256_context sha256_ctx;
+    mbedtls_sha512_context sha512_ctx;
+
+    // Bit per Algorithm value, set for contexts currently being updated
+    uint8_t active = 0;
+
     std::vector<uint8_t> hash_output;
 
+    void start(uint8_t mask);
+    void compute_md5();
     void compute_sha1();
     void compute_sha256();
     void compute_sha512();
@@ -40,4 +59,4 @@ private:
 
 extern Hash hasher;
 
-#endif // HASH_H
\ No newline at end of file
+#endif // HASH_H
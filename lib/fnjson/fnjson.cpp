@@ -8,6 +8,7 @@
 #include "fnjson.h"
 
 #include <string.h>
+#include <algorithm>
 #include <sstream>
 #include <math.h>
 #include <iomanip>
@@ -59,6 +60,7 @@ void FNJSON::setProtocol(NetworkProtocol *newProtocol)
     Debug_printf("FNJSON::setProtocol()\r\n");
 #endif
     _protocol = newProtocol;
+    _streamQuery.clear();
 }
 
 void FNJSON::setQueryParam(uint8_t qp)
@@ -79,15 +81,158 @@ void FNJSON::setReadQuery(const std::string &queryString, uint8_t queryParam)
 #endif
     _queryString = queryString;
     _queryParam = queryParam;
+
     _item = resolveQuery();
+    _hasValue = _item != nullptr;
+    _value = _hasValue ? getValue(_item) : std::string();
     json_bytes_remaining = readValueLen();
 }
 
+/**
+ * Pointers of a query batch, merged where they share segments
+ */
+struct json_query_node
+{
+    std::string segment;
+    std::vector<size_t> queries; // Batch positions that end here
+    std::vector<json_query_node> children;
+};
+
+/**
+ * Resolve every pointer below node in one walk down from item
+ */
+static void resolveQueryNode(cJSON *item, const json_query_node &node, std::vector<cJSON *> &items)
+{
+    for (size_t q : node.queries)
+        items[q] = item;
+
+    if (node.children.empty())
+        return;
+
+    if (cJSON_IsArray(item))
+    {
+        // Go through the elements once, stopping at each wanted position
+        std::vector<std::pair<uint32_t, const json_query_node *>> wanted;
+        for (const json_query_node &child : node.children)
+        {
+            uint32_t index;
+            if (FNJSONStream::segment_index(child.segment, &index))
+                wanted.push_back({index, &child});
+        }
+        std::sort(wanted.begin(), wanted.end(),
+                  [](const std::pair<uint32_t, const json_query_node *> &a,
+                     const std::pair<uint32_t, const json_query_node *> &b) { return a.first < b.first; });
+
+        size_t w = 0;
+        uint32_t index = 0;
+        for (cJSON *element = item->child; element != nullptr && w < wanted.size(); element = element->next, index++)
+        {
+            for (; w < wanted.size() && wanted[w].first == index; w++)
+                resolveQueryNode(element, *wanted[w].second, items);
+        }
+    }
+    else if (cJSON_IsObject(item))
+    {
+        // Go through the members once; the first match of a key wins, as with cJSONUtils_GetPointer
+        std::vector<bool> matched(node.children.size(), false);
+        size_t remaining = node.children.size();
+        for (cJSON *element = item->child; element != nullptr && remaining > 0; element = element->next)
+        {
+            for (size_t c = 0; c < node.children.size(); c++)
+            {
+                if (!matched[c] && FNJSONStream::key_matches(node.children[c].segment, element->string))
+                {
+                    matched[c] = true;
+                    remaining--;
+                    resolveQueryNode(element, node.children[c], items);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Set several read queries at once. The value to read is the number of
+ * queries, then for each a 16 bit little endian length and the value as
+ * setReadQuery() would return it. Length 0 means nothing was found.
+ * @return false, with nothing to read, if the record would be larger than
+ * JSON_QUERIES_MAX_RECORD
+ */
+bool FNJSON::setReadQueries(const std::vector<std::string> &queries, uint8_t queryParam)
+{
+#ifdef VERBOSE_PROTOCOL
+    Debug_printf("FNJSON::setReadQueries %u queries, queryParam: %d\r\n", (unsigned)queries.size(), queryParam);
+#endif
+    _queryParam = queryParam;
+    _item = nullptr;
+
+    std::vector<cJSON *> items(queries.size(), nullptr);
+    if (!_streamQuery.empty())
+    {
+        // Only the streamed value was kept
+        for (size_t i = 0; i < queries.size(); i++)
+            if (queries[i] == _streamQuery)
+                items[i] = _json;
+    }
+    else if (_json != nullptr)
+    {
+        json_query_node root;
+        for (size_t i = 0; i < queries.size(); i++)
+        {
+            json_query_node *node = &root;
+            for (const std::string &segment : FNJSONStream::split_pointer(queries[i]))
+            {
+                auto child = std::find_if(node->children.begin(), node->children.end(),
+                                          [&segment](const json_query_node &n) { return n.segment == segment; });
+                if (child == node->children.end())
+                {
+                    node->children.push_back(json_query_node());
+                    node->children.back().segment = segment;
+                    child = node->children.end() - 1;
+                }
+                node = &*child;
+            }
+            node->queries.push_back(i);
+        }
+        resolveQueryNode(_json, root, items);
+    }
+
+    _value.assign(1, (char)queries.size());
+    for (cJSON *item : items)
+    {
+        std::string value = item != nullptr ? getValue(item) : std::string();
+        if (_value.size() + 2 + value.size() > JSON_QUERIES_MAX_RECORD)
+        {
+            Debug_printf("FNJSON::setReadQueries - values are over %u bytes\r\n", JSON_QUERIES_MAX_RECORD);
+            _value.clear();
+            _hasValue = false;
+            json_bytes_remaining = 0;
+            return false;
+        }
+        _value += (char)(value.size() & 0xFF);
+        _value += (char)(value.size() >> 8);
+        _value += value;
+    }
+    _hasValue = true;
+    json_bytes_remaining = _value.size();
+    return true;
+}
+
 /**
  * Resolve query string
  */
 cJSON *FNJSON::resolveQuery()
 {
+    if (!_streamQuery.empty())
+    {
+        // Only the streamed value was kept
+        if (_queryString == _streamQuery)
+            return _json;
+
+        Debug_printf("FNJSON::resolveQuery - only \"%s\" was kept while parsing\r\n", _streamQuery.c_str());
+        return nullptr;
+    }
+
     if (_queryString.empty())
         return _json;
 
@@ -261,10 +406,20 @@ std::string FNJSON::getValue(cJSON *item)
     else if (cJSON_IsArray(item))
     {
         cJSON *child = item->child;
-        do
+        if (child == NULL)
+        {
+#ifdef VERBOSE_PROTOCOL
+            Debug_printf("FNJSON::getValue ARRAY is empty, adding empty string\r\n");
+#endif
+            ss << lineEnding;
+        }
+        else
         {
-            ss << getValue(child);
-        } while ((child = child->next) != NULL);
+            do
+            {
+                ss << getValue(child);
+            } while ((child = child->next) != NULL);
+        }
     }
     else
         ss << "UNKNOWN" + lineEnding;
@@ -277,10 +432,10 @@ std::string FNJSON::getValue(cJSON *item)
  */
 bool FNJSON::readValue(uint8_t *rx_buf, unsigned short len)
 {    
-    if (_item == nullptr)
+    if (!_hasValue)
         return true; // error
 
-    memcpy(rx_buf, getValue(_item).data(), len);
+    memcpy(rx_buf, _value.data(), std::min((size_t)len, _value.size()));
 
     return false; // no error.
 }
@@ -290,16 +445,17 @@ bool FNJSON::readValue(uint8_t *rx_buf, unsigned short len)
  */
 int FNJSON::readValueLen()
 {
-    if (_item == nullptr)
+    if (!_hasValue)
         return 0;
 
-    return getValue(_item).size();
+    return _value.size();
 }
 
 /**
- * Parse data from protocol
+ * Parse data from protocol. With stream set, only the value the read query
+ * points to is kept, and other queries find nothing until the next parse.
  */
-bool FNJSON::parse()
+bool FNJSON::parse(bool stream)
 {
     NetworkStatus ns;
 
@@ -310,12 +466,23 @@ bool FNJSON::parse()
         _json = nullptr;
     }
 
+    // Any value from before was out of the old document
+    _item = nullptr;
+    _hasValue = false;
+    _value.clear();
+    _streamQuery.clear();
+
     if (_protocol == nullptr)
     {
         // Debug_printf("FNJSON::parse() - NULL protocol.\r\n");
         return false;
     }
-    _parseBuffer.clear();
+    bool streaming = stream && !_queryString.empty();
+    if (streaming)
+        _stream.begin(_queryString);
+    else
+        _parseBuffer.clear();
+
     _protocol->status(&ns);
 #ifdef VERBOSE_PROTOCOL
     Debug_printf("json parse, initial status: ns.rxBW: %d, ns.conn: %d, ns.err: %d\r\n", ns.rxBytesWaiting, ns.connected, ns.error);
@@ -331,7 +498,10 @@ bool FNJSON::parse()
         if (ns.rxBytesWaiting > 0)
         {
             _protocol->read(ns.rxBytesWaiting);
-            _parseBuffer += *_protocol->receiveBuffer;
+            if (streaming)
+                _stream.feed(_protocol->receiveBuffer->data(), _protocol->receiveBuffer->size());
+            else
+                _parseBuffer.append(_protocol->receiveBuffer->data(), _protocol->receiveBuffer->size());
             _protocol->receiveBuffer->clear();
         }
         _protocol->status(&ns);
@@ -340,6 +510,19 @@ bool FNJSON::parse()
 #endif
     }
 
+    if (streaming)
+    {
+        _streamQuery = _queryString;
+        bool valid = _stream.finish();
+        if (_stream.found())
+            _json = cJSON_Parse(_stream.value().c_str());
+        _stream.clear();
+#ifdef VERBOSE_PROTOCOL
+        Debug_printf("FNJSON::parse() - streamed for \"%s\", %s\r\n", _streamQuery.c_str(), _json != nullptr ? "found" : "not found");
+#endif
+        return valid;
+    }
+
     // Debug_printf("S: %s\r\n", _parseBuffer.c_str());
     // only try and parse the buffer if it has data. Empty response doesn't need parsing.
     if (!_parseBuffer.empty())
@@ -347,10 +530,13 @@ bool FNJSON::parse()
         _json = cJSON_Parse(_parseBuffer.c_str());
     }
 
+    // The tree has everything now, give the text back
+    std::string().swap(_parseBuffer);
+
     if (_json == nullptr)
     {
 #ifdef VERBOSE_PROTOCOL
-        Debug_printf("FNJSON::parse() - Could not parse JSON, parseBuffer length: %d\r\n", _parseBuffer.size());
+        Debug_printf("FNJSON::parse() - Could not parse JSON\r\n");
 #endif
         return false;
     }
@@ -11,8 +11,14 @@
 #include <cJSON.h>
 #include <cJSON_Utils.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 #include "../network-protocol/Protocol.h"
+#include "fnjsonstream.h"
+
+// Largest setReadQueries() record, so its size fits the 16 bit byte counts the buses use
+#define JSON_QUERIES_MAX_RECORD 0xFFFF
 
 class FNJSON
 {
@@ -23,10 +29,11 @@ public:
     void setLineEnding(const std::string &_lineEnding);
     void setProtocol(NetworkProtocol *newProtocol);
     void setReadQuery(const std::string &queryString, uint8_t queryParam);
+    bool setReadQueries(const std::vector<std::string> &queries, uint8_t queryParam);
     cJSON *resolveQuery();
     bool status(NetworkStatus *status);
     
-    bool parse();
+    bool parse(bool stream = false);
     int readValueLen();
     bool readValue(uint8_t *buf, unsigned short len);
     std::string processString(std::string in);
@@ -42,6 +49,18 @@ private:
     std::string lineEnding;
     std::string getValue(cJSON *item);
     std::string _parseBuffer;
+
+    // What readValue() returns for the last query, built once
+    std::string _value;
+    bool _hasValue = false;
+
+    /**
+     * parse(true) looks for the read query while the document streams in,
+     * and _json then holds only the value it points to. _streamQuery is that
+     * query, empty when the whole document was parsed.
+     */
+    FNJSONStream _stream;
+    std::string _streamQuery;
 };
 
 #endif /* JSON_H */
\ No newline at end of file
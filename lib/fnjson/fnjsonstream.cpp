@@ -0,0 +1,331 @@
+/**
+ * Streaming JSON pointer evaluator for #FujiNet
+ */
+
+#include "fnjsonstream.h"
+
+#include <ctype.h>
+#include <cJSON.h>
+
+#include "../../include/debug.h"
+
+// Same as cJSON's CJSON_NESTING_LIMIT
+#define JSON_STREAM_MAX_DEPTH 1000
+
+void FNJSONStream::begin(const std::string &pointer)
+{
+    clear();
+    _tokens = split_pointer(pointer);
+}
+
+void FNJSONStream::clear()
+{
+    std::vector<std::string>().swap(_tokens);
+    std::vector<frame>().swap(_stack);
+    std::string().swap(_key);
+    std::string().swap(_value);
+    _matched = 0;
+    _state = STATE_VALUE;
+    _escape = false;
+    _keep_key = false;
+    _capturing = false;
+    _capture_depth = 0;
+    _capture_from = nullptr;
+    _found = false;
+}
+
+std::vector<std::string> FNJSONStream::split_pointer(const std::string &pointer)
+{
+    std::vector<std::string> segments;
+    size_t pos = 0;
+
+    while (pos < pointer.size() && pointer[pos] == '/')
+    {
+        size_t next = pointer.find('/', pos + 1);
+        if (next == std::string::npos)
+            next = pointer.size();
+        segments.push_back(pointer.substr(pos + 1, next - pos - 1));
+        pos = next;
+    }
+    return segments;
+}
+
+bool FNJSONStream::key_matches(const std::string &segment, const char *key)
+{
+    size_t i = 0;
+
+    if (key == nullptr)
+        return false;
+
+    for (; *key != '\0' && i < segment.size(); key++, i++)
+    {
+        if (segment[i] == '~')
+        {
+            if (i + 1 >= segment.size() ||
+                !((segment[i + 1] == '0' && *key == '~') || (segment[i + 1] == '1' && *key == '/')))
+                return false;
+            i++;
+        }
+        else if (tolower((unsigned char)*key) != tolower((unsigned char)segment[i]))
+            return false;
+    }
+
+    return *key == '\0' && i == segment.size();
+}
+
+bool FNJSONStream::segment_index(const std::string &segment, uint32_t *index)
+{
+    if (segment.size() > 1 && segment[0] == '0')
+        return false;
+
+    uint64_t value = 0;
+    for (char c : segment)
+    {
+        if (c < '0' || c > '9' || value > UINT32_MAX)
+            return false;
+        value = value * 10 + (c - '0');
+    }
+    if (value > UINT32_MAX)
+        return false;
+
+    *index = value;
+    return true;
+}
+
+bool FNJSONStream::segment_matches_index(uint32_t index)
+{
+    uint32_t wanted;
+    return segment_index(_tokens[_stack.size() - 1], &wanted) && wanted == index;
+}
+
+/**
+ * The container on top of the stack moved on to a new element
+ */
+void FNJSONStream::enter_element(bool matches)
+{
+    size_t depth = _stack.size();
+
+    if (_matched + 1 >= depth)
+        _matched = matches ? depth : depth - 1;
+}
+
+void FNJSONStream::start_value(const char *p)
+{
+    if (!_capturing && _matched == _stack.size() && _stack.size() == _tokens.size())
+    {
+        _capturing = true;
+        _capture_depth = _stack.size();
+        _capture_from = p;
+    }
+}
+
+/**
+ * A value at the current depth ended just before p
+ */
+void FNJSONStream::end_value(const char *p)
+{
+    if (_capturing && _stack.size() == _capture_depth)
+    {
+        _value.append(_capture_from, p - _capture_from);
+        _capturing = false;
+        _found = true;
+        _state = STATE_DONE;
+        return;
+    }
+
+    _state = _stack.empty() ? STATE_DONE : STATE_NEXT;
+}
+
+void FNJSONStream::close_container(const char *p)
+{
+    _stack.pop_back();
+    if (_matched > _stack.size())
+        _matched = _stack.size();
+    end_value(p + 1);
+}
+
+bool FNJSONStream::feed(const char *data, size_t len)
+{
+    const char *end = data + len;
+
+    if (_capturing)
+        _capture_from = data;
+
+    const char *p = data;
+    while (p < end && _state != STATE_DONE)
+    {
+        char c = *p;
+        bool consumed = true;
+
+        switch (_state)
+        {
+        case STATE_STRING:
+            // Most of a document is string contents, so go through them in one loop
+            while (true)
+            {
+                if (_escape)
+                    _escape = false;
+                else if (c == '\\')
+                    _escape = true;
+                else if (c == '"')
+                {
+                    end_value(p + 1);
+                    break;
+                }
+                if (p + 1 == end)
+                    break;
+                c = *++p;
+            }
+            break;
+
+        case STATE_KEY_STRING:
+            if (_escape)
+                _escape = false;
+            else if (c == '\\')
+                _escape = true;
+            else if (c == '"')
+            {
+                if (_keep_key)
+                {
+                    // Only escaped keys need decoding, let cJSON do it
+                    if (_key.find('\\') != std::string::npos)
+                    {
+                        cJSON *decoded = cJSON_Parse(("\"" + _key + "\"").c_str());
+                        _key = decoded != nullptr ? cJSON_GetStringValue(decoded) : "";
+                        cJSON_Delete(decoded);
+                    }
+                    enter_element(key_matches(_tokens[_stack.size() - 1], _key.c_str()));
+                }
+                else
+                    enter_element(false);
+                _state = STATE_COLON;
+                break;
+            }
+            if (_keep_key)
+                _key += c;
+            break;
+
+        case STATE_SCALAR:
+            if (isalnum((unsigned char)c) || c == '-' || c == '+' || c == '.')
+                break;
+            end_value(p);
+            // The delimiter belongs to the container
+            consumed = false;
+            break;
+
+        default:
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+                break;
+
+            switch (_state)
+            {
+            case STATE_KEY_OR_END:
+            case STATE_KEY:
+                if (c == '}' && _state == STATE_KEY_OR_END)
+                    close_container(p);
+                else if (c == '"')
+                {
+                    size_t depth = _stack.size();
+                    _keep_key = depth <= _tokens.size() && _matched + 1 >= depth;
+                    _key.clear();
+                    _state = STATE_KEY_STRING;
+                }
+                else
+                    _state = STATE_ERROR;
+                break;
+
+            case STATE_COLON:
+                _state = c == ':' ? STATE_VALUE : STATE_ERROR;
+                break;
+
+            case STATE_NEXT:
+                if (c == ',')
+                {
+                    if (_stack.back().object)
+                        _state = STATE_KEY;
+                    else
+                    {
+                        _stack.back().index++;
+                        _state = STATE_VALUE;
+                    }
+                }
+                else if (c == (_stack.back().object ? '}' : ']'))
+                    close_container(p);
+                else
+                    _state = STATE_ERROR;
+                break;
+
+            case STATE_VALUE_OR_END:
+            case STATE_VALUE:
+                if (c == ']' && _state == STATE_VALUE_OR_END)
+                {
+                    close_container(p);
+                    break;
+                }
+
+                if (!_stack.empty() && !_stack.back().object)
+                {
+                    size_t depth = _stack.size();
+                    enter_element(depth <= _tokens.size() && _matched + 1 >= depth &&
+                                  segment_matches_index(_stack.back().index));
+                }
+
+                if (c == '{' || c == '[')
+                {
+                    if (_stack.size() >= JSON_STREAM_MAX_DEPTH)
+                    {
+                        _state = STATE_ERROR;
+                        break;
+                    }
+                    start_value(p);
+                    _stack.push_back({c == '{', 0});
+                    _state = c == '{' ? STATE_KEY_OR_END : STATE_VALUE_OR_END;
+                }
+                else if (c == '"')
+                {
+                    start_value(p);
+                    _state = STATE_STRING;
+                }
+                else if (c == '-' || isalnum((unsigned char)c))
+                {
+                    start_value(p);
+                    _state = STATE_SCALAR;
+                }
+                else
+                    _state = STATE_ERROR;
+                break;
+
+            default:
+                break;
+            }
+            break;
+        }
+
+        if (_state == STATE_ERROR)
+        {
+            Debug_printf("FNJSONStream::feed - unexpected '%c' in JSON\r\n", c);
+            return false;
+        }
+
+        if (consumed)
+            p++;
+    }
+
+    if (_capturing)
+        _value.append(_capture_from, end - _capture_from);
+
+    return true;
+}
+
+bool FNJSONStream::finish()
+{
+    // A number or literal at the top level ends with the input
+    if (_state == STATE_SCALAR && _stack.empty())
+    {
+        _found = _capturing;
+        _capturing = false;
+        _state = STATE_DONE;
+    }
+
+    return _found || _state == STATE_DONE;
+}
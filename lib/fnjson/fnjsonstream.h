@@ -0,0 +1,116 @@
+/**
+ * Streaming JSON pointer evaluator for #FujiNet
+ */
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Pulls the value at one JSON pointer out of a document fed in pieces as
+ * it arrives, without building a tree of the whole thing.
+ *
+ * The pointer works as with cJSONUtils_GetPointer: /key/0/key, ~0 for ~,
+ * ~1 for /, object keys matched case insensitively and the first of any
+ * duplicate keys used. The rest of the document is only tokenized to keep
+ * track of the current path, so what's kept in memory is the text of the
+ * matching value and a few bytes per nesting level. Once the value is
+ * complete the remaining input is ignored.
+ */
+class FNJSONStream
+{
+public:
+    /**
+     * Start a new document, looking for the value at pointer.
+     */
+    void begin(const std::string &pointer);
+
+    /**
+     * Feed the next len bytes of the document.
+     * @return false once the document is found to be malformed.
+     */
+    bool feed(const char *data, size_t len);
+
+    /**
+     * End of input.
+     * @return true if the value was found or the whole document was valid.
+     */
+    bool finish();
+
+    /**
+     * Free the kept value and the parse state.
+     */
+    void clear();
+
+    bool found() { return _found; }
+
+    /**
+     * JSON text of the matching value, once found() is true.
+     */
+    const std::string &value() { return _value; }
+
+    /**
+     * Split a pointer into its segments, still ~ escaped. Like
+     * cJSONUtils_GetPointer, anything not starting with / has none.
+     */
+    static std::vector<std::string> split_pointer(const std::string &pointer);
+
+    /**
+     * Compare an object key with a pointer segment, as cJSON's compare_pointers() does.
+     */
+    static bool key_matches(const std::string &segment, const char *key);
+
+    /**
+     * Array position named by a pointer segment: plain digits, no leading zero.
+     */
+    static bool segment_index(const std::string &segment, uint32_t *index);
+
+private:
+    enum parse_state
+    {
+        STATE_VALUE,        // a value is next
+        STATE_VALUE_OR_END, // first array element, or ]
+        STATE_KEY,          // object key after ,
+        STATE_KEY_OR_END,   // first object key, or }
+        STATE_COLON,
+        STATE_NEXT,         // , or the end of the container
+        STATE_STRING,
+        STATE_KEY_STRING,
+        STATE_SCALAR,       // number, true, false or null
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    struct frame
+    {
+        bool object;
+        uint32_t index; // current element, arrays only
+    };
+
+    std::vector<std::string> _tokens; // pointer segments, still ~ escaped
+    std::vector<frame> _stack;
+    size_t _matched = 0; // leading stack levels on the path to the pointer
+
+    parse_state _state = STATE_VALUE;
+    bool _escape = false;
+    bool _keep_key = false; // key could be the next path segment
+    std::string _key;
+
+    bool _capturing = false;
+    size_t _capture_depth = 0;
+    const char *_capture_from = nullptr; // start of the value in the current piece
+    bool _found = false;
+    std::string _value;
+
+    void enter_element(bool matches);
+    bool segment_matches_index(uint32_t index);
+    void start_value(const char *p);
+    void end_value(const char *p);
+    void close_container(const char *p);
+};
+
+#endif /* JSON_STREAM_H */
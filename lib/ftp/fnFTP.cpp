@@ -781,6 +781,21 @@ bool fnFTP::reconnect()
     return login(username, password, hostname, control_port);
 }
 
+bool fnFTP::noop()
+{
+    if (!control->connected())
+        return true;
+    // The server waits on the transfer before it answers
+    if (data->connected())
+        return false;
+
+    NOOP();
+    if (parse_response())
+        return true;
+
+    return !is_positive_completion_reply();
+}
+
 bool fnFTP::open_file(string path, bool stor)
 {
     if (!control->connected())
@@ -1196,6 +1211,11 @@ void fnFTP::QUIT()
     control->write("QUIT\r\n");
 }
 
+void fnFTP::NOOP()
+{
+    control->write("NOOP\r\n");
+}
+
 void fnFTP::EPSV()
 {
     Debug_printf("fnFTP::EPSV()\r\n");
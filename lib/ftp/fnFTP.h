@@ -120,6 +120,12 @@ public:
      */
     bool reconnect();
 
+    /**
+     * Check the control connection is still up, keeping it from timing out.
+     * @return TRUE on error, FALSE on success
+     */
+    bool noop();
+
 protected:
 private:
     /**
@@ -281,6 +287,11 @@ private:
      */
     void QUIT();
 
+    /**
+     * @brief Do nothing, but get a reply
+     */
+    void NOOP();
+
     /**
      * @brief Enter extended passive mode (RFC 2428)
      */
@@ -0,0 +1,403 @@
+#include "fujiCopy.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+#include "fnFsSD.h"
+#include "compat_string.h"
+#include "utils.h"
+
+#include "fujiHostSessions.h"
+
+// The filesystem clients run on these tasks
+#define COPY_TASK_STACKSIZE 8192
+#define COPY_TASK_PRIORITY 5
+
+fujiCopy fnCopy;
+
+fujiCopy::~fujiCopy()
+{
+    cancel();
+    wait();
+}
+
+/* Runs a task body on its own FreeRTOS task / thread
+   Returns false if it couldn't be started
+*/
+static bool _spawn(void (*fn)(void *), void *arg, const char *name)
+{
+#ifdef ESP_PLATFORM
+    if (xTaskCreate(fn, name, COPY_TASK_STACKSIZE, arg, COPY_TASK_PRIORITY, nullptr) != pdPASS)
+    {
+        Debug_printf("fujiCopy: could not start task %s\n", name);
+        return false;
+    }
+#else
+    std::thread(fn, arg).detach();
+#endif
+    return true;
+}
+
+/* A session to the host's server for the copy alone, or the SD card for a local host
+*/
+static FileSystem *_open_session(fujiHost *host, fujiHostType &type, char *hostname)
+{
+    type = host->get_type();
+    host->get_hostname(hostname, MAX_HOSTNAME_LEN);
+    if (type == HOSTTYPE_LOCAL)
+        return &fnSDFAT;
+    return fnHostSessions.acquire(type, hostname);
+}
+
+static void _close_session(FileSystem *fs, fujiHostType type, const char *hostname)
+{
+    if (fs != nullptr && !fs->is_global())
+        fnHostSessions.release(fs, type, hostname);
+}
+
+bool fujiCopy::open_sessions(fujiHost *src_host, fujiHost *dst_host)
+{
+    _src_fs = _open_session(src_host, _src_type, _src_hostname);
+    if (_src_fs == nullptr)
+        return false;
+
+    if (dst_host == src_host)
+    {
+        _dst_fs = _src_fs;
+        _dst_type = _src_type;
+        strlcpy(_dst_hostname, _src_hostname, sizeof(_dst_hostname));
+        return true;
+    }
+
+    _dst_fs = _open_session(dst_host, _dst_type, _dst_hostname);
+    if (_dst_fs == nullptr)
+    {
+        close_sessions();
+        return false;
+    }
+    return true;
+}
+
+void fujiCopy::close_sessions()
+{
+    if (_dst_fs != _src_fs)
+        _close_session(_dst_fs, _dst_type, _dst_hostname);
+    _close_session(_src_fs, _src_type, _src_hostname);
+    _src_fs = _dst_fs = nullptr;
+}
+
+void fujiCopy::_worker_task(void *arg)
+{
+    fujiCopy *c = (fujiCopy *)arg;
+
+    if (c->_buf[1] != nullptr)
+        c->run_overlapped();
+    else
+        c->run_single();
+
+#ifdef ESP_PLATFORM
+    vTaskDelete(nullptr);
+#endif
+}
+
+void fujiCopy::_reader_task(void *arg)
+{
+    ((fujiCopy *)arg)->reader();
+
+#ifdef ESP_PLATFORM
+    vTaskDelete(nullptr);
+#endif
+}
+
+bool fujiCopy::start(fujiHost *src_host, const char *src_path, fujiHost *dst_host, const char *dst_path)
+{
+    char src_full[256];
+
+    if (running())
+    {
+        Debug_println("fujiCopy: copy already in progress");
+        return false;
+    }
+
+    _state = COPY_STATE_IDLE;
+    _cancel = false;
+    _total = 0;
+    _done = 0;
+
+    if (src_host == nullptr || dst_host == nullptr || !src_host->mount() || !dst_host->mount())
+        return false;
+
+    if (!util_concat_paths(src_full, src_host->get_prefix(), src_path, sizeof(src_full)) ||
+        !util_concat_paths(_dst_path, dst_host->get_prefix(), dst_path, sizeof(_dst_path)))
+        return false;
+
+    if (!open_sessions(src_host, dst_host))
+        return false;
+
+    _src = _src_fs->fnfile_open(src_full, FILE_READ);
+    if (_src == nullptr)
+    {
+        close_sessions();
+        return false;
+    }
+
+    _dst = _dst_fs->fnfile_open(_dst_path, FILE_WRITE);
+    if (_dst == nullptr)
+    {
+        fnio::fclose(_src);
+        _src = nullptr;
+        close_sessions();
+        return false;
+    }
+
+    // Find the largest block we can get, two of them unless both ends share a session
+    bool overlap = _src_fs != _dst_fs;
+    for (_buf_size = COPY_BLOCK_MAX; _buf_size >= COPY_BLOCK_MIN; _buf_size /= 2)
+    {
+        _buf[0] = (uint8_t *)malloc(_buf_size);
+        _buf[1] = overlap ? (uint8_t *)malloc(_buf_size) : nullptr;
+        if (_buf[0] != nullptr && (_buf[1] != nullptr || !overlap))
+            break;
+        free(_buf[0]);
+        free(_buf[1]);
+        _buf[0] = _buf[1] = nullptr;
+    }
+
+    if (_buf[0] == nullptr)
+    {
+        Debug_println("fujiCopy: could not allocate copy buffers");
+        fnio::fclose(_src);
+        fnio::fclose(_dst);
+        _src = _dst = nullptr;
+        _dst_fs->remove(_dst_path);
+        close_sessions();
+        return false;
+    }
+
+    long size = FileSystem::filesize(_src);
+    _total = size > 0 ? (uint32_t)size : 0;
+    _read_total = 0;
+    _filled = 0;
+    _reader_done = false;
+    _read_error = false;
+
+    Debug_printf("fujiCopy: %s -> %s, %lu bytes, %u byte blocks%s\n", src_full, _dst_path,
+                 (unsigned long)_total, (unsigned)_buf_size, overlap ? ", overlapped" : "");
+
+    _state = COPY_STATE_RUNNING;
+    if (!_spawn(_worker_task, this, "fujicopy"))
+    {
+        finish(false);
+        return false;
+    }
+
+    return true;
+}
+
+/* Reads the next block from the source, growing the block size while reads are quick.
+   Returns bytes read, 0 at end of file. Sets _read_error on a short read before the expected end.
+*/
+size_t fujiCopy::read_block(uint8_t *buf, size_t &block)
+{
+    uint64_t t = fnSystem.millis();
+    size_t count = fnio::fread(buf, 1, block, _src);
+    uint64_t elapsed = fnSystem.millis() - t;
+
+    _read_total += count;
+
+    if (count < block && _total != 0 && _read_total != _total)
+    {
+        Debug_printf("fujiCopy: short read, %lu of %lu\n", (unsigned long)_read_total, (unsigned long)_total);
+        _read_error = true;
+        return 0;
+    }
+
+    if (count == block && elapsed < COPY_ADAPT_MS && block * 2 <= _buf_size)
+        block *= 2;
+
+    return count;
+}
+
+/* Same host on both ends: read and write alternately from one task
+*/
+void fujiCopy::run_single()
+{
+    size_t block = COPY_BLOCK_START < _buf_size ? COPY_BLOCK_START : _buf_size;
+    bool ok = true;
+
+    while (!_cancel)
+    {
+        size_t count = read_block(_buf[0], block);
+        if (_read_error)
+        {
+            ok = false;
+            break;
+        }
+        if (count == 0)
+            break;
+        if (fnio::fwrite(_buf[0], 1, count, _dst) != count)
+        {
+            ok = false;
+            break;
+        }
+        _done += count;
+    }
+
+    finish(ok && !_cancel);
+}
+
+/* Reader half of an overlapped copy, fills whichever buffer the writer has released
+*/
+void fujiCopy::reader()
+{
+    size_t block = COPY_BLOCK_START < _buf_size ? COPY_BLOCK_START : _buf_size;
+    int slot = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_m);
+            _cv.wait(lock, [this] { return _filled < 2 || _cancel; });
+            if (_cancel)
+                break;
+        }
+
+        size_t count = read_block(_buf[slot], block);
+        if (count == 0)
+            break;
+
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            _len[slot] = count;
+            _filled++;
+        }
+        _cv.notify_all();
+        slot ^= 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        _reader_done = true;
+    }
+    _cv.notify_all();
+}
+
+/* Writer half of an overlapped copy, runs on the worker task
+*/
+void fujiCopy::run_overlapped()
+{
+    bool write_error = false;
+    int slot = 0;
+
+    if (!_spawn(_reader_task, this, "fujicopy_rd"))
+    {
+        _read_error = true;
+        finish(false);
+        return;
+    }
+
+    while (true)
+    {
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(_m);
+            _cv.wait(lock, [this] { return _filled > 0 || _reader_done || _cancel; });
+            if (_filled == 0 || _cancel)
+                break;
+            count = _len[slot];
+        }
+
+        if (fnio::fwrite(_buf[slot], 1, count, _dst) != count)
+        {
+            write_error = true;
+            break;
+        }
+        _done += count;
+
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            _filled--;
+        }
+        _cv.notify_all();
+        slot ^= 1;
+    }
+
+    // Stop the reader and wait for it to let go of the buffers
+    bool cancelled = _cancel;
+    {
+        std::unique_lock<std::mutex> lock(_m);
+        _cancel = true;
+        _cv.notify_all();
+        _cv.wait(lock, [this] { return _reader_done; });
+    }
+    _cancel = cancelled;
+
+    finish(!write_error && !_read_error && !cancelled);
+}
+
+void fujiCopy::finish(bool ok)
+{
+    fnio::fclose(_src);
+    fnio::fclose(_dst);
+    _src = _dst = nullptr;
+
+    // Don't leave a partial file behind
+    if (!ok)
+        _dst_fs->remove(_dst_path);
+    close_sessions();
+
+    free(_buf[0]);
+    free(_buf[1]);
+    _buf[0] = _buf[1] = nullptr;
+
+    Debug_printf("fujiCopy: %s, %lu of %lu bytes\n", ok ? "done" : (_cancel ? "cancelled" : "failed"),
+                 (unsigned long)_done, (unsigned long)_total);
+
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        _state = ok ? COPY_STATE_DONE : (_cancel ? COPY_STATE_CANCELLED : COPY_STATE_ERROR);
+    }
+    _cv.notify_all();
+}
+
+bool fujiCopy::wait()
+{
+    std::unique_lock<std::mutex> lock(_m);
+    _cv.wait(lock, [this] { return _state != COPY_STATE_RUNNING; });
+    return _state == COPY_STATE_DONE;
+}
+
+void fujiCopy::cancel()
+{
+    if (!running())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        _cancel = true;
+    }
+    _cv.notify_all();
+}
+
+void fujiCopy::get_status(fujiCopyStatus *status)
+{
+    uint32_t total = _total;
+    uint32_t done = _done;
+
+    status->state = _state;
+    status->bytes_total = total;
+    status->bytes_done = done;
+    if (_state == COPY_STATE_DONE)
+        status->percent = 100;
+    else
+        status->percent = total ? (uint8_t)((uint64_t)done * 100 / total) : 0;
+}
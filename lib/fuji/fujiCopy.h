@@ -0,0 +1,113 @@
+#ifndef _FUJI_COPY_
+#define _FUJI_COPY_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include "fujiHost.h"
+
+/*
+ * Background file copy between host slots, shared by the fuji devices.
+ *
+ * The source is read by one task while the previous block is written to
+ * the destination by another, through two buffers. Block size starts
+ * small and doubles while reads keep completing quickly.
+ *
+ * The filesystem clients are not safe for concurrent use, so the copy
+ * takes sessions of its own from fnHostSessions rather than sharing the
+ * ones the host slots' mounted disks read through. When source and
+ * destination are the same host slot they share one session, and the
+ * copy runs in a single task.
+ */
+
+#ifdef ESP_PLATFORM
+#define COPY_BLOCK_MAX 16384
+#else
+#define COPY_BLOCK_MAX 65536
+#endif
+#define COPY_BLOCK_MIN 512
+#define COPY_BLOCK_START 4096
+// Keep growing the block size while a read takes less than this
+#define COPY_ADAPT_MS 100
+
+enum fujiCopyState
+{
+    COPY_STATE_IDLE = 0,
+    COPY_STATE_RUNNING,
+    COPY_STATE_DONE,
+    COPY_STATE_ERROR,
+    COPY_STATE_CANCELLED,
+};
+
+// Status as sent to the host computer, little-endian
+struct fujiCopyStatus
+{
+    uint8_t state;
+    uint8_t percent;
+    uint32_t bytes_total;
+    uint32_t bytes_done;
+} __attribute__((packed));
+
+class fujiCopy
+{
+private:
+    FileSystem *_src_fs = nullptr;
+    FileSystem *_dst_fs = nullptr;
+    fujiHostType _src_type = HOSTTYPE_UNINITIALIZED;
+    fujiHostType _dst_type = HOSTTYPE_UNINITIALIZED;
+    char _src_hostname[MAX_HOSTNAME_LEN] = { '\0' };
+    char _dst_hostname[MAX_HOSTNAME_LEN] = { '\0' };
+    fnFile *_src = nullptr;
+    fnFile *_dst = nullptr;
+    char _dst_path[256] = { '\0' };
+
+    uint8_t *_buf[2] = { nullptr, nullptr };
+    size_t _buf_size = 0;
+    size_t _len[2] = { 0, 0 };
+    int _filled = 0;      // buffers holding data not yet written
+    bool _reader_done = false;
+    bool _read_error = false;
+    uint32_t _read_total = 0; // only touched by the reading task
+
+    std::mutex _m;
+    std::condition_variable _cv;
+
+    std::atomic<uint8_t> _state{COPY_STATE_IDLE};
+    std::atomic<bool> _cancel{false};
+    std::atomic<uint32_t> _total{0};
+    std::atomic<uint32_t> _done{0};
+
+    bool open_sessions(fujiHost *src_host, fujiHost *dst_host);
+    void close_sessions();
+    size_t read_block(uint8_t *buf, size_t &block);
+    void run_single();
+    void run_overlapped();
+    void reader();
+    void finish(bool ok);
+
+    static void _worker_task(void *arg);
+    static void _reader_task(void *arg);
+
+public:
+    ~fujiCopy();
+
+    // Opens both files and starts copying in the background.
+    // Paths are relative to the host prefix. Returns false if nothing was started.
+    bool start(fujiHost *src_host, const char *src_path, fujiHost *dst_host, const char *dst_path);
+
+    // Blocks until the current copy ends. Returns true if it completed.
+    bool wait();
+
+    void cancel();
+
+    bool running() { return _state == COPY_STATE_RUNNING; };
+
+    fujiCopyState state() { return (fujiCopyState)_state.load(); };
+    void get_status(fujiCopyStatus *status);
+};
+
+extern fujiCopy fnCopy;
+
+#endif // _FUJI_COPY_
@@ -0,0 +1,121 @@
+#include "fujiDirPage.h"
+
+#include <cstring>
+#include "compat_string.h"
+
+#include "../../include/debug.h"
+
+#include "utils.h"
+
+int fujiDirPage::format_entry(fsdir_entry_t *f, char *dest, int bufsize, uint8_t maxlen,
+                              fujiDirDetailsFn details, int details_len, bool ellipsize)
+{
+    char *name = dest;
+
+    if (details != nullptr)
+    {
+        details(f, (uint8_t *)dest, maxlen);
+        name = dest + details_len;
+    }
+    else
+        details_len = 0;
+
+    // Directories keep a byte for the slash at the end
+    int namesize = f->isDir && bufsize > 1 ? bufsize - 1 : bufsize;
+    int filelen = ellipsize ? util_ellipsize(f->filename, name, namesize)
+                            : strlcpy(name, f->filename, namesize);
+    if (filelen >= namesize)
+        filelen = namesize > 0 ? namesize - 1 : 0;
+
+    if (namesize < bufsize)
+    {
+        name[filelen++] = '/';
+        name[filelen] = '\0';
+    }
+
+    return details_len + filelen;
+}
+
+uint8_t *fujiDirPage::render_block(fujiHost &host, uint16_t size, uint8_t maxlen,
+                                   fujiDirDetailsFn details, int details_len)
+{
+    if (size > FUJI_DIR_BLOCK_MAX)
+        size = FUJI_DIR_BLOCK_MAX;
+
+    // Entries go in right after the header and are moved up past the offsets once the count is known
+    uint8_t *data = _block + FUJI_DIR_BLOCK_HEADER;
+    uint16_t offsets[FUJI_DIR_BLOCK_ENTRIES];
+    uint16_t data_len = 0;
+    int num_entries = 0;
+    char entry[256];
+
+    uint16_t initial_pos = host.dir_tell();
+
+    while (num_entries < FUJI_DIR_BLOCK_ENTRIES)
+    {
+        fsdir_entry_t *f = host.dir_nextfile();
+        int len;
+        if (f == nullptr)
+        {
+            // End of directory, double 0x7F
+            entry[0] = 0x7F;
+            entry[1] = 0x7F;
+            len = 2;
+        }
+        else
+            len = format_entry(f, entry, details != nullptr ? sizeof(entry) - details_len : maxlen,
+                               maxlen, details, details_len);
+
+        if (FUJI_DIR_BLOCK_HEADER + 2 * (num_entries + 1) + data_len + len > size)
+        {
+            // Leave it for the next block
+            if (f != nullptr)
+                host.dir_seek(initial_pos + num_entries);
+            break;
+        }
+
+        offsets[num_entries++] = data_len;
+        memcpy(data + data_len, entry, len);
+        data_len += len;
+
+        if (f == nullptr)
+            break;
+    }
+
+    // ###################################################################
+    // byte 0-1 = "MF" (Multi-File, take your pick :D )
+    // byte 2   = Flags (currently 0x80 = Extended Information)
+    // byte 3   = Max Size Per Entry (maxlen from input)
+    // byte 4   = Num Entries in block (max 255)
+    // byte 5-6 = Total size of block (i.e. size without padding)
+    // byte 7-8 = First Position in block (i.e. dir pos value at start), allows up to 64k entries over all blocks
+    // Num Entries x 2 = Offsets in Data for each entry
+    // Data x Num Entries = data for each dir.
+    //
+    // All above is < pages x 256 in size
+    // ###################################################################
+    uint16_t offsets_len = num_entries * 2;
+    memmove(data + offsets_len, data, data_len);
+    for (int i = 0; i < num_entries; i++)
+    {
+        data[i * 2] = offsets[i] & 0xFF;
+        data[i * 2 + 1] = (offsets[i] >> 8) & 0xFF;
+    }
+
+    uint16_t total = FUJI_DIR_BLOCK_HEADER + offsets_len + data_len;
+    _block[0] = 'M';
+    _block[1] = 'F';
+    _block[2] = details != nullptr ? 0x80 : 0;
+    _block[3] = maxlen;
+    _block[4] = num_entries;
+    _block[5] = total & 0xFF;
+    _block[6] = (total >> 8) & 0xFF;
+    _block[7] = initial_pos & 0xFF;
+    _block[8] = (initial_pos >> 8) & 0xFF;
+
+    memset(_block + total, 0, size - total);
+
+    Debug_printf("Directory block: %d entries, %hu of %hu bytes\n", num_entries, total, size);
+
+    return _block;
+}
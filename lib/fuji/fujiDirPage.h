@@ -0,0 +1,52 @@
+#ifndef _FUJI_DIR_PAGE_
+#define _FUJI_DIR_PAGE_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fujiHost.h"
+
+/*
+ * Renders directory listings for the fuji devices.
+ *
+ * format_entry() produces one entry the way READ DIRECTORY ENTRY returns
+ * it: optional extended details, the ellipsized name and a trailing slash
+ * for directories. The details differ between buses, so each device passes
+ * its own writer and the number of bytes it writes. Anything a bus adds on
+ * top, such as file type glyphs, is left to the device.
+ *
+ * render_block() fills a whole multi-entry "MF" block from the open
+ * directory in one pass, straight into a fixed buffer. The position is
+ * read once at the start and only set again if an entry didn't fit.
+ */
+
+#define FUJI_DIR_BLOCK_MAX 2048 // 8 pages of 256
+#define FUJI_DIR_BLOCK_HEADER 9
+#define FUJI_DIR_BLOCK_ENTRIES 255 // Entry count is a single byte
+
+// Writes the bus specific extended details for an entry at dest
+typedef void (*fujiDirDetailsFn)(fsdir_entry_t *f, uint8_t *dest, uint8_t maxlen);
+
+class fujiDirPage
+{
+private:
+    uint8_t _block[FUJI_DIR_BLOCK_MAX];
+
+public:
+    /*
+     * Formats f into dest, NUL terminated. The name gets bufsize bytes after the details,
+     * a directory's slash included. It is ellipsized to fit, or just cut short if ellipsize
+     * is false. Returns the length of the entry, details included, without the terminator.
+     */
+    static int format_entry(fsdir_entry_t *f, char *dest, int bufsize, uint8_t maxlen,
+                            fujiDirDetailsFn details, int details_len, bool ellipsize = true);
+
+    /*
+     * Fills the block with as many entries from the host's open directory as fit in
+     * size bytes (up to FUJI_DIR_BLOCK_MAX), zero padded to size. Returns the block.
+     */
+    uint8_t *render_block(fujiHost &host, uint16_t size, uint8_t maxlen,
+                          fujiDirDetailsFn details, int details_len);
+};
+
+#endif // _FUJI_DIR_PAGE_
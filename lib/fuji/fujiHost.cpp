@@ -11,6 +11,7 @@
 #include "fnFsFTP.h"
 #include "fnFsHTTP.h"
 
+#include "fujiHostSessions.h"
 #include "utils.h"
 
 void fujiHost::unmount()
@@ -22,12 +23,14 @@ void fujiHost::unmount()
 */
 void fujiHost::cleanup()
 {
+    // Hand the filesystem back to be kept warm if it's not one of the global ones
     if (_fs != nullptr)
-        _fs->dir_close();
-
-    // Delete the filesystem if it's not one of the global ones
-    if (_fs->is_global() == false)
-        delete _fs;
+    {
+        if (_fs->is_global())
+            _fs->dir_close();
+        else
+            fnHostSessions.release(_fs, _type, _hostname);
+    }
 
     _fs = nullptr;
 
@@ -245,7 +248,10 @@ fnFile * fujiHost::fnfile_open(const char *path, char *fullpath, int fullpathlen
     }
     Debug_printf("fujiHost #%d opening file path \"%s\"\n", slotid, fullpath);
 
-    return _fs->fnfile_open(fullpath, mode);
+    if (_fs->is_global())
+        return _fs->fnfile_open(fullpath, mode);
+    // Keeps the session from being handed on while the file is open
+    return fnHostSessions.file_open(_fs, fullpath, mode);
 }
 
 /* Remove a file from the host
@@ -334,153 +340,54 @@ int fujiHost::unmount_local()
     return 0;
 }
 
-/* Returns:
+/* Mount a session of the given type to _hostname, reusing a warm one if there is one
+   Returns:
     0 on success
    -1 on failure
 */
-int fujiHost::mount_tnfs()
+int fujiHost::mount_session(fujiHostType type)
 {
-    Debug_printf("::mount_tnfs {%d:%d} \"%s\"\n", slotid, _type, _hostname);
-
     // Don't do anything if that's already what's set
-    if (_type == HOSTTYPE_TNFS)
+    if (_type == type)
     {
         if (_fs != nullptr && _fs->running())
         {
-            Debug_printf("::mount_tnfs Currently connected to host \"%s\"\n", _hostname);
+            Debug_printf("::mount_session Currently connected to \"%s\"\n", _hostname);
             return 0;
         }
+        // Connection was lost while mounted
+        fnHostSessions.discard(_fs, _hostname);
+        _fs = nullptr;
     }
     else
-        set_type(HOSTTYPE_TNFS); // Only start fresh if not HOSTTYPE_TNFS
+        set_type(type); // Only start fresh if not already this type
 
-    _fs = new FileSystemTNFS;
-
-    if (_fs == nullptr)
-    {
-        Debug_println("Couldn't create a new FileSystemTNFS in fujiHost::mount_tnfs!");
-    }
-    else
-    {
-        Debug_printf("Starting FileSystemTNFS(\"%s\")\n", _hostname);
-        if (((FileSystemTNFS *)_fs)->start(_hostname))
-        {
-            return 0;
-        }
-    }
+    _fs = fnHostSessions.acquire(type, _hostname);
+    return _fs != nullptr ? 0 : -1;
+}
 
-    return -1;
+int fujiHost::mount_tnfs()
+{
+    Debug_printf("::mount_tnfs {%d:%d} \"%s\"\n", slotid, _type, _hostname);
+    return mount_session(HOSTTYPE_TNFS);
 }
 
 int fujiHost::mount_smb()
 {
     Debug_printf("::mount_smb {%d:%d} \"%s\"\n", slotid, _type, _hostname);
-
-    // Don't do anything if that's already what's set
-    if (_type == HOSTTYPE_SMB)
-    {
-        if (_fs != nullptr && _fs->running())
-        {
-            Debug_printf("::mount_smb Currently connected to share \"%s\"\n", _hostname);
-            return 0;
-        }
-    }
-    else
-        set_type(HOSTTYPE_SMB); // Only start fresh if not HOSTTYPE_SMB
-
-    _fs = new FileSystemSMB;
-
-    if (_fs == nullptr)
-    {
-        Debug_println("Couldn't create a new FileSystemSMB in fujiHost::mount_smb!");
-    }
-    else
-    {
-        Debug_printf("Starting FileSystemSMB(\"%s\")\n", _hostname);
-        // ensure URL starts with lowercase 'smb'
-        char url[MAX_HOSTNAME_LEN];
-        strcpy(url, _hostname);
-        url[0] = 's';
-        url[1] = 'm';
-        url[2] = 'b';
-
-        if (((FileSystemSMB *)_fs)->start(url))
-        {
-            return 0;
-        }
-    }
-
-    return -1;
+    return mount_session(HOSTTYPE_SMB);
 }
 
 int fujiHost::mount_ftp()
 {
     Debug_printf("::mount_ftp {%d:%d} \"%s\"\n", slotid, _type, _hostname);
-
-    // Don't do anything if that's already what's set
-    if (_type == HOSTTYPE_FTP)
-    {
-        if (_fs != nullptr && _fs->running())
-        {
-            Debug_printf("::mount_ftp Currently connected to host \"%s\"\n", _hostname);
-            return 0;
-        }
-    }
-    else
-        set_type(HOSTTYPE_FTP); // Only start fresh if not HOSTTYPE_FTP
-
-    _fs = new FileSystemFTP;
-
-    if (_fs == nullptr)
-    {
-        Debug_println("Couldn't create a new FileSystemFTP in fujiHost::mount_ftp!");
-    }
-    else
-    {
-        Debug_printf("Starting FileSystemFTP(\"%s\")\n", _hostname);
-
-        if (((FileSystemFTP *)_fs)->start(_hostname))
-        {
-            return 0;
-        }
-    }
-
-    return -1;
+    return mount_session(HOSTTYPE_FTP);
 }
 
 int fujiHost::mount_http()
 {
     Debug_printf("::mount_http {%d:%d} \"%s\"\n", slotid, _type, _hostname);
-
-    // Don't do anything if that's already what's set
-    if (_type == HOSTTYPE_HTTP)
-    {
-        if (_fs != nullptr && _fs->running())
-        {
-            Debug_printf("::mount_http Currently connected to \"%s\"\n", _hostname);
-            return 0;
-        }
-    }
-    else
-        set_type(HOSTTYPE_HTTP); // Only start fresh if not HOSTTYPE_HTTP
-
-    _fs = new FileSystemHTTP;
-
-    if (_fs == nullptr)
-    {
-        Debug_println("Couldn't create a new FileSystemHTTP in fujiHost::mount_http!");
-    }
-    else
-    {
-        Debug_printf("Starting FileSystemHTTP(\"%s\")\n", _hostname);
-
-        if (((FileSystemHTTP *)_fs)->start(_hostname))
-        {
-            return 0;
-        }
-    }
-
-    return -1;
+    return mount_session(HOSTTYPE_HTTP);
 }
 
 int fujiHost::unmount_fs()
@@ -489,7 +396,7 @@ int fujiHost::unmount_fs()
 
     if (_fs != nullptr)
     {
-        delete _fs;
+        fnHostSessions.release(_fs, _type, _hostname);
         _fs = nullptr;
     }
 
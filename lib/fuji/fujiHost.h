@@ -29,6 +29,7 @@ private:
     void unmount();
 
     int mount_local();
+    int mount_session(fujiHostType type);
     int mount_tnfs();
     int mount_smb();
     int mount_ftp();
@@ -0,0 +1,515 @@
+#include "fujiHostSessions.h"
+
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+#include "compat_string.h"
+
+#include "../../include/debug.h"
+
+#include "fnSystem.h"
+#include "fnFsTNFS.h"
+#include "fnFsSMB.h"
+#include "fnFsFTP.h"
+#include "fnFsHTTP.h"
+
+#define SESSION_TASK_STACKSIZE 8192
+#define SESSION_TASK_PRIORITY 4
+
+fujiHostSessions fnHostSessions;
+
+#ifndef FNIO_IS_STDIO
+/**
+ * @brief File opened through a host slot, counted against its session until it's closed
+ */
+class FileHandlerSession : public FileHandler
+{
+private:
+    FileHandler *_fh;
+    FileSystem *_fs;
+
+public:
+    FileHandlerSession(FileHandler *fh, FileSystem *fs) : _fh(fh), _fs(fs) {}
+    virtual ~FileHandlerSession() override { if (_fh != nullptr) close(false); }
+
+    virtual int close(bool destroy=true) override;
+    virtual int seek(long int off, int whence) override { return _fh->seek(off, whence); }
+    virtual long int tell() override { return _fh->tell(); }
+    virtual size_t read(void *ptr, size_t size, size_t n) override { return _fh->read(ptr, size, n); }
+    virtual size_t write(const void *ptr, size_t size, size_t n) override { return _fh->write(ptr, size, n); }
+    virtual int flush() override { return _fh->flush(); }
+    virtual int eof() override { return _fh->eof(); }
+};
+
+int FileHandlerSession::close(bool destroy)
+{
+    int result = 0;
+    if (_fh != nullptr)
+    {
+        result = _fh->close();
+        _fh = nullptr;
+        fnHostSessions.file_closed(_fs);
+    }
+    if (destroy) delete this;
+    return result;
+}
+#endif
+
+/* Start a new session, timing how long it takes
+*/
+FileSystem *fujiHostSessions::connect(fujiHostType type, const char *hostname)
+{
+    FileSystem *fs = nullptr;
+    bool started = false;
+    uint64_t start = fnSystem.millis();
+
+    switch (type)
+    {
+    case HOSTTYPE_TNFS:
+    {
+        FileSystemTNFS *tnfs = new FileSystemTNFS;
+        started = tnfs->start(hostname);
+        fs = tnfs;
+        break;
+    }
+    case HOSTTYPE_SMB:
+    {
+        // ensure URL starts with lowercase 'smb'
+        char url[MAX_HOSTNAME_LEN];
+        strlcpy(url, hostname, sizeof(url));
+        url[0] = 's';
+        url[1] = 'm';
+        url[2] = 'b';
+        FileSystemSMB *smb = new FileSystemSMB;
+        started = smb->start(url);
+        fs = smb;
+        break;
+    }
+    case HOSTTYPE_FTP:
+    {
+        FileSystemFTP *ftp = new FileSystemFTP;
+        started = ftp->start(hostname);
+        fs = ftp;
+        break;
+    }
+    case HOSTTYPE_HTTP:
+    {
+        FileSystemHTTP *http = new FileSystemHTTP;
+        started = http->start(hostname);
+        fs = http;
+        break;
+    }
+    default:
+        return nullptr;
+    }
+
+    uint32_t elapsed = (uint32_t)(fnSystem.millis() - start);
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        fujiHostSessionStats *st = stats_for(hostname);
+        if (started)
+        {
+            st->connects++;
+            st->last_ms = elapsed;
+            st->total_ms += elapsed;
+            if (st->connects == 1 || elapsed < st->min_ms)
+                st->min_ms = elapsed;
+            if (elapsed > st->max_ms)
+                st->max_ms = elapsed;
+            Debug_printf("fujiHostSessions: connected to \"%s\" in %u ms (avg %u ms over %u)\n",
+                         hostname, elapsed, st->total_ms / st->connects, st->connects);
+        }
+        else
+        {
+            st->failures++;
+            Debug_printf("fujiHostSessions: failed to connect to \"%s\" after %u ms\n", hostname, elapsed);
+        }
+    }
+
+    if (!started)
+    {
+        delete fs;
+        return nullptr;
+    }
+    return fs;
+}
+
+/* Take the session released longest ago out of the cache, for the caller to delete
+*/
+FileSystem *fujiHostSessions::evict_oldest()
+{
+    session *oldest = nullptr;
+    for (int i = 0; i < HOST_SESSIONS_MAX; i++)
+    {
+        session &s = _idle[i];
+        if (s.fs != nullptr && !s.busy && (oldest == nullptr || s.released < oldest->released))
+            oldest = &s;
+    }
+    if (oldest == nullptr)
+        return nullptr;
+
+    Debug_printf("fujiHostSessions: closing \"%s\" to make room\n", oldest->hostname);
+    FileSystem *fs = oldest->fs;
+    oldest->fs = nullptr;
+    return fs;
+}
+
+/* Stats entry for hostname, replacing the least used if it's new. Called with _m held.
+*/
+fujiHostSessionStats *fujiHostSessions::stats_for(const char *hostname)
+{
+    fujiHostSessionStats *least = &_stats[0];
+    for (int i = 0; i < HOST_SESSIONS_STATS_MAX; i++)
+    {
+        fujiHostSessionStats *st = &_stats[i];
+        if (st->hostname[0] != '\0' && 0 == strcasecmp(st->hostname, hostname))
+            return st;
+        if (st->connects + st->reuses < least->connects + least->reuses)
+            least = st;
+    }
+    memset(least, 0, sizeof(*least));
+    strlcpy(least->hostname, hostname, sizeof(least->hostname));
+    return least;
+}
+
+/* Open files entry for fs, nullptr if it has none. Called with _m held.
+*/
+fujiHostSessions::open_session *fujiHostSessions::find_open(FileSystem *fs)
+{
+    for (open_session &o : _open)
+    {
+        if (o.fs == fs)
+            return &o;
+    }
+    return nullptr;
+}
+
+FileSystem *fujiHostSessions::acquire(fujiHostType type, const char *hostname)
+{
+    FileSystem *fs = nullptr;
+    FileSystem *dead = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        for (int i = 0; i < HOST_SESSIONS_MAX && fs == nullptr; i++)
+        {
+            session &s = _idle[i];
+            // One being checked is left to the keep-alive task, a fresh one is quicker than waiting
+            if (s.fs == nullptr || s.busy || s.type != type || 0 != strcasecmp(s.hostname, hostname))
+                continue;
+            fs = s.fs;
+            s.fs = nullptr;
+        }
+
+        if (fs != nullptr && !fs->running())
+        {
+            dead = fs;
+            fs = nullptr;
+        }
+        if (fs != nullptr)
+        {
+            stats_for(hostname)->reuses++;
+            Debug_printf("fujiHostSessions: reusing session to \"%s\"\n", hostname);
+        }
+    }
+    delete dead;
+    if (fs != nullptr)
+        return fs;
+
+    fs = connect(type, hostname);
+    if (fs == nullptr)
+    {
+        // Sessions not mounted may be holding what a new one needs; try again without one
+        FileSystem *old;
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            old = evict_oldest();
+        }
+        if (old != nullptr)
+        {
+            delete old;
+            fs = connect(type, hostname);
+        }
+    }
+    return fs;
+}
+
+void fujiHostSessions::release(FileSystem *fs, fujiHostType type, const char *hostname)
+{
+    if (fs == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        open_session *o = find_open(fs);
+        if (o != nullptr)
+        {
+            // Kept or closed when the last file is
+            Debug_printf("fujiHostSessions: \"%s\" released with %d files open\n", hostname, o->files);
+            o->released = true;
+            o->type = type;
+            strlcpy(o->hostname, hostname, sizeof(o->hostname));
+            return;
+        }
+    }
+    keep(fs, type, hostname);
+}
+
+/* Put fs in the cache for the next mount, if it's still running and there's room
+*/
+void fujiHostSessions::keep(FileSystem *fs, fujiHostType type, const char *hostname)
+{
+    fs->dir_close();
+    bool keepable = fs->running() && type != HOSTTYPE_UNINITIALIZED && type != HOSTTYPE_LOCAL && hostname[0] != '\0';
+#ifdef FNIO_IS_STDIO
+    // Files opened through it can't be counted, so it may still be in use
+    keepable = false;
+#endif
+    if (!keepable)
+    {
+        delete fs;
+        return;
+    }
+
+    FileSystem *old = nullptr;
+    bool start_task = false;
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        session *free_slot = nullptr;
+        for (int i = 0; i < HOST_SESSIONS_MAX && free_slot == nullptr; i++)
+        {
+            if (_idle[i].fs == nullptr && !_idle[i].busy)
+                free_slot = &_idle[i];
+        }
+        if (free_slot == nullptr)
+        {
+            old = evict_oldest();
+            for (int i = 0; i < HOST_SESSIONS_MAX && free_slot == nullptr; i++)
+            {
+                if (_idle[i].fs == nullptr && !_idle[i].busy)
+                    free_slot = &_idle[i];
+            }
+        }
+
+        if (free_slot != nullptr)
+        {
+            free_slot->fs = fs;
+            free_slot->type = type;
+            strlcpy(free_slot->hostname, hostname, sizeof(free_slot->hostname));
+            free_slot->released = fnSystem.millis();
+            free_slot->checked = free_slot->released;
+            fs = nullptr;
+            Debug_printf("fujiHostSessions: keeping session to \"%s\"\n", hostname);
+        }
+
+        start_task = !_task_started;
+        _task_started = true;
+    }
+    // Nowhere to keep it
+    delete fs;
+    delete old;
+
+    if (start_task)
+    {
+#ifdef ESP_PLATFORM
+        xTaskCreate(_keep_alive_task, "hostsessions", SESSION_TASK_STACKSIZE, this, SESSION_TASK_PRIORITY, nullptr);
+#else
+        std::thread(_keep_alive_task, this).detach();
+#endif
+    }
+}
+
+void fujiHostSessions::discard(FileSystem *fs, const char *hostname)
+{
+    if (fs == nullptr)
+        return;
+
+    Debug_printf("fujiHostSessions: session to \"%s\" is gone\n", hostname);
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        stats_for(hostname)->drops++;
+        open_session *o = find_open(fs);
+        if (o != nullptr)
+        {
+            // The open files still point into it
+            o->discarded = true;
+            return;
+        }
+    }
+    delete fs;
+}
+
+fnFile *fujiHostSessions::file_open(FileSystem *fs, const char *path, const char *mode)
+{
+#ifdef FNIO_IS_STDIO
+    return fs->fnfile_open(path, mode);
+#else
+    FileHandler *fh = fs->filehandler_open(path, mode);
+    if (fh == nullptr)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(_m);
+    open_session *o = find_open(fs);
+    if (o != nullptr)
+        o->files++;
+    else
+        _open.push_back({fs, 1, false, false, HOSTTYPE_UNINITIALIZED, ""});
+    return new FileHandlerSession(fh, fs);
+#endif
+}
+
+void fujiHostSessions::file_closed(FileSystem *fs)
+{
+    bool released = false;
+    bool discarded = false;
+    fujiHostType type = HOSTTYPE_UNINITIALIZED;
+    char hostname[MAX_HOSTNAME_LEN];
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        open_session *o = find_open(fs);
+        if (o == nullptr || --o->files > 0)
+            return;
+        released = o->released;
+        discarded = o->discarded;
+        type = o->type;
+        strlcpy(hostname, o->hostname, sizeof(hostname));
+        _open.erase(_open.begin() + (o - _open.data()));
+    }
+
+    if (discarded)
+        delete fs;
+    else if (released)
+        keep(fs, type, hostname);
+    // Otherwise it's still mounted and carries on as it is
+}
+
+/* Close sessions idle too long, and check the others, starting again any found dead
+*/
+void fujiHostSessions::keep_alive_pass()
+{
+    FileSystem *expired[HOST_SESSIONS_MAX] = { nullptr };
+    session *check[HOST_SESSIONS_MAX] = { nullptr };
+    int nexpired = 0;
+    int ncheck = 0;
+    uint64_t now = fnSystem.millis();
+
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        for (int i = 0; i < HOST_SESSIONS_MAX; i++)
+        {
+            session &s = _idle[i];
+            if (s.fs == nullptr || s.busy)
+                continue;
+            if (now - s.released >= HOST_SESSION_IDLE_MS)
+            {
+                Debug_printf("fujiHostSessions: closing idle session to \"%s\"\n", s.hostname);
+                expired[nexpired++] = s.fs;
+                s.fs = nullptr;
+            }
+            else if (now - s.checked >= HOST_SESSION_KEEPALIVE_MS)
+            {
+                s.busy = true;
+                check[ncheck++] = &s;
+            }
+        }
+    }
+
+    for (int i = 0; i < nexpired; i++)
+        delete expired[i];
+
+    // Only this task touches a busy session
+    for (int i = 0; i < ncheck; i++)
+    {
+        session &s = *check[i];
+        bool alive = s.fs->keep_alive();
+
+        FileSystem *dead = nullptr;
+        fujiHostType type = s.type;
+        char hostname[MAX_HOSTNAME_LEN];
+        strlcpy(hostname, s.hostname, sizeof(hostname));
+        {
+            std::lock_guard<std::mutex> lock(_m);
+            if (!alive)
+            {
+                dead = s.fs;
+                s.fs = nullptr;
+            }
+            s.checked = fnSystem.millis();
+            s.busy = false;
+        }
+
+        if (dead != nullptr)
+        {
+            discard(dead, hostname);
+            // Started again out of the cache so it's ready for the next mount
+            release(connect(type, hostname), type, hostname);
+        }
+    }
+}
+
+void fujiHostSessions::_keep_alive_task(void *arg)
+{
+    fujiHostSessions *sessions = (fujiHostSessions *)arg;
+
+    while (true)
+    {
+        fnSystem.delay(HOST_SESSION_KEEPALIVE_MS / 6);
+        sessions->keep_alive_pass();
+    }
+}
+
+bool fujiHostSessions::get_stats(const char *hostname, fujiHostSessionStats *stats)
+{
+    std::lock_guard<std::mutex> lock(_m);
+    for (int i = 0; i < HOST_SESSIONS_STATS_MAX; i++)
+    {
+        if (_stats[i].hostname[0] != '\0' && 0 == strcasecmp(_stats[i].hostname, hostname))
+        {
+            *stats = _stats[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+fujiHostSessionStats fujiHostSessions::get_totals()
+{
+    fujiHostSessionStats totals = {};
+    std::lock_guard<std::mutex> lock(_m);
+    for (int i = 0; i < HOST_SESSIONS_STATS_MAX; i++)
+    {
+        fujiHostSessionStats &st = _stats[i];
+        if (st.hostname[0] == '\0')
+            continue;
+        if (st.connects > 0 && (totals.connects == 0 || st.min_ms < totals.min_ms))
+            totals.min_ms = st.min_ms;
+        if (st.max_ms > totals.max_ms)
+            totals.max_ms = st.max_ms;
+        totals.connects += st.connects;
+        totals.failures += st.failures;
+        totals.reuses += st.reuses;
+        totals.drops += st.drops;
+        totals.total_ms += st.total_ms;
+    }
+    return totals;
+}
+
+void fujiHostSessions::report()
+{
+    std::lock_guard<std::mutex> lock(_m);
+    Debug_println("fujiHostSessions: host, connects/failures/reuses/drops, connect ms last/min/avg/max");
+    for (int i = 0; i < HOST_SESSIONS_STATS_MAX; i++)
+    {
+        fujiHostSessionStats &st = _stats[i];
+        if (st.hostname[0] == '\0')
+            continue;
+        Debug_printf("  \"%s\" %u/%u/%u/%u %u/%u/%u/%u\n", st.hostname,
+                     st.connects, st.failures, st.reuses, st.drops,
+                     st.last_ms, st.min_ms, st.connects ? st.total_ms / st.connects : 0, st.max_ms);
+    }
+}
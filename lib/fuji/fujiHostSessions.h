@@ -0,0 +1,121 @@
+#ifndef _FUJI_HOST_SESSIONS_
+#define _FUJI_HOST_SESSIONS_
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "fujiHost.h"
+
+/*
+ * Filesystem sessions kept warm between host slot mounts.
+ *
+ * A host slot unmounting hands its started filesystem back here instead of
+ * deleting it, and the next mount of the same host takes it back without
+ * another DNS lookup, connect and login. Sessions nobody has mounted are
+ * checked by a background task every so often with FileSystem::keep_alive(),
+ * which also stops the server timing them out; one found dead is started
+ * again there so it's ready when wanted. Sessions idle too long are closed.
+ *
+ * Only sessions no host slot has mounted are touched by the task, since the
+ * filesystem clients are not safe for concurrent use. A mount never waits
+ * for a check, it connects afresh instead.
+ *
+ * Files opened through a host slot are counted against their session. One
+ * released or discarded with files still open, e.g. a mounted disk image,
+ * isn't kept, checked, handed out or closed until the last of them is
+ * closed. With stdio files there's no telling when that is, so sessions
+ * aren't kept at all.
+ */
+
+#ifdef ESP_PLATFORM
+// Each TNFS session holds one of the few VFS registrations
+#define HOST_SESSIONS_MAX 4
+#else
+#define HOST_SESSIONS_MAX 8
+#endif
+#define HOST_SESSIONS_STATS_MAX 16
+// How often sessions not mounted are checked
+#define HOST_SESSION_KEEPALIVE_MS 30000
+// Sessions not mounted for this long are closed
+#define HOST_SESSION_IDLE_MS 600000
+
+struct fujiHostSessionStats
+{
+    char hostname[MAX_HOSTNAME_LEN];
+    uint32_t connects;  // sessions started
+    uint32_t failures;  // sessions that couldn't be started
+    uint32_t reuses;    // mounts given a warm session
+    uint32_t drops;     // sessions found dead
+    uint32_t last_ms;   // connect time
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;
+};
+
+class fujiHostSessions
+{
+private:
+    struct session
+    {
+        FileSystem *fs = nullptr;
+        fujiHostType type = HOSTTYPE_UNINITIALIZED;
+        char hostname[MAX_HOSTNAME_LEN] = { '\0' };
+        uint64_t released = 0;   // ms
+        uint64_t checked = 0;    // ms, last keep-alive
+        bool busy = false;       // keep-alive in progress
+    };
+
+    // A filesystem with files open, and what's to become of it once they're closed
+    struct open_session
+    {
+        FileSystem *fs;
+        int files;
+        bool released;
+        bool discarded;
+        fujiHostType type;
+        char hostname[MAX_HOSTNAME_LEN];
+    };
+
+    session _idle[HOST_SESSIONS_MAX];
+    std::vector<open_session> _open;
+    fujiHostSessionStats _stats[HOST_SESSIONS_STATS_MAX] = {};
+
+    std::mutex _m; // Guards everything above
+    bool _task_started = false;
+
+    FileSystem *connect(fujiHostType type, const char *hostname);
+    FileSystem *evict_oldest();
+    open_session *find_open(FileSystem *fs);
+    void keep(FileSystem *fs, fujiHostType type, const char *hostname);
+    fujiHostSessionStats *stats_for(const char *hostname);
+    void keep_alive_pass();
+
+    static void _keep_alive_task(void *arg);
+
+public:
+    // A started filesystem for hostname, the warm one if there is one.
+    // nullptr if it couldn't be started.
+    FileSystem *acquire(fujiHostType type, const char *hostname);
+
+    // The host slot is done with fs; it's kept for the next mount if still running
+    void release(FileSystem *fs, fujiHostType type, const char *hostname);
+
+    // fs stopped working while mounted
+    void discard(FileSystem *fs, const char *hostname);
+
+    // Open path on fs, counted against the session until it's closed
+    fnFile *file_open(FileSystem *fs, const char *path, const char *mode);
+    // A file opened with file_open() on fs was closed
+    void file_closed(FileSystem *fs);
+
+    // Connect times and counts for hostname. False if it's never been mounted.
+    bool get_stats(const char *hostname, fujiHostSessionStats *stats);
+    // Counts summed over every host, connect times over all connects
+    fujiHostSessionStats get_totals();
+    void report();
+};
+
+extern fujiHostSessions fnHostSessions;
+
+#endif // _FUJI_HOST_SESSIONS_
@@ -9,8 +9,10 @@
 #include "fnConfig.h"
 #include "fnWiFi.h"
 #include "fsFlash.h"
+#include "fnFileCache.h"
 #include "httpService.h"
 #include "fuji.h"
+#include "fujiHostSessions.h"
 
 using namespace std;
 
@@ -133,6 +135,9 @@ const string fnHttpServiceParser::substitute_tag(const string &tag)
         FN_CPM_CCP,
         FN_ALT_CFG,
         FN_PCLINK_ENABLED,
+        FN_DISK_CACHE_STATS,
+        FN_FILECACHE_STATS,
+        FN_HOST_SESSION_STATS,
         FN_LASTTAG
     };
 
@@ -251,6 +256,9 @@ const string fnHttpServiceParser::substitute_tag(const string &tag)
         "FN_CPM_CCP",
         "FN_ALT_CFG",
         "FN_PCLINK_ENABLED",
+        "FN_DISK_CACHE_STATS",
+        "FN_FILECACHE_STATS",
+        "FN_HOST_SESSION_STATS",
     };
 
     stringstream resultstream;
@@ -350,7 +358,53 @@ const string fnHttpServiceParser::substitute_tag(const string &tag)
     case FN_PCLINK_ENABLED:
         resultstream << Config.get_pclink_enabled();
         break;
+    case FN_DISK_CACHE_STATS:
+        {
+            // Totals over all mounted images
+            uint32_t hits = 0, misses = 0, fills = 0, size = 0;
+            for (int i = 0; i < MAX_DISK_DEVICES; i++)
+            {
+                MediaType *media = theFuji.get_disks(i)->disk_dev.media();
+                if (media == nullptr)
+                    continue;
+                const media_cache_stats &st = media->cache_stats();
+                hits += st.hits;
+                misses += st.misses;
+                fills += st.fills;
+                size += st.size;
+            }
+            if (size == 0)
+                resultstream << "off";
+            else
+                resultstream << hits << " hits, " << misses << " misses ("
+                             << (hits + misses ? hits * 100ULL / (hits + misses) : 0) << "%), "
+                             << fills << " reads, " << size / 1024 << " KB";
+        }
+        break;
 #endif /* BUILD_ATARI */
+    case FN_FILECACHE_STATS:
+#ifndef FNIO_IS_STDIO
+        {
+            fc_stats st = FileCache::get_stats();
+            resultstream << st.hits << " hits, " << st.misses << " misses ("
+                         << (st.hits + st.misses ? st.hits * 100ULL / (st.hits + st.misses) : 0) << "%), "
+                         << st.stale << " stale, " << st.evictions << " evicted, "
+                         << st.bytes_used / 1024 << " KB used";
+        }
+#else
+        resultstream << "off";
+#endif
+        break;
+    case FN_HOST_SESSION_STATS:
+        {
+            fujiHostSessionStats st = fnHostSessions.get_totals();
+            resultstream << st.reuses << " reused, " << st.connects << " connected ("
+                         << (st.reuses + st.connects ? st.reuses * 100ULL / (st.reuses + st.connects) : 0) << "%), "
+                         << st.failures << " failed, " << st.drops << " dropped, connect "
+                         << (st.connects ? st.total_ms / st.connects : 0) << " ms avg, "
+                         << st.max_ms << " ms max";
+        }
+        break;
 
     case FN_ROTATION_SOUNDS:
         resultstream << Config.get_general_rotation_sounds();
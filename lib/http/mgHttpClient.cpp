@@ -913,9 +913,10 @@ int mgHttpClient::HEAD()
 // Existing connection will be closed if this is a different host
 bool mgHttpClient::set_url(const char *url)
 {
-    if (_handle == nullptr)
+    if (_handle == nullptr || url == nullptr)
         return false;
 
+    _url = url;
     return true;
 }
 
@@ -4,6 +4,8 @@
 #include "esp_heap_caps.h"
 #endif
 #include "mediaTypeDSK.h"
+#include "trackCache.h"
+#include "fnSystem.h"
 #include "../../include/debug.h"
 #include <string.h>
 
@@ -16,22 +18,38 @@
 
 #define BYTES_PER_TRACK 4096
 #define BYTES_PER_SECTOR 256
+#define SECTORS_PER_TRACK 16 // FIXME - what about 13 sector disks?
 
 // routines to convert DSK to WOZ stolen from DSK2WOZ by Tom Harte 
 // https://github.com/TomHarte/dsk2woz
 
 // forward reference
 static void serialise_track(uint8_t *dest, const uint8_t *src, uint8_t track_number, bool is_prodos);
+static void encode_6_and_2(uint8_t *dest, const uint8_t *src);
 
-bool MediaTypeDSK::write_sector(int qtrack, int sector, uint8_t *buffer)
+MediaTypeDSK::~MediaTypeDSK()
+{
+  unmount();
+}
+
+int MediaTypeDSK::logical_sector(int physical_sector)
 {
-  size_t offset, size;
-  size_t sectors_per_track = 16; // FIXME - what about 13 sector disks?
-  uint8_t *trackbuf;
-  int track = tmap[qtrack];
   const int phys2log[] = {0, 7, 14, 6, 13, 5, 12, 4, 11, 3, 10, 2, 9, 1, 8, 15};
   const int prodos[] = {0, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 15};
 
+  int sector = phys2log[physical_sector];
+  if (_mediatype == MEDIATYPE_PO)
+    sector = prodos[sector];
+  return sector;
+}
+
+/* Sector writes go into the nibblized track in the cache straight away, and to the
+   image file when the drive has been idle for _write_back_ms, another track is
+   written or the image is unmounted
+*/
+bool MediaTypeDSK::write_sector(int qtrack, int sector, uint8_t *buffer)
+{
+  int track = tmap[qtrack];
 
   if (_mediatype != MEDIATYPE_DO &&
       _mediatype != MEDIATYPE_DSK &&
@@ -39,42 +57,135 @@ bool MediaTypeDSK::write_sector(int qtrack, int sector, uint8_t *buffer)
     Debug_printf("\r\nDon't know how to write sector");
     return true;
   }
+  if (track == 255 || sector < 0 || sector >= SECTORS_PER_TRACK)
+    return true;
 
-  sector = phys2log[sector];
-  if (_mediatype == MEDIATYPE_PO)
-    sector = prodos[sector];
+  int physical_sector = sector;
+  sector = logical_sector(physical_sector);
 
   Debug_printf("\r\nDSK writing track %i sector %i ", track, sector);
 
-  offset = (track * sectors_per_track + sector) * BYTES_PER_SECTOR;
-  if (fnio::fseek(_media_fileh, offset, SEEK_SET) != 0)
-    return true;
-  size = fnio::fwrite(buffer, 1, BYTES_PER_SECTOR, _media_fileh);
-  if (size != BYTES_PER_SECTOR)
-    return true;
+  std::lock_guard<std::recursive_mutex> lock(_dsk_mutex);
 
-  offset = track * sectors_per_track * BYTES_PER_SECTOR;
-  if (fnio::fseek(_media_fileh, offset, SEEK_SET) != 0)
+  if (_wb_track != track && flush() == false)
     return true;
 
-  size = sectors_per_track * BYTES_PER_SECTOR;
-  trackbuf = (uint8_t *) malloc(size);
-  if (!trackbuf)
-    return true;
+  memcpy(&_wb_data[sector * BYTES_PER_SECTOR], buffer, BYTES_PER_SECTOR);
+  _wb_track = track;
+  _wb_dirty |= 1 << sector;
+  _wb_last_write = fnSystem.millis();
+
+  // Patch the track the drive reads from, if it's loaded; otherwise it's built
+  // from the held sectors when it is
+  uint8_t *bits = wozTrackCache.find(this, track);
+  if (bits != nullptr)
+    dsk_nibblize_sector(bits, buffer, physical_sector);
 
-  offset = fnio::fread(trackbuf, 1, size, _media_fileh);
-  if (offset != size)
+  if (_write_back_ms == 0)
+    return !flush();
+  return false;
+}
+
+/* Writes held sectors to the image, one write per run of consecutive sectors.
+   Returns false on error.
+*/
+bool MediaTypeDSK::flush()
+{
+  std::lock_guard<std::recursive_mutex> lock(_dsk_mutex);
+
+  if (_wb_dirty == 0)
     return true;
 
-  offset = sector * BYTES_PER_SECTOR;
-  memcpy(&trackbuf[offset], buffer, BYTES_PER_SECTOR);
+  bool ok = true;
+  uint16_t written = 0;
+  int s = 0;
+  while (s < SECTORS_PER_TRACK)
+  {
+    if ((_wb_dirty & (1 << s)) == 0)
+    {
+      s++;
+      continue;
+    }
+    int run = 1;
+    while (s + run < SECTORS_PER_TRACK && (_wb_dirty & (1 << (s + run))))
+      run++;
+
+    size_t offset = (_wb_track * SECTORS_PER_TRACK + s) * BYTES_PER_SECTOR;
+    size_t len = run * BYTES_PER_SECTOR;
+    if (fnio::fseek(_media_fileh, offset, SEEK_SET) != 0 ||
+        fnio::fwrite(&_wb_data[s * BYTES_PER_SECTOR], 1, len, _media_fileh) != len)
+    {
+      Debug_printf("\r\nDSK error writing track %i sectors %i-%i", _wb_track, s, s + run - 1);
+      ok = false;
+    }
+    else
+      written |= ((1 << run) - 1) << s;
+    s += run;
+  }
 
-  memset(trk_ptrs[track], 0, WOZ1_NUM_BLKS * 512);
-  serialise_track(trk_ptrs[track], trackbuf, track, _mediatype == MEDIATYPE_PO);
+  // Sectors that didn't make it stay held for the next try
+  if (fnio::fflush(_media_fileh) != 0)
+  {
+    Debug_printf("\r\nDSK error flushing track %i", _wb_track);
+    return false;
+  }
 
-  free(trackbuf);
+  Debug_printf("\r\nDSK flushed track %i, sectors 0x%04x", _wb_track, written);
+  _wb_dirty &= ~written;
+  return ok;
+}
 
-  return false;
+void MediaTypeDSK::idle()
+{
+  // On failure wait another _write_back_ms before trying again
+  if (_wb_dirty != 0 && fnSystem.millis() - _wb_last_write >= _write_back_ms && !flush())
+    _wb_last_write = fnSystem.millis();
+}
+
+/* Nibblizes a track from the image, including any sectors not written to it yet
+*/
+bool MediaTypeDSK::read_track(uint8_t trk, uint8_t *buf, size_t size)
+{
+  std::lock_guard<std::recursive_mutex> lock(_dsk_mutex);
+
+  if (_media_fileh == nullptr || trk >= num_tracks || size < WOZ1_NUM_BLKS * 512)
+    return false;
+
+  if (fnio::fseek(_media_fileh, trk * BYTES_PER_TRACK, SEEK_SET) != 0 ||
+      fnio::fread(_track_data, 1, BYTES_PER_TRACK, _media_fileh) != BYTES_PER_TRACK)
+  {
+    Debug_printf("\nError reading track %d", trk);
+    return false;
+  }
+
+  if (_wb_track == trk && _wb_dirty != 0)
+  {
+    for (int s = 0; s < SECTORS_PER_TRACK; s++)
+      if (_wb_dirty & (1 << s))
+        memcpy(&_track_data[s * BYTES_PER_SECTOR], &_wb_data[s * BYTES_PER_SECTOR], BYTES_PER_SECTOR);
+  }
+
+  dsk_nibblize_track(buf, _track_data, trk, _mediatype == MEDIATYPE_PO);
+  trks[trk].bit_count = buf[WOZ1_TRACK_LEN + 2] | (buf[WOZ1_TRACK_LEN + 3] << 8);
+  return true;
+}
+
+/* Patches sectors written while the track was being loaded, which
+   write_sector() couldn't find in the cache yet
+*/
+void MediaTypeDSK::track_loaded(uint8_t trk, uint8_t *buf)
+{
+  std::lock_guard<std::recursive_mutex> lock(_dsk_mutex);
+
+  if (_wb_track != trk || _wb_dirty == 0)
+    return;
+
+  for (int p = 0; p < SECTORS_PER_TRACK; p++)
+  {
+    int s = logical_sector(p);
+    if (_wb_dirty & (1 << s))
+      dsk_nibblize_sector(buf, &_wb_data[s * BYTES_PER_SECTOR], p);
+  }
 }
 
 mediatype_t MediaTypeDSK::mount(fnFile *f, uint32_t disksize)
@@ -94,27 +205,38 @@ mediatype_t MediaTypeDSK::mount(fnFile *f, uint32_t disksize)
     diskiiemulation = true;
     num_tracks = disksize / BYTES_PER_TRACK;
 
-    // allocated SPRAM
-    const size_t dsk_image_size = num_tracks * BYTES_PER_TRACK;
-#ifdef ESP_PLATFORM
-    uint8_t *dsk = (uint8_t*)heap_caps_malloc(dsk_image_size, MALLOC_CAP_SPIRAM);
-#else
-	uint8_t *dsk = (uint8_t*)malloc(dsk_image_size);
-#endif
-    if (fnio::fseek(f, 0, SEEK_SET) != 0)
-        return MEDIATYPE_UNKNOWN;
-    size_t bytes_read = fnio::fread(dsk, 1, dsk_image_size, f);
-    if (bytes_read != dsk_image_size)
+    _track_data = (uint8_t *)malloc(BYTES_PER_TRACK);
+    _wb_data = (uint8_t *)malloc(BYTES_PER_TRACK);
+    if (_track_data == nullptr || _wb_data == nullptr)
         return MEDIATYPE_UNKNOWN;
 
     dsk2woz_info();
     dsk2woz_tmap();
-	dsk2woz_tracks(dsk);
+    if (dsk2woz_tracks())
+        return MEDIATYPE_UNKNOWN;
 
-    free(dsk);
     return MEDIATYPE_WOZ;
 }
 
+void MediaTypeDSK::unmount()
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock(_dsk_mutex);
+        if (_media_fileh != nullptr && !flush())
+            Debug_printf("\r\nDSK lost sectors 0x%04x of track %i", _wb_dirty, _wb_track);
+        _wb_track = -1;
+        _wb_dirty = 0;
+    }
+
+    // Stops track loads before the buffers go
+    MediaTypeWOZ::unmount();
+
+    free(_track_data);
+    _track_data = nullptr;
+    free(_wb_data);
+    _wb_data = nullptr;
+}
+
 void MediaTypeDSK::dsk2woz_info()
 {
 	optimal_bit_timing = WOZ1_BIT_TIME; // 4 us
@@ -149,58 +271,48 @@ void MediaTypeDSK::dsk2woz_tmap()
 #endif
 }
 
-bool MediaTypeDSK::dsk2woz_tracks(uint8_t *dsk)
-{    // depend upon little endian-ness
-
-    // woz1 track data organized as:
-    // Offset	Size	    Name	        Usage
-    // +0	    6646 bytes  Bitstream	    The bitstream data padded out to 6646 bytes
-    // +6646	uint16	    Bytes Used	    The actual byte count for the bitstream.
-    // +6648	uint16	    Bit Count	    The number of bits in the bitstream.
-    // +6650	uint16	    Splice Point	Index of first bit after track splice (write hint). If no splice information is provided, then will be 0xFFFF.
-    // +6652	uint8	    Splice Nibble	Nibble value to use for splice (write hint).
-    // +6653	uint8	    Splice Bit Count	Bit count of splice nibble (write hint).
-    // +6654	uint16		Reserved for future use.
-
-    // Debug_printf("\nStart Block, Block Count, Bit Count");
-    
+bool MediaTypeDSK::dsk2woz_tracks()
+{
 	Debug_printf("\nMediaTypeDSK is_prodos: %s", _mediatype == MEDIATYPE_PO ? "Y" : "N");
 
-	// TODO: adapt this to that
-	// Write out all tracks.
+	// Tracks are nibblized as the head gets to them, see read_track()
+	memset(trks, 0, sizeof(trks));
 	for (size_t c = 0; c < num_tracks; c++)
+		trks[c].block_count = WOZ1_NUM_BLKS;
+
+	return !wozTrackCache.attach(this);
+}
+
+/*
+	Builds a whole track in WOZ1 TRKS layout: the bitstream padded to 6646 bytes,
+	followed by its byte and bit counts.
+*/
+void dsk_nibblize_track(uint8_t *dest, const uint8_t *src, uint8_t track_number, bool is_prodos)
+{
+	memset(dest, 0, WOZ1_NUM_BLKS * 512);
+	serialise_track(dest, src, track_number, is_prodos);
+}
+
+/*
+	Writes the 343 data nibbles of one sector over those already in a track, which
+	are at a fixed position since every sector has the same layout.
+*/
+void dsk_nibblize_sector(uint8_t *dest, const uint8_t *src, int physical_sector)
+{
+	uint8_t contents[343];
+	encode_6_and_2(contents, src);
+
+	size_t position = DSK_GAP1_BITS + physical_sector * DSK_SECTOR_BITS + DSK_SECTOR_DATA_BITS;
+	const size_t shift = position & 7;
+	uint8_t *p = dest + (position >> 3);
+	const uint8_t keep = shift ? (uint8_t)(0xff << (8 - shift)) : 0;
+
+	for (size_t c = 0; c < sizeof(contents); c++, p++)
 	{
-		uint16_t bytes_used;
-		uint16_t bit_count;
-#ifdef ESP_PLATFORM
-		uint8_t* temp_ptr = (uint8_t *)heap_caps_malloc(WOZ1_NUM_BLKS * 512, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-#else
-		uint8_t* temp_ptr = (uint8_t *)malloc(WOZ1_NUM_BLKS * 512);
-#endif
-		if (temp_ptr != nullptr)
-		{
-			trk_ptrs[c] = temp_ptr;
-			memset(trk_ptrs[c], 0, WOZ1_NUM_BLKS * 512);
-			serialise_track(trk_ptrs[c], &dsk[c * 16 * 256], c, _mediatype == MEDIATYPE_PO);
-			temp_ptr += WOZ1_TRACK_LEN;
-			bytes_used = temp_ptr[0] + (temp_ptr[1] << 8);
-			temp_ptr += sizeof(uint16_t);
-			bit_count = temp_ptr[0] + (temp_ptr[1] << 8);
-			trks[c].block_count = WOZ1_NUM_BLKS; //bytes_used / 512;
-			// if (bytes_used % 512)
-			// 	trks[c].block_count++;
-			trks[c].bit_count = bit_count;
-			Debug_printf("\nStored %d bytes containing %d bits of track %d into location %hhn", bytes_used, bit_count, c, trk_ptrs[c]);
-			Debug_printf(" -- %02x %02x %02x %02x %02x", trk_ptrs[c][0], trk_ptrs[c][1], trk_ptrs[c][2], trk_ptrs[c][3], trk_ptrs[c][4] );
-		}
-		else
-		{
-			Debug_printf("\nNo RAM allocated!");
-			free(temp_ptr);
-			return true;
-            }
+		p[0] = (p[0] & keep) | (contents[c] >> shift);
+		if (shift)
+			p[1] = (p[1] & ~keep) | (uint8_t)(contents[c] << (8 - shift));
 	}
-	return false;
 }
 
 // ================ code below from TomHarte dsk2woz program ===============
@@ -2,6 +2,9 @@
 #define _MEDIATYPE_DSK_
 
 #include <stdio.h>
+#include <stdint.h>
+
+#include <mutex>
 
 #include "mediaTypeWOZ.h"
 
@@ -14,22 +17,54 @@
 //     uint32_t bit_count;
 // };
 
+// Layout of a track as built by dsk_nibblize_track(), in bits
+#define DSK_GAP1_BITS (16 * 10)
+#define DSK_SECTOR_BITS (14 * 8 + 7 * 10 + 349 * 8 + 16 * 10) // address field, gap 2, data field, gap 3
+#define DSK_SECTOR_DATA_BITS (14 * 8 + 7 * 10 + 3 * 8) // start of the 343 data nibbles in a sector
+
 extern uint16_t decode_6_and_2(uint8_t *dest, const uint8_t *src);
 
+// Builds the WOZ1 style bitstream (WOZ1_NUM_BLKS * 512 bytes) of a 16 sector track
+extern void dsk_nibblize_track(uint8_t *dest, const uint8_t *src, uint8_t track_number, bool is_prodos);
+// Re-encodes one physical sector of a track built by dsk_nibblize_track() in place
+extern void dsk_nibblize_sector(uint8_t *dest, const uint8_t *src, int physical_sector);
+
 class MediaTypeDSK  : public MediaTypeWOZ
 {
 private:
     size_t num_tracks = 0;
 
+    // Guards the image file and the sectors below; tracks are loaded from another task
+    std::recursive_mutex _dsk_mutex;
+    uint8_t *_track_data = nullptr; // one track of sectors, for nibblizing
+    // Sectors written to one track but not yet to the image, in image order
+    uint8_t *_wb_data = nullptr;
+    int _wb_track = -1;
+    uint16_t _wb_dirty = 0; // bit per logical sector
+    uint64_t _wb_last_write = 0;
+
     void dsk2woz_info();
     void dsk2woz_tmap();
-    bool dsk2woz_tracks(uint8_t *dsk); 
+    bool dsk2woz_tracks();
+
+    int logical_sector(int physical_sector);
 
 public:
+    ~MediaTypeDSK();
+
+    // Keep written sectors in memory for this long before writing them to the image, 0 = write through
+    uint32_t _write_back_ms = 0;
 
     virtual mediatype_t mount(fnFile *f, uint32_t disksize) override;
-    // virtual void unmount() override;
+    virtual void unmount() override;
     virtual bool write_sector(int track, int sector, uint8_t *buffer) override;
+    virtual bool read_track(uint8_t trk, uint8_t *buf, size_t size) override;
+    virtual void track_loaded(uint8_t trk, uint8_t *buf) override;
+
+    // Writes held sectors to the image
+    bool flush();
+    // Called while the drive is idle, flushes once _write_back_ms has passed
+    virtual void idle() override;
 
     // static bool create(FILE *f, uint32_t numBlock);
 };
@@ -1,9 +1,8 @@
 #ifdef BUILD_APPLE
 
-#ifndef DEV_RELAY_SLIP
-#include "esp_heap_caps.h"
-#endif
 #include "mediaTypeWOZ.h"
+#include "trackCache.h"
+#include "compat_esp.h" // empty IRAM_ATTR macro for FujiNet-PC
 #include "../../include/debug.h"
 #include <string.h>
 
@@ -50,14 +49,112 @@ mediatype_t MediaTypeWOZ::mount(fnFile *f, uint32_t disksize)
     return MEDIATYPE_WOZ;
 }
 
+MediaTypeWOZ::~MediaTypeWOZ()
+{
+    unmount();
+}
+
 void MediaTypeWOZ::unmount()
 {
+    wozTrackCache.release(this);
     MediaType::unmount();
     for (int i = 0; i < MAX_TRACKS; i++)
     {
         if (trk_ptrs[i] != nullptr)
+        {
             free(trk_ptrs[i]);
+            trk_ptrs[i] = nullptr;
+        }
+    }
+}
+
+uint8_t * IRAM_ATTR MediaTypeWOZ::get_track(int t)
+{
+    uint8_t trk = tmap[t];
+    if (trk == 255)
+        return nullptr;
+
+    // Generated images keep all their tracks
+    if (trk_ptrs[trk] != nullptr)
+        return trk_ptrs[trk];
+
+    _head_track = trk;
+    uint8_t *data = wozTrackCache.find(this, trk);
+    if (TrackCache::in_isr())
+        _track_pending = data == nullptr;
+    else
+    {
+        if (data == nullptr)
+            data = wozTrackCache.load(this, trk);
+        _track_pending = false;
+    }
+    wozTrackCache.prefetch(this, t);
+
+    // A WOZ1 track only turns out to be blank once it's read
+    if (trks[trk].bit_count == 0)
+        return nullptr;
+    return data;
+}
+
+/*
+ Bytes of track data at quarter-track t, for WOZ1 the used part of the
+ record rounded up to a block
+*/
+int IRAM_ATTR MediaTypeWOZ::track_len(int t)
+{
+    uint8_t trk = tmap[t];
+    if (woz_version == WOZ1)
+        return (woz1_bytes_used[trk] + 511) / 512 * 512;
+    return trks[trk].block_count * 512;
+}
+
+/*
+ Reads a track into buf, which holds track_bytes(trk).
+ Returns false on error.
+*/
+bool MediaTypeWOZ::read_track(uint8_t trk, uint8_t *buf, size_t size)
+{
+    if (_media_fileh == nullptr)
+        return false;
+
+    switch (woz_version)
+    {
+    case WOZ1:
+    {
+        // The whole TRKS record, bitstream followed by its lengths
+        if (size < WOZ1_NUM_BLKS * 512 ||
+            fnio::fseek(_media_fileh, 256 + trk * WOZ1_NUM_BLKS * 512, SEEK_SET) != 0 ||
+            fnio::fread(buf, 1, WOZ1_NUM_BLKS * 512, _media_fileh) != WOZ1_NUM_BLKS * 512)
+        {
+            Debug_printf("\nError reading track %d", trk);
+            return false;
+        }
+        uint16_t bytes_used = buf[WOZ1_TRACK_LEN] | (buf[WOZ1_TRACK_LEN + 1] << 8);
+        uint16_t bit_count = buf[WOZ1_TRACK_LEN + 2] | (buf[WOZ1_TRACK_LEN + 3] << 8);
+        if (bytes_used > WOZ1_TRACK_LEN)
+            bytes_used = WOZ1_TRACK_LEN;
+        memset(buf + bytes_used, 0, size - bytes_used);
+        // block_count stays at the full record so the slot and the next read keep their size
+        woz1_bytes_used[trk] = bytes_used;
+        trks[trk].bit_count = bit_count;
+        if (bit_count == 0)
+            Debug_printf("\nTrack %d is blank!", trk);
+        break;
     }
+    case WOZ2:
+        if (fnio::fseek(_media_fileh, trks[trk].start_block * 512, SEEK_SET) != 0 ||
+            fnio::fread(buf, 1, size, _media_fileh) != size)
+        {
+            Debug_printf("\nError reading track %d", trk);
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    Debug_printf("\nLoaded track %d, %d bytes, %lu bits", trk, size, trks[trk].bit_count);
+    return true;
 }
 
 bool MediaTypeWOZ::wozX_check_header()
@@ -160,9 +257,7 @@ bool MediaTypeWOZ::wozX_read_tmap()
 }
 
 bool MediaTypeWOZ::woz1_read_tracks()
-{    // depend upon little endian-ness
-    fnio::fseek(_media_fileh, 256, SEEK_SET);
-
+{
     // woz1 track data organized as:
     // Offset	Size	    Name	        Usage
     // +0	    6646 bytes  Bitstream	    The bitstream data padded out to 6646 bytes
@@ -173,56 +268,16 @@ bool MediaTypeWOZ::woz1_read_tracks()
     // +6653	uint8	    Splice Bit Count	Bit count of splice nibble (write hint).
     // +6654	uint16		Reserved for future use.
 
-    Debug_printf("\nStart Block, Block Count, Bit Count");
-    
-#ifdef ESP_PLATFORM
-    uint8_t *temp_ptr = (uint8_t *)heap_caps_malloc(WOZ1_NUM_BLKS * 512, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
-#else
-    uint8_t *temp_ptr = (uint8_t *)malloc(WOZ1_NUM_BLKS * 512);
-#endif
-    uint16_t bytes_used;
-    uint16_t bit_count;
-
+    // Lengths are only known once a track is read, see read_track()
+    memset(trks, 0, sizeof(trks));
+    memset(woz1_bytes_used, 0, sizeof(woz1_bytes_used));
     for (int i = 0; i < MAX_TRACKS; i++)
     {
-        memset(temp_ptr, 0, WOZ1_NUM_BLKS * 512);
-        fnio::fread(temp_ptr, 1, WOZ1_TRACK_LEN, _media_fileh);
-        fnio::fread(&bytes_used, sizeof(bytes_used), 1, _media_fileh);
-        fnio::fread(&bit_count, sizeof(bit_count), 1, _media_fileh);
-        trks[i].block_count = bytes_used / 512;
-        if (bytes_used % 512)
-            trks[i].block_count++;
-        trks[i].bit_count = bit_count;
-        if (bit_count > 0)
-        {
-            size_t s = trks[i].block_count * 512;
-#ifdef ESP_PLATFORM
-            trk_ptrs[i] = (uint8_t *)heap_caps_malloc(s, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-#else
-            trk_ptrs[i] = (uint8_t *)malloc(s);
-#endif
-            if (trk_ptrs[i] != nullptr)
-            {
-                Debug_printf("\nStoring %d bytes of track %d into location %hhn", bytes_used, i, trk_ptrs[i]);
-                memset(trk_ptrs[i],0,s);
-                memcpy(trk_ptrs[i], temp_ptr, bytes_used);
-            }
-            else
-            {
-                Debug_printf("\nNo RAM allocated!");
-                free(temp_ptr);
-                return true;
-            }
-        }
-        else
-        {
-            trk_ptrs[i] = nullptr;
-            Debug_printf("\nTrack %d is blank!",i);
-        }
-        fnio::fread(temp_ptr, 1, 6, _media_fileh); // read through rest of bytes in track
+        if (tmap[i] != 255)
+            trks[tmap[i]].block_count = WOZ1_NUM_BLKS;
     }
-    free(temp_ptr);
-    return false;
+
+    return !wozTrackCache.attach(this);
 }
 
 bool MediaTypeWOZ::woz2_read_tracks()
@@ -234,32 +289,9 @@ bool MediaTypeWOZ::woz2_read_tracks()
     for (int i=0; i<MAX_TRACKS; i++)
         Debug_printf("\n%d, %d, %lu", trks[i].start_block, trks[i].block_count, trks[i].bit_count);
 #endif
-    // read WOZ tracks into RAM
-    for (int i=0; i<MAX_TRACKS; i++)
-    {
-        size_t s = trks[i].block_count * 512;
-        if (s != 0)
-        {
-#ifdef ESP_PLATFORM
-            trk_ptrs[i] = (uint8_t *)heap_caps_malloc(s, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-#else
-            trk_ptrs[i] = (uint8_t *)malloc(s);
-#endif
-            if (trk_ptrs[i] != nullptr)
-            {
-                Debug_printf("\nReading %d bytes of track %d into location %hhn", s, i, trk_ptrs[i]);
-                fnio::fseek(_media_fileh, trks[i].start_block * 512, SEEK_SET);
-                fnio::fread(trk_ptrs[i], 1, s, _media_fileh);
-                Debug_printf("\n%d, %d, %lu", trks[i].start_block, trks[i].block_count, trks[i].bit_count);
-            }
-            else
-            {
-                Debug_printf("\nNo RAM allocated!");
-                return true;
-            }
-        }
-    }
-    return false;
+
+    // Track data is read as the head gets to it
+    return !wozTrackCache.attach(this);
 }
 
 #endif // BUILD_APPLE
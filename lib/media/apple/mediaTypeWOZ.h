@@ -31,9 +31,14 @@ private:
 protected:
     uint8_t tmap[MAX_TRACKS];
     TRK_t trks[MAX_TRACKS];
-    uint8_t *trk_ptrs[MAX_TRACKS] = { };
+    uint16_t woz1_bytes_used[MAX_TRACKS] = { }; // WOZ1 bitstream length, known once the track is read
+    uint8_t *trk_ptrs[MAX_TRACKS] = { }; // Tracks held in memory for the life of the image, others come from wozTrackCache
+    volatile int _head_track = -1; // TRKS index last asked for by the drive
+    volatile bool _track_pending = false; // The drive was given a blank track because it wasn't loaded yet
 
 public:
+    ~MediaTypeWOZ();
+
     virtual bool read(uint32_t blockNum, uint16_t *count, uint8_t* buffer) override { return false; };
     virtual bool write(uint32_t blockNum, uint16_t *count, uint8_t* buffer) override { return false; };
     virtual bool write_sector(int track, int sector, uint8_t *buffer) override;
@@ -46,9 +51,21 @@ public:
     virtual bool status() override {return (_media_fileh != nullptr);}
 
     uint8_t trackmap(uint8_t t) { return tmap[t]; };
-    uint8_t *get_track(int t) { return trk_ptrs[tmap[t]]; };
-    int track_len(int t) { return trks[tmap[t]].block_count * 512; };
+    // Track data at quarter-track t, or nullptr if blank or not loaded yet (see track_pending())
+    uint8_t *get_track(int t);
+    int track_len(int t);
     int num_bits(int t) { return trks[tmap[t]].bit_count; };
+    bool track_pending() { return _track_pending; };
+    // Called while the drive is idle
+    virtual void idle() {};
+
+    // Used by wozTrackCache
+    int head_track() { return _head_track; };
+    bool lazy_track(uint8_t trk) { return trk_ptrs[trk] == nullptr && trks[trk].block_count != 0; };
+    size_t track_bytes(uint8_t trk) { return trks[trk].block_count * 512; };
+    virtual bool read_track(uint8_t trk, uint8_t *buf, size_t size);
+    // A track read by read_track() is now in the cache and can be found
+    virtual void track_loaded(uint8_t trk, uint8_t *buf) {};
     uint8_t optimal_bit_timing;
     // static bool create(FILE *f, uint32_t numBlock);
 };
@@ -0,0 +1,299 @@
+#ifdef BUILD_APPLE
+
+#include "trackCache.h"
+
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#include <freertos/task.h>
+#endif
+
+#include "mediaTypeWOZ.h"
+#include "compat_esp.h" // empty IRAM_ATTR macro for FujiNet-PC
+#include "../../include/debug.h"
+
+#define TRACK_PREFETCH_QUEUE_LEN 8
+#define TRACK_PREFETCH_STACKSIZE 4096
+#define TRACK_PREFETCH_PRIORITY 5
+
+TrackCache wozTrackCache;
+
+struct track_prefetch_req
+{
+    MediaTypeWOZ *owner;
+    int qtrack;
+};
+
+bool IRAM_ATTR TrackCache::in_isr()
+{
+#ifdef ESP_PLATFORM
+    return xPortInIsrContext();
+#else
+    return false;
+#endif
+}
+
+void IRAM_ATTR TrackCache::lock()
+{
+#ifdef ESP_PLATFORM
+    if (in_isr())
+        portENTER_CRITICAL_ISR(&_mux);
+    else
+        portENTER_CRITICAL(&_mux);
+#endif
+}
+
+void IRAM_ATTR TrackCache::unlock()
+{
+#ifdef ESP_PLATFORM
+    if (in_isr())
+        portEXIT_CRITICAL_ISR(&_mux);
+    else
+        portEXIT_CRITICAL(&_mux);
+#endif
+}
+
+bool TrackCache::attach(MediaTypeWOZ *owner)
+{
+    std::lock_guard<std::recursive_mutex> guard(_load_mutex);
+
+#ifdef ESP_PLATFORM
+    if (_prefetch_queue == nullptr)
+    {
+        _prefetch_queue = xQueueCreate(TRACK_PREFETCH_QUEUE_LEN, sizeof(track_prefetch_req));
+        xTaskCreate(_prefetch_task, "woztracks", TRACK_PREFETCH_STACKSIZE, this, TRACK_PREFETCH_PRIORITY, nullptr);
+    }
+#endif
+
+    for (int i = 0; i < TRACK_CACHE_OWNERS; i++)
+    {
+        if (_owners[i] == nullptr)
+        {
+            _owners[i] = owner;
+            return true;
+        }
+    }
+    Debug_printf("\nTrackCache: no room for another image");
+    return false;
+}
+
+void TrackCache::release(MediaTypeWOZ *owner)
+{
+    std::lock_guard<std::recursive_mutex> guard(_load_mutex);
+
+    bool found = false;
+    for (int i = 0; i < TRACK_CACHE_OWNERS; i++)
+    {
+        if (_owners[i] == owner)
+        {
+            _owners[i] = nullptr;
+            found = true;
+        }
+    }
+    if (!found)
+        return;
+
+    // Keep the buffers for the next image
+    lock();
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++)
+        if (_slots[i].owner == owner)
+            _slots[i].owner = nullptr;
+    unlock();
+
+    Debug_printf("\nTrackCache: %lu hits, %lu misses, %lu loads (%lu ahead of the head)",
+                 (unsigned long)_stats.hits, (unsigned long)_stats.misses,
+                 (unsigned long)_stats.loads, (unsigned long)_stats.prefetched);
+}
+
+bool TrackCache::attached(MediaTypeWOZ *owner)
+{
+    for (int i = 0; i < TRACK_CACHE_OWNERS; i++)
+        if (owner != nullptr && _owners[i] == owner)
+            return true;
+    return false;
+}
+
+uint8_t * IRAM_ATTR TrackCache::find(MediaTypeWOZ *owner, uint8_t track)
+{
+    uint8_t *data = nullptr;
+
+    lock();
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++)
+    {
+        cache_slot &s = _slots[i];
+        if (s.owner == owner && s.track == track)
+        {
+            s.last_use = ++_tick;
+            data = s.data;
+            break;
+        }
+    }
+    if (data != nullptr)
+        _stats.hits++;
+    else
+        _stats.misses++;
+    unlock();
+
+    return data;
+}
+
+/*
+ Picks the slot to load into: an unused one, otherwise the least recently used
+ one that isn't the track under a drive's head (the interrupt may be copying it).
+ Called with the slot table locked.
+*/
+TrackCache::cache_slot *TrackCache::victim()
+{
+    cache_slot *lru = nullptr;
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++)
+    {
+        cache_slot &s = _slots[i];
+        if (s.owner == nullptr)
+            return &s;
+        if (s.owner->head_track() == s.track)
+            continue;
+        if (lru == nullptr || s.last_use < lru->last_use)
+            lru = &s;
+    }
+    return lru;
+}
+
+uint8_t *TrackCache::_load(MediaTypeWOZ *owner, uint8_t track, bool prefetch)
+{
+    std::lock_guard<std::recursive_mutex> guard(_load_mutex);
+
+    if (!attached(owner))
+        return nullptr;
+
+    uint8_t *data = nullptr;
+    cache_slot *s = nullptr;
+
+    lock();
+    for (int i = 0; i < TRACK_CACHE_SLOTS; i++)
+    {
+        if (_slots[i].owner == owner && _slots[i].track == track)
+        {
+            _slots[i].last_use = ++_tick;
+            data = _slots[i].data;
+            break;
+        }
+    }
+    if (data == nullptr)
+    {
+        s = victim();
+        if (s != nullptr)
+            s->owner = nullptr; // out of reach of find() while it is refilled
+    }
+    unlock();
+
+    if (data != nullptr)
+        return data;
+    if (s == nullptr)
+        return nullptr;
+
+    size_t size = owner->track_bytes(track);
+    if (size > s->size)
+    {
+        free(s->data);
+#ifdef ESP_PLATFORM
+        s->data = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+#else
+        s->data = (uint8_t *)malloc(size);
+#endif
+        s->size = s->data != nullptr ? size : 0;
+        if (s->data == nullptr)
+        {
+            Debug_printf("\nTrackCache: no RAM for track %u", track);
+            return nullptr;
+        }
+    }
+
+    if (!owner->read_track(track, s->data, size))
+        return nullptr;
+
+    lock();
+    s->owner = owner;
+    s->track = track;
+    s->last_use = ++_tick;
+    _stats.loads++;
+    if (prefetch)
+        _stats.prefetched++;
+    unlock();
+
+    // Still under _load_mutex, so the slot can't be given to another track yet
+    owner->track_loaded(track, s->data);
+
+    return s->data;
+}
+
+/*
+ Loads the track under the head and those around it, nearest first, stopping
+ early if the head has moved on in the meantime
+*/
+void TrackCache::_prefetch(MediaTypeWOZ *owner, int qtrack)
+{
+    std::lock_guard<std::recursive_mutex> guard(_load_mutex);
+
+    if (!attached(owner))
+        return;
+
+    for (int d = 0; d <= TRACK_PREFETCH_QTRACKS; d++)
+    {
+        int q_side[2] = { qtrack + d, qtrack - d };
+        for (int i = 0; i < (d == 0 ? 1 : 2); i++)
+        {
+            int q = q_side[i];
+            if (q < 0 || q >= MAX_TRACKS)
+                continue;
+            uint8_t track = owner->trackmap(q);
+            if (track == 255 || !owner->lazy_track(track))
+                continue;
+            _load(owner, track, true);
+        }
+#ifdef ESP_PLATFORM
+        if (uxQueueMessagesWaiting(_prefetch_queue) > 0)
+            return;
+#endif
+    }
+}
+
+void IRAM_ATTR TrackCache::prefetch(MediaTypeWOZ *owner, int qtrack)
+{
+#ifdef ESP_PLATFORM
+    if (_prefetch_queue == nullptr)
+        return;
+    track_prefetch_req req = { owner, qtrack };
+    if (in_isr())
+    {
+        BaseType_t woken = pdFALSE;
+        xQueueSendFromISR(_prefetch_queue, &req, &woken);
+        if (woken)
+            portYIELD_FROM_ISR();
+    }
+    else
+        xQueueSend(_prefetch_queue, &req, 0);
+#else
+    _prefetch(owner, qtrack);
+#endif
+}
+
+#ifdef ESP_PLATFORM
+void TrackCache::_prefetch_task(void *arg)
+{
+    TrackCache *c = (TrackCache *)arg;
+    track_prefetch_req req;
+
+    while (true)
+    {
+        if (xQueueReceive(c->_prefetch_queue, &req, portMAX_DELAY) != pdTRUE)
+            continue;
+        // Only the latest head position matters
+        while (xQueueReceive(c->_prefetch_queue, &req, 0) == pdTRUE)
+            ;
+        c->_prefetch(req.owner, req.qtrack);
+    }
+}
+#endif
+
+#endif // BUILD_APPLE
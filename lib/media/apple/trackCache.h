@@ -0,0 +1,103 @@
+#ifndef _TRACK_CACHE_
+#define _TRACK_CACHE_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
+
+/*
+ Track cache shared by the Disk II drives.
+
+ WOZ images are no longer read into memory at mount. Tracks are loaded the
+ first time the head lands on them and kept in a fixed number of slots,
+ replaced least recently used first. Each time the head moves, the tracks
+ either side of it are loaded in the background so stepping normally finds
+ them already here.
+
+ The head is stepped from the phase interrupt, which can't read files. A
+ miss there returns nothing (the drive sees a blank track for a moment) and
+ the drive asks again from task context, see iwmDisk2::refresh_track().
+*/
+
+#ifdef ESP_PLATFORM
+#define TRACK_CACHE_SLOTS 20 // ~130 KB of 6.5 KB tracks for both drives
+#else
+#define TRACK_CACHE_SLOTS 40
+#endif
+#define TRACK_CACHE_OWNERS 4 // Images that can use the cache at once
+#define TRACK_PREFETCH_QTRACKS 8 // Quarter-tracks either side of the head to load ahead
+
+class MediaTypeWOZ;
+
+struct track_cache_stats
+{
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t loads = 0;    // tracks read from an image
+    uint32_t prefetched = 0; // of those, loaded ahead of the head
+};
+
+class TrackCache
+{
+private:
+    struct cache_slot
+    {
+        MediaTypeWOZ *owner = nullptr; // nullptr = unused
+        uint8_t track = 0;             // TRKS index in the owner
+        uint32_t last_use = 0;
+        uint8_t *data = nullptr;
+        size_t size = 0;               // allocated
+    };
+
+    cache_slot _slots[TRACK_CACHE_SLOTS];
+    MediaTypeWOZ *_owners[TRACK_CACHE_OWNERS] = { nullptr };
+    uint32_t _tick = 0;
+    track_cache_stats _stats;
+
+    // Held for a whole load, and while owners come and go
+    std::recursive_mutex _load_mutex;
+
+#ifdef ESP_PLATFORM
+    // Guards the slot table against the phase interrupt
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+    QueueHandle_t _prefetch_queue = nullptr;
+
+    static void _prefetch_task(void *arg);
+#endif
+
+    void lock();
+    void unlock();
+    bool attached(MediaTypeWOZ *owner);
+    cache_slot *victim();
+    uint8_t *_load(MediaTypeWOZ *owner, uint8_t track, bool prefetch);
+    void _prefetch(MediaTypeWOZ *owner, int qtrack);
+
+public:
+    // Register an image before using the cache, release it before it goes away
+    bool attach(MediaTypeWOZ *owner);
+    void release(MediaTypeWOZ *owner);
+
+    // Returns the cached track or nullptr. Safe to call from an interrupt.
+    uint8_t *find(MediaTypeWOZ *owner, uint8_t track);
+
+    // Returns the track, reading it from the image if needed. Task context only.
+    uint8_t *load(MediaTypeWOZ *owner, uint8_t track) { return _load(owner, track, false); };
+
+    // The head of the owner's drive is at qtrack; load the tracks around it in the background.
+    // Safe to call from an interrupt.
+    void prefetch(MediaTypeWOZ *owner, int qtrack);
+
+    static bool in_isr();
+
+    const track_cache_stats &stats() { return _stats; };
+};
+
+extern TrackCache wozTrackCache;
+
+#endif // _TRACK_CACHE_
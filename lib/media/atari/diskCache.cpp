@@ -0,0 +1,142 @@
+#ifdef BUILD_ATARI // temporary
+
+#include "diskCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#include "sdkconfig.h"
+#endif
+
+#include "../../include/debug.h"
+
+bool MediaCache::begin(size_t budget, uint16_t sectors_per_block, uint16_t slot_size)
+{
+    end();
+
+    if (sectors_per_block == 0 || slot_size == 0)
+        return false;
+
+    size_t block_size = (size_t)sectors_per_block * slot_size;
+    int num_blocks = budget / block_size;
+    if (num_blocks < 2)
+        return false;
+
+#if defined(ESP_PLATFORM) && CONFIG_SPIRAM
+    _pool = (uint8_t *)heap_caps_malloc(num_blocks * block_size, MALLOC_CAP_SPIRAM);
+    if (_pool == nullptr)
+#endif
+    _pool = (uint8_t *)malloc(num_blocks * block_size);
+    _blocks = new cache_block[num_blocks];
+
+    if (_pool == nullptr)
+    {
+        Debug_printf("MediaCache: failed to allocate %u bytes\r\n", (unsigned)(num_blocks * block_size));
+        end();
+        return false;
+    }
+
+    for (int i = 0; i < num_blocks; i++)
+        _blocks[i].data = _pool + i * block_size;
+
+    _num_blocks = num_blocks;
+    _sectors_per_block = sectors_per_block;
+    _slot_size = slot_size;
+    _stats.size = num_blocks * block_size;
+
+    Debug_printf("MediaCache: %d blocks of %u sectors\r\n", num_blocks, sectors_per_block);
+
+    return true;
+}
+
+void MediaCache::end()
+{
+    free(_pool);
+    _pool = nullptr;
+    delete[] _blocks;
+    _blocks = nullptr;
+    _num_blocks = 0;
+    _filling = nullptr;
+    _stats = media_cache_stats();
+}
+
+MediaCache::cache_block *MediaCache::_find_block(uint16_t sectornum)
+{
+    for (int i = 0; i < _num_blocks; i++)
+    {
+        cache_block &b = _blocks[i];
+        if (b.first != 0 && sectornum >= b.first && sectornum < b.first + b.count)
+            return &b;
+    }
+    return nullptr;
+}
+
+const uint8_t *MediaCache::find(uint16_t sectornum)
+{
+    cache_block *b = _find_block(sectornum);
+    if (b == nullptr)
+    {
+        _stats.misses++;
+        return nullptr;
+    }
+
+    _stats.hits++;
+    b->last_use = ++_tick;
+    return b->data + (sectornum - b->first) * _slot_size;
+}
+
+uint8_t *MediaCache::fill_begin(uint16_t first)
+{
+    cache_block *victim = &_blocks[0];
+    for (int i = 0; i < _num_blocks; i++)
+    {
+        // Reuse a stale copy of the same block before anything else
+        if (_blocks[i].first == first)
+        {
+            victim = &_blocks[i];
+            break;
+        }
+        if (_blocks[i].last_use < victim->last_use)
+            victim = &_blocks[i];
+    }
+
+    victim->first = 0;
+    victim->count = 0;
+    _filling = victim;
+    return victim->data;
+}
+
+void MediaCache::fill_end(uint16_t first, uint16_t count)
+{
+    if (_filling == nullptr || count == 0)
+        return;
+
+    _filling->first = first;
+    _filling->count = count;
+    _filling->last_use = ++_tick;
+    _filling = nullptr;
+    _stats.fills++;
+}
+
+void MediaCache::update(uint16_t sectornum, const uint8_t *data, uint16_t len)
+{
+    cache_block *b = _find_block(sectornum);
+    if (b == nullptr)
+        return;
+
+    uint8_t *slot = b->data + (sectornum - b->first) * _slot_size;
+    memcpy(slot, data, len < _slot_size ? len : _slot_size);
+}
+
+void MediaCache::invalidate()
+{
+    for (int i = 0; i < _num_blocks; i++)
+    {
+        _blocks[i].first = 0;
+        _blocks[i].count = 0;
+    }
+}
+
+#endif /* BUILD_ATARI */
@@ -0,0 +1,77 @@
+#ifndef _MEDIA_CACHE_
+#define _MEDIA_CACHE_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ Read-through sector cache for a mounted disk image.
+
+ The cache is split into blocks of sectors_per_block consecutive sectors
+ (normally one track), each stored in fixed slots of slot_size bytes.
+ On a miss the whole block is read in one go, so the neighbouring sectors
+ a DOS or loader asks for next are already in memory. Blocks are replaced
+ least recently used first. Writes update a cached copy in place.
+*/
+
+struct media_cache_stats
+{
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t fills = 0;     // block reads from the image
+    uint32_t size = 0;      // bytes allocated, 0 if disabled
+};
+
+class MediaCache
+{
+private:
+    struct cache_block
+    {
+        uint16_t first = 0; // first sector, 0 = unused
+        uint16_t count = 0;
+        uint32_t last_use = 0;
+        uint8_t *data = nullptr;
+    };
+
+    cache_block *_blocks = nullptr;
+    cache_block *_filling = nullptr;
+    uint8_t *_pool = nullptr;
+    int _num_blocks = 0;
+    uint16_t _sectors_per_block = 0;
+    uint16_t _slot_size = 0;
+    uint32_t _tick = 0;
+    media_cache_stats _stats;
+
+    cache_block *_find_block(uint16_t sectornum);
+
+public:
+    ~MediaCache() { end(); };
+
+    // Allocates up to budget bytes. Returns false (and stays disabled) if
+    // the budget can't hold at least two blocks or allocation fails.
+    bool begin(size_t budget, uint16_t sectors_per_block, uint16_t slot_size);
+    void end();
+    bool enabled() { return _num_blocks > 0; };
+
+    // Sector numbers are 1-based like the rest of MediaType.
+    // First sector of the block holding sectornum
+    uint16_t block_first(uint16_t sectornum) { return ((sectornum - 1) / _sectors_per_block) * _sectors_per_block + 1; };
+    uint16_t sectors_per_block() { return _sectors_per_block; };
+    uint16_t slot_size() { return _slot_size; };
+
+    // Returns cached sector data or nullptr, counting the hit or miss
+    const uint8_t *find(uint16_t sectornum);
+
+    // Returns the least recently used block buffer for filling with sectors
+    // starting at first, one per slot. The block is invalid until fill_end().
+    uint8_t *fill_begin(uint16_t first);
+    void fill_end(uint16_t first, uint16_t count);
+
+    // Replace a sector's cached data, if cached
+    void update(uint16_t sectornum, const uint8_t *data, uint16_t len);
+    void invalidate();
+
+    const media_cache_stats &stats() { return _stats; };
+};
+
+#endif // _MEDIA_CACHE_
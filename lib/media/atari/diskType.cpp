@@ -136,6 +136,8 @@ void MediaType::dump_percom_block()
 
 void MediaType::unmount()
 {
+    _cache.end();
+
     if (_disk_fileh != nullptr)
     {
         fnio::fclose(_disk_fileh);
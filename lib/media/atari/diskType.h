@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "fnio.h"
 #include "fujiHost.h"
+#include "diskCache.h"
 
 #define INVALID_SECTOR_VALUE 65536
 
@@ -53,7 +54,9 @@ protected:
     bool _disk_readonly = true;
     uint16_t _high_score_sector = 0; /* High score sector to allow write. 1-65535 */
     uint8_t _high_score_num_sectors = 0;
-    
+
+    MediaCache _cache;
+
 public:
     struct
     {
@@ -79,6 +82,12 @@ public:
 
     fujiHost *_disk_host = nullptr;
 
+    // Sector cache budget in bytes for image types that support it, set before mount()
+    uint32_t _cache_budget = 0;
+    // Hold written sectors until the bus has been quiet this long, 0 = write and sync every sector
+    uint32_t _write_back_ms = 0;
+    const media_cache_stats &cache_stats() { return _cache.stats(); };
+
     mediatype_t _disktype = MEDIATYPE_UNKNOWN;
     bool _allow_hsio = true;
 
@@ -93,6 +102,11 @@ public:
     // Returns TRUE if an error condition occurred
     virtual bool write(uint16_t sectornum, bool verify);
 
+    // Write out any sectors held back by write-back. Returns TRUE if an error condition occurred
+    virtual bool flush() { return false; };
+    // Called while the bus is idle, lets write-back flush after its timeout
+    virtual void idle() {};
+
     // Always returns 128 for the first 3 sectors, otherwise _sectorSize
     virtual uint16_t sector_size(uint16_t sectornum);
     
@@ -16,6 +16,9 @@
 
 #define ATR_MAGIC_HEADER 0x0296 // Sum of 'NICKATARI'
 
+#define ATR_CACHE_DEFAULT_PREFETCH 18
+#define ATR_CACHE_MAX_PREFETCH 36
+
 // Returns byte offset of given sector number (1-based)
 uint32_t MediaTypeATR::_sector_to_offset(uint16_t sectorNum)
 {
@@ -51,6 +54,65 @@ uint32_t MediaTypeATR::_sector_to_offset(uint16_t sectorNum)
     return offset;
 }
 
+/* Reads the cache block holding sectornum with a single seek and read.
+   Sectors are contiguous in the image, so the block is read packed and then
+   spread out into the cache slots, last sector first.
+   Returns the cached sector, or nullptr if the block couldn't be read.
+*/
+const uint8_t *MediaTypeATR::_cache_fill(uint16_t sectornum)
+{
+    uint16_t first = _cache.block_first(sectornum);
+    uint16_t last = first + _cache.sectors_per_block() - 1;
+    if (last > _disk_num_sectors)
+        last = _disk_num_sectors;
+
+    uint32_t start = _sector_to_offset(first);
+    for (uint16_t s = first; s < last; s++)
+    {
+        if (_sector_to_offset(s + 1) != _sector_to_offset(s) + sector_size(s))
+        {
+            last = s;
+            break;
+        }
+    }
+    // Don't read past the end of a short image
+    while (last > first && _disk_image_size != 0 && _sector_to_offset(last) + sector_size(last) > _disk_image_size)
+        last--;
+    if (sectornum > last)
+        return nullptr;
+
+    uint32_t len = _sector_to_offset(last) + sector_size(last) - start;
+    uint8_t *block = _cache.fill_begin(first);
+
+    if (first != _disk_last_sector + 1 && fnio::fseek(_disk_fileh, start, SEEK_SET) != 0)
+    {
+        _disk_last_sector = INVALID_SECTOR_VALUE;
+        return nullptr;
+    }
+    if (fnio::fread(block, 1, len, _disk_fileh) != len)
+    {
+        _disk_last_sector = INVALID_SECTOR_VALUE;
+        return nullptr;
+    }
+    _disk_last_sector = last;
+
+    uint16_t slot = _cache.slot_size();
+    for (int s = last; s >= first; s--)
+        memmove(block + (s - first) * slot, block + (_sector_to_offset(s) - start), sector_size(s));
+
+    // Sectors held for write-back are newer than the image
+    for (int i = 0; i < _wb_count; i++)
+    {
+        uint16_t s = _wb_sectors[i];
+        if (s >= first && s <= last)
+            memcpy(block + (s - first) * slot, _wb_data + i * _disk_sector_size, sector_size(s));
+    }
+
+    _cache.fill_end(first, last - first + 1);
+
+    return block + (sectornum - first) * slot;
+}
+
 // Returns TRUE if an error condition occurred
 bool MediaTypeATR::read(uint16_t sectornum, uint16_t *readcount)
 {
@@ -69,6 +131,34 @@ bool MediaTypeATR::read(uint16_t sectornum, uint16_t *readcount)
 
     memset(_disk_sectorbuff, 0, sizeof(_disk_sectorbuff));
 
+    if (_wb_count > 0)
+    {
+        // A boot sector read usually means the computer was reset, a good time to get writes out
+        if (sectornum == 1)
+            flush();
+
+        int slot = _wb_find(sectornum);
+        if (slot >= 0)
+        {
+            memcpy(_disk_sectorbuff, _wb_data + slot * _disk_sector_size, sectorSize);
+            *readcount = sectorSize;
+            return false;
+        }
+    }
+
+    if (_cache.enabled())
+    {
+        const uint8_t *cached = _cache.find(sectornum);
+        if (cached == nullptr)
+            cached = _cache_fill(sectornum);
+        if (cached != nullptr)
+        {
+            memcpy(_disk_sectorbuff, cached, sectorSize);
+            *readcount = sectorSize;
+            return false;
+        }
+    }
+
     bool err = false;
     // Perform a seek if we're not reading the sector after the last one we read
     if (sectornum != _disk_last_sector + 1)
@@ -95,23 +185,54 @@ bool inHighScoreRange(int minimum, int maximum, int val)
     return ((minimum <= val) && (val <= maximum));
 }
 
-// Returns TRUE if an error condition occurred
-bool MediaTypeATR::write(uint16_t sectornum, bool verify)
+// Finds sectornum in the write-back buffer, returns its slot or -1
+int MediaTypeATR::_wb_find(uint16_t sectornum)
 {
-    fnFile *oldFileh, *hsFileh;
-
-    oldFileh = nullptr;
-    hsFileh = nullptr;
+    for (int i = 0; i < _wb_count; i++)
+        if (_wb_sectors[i] == sectornum)
+            return i;
+    return -1;
+}
 
-    Debug_printf("ATR WRITE %d / %lu\r\n", sectornum, _disk_num_sectors);
+// Seeks (if needed) and writes one sector. Returns TRUE if an error condition occurred
+bool MediaTypeATR::_write_sector(uint16_t sectornum, const uint8_t *data)
+{
+    uint16_t sectorSize = sector_size(sectornum);
+    int e;
 
-    // Return an error if we're trying to write beyond the end of the disk
-    if (sectornum > _disk_num_sectors)
+    // Perform a seek if we're not writing to the sector after the last one
+    if (sectornum != _disk_last_sector + 1)
     {
-        Debug_printf("::write sector %d > %lu\r\n", sectornum, _disk_num_sectors);
+        e = fnio::fseek(_disk_fileh, _sector_to_offset(sectornum), SEEK_SET);
+        if (e != 0)
+        {
+            Debug_printf("::write seek error %d\r\n", e);
+            _disk_last_sector = INVALID_SECTOR_VALUE;
+            return true;
+        }
+    }
+    // Write the data
+    e = fnio::fwrite(data, 1, sectorSize, _disk_fileh);
+    if (e != sectorSize)
+    {
+        Debug_printf("::write error %d, %d\r\n", e, errno);
+        _disk_last_sector = INVALID_SECTOR_VALUE;
         return true;
     }
 
+    _disk_last_sector = sectornum;
+    return false;
+}
+
+// Writes and syncs a single sector right away
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::_write_strict(uint16_t sectornum)
+{
+    fnFile *oldFileh, *hsFileh;
+
+    oldFileh = nullptr;
+    hsFileh = nullptr;
+
     if (_high_score_sector != 0)
     {
         Debug_printf("High score mode activated, attempting write open\r\n");
@@ -126,30 +247,17 @@ bool MediaTypeATR::write(uint16_t sectornum, bool verify)
             _disk_fileh = hsFileh;
         }
     }
-    uint16_t sectorSize = sector_size(sectornum);
-    uint32_t offset = _sector_to_offset(sectornum);
 
     _disk_last_sector = INVALID_SECTOR_VALUE;
 
-    // Perform a seek if we're writing to the sector after the last one
-    int e;
-    if (sectornum != _disk_last_sector + 1)
-    {
-        e = fnio::fseek(_disk_fileh, offset, SEEK_SET);
-        if (e != 0)
-        {
-            Debug_printf("::write seek error %d\r\n", e);
-            return true;
-        }
-    }
-    // Write the data
-    e = fnio::fwrite(_disk_sectorbuff, 1, sectorSize, _disk_fileh);
-    if (e != sectorSize)
+    if (_write_sector(sectornum, _disk_sectorbuff))
     {
-        Debug_printf("::write error %d, %d\r\n", e, errno);
+        _cache.invalidate();
         return true;
     }
 
+    _cache.update(sectornum, _disk_sectorbuff, sector_size(sectornum));
+
     int ret = fnio::fflush(_disk_fileh); // Since we might get reset at any moment, go ahead and sync the file
     Debug_printf("ATR::write fflush:%d\r\n", ret);
 
@@ -163,12 +271,137 @@ bool MediaTypeATR::write(uint16_t sectornum, bool verify)
         _disk_fileh = oldFileh;
         _disk_last_sector = INVALID_SECTOR_VALUE; // force a cache invalidate.
     }
-    else
-        _disk_last_sector = sectornum;
 
     return false;
 }
 
+// Returns TRUE if an error condition occurred
+bool MediaTypeATR::write(uint16_t sectornum, bool verify)
+{
+    Debug_printf("ATR WRITE %d / %lu\r\n", sectornum, _disk_num_sectors);
+
+    // Return an error if we're trying to write beyond the end of the disk
+    if (sectornum > _disk_num_sectors)
+    {
+        Debug_printf("::write sector %d > %lu\r\n", sectornum, _disk_num_sectors);
+        return true;
+    }
+
+    // High score images are reopened for every write, so they stay strict
+    if (_write_back_ms == 0 || _high_score_sector != 0)
+        return _write_strict(sectornum);
+
+    if (_wb_data == nullptr)
+    {
+        _wb_data = (uint8_t *)malloc(ATR_WRITEBACK_SECTORS * _disk_sector_size);
+        if (_wb_data == nullptr)
+            return _write_strict(sectornum);
+    }
+
+    uint16_t sectorSize = sector_size(sectornum);
+    int slot = _wb_find(sectornum);
+    if (slot < 0)
+    {
+        if (_wb_count == ATR_WRITEBACK_SECTORS && flush())
+            return true;
+        slot = _wb_count++;
+        _wb_sectors[slot] = sectornum;
+    }
+
+    memcpy(_wb_data + slot * _disk_sector_size, _disk_sectorbuff, sectorSize);
+    _cache.update(sectornum, _disk_sectorbuff, sectorSize);
+    _wb_last_write = fnSystem.millis();
+
+    return false;
+}
+
+/* Writes all held sectors in ascending order, so runs of adjacent sectors
+   go out without seeking, then syncs the file once.
+   Sectors that fail to write stay held, to be tried again on the next flush.
+   Returns TRUE if an error condition occurred
+*/
+bool MediaTypeATR::flush()
+{
+    if (_wb_count == 0)
+        return false;
+
+    uint8_t order[ATR_WRITEBACK_SECTORS];
+    for (int i = 0; i < _wb_count; i++)
+    {
+        int j = i;
+        while (j > 0 && _wb_sectors[order[j - 1]] > _wb_sectors[i])
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    bool written[ATR_WRITEBACK_SECTORS];
+    int failed = 0;
+    for (int i = 0; i < _wb_count; i++)
+    {
+        written[order[i]] = !_write_sector(_wb_sectors[order[i]], _wb_data + order[i] * _disk_sector_size);
+        if (!written[order[i]])
+            failed++;
+    }
+
+    int ret = fnio::fflush(_disk_fileh);
+    Debug_printf("ATR::flush %d sectors, %d failed, fflush:%d\r\n", _wb_count, failed, ret);
+
+    if (ret != 0)
+    {
+        // Nothing is known to have reached the image
+        failed = _wb_count;
+    }
+    else if (failed > 0)
+    {
+        // Keep only what didn't make it out
+        int kept = 0;
+        for (int i = 0; i < _wb_count; i++)
+        {
+            if (written[i])
+                continue;
+            if (kept != i)
+            {
+                _wb_sectors[kept] = _wb_sectors[i];
+                memcpy(_wb_data + kept * _disk_sector_size, _wb_data + i * _disk_sector_size, _disk_sector_size);
+            }
+            kept++;
+        }
+    }
+    _wb_count = failed;
+
+    return failed > 0;
+}
+
+void MediaTypeATR::idle()
+{
+    if (_wb_count > 0 && fnSystem.millis() - _wb_last_write >= _write_back_ms)
+    {
+        // Don't retry a failing image on every idle pass
+        if (flush())
+            _wb_last_write = fnSystem.millis();
+    }
+}
+
+void MediaTypeATR::unmount()
+{
+    if (_disk_fileh != nullptr && flush())
+        Debug_printf("ATR::unmount %d sectors could not be written\r\n", _wb_count);
+
+    free(_wb_data);
+    _wb_data = nullptr;
+    _wb_count = 0;
+
+    MediaType::unmount();
+}
+
+MediaTypeATR::~MediaTypeATR()
+{
+    unmount();
+}
+
 void MediaTypeATR::status(uint8_t statusbuff[4])
 {
     statusbuff[0] = DISK_DRIVE_STATUS_CLEAR;
@@ -276,6 +509,13 @@ mediatype_t MediaTypeATR::mount(fnFile *f, uint32_t disksize)
     Debug_printf("mounted ATR: paragraphs=%lu, sect_size=%d, sect_count=%lu, disk_size=%lu\r\n",
                  num_paragraphs, num_bytes_sector, _disk_num_sectors, disksize);
 
+    // Prefetch a track at a time, unless this is a custom "one long track" geometry
+    uint16_t sectors_per_track = UINT16_FROM_HILOBYTES(_percomBlock.sectors_per_trackH, _percomBlock.sectors_per_trackL);
+    if (_percomBlock.num_tracks == 1 || sectors_per_track == 0 || sectors_per_track > ATR_CACHE_MAX_PREFETCH)
+        sectors_per_track = ATR_CACHE_DEFAULT_PREFETCH;
+    if (_cache_budget > 0)
+        _cache.begin(_cache_budget, sectors_per_track, _disk_sector_size);
+
     _disktype = MEDIATYPE_ATR;
 
     return _disktype;
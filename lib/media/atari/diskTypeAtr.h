@@ -3,12 +3,32 @@
 
 #include "diskType.h"
 
+// Most sectors held for write-back before they are flushed regardless of idle time
+#define ATR_WRITEBACK_SECTORS 64
+
 class MediaTypeATR : public MediaType
 {
 private:
     uint32_t _sector_to_offset(uint16_t sectorNum);
+    const uint8_t *_cache_fill(uint16_t sectornum);
+
+    // Write-back buffer, one _disk_sector_size slot per dirty sector
+    uint8_t *_wb_data = nullptr;
+    uint16_t _wb_sectors[ATR_WRITEBACK_SECTORS];
+    int _wb_count = 0;
+    uint64_t _wb_last_write = 0;
+
+    int _wb_find(uint16_t sectornum);
+    bool _write_sector(uint16_t sectornum, const uint8_t *data);
+    bool _write_strict(uint16_t sectornum);
 
 public:
+    ~MediaTypeATR();
+
+    virtual bool flush() override;
+    virtual void idle() override;
+    virtual void unmount() override;
+
     virtual bool read(uint16_t sectornum, uint16_t *readcount) override;
     virtual bool write(uint16_t sectornum, bool verify) override;
 
@@ -21,7 +21,7 @@
 
 #define ENTRY_BUFFER_SIZE 256
 
-NetworkProtocolFS::NetworkProtocolFS(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolFS::NetworkProtocolFS(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     fileSize = 0;
@@ -206,16 +206,16 @@ bool NetworkProtocolFS::read(unsigned short len)
 
 bool NetworkProtocolFS::read_file(unsigned short len)
 {
-    std::vector<uint8_t> buf = std::vector<uint8_t>(len);
-
 #ifdef VERBOSE_HTTP
     Debug_printf("NetworkProtocolFS::read_file(%u)\r\n", len);
 #endif
 
     if (receiveBuffer->length() == 0)
     {
-        // Do block read.
-        if (read_file_handle(buf.data(), len) == true)
+        // Do block read, straight into the receive buffer.
+        uint8_t *buf = (uint8_t *)receiveBuffer->prepare(len);
+        memset(buf, 0, len);
+        if (read_file_handle(buf, len) == true)
         {
 #ifdef VERBOSE_PROTOCOL
             Debug_printf("Nothing new from adapter, bailing.\n");
@@ -224,7 +224,7 @@ bool NetworkProtocolFS::read_file(unsigned short len)
         }
 
         // Append to receive buffer.
-        receiveBuffer->insert(receiveBuffer->end(), buf.begin(), buf.end());
+        receiveBuffer->commit(len);
         fileSize -= len;
     }
     else
@@ -240,7 +240,7 @@ bool NetworkProtocolFS::read_dir(unsigned short len)
 
     if (receiveBuffer->length() == 0)
     {
-        *receiveBuffer = dirBuffer.substr(0, len);
+        receiveBuffer->assign(dirBuffer.substr(0, len));
         dirBuffer.erase(0, len);
         dirBuffer.shrink_to_fit();
     }
@@ -262,7 +262,7 @@ bool NetworkProtocolFS::write_file(unsigned short len)
     if (write_file_handle((uint8_t *)transmitBuffer->data(), len) == true)
         return true;
 
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
     return false;
 }
 
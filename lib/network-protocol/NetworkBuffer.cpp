@@ -0,0 +1,168 @@
+/**
+ * Network protocol data buffer
+ */
+
+#include "NetworkBuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "../../include/debug.h"
+
+NetworkBuffer::NetworkBuffer(NetworkBuffer &&other)
+{
+    *this = std::move(other);
+}
+
+NetworkBuffer &NetworkBuffer::operator=(NetworkBuffer &&other)
+{
+    if (this != &other)
+    {
+        free(_buf);
+        _buf = other._buf;
+        _capacity = other._capacity;
+        _head = other._head;
+        _tail = other._tail;
+        other._buf = nullptr;
+        other._capacity = other._head = other._tail = 0;
+    }
+    return *this;
+}
+
+NetworkBuffer::~NetworkBuffer()
+{
+    free(_buf);
+}
+
+void NetworkBuffer::make_room(size_t len)
+{
+    // +1 for the NUL
+    if (_tail + len < _capacity)
+        return;
+
+    size_t used = size();
+
+    // Sliding the data down is enough if that leaves at least half free,
+    // which keeps the copying to a fraction of what's been written since
+    if (_head > 0)
+    {
+        memmove(_buf, _buf + _head, used);
+        _head = 0;
+        _tail = used;
+        _buf[_tail] = '\0';
+        if (used + len < _capacity / 2)
+            return;
+    }
+
+    size_t want = _capacity * 2;
+    if (want < used + len + 1)
+        want = used + len + 1;
+
+    char *p = (char *)realloc(_buf, want);
+    if (p == nullptr)
+    {
+        // Same outcome as std::string running out of memory
+        Debug_printf("NetworkBuffer: could not grow to %u bytes\r\n", (unsigned)want);
+        abort();
+    }
+    _buf = p;
+    _capacity = want;
+    _buf[_tail] = '\0';
+}
+
+void NetworkBuffer::reserve(size_t len)
+{
+    if (len > size())
+        make_room(len - size());
+}
+
+void NetworkBuffer::clear()
+{
+    _head = _tail = 0;
+    if (_buf != nullptr)
+        _buf[0] = '\0';
+}
+
+void NetworkBuffer::shrink_to_fit()
+{
+    if (empty())
+    {
+        free(_buf);
+        _buf = nullptr;
+        _capacity = _head = _tail = 0;
+        return;
+    }
+
+    size_t used = size();
+    if (_head > 0)
+    {
+        memmove(_buf, _buf + _head, used);
+        _head = 0;
+        _tail = used;
+        _buf[_tail] = '\0';
+    }
+
+    char *p = (char *)realloc(_buf, used + 1);
+    if (p != nullptr)
+    {
+        _buf = p;
+        _capacity = used + 1;
+    }
+}
+
+void NetworkBuffer::append(const void *src, size_t len)
+{
+    if (len == 0)
+        return;
+    make_room(len);
+    memcpy(_buf + _tail, src, len);
+    _tail += len;
+    _buf[_tail] = '\0';
+}
+
+void NetworkBuffer::assign(const std::string &s)
+{
+    clear();
+    append(s.data(), s.size());
+}
+
+void NetworkBuffer::consume(size_t len)
+{
+    if (len >= size())
+    {
+        // Empty, so the next write starts at the beginning again
+        clear();
+        return;
+    }
+    _head += len;
+}
+
+void NetworkBuffer::truncate(size_t len)
+{
+    if (len >= size())
+        return;
+    _tail = _head + len;
+    _buf[_tail] = '\0';
+}
+
+char *NetworkBuffer::prepare(size_t len)
+{
+    make_room(len);
+    return _buf + _tail;
+}
+
+void NetworkBuffer::commit(size_t len)
+{
+    _tail += len;
+    _buf[_tail] = '\0';
+}
+
+std::string NetworkBuffer::substr(size_t pos, size_t len) const
+{
+    if (pos >= size())
+        return std::string();
+    if (len > size() - pos)
+        len = size() - pos;
+    return std::string(data() + pos, len);
+}
@@ -0,0 +1,108 @@
+#ifndef NETWORKBUFFER_H
+#define NETWORKBUFFER_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Byte buffer for the data moving between a network protocol and the bus.
+ *
+ * Data is kept in one contiguous block, so the bus layer can send straight
+ * from data() and protocols can receive straight into prepare(). Consuming
+ * from the front only moves a read offset; the block is compacted or grown
+ * when a write runs out of room at the end, and it keeps its capacity
+ * between reads until shrink_to_fit().
+ *
+ * The contents are always followed by a NUL so c_str() works for logging
+ * and text protocols.
+ */
+class NetworkBuffer
+{
+private:
+    char *_buf = nullptr;
+    size_t _capacity = 0;
+    size_t _head = 0; // first byte of data
+    size_t _tail = 0; // one past the last byte of data
+
+    /**
+     * Make sure len more bytes (and the NUL) fit after the data.
+     */
+    void make_room(size_t len);
+
+public:
+    NetworkBuffer() {}
+    NetworkBuffer(const NetworkBuffer &) = delete;
+    NetworkBuffer &operator=(const NetworkBuffer &) = delete;
+    NetworkBuffer(NetworkBuffer &&other);
+    NetworkBuffer &operator=(NetworkBuffer &&other);
+    ~NetworkBuffer();
+
+    size_t size() const { return _tail - _head; }
+    size_t length() const { return _tail - _head; }
+    bool empty() const { return _tail == _head; }
+    size_t capacity() const { return _capacity; }
+
+    /**
+     * The data, contiguous and NUL terminated. Valid until the next write.
+     */
+    char *data() { return _buf != nullptr ? _buf + _head : (char *)""; }
+    const char *data() const { return _buf != nullptr ? _buf + _head : ""; }
+    const char *c_str() const { return data(); }
+
+    char &operator[](size_t pos) { return _buf[_head + pos]; }
+    char operator[](size_t pos) const { return _buf[_head + pos]; }
+
+    /**
+     * Reserve room for len bytes of data in total.
+     */
+    void reserve(size_t len);
+
+    /**
+     * Remove all data but keep the memory for the next use.
+     */
+    void clear();
+
+    /**
+     * Release memory not needed for the current data (all of it when empty).
+     */
+    void shrink_to_fit();
+
+    void append(const void *src, size_t len);
+    void append(const std::string &s) { append(s.data(), s.size()); }
+    NetworkBuffer &operator+=(const std::string &s)
+    {
+        append(s.data(), s.size());
+        return *this;
+    }
+
+    /**
+     * Replace the data with a copy of s.
+     */
+    void assign(const std::string &s);
+
+    /**
+     * Drop len bytes (or everything if there are fewer) from the front.
+     */
+    void consume(size_t len);
+
+    /**
+     * Keep only the first len bytes.
+     */
+    void truncate(size_t len);
+
+    /**
+     * Return room for len bytes after the data, to be filled in place and
+     * then added with commit().
+     */
+    char *prepare(size_t len);
+
+    /**
+     * Add len bytes written to the room returned by prepare().
+     */
+    void commit(size_t len);
+
+    std::string str() const { return std::string(data(), size()); }
+    std::string substr(size_t pos, size_t len = std::string::npos) const;
+};
+
+#endif /* NETWORKBUFFER_H */
@@ -29,17 +29,6 @@ using namespace std;
 #define ATASCII_TAB 0x7F
 #define ATASCII_BUZZER 0xFD
 
-#define STR_ASCII_BELL "\x07"
-#define STR_ASCII_BACKSPACE "\x08"
-#define STR_ASCII_TAB "\x09"
-#define STR_ASCII_LF "\x0a"
-#define STR_ASCII_CR "\x0d"
-#define STR_ASCII_CRLF "\x0d\x0a"
-#define STR_ATASCII_EOL "\x9b"
-#define STR_ATASCII_DEL "\x7e"
-#define STR_ATASCII_TAB "\x7f"
-#define STR_ATASCII_BUZZER "\xfd"
-
 /**
  * NWD
  * We only have 2 bits for translations (see NetworkProtocol::open)
@@ -51,10 +40,8 @@ using namespace std;
 
 #ifdef BUILD_APPLE
 #define EOL 0x0D
-#define STR_EOL "\x0d"
 #else
 #define EOL 0x9B
-#define STR_EOL "\x9b"
 #endif
 
 
@@ -64,14 +51,156 @@ using namespace std;
 #define TRANSLATION_MODE_CRLF 3
 #define TRANSLATION_MODE_PETSCII 4
 
+/**
+ * End of line translation tables, one per mode, built at compile time.
+ * Each maps every byte to its replacement for the 1:1 substitutions;
+ * dropping LF (receive CR/LF) and expanding EOL (transmit CR/LF) are done
+ * by the loops below as they go through the table.
+ */
+struct translation_table
+{
+    uint8_t map[256];
+};
+
+static constexpr translation_table make_rx_table(int mode)
+{
+    translation_table t = {};
+    for (int i = 0; i < 256; i++)
+        t.map[i] = i;
+
+#ifdef BUILD_ATARI
+    t.map[ASCII_BELL] = ATASCII_BUZZER;
+    t.map[ASCII_BACKSPACE] = ATASCII_DEL;
+    t.map[ASCII_TAB] = ATASCII_TAB;
+#endif
+
+    if (mode == TRANSLATION_MODE_CR)
+        t.map[ASCII_CR] = EOL;
+    else if (mode == TRANSLATION_MODE_LF)
+        t.map[ASCII_LF] = EOL;
+#ifndef BUILD_APPLE
+    // With Apple2, we would be translating CR to CR
+    else if (mode == TRANSLATION_MODE_CRLF)
+        t.map[ASCII_CR] = EOL;
+#endif
+    return t;
+}
+
+static constexpr translation_table make_tx_table(int mode)
+{
+    translation_table t = {};
+    for (int i = 0; i < 256; i++)
+        t.map[i] = i;
+
+#ifdef BUILD_ATARI
+    t.map[ATASCII_BUZZER] = ASCII_BELL;
+    t.map[ATASCII_DEL] = ASCII_BACKSPACE;
+    t.map[ATASCII_TAB] = ASCII_TAB;
+#endif
+
+    if (mode == TRANSLATION_MODE_CR || mode == TRANSLATION_MODE_CRLF)
+        t.map[EOL] = ASCII_CR;
+    else if (mode == TRANSLATION_MODE_LF)
+        t.map[EOL] = ASCII_LF;
+    return t;
+}
+
+// Index 0 has only the ATASCII control characters, for PETSCII and unknown modes
+static constexpr translation_table rx_tables[] = {
+    make_rx_table(TRANSLATION_MODE_NONE),
+    make_rx_table(TRANSLATION_MODE_CR),
+    make_rx_table(TRANSLATION_MODE_LF),
+    make_rx_table(TRANSLATION_MODE_CRLF),
+};
+
+static constexpr translation_table tx_tables[] = {
+    make_tx_table(TRANSLATION_MODE_NONE),
+    make_tx_table(TRANSLATION_MODE_CR),
+    make_tx_table(TRANSLATION_MODE_LF),
+    make_tx_table(TRANSLATION_MODE_CRLF),
+};
+
+/**
+ * Translate buf in place for receive. CR/LF mode also drops every LF,
+ * compacting as it goes. Returns the new length.
+ */
+template <int MODE>
+static size_t translate_rx(uint8_t *buf, size_t len)
+{
+    const uint8_t *map = rx_tables[MODE <= TRANSLATION_MODE_CRLF ? MODE : 0].map;
+
+    if (MODE != TRANSLATION_MODE_CRLF)
+    {
+        for (size_t i = 0; i < len; i++)
+            buf[i] = map[buf[i]];
+        return len;
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t c = buf[i];
+        buf[out] = map[c];
+        out += (c != ASCII_LF);
+    }
+    return out;
+}
+
+/**
+ * Translate the transmit buffer in place. CR/LF mode turns each EOL into two
+ * bytes, so the buffer grows by the EOL count and is filled from the back.
+ */
+template <int MODE>
+static void translate_tx(NetworkBuffer *tx)
+{
+    const uint8_t *map = tx_tables[MODE <= TRANSLATION_MODE_CRLF ? MODE : 0].map;
+    size_t len = tx->length();
+    uint8_t *buf = (uint8_t *)tx->data();
+
+    size_t eols = 0;
+    if (MODE == TRANSLATION_MODE_CRLF)
+        eols = std::count(buf, buf + len, (uint8_t)EOL);
+
+    if (eols == 0)
+    {
+        for (size_t i = 0; i < len; i++)
+            buf[i] = map[buf[i]];
+        return;
+    }
+
+    tx->prepare(eols);
+    tx->commit(eols);
+    buf = (uint8_t *)tx->data();
+
+    uint8_t *src = buf + len;
+    uint8_t *dst = buf + len + eols;
+    while (src != dst)
+    {
+        uint8_t c = *--src;
+        if (c == EOL)
+        {
+            *--dst = ASCII_LF;
+            *--dst = ASCII_CR;
+        }
+        else
+            *--dst = map[c];
+    }
+    // Everything before the first EOL is still in place
+    for (; src != buf;)
+    {
+        --src;
+        *src = map[*src];
+    }
+}
+
 /**
  * ctor - Initialize network protocol object.
  * @param rx_buf pointer to receive buffer
  * @param tx_buf pointer to transmit buffer
  * @param sp_buf pointer to special buffer
  */
-NetworkProtocol::NetworkProtocol(std::string *rx_buf,
-                                 std::string *tx_buf,
+NetworkProtocol::NetworkProtocol(NetworkBuffer *rx_buf,
+                                 NetworkBuffer *tx_buf,
                                  std::string *sp_buf)
 {
 #ifdef VERBOSE_PROTOCOL
@@ -203,36 +332,35 @@ void NetworkProtocol::translate_receive_buffer()
     if (translation_mode == 0)
         return;
 
-    #ifdef BUILD_ATARI
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BELL, ATASCII_BUZZER);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BACKSPACE, ATASCII_DEL);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_TAB, ATASCII_TAB);
-    #endif   
+    uint8_t *rx = (uint8_t *)receiveBuffer->data();
+    size_t len = receiveBuffer->length();
 
     switch (translation_mode)
     {
     case TRANSLATION_MODE_CR:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
+        translate_rx<TRANSLATION_MODE_CR>(rx, len);
         break;
     case TRANSLATION_MODE_LF:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_LF, EOL);
+        translate_rx<TRANSLATION_MODE_LF>(rx, len);
         break;
     case TRANSLATION_MODE_CRLF:
-    #ifndef BUILD_APPLE
-        // With Apple2, we would be translating CR to CR; a waste of CPU
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
-    #endif
+        receiveBuffer->truncate(translate_rx<TRANSLATION_MODE_CRLF>(rx, len));
         break;
     case TRANSLATION_MODE_PETSCII:
 #ifdef VERBOSE_PROTOCOL
         Debug_printf("!!! PETSCII !!!\r\n");
 #endif
-        *receiveBuffer = mstr::toUTF8(*receiveBuffer);
+#ifdef BUILD_ATARI
+        translate_rx<TRANSLATION_MODE_NONE>(rx, len);
+#endif
+        receiveBuffer->assign(mstr::toUTF8(receiveBuffer->str()));
+        break;
+    default:
+#ifdef BUILD_ATARI
+        translate_rx<TRANSLATION_MODE_NONE>(rx, len);
+#endif
         break;
     }
-
-    if (translation_mode == TRANSLATION_MODE_CRLF)
-        receiveBuffer->erase(std::remove(receiveBuffer->begin(), receiveBuffer->end(), '\n'), receiveBuffer->end());
 }
 
 /**
@@ -247,25 +375,27 @@ unsigned short NetworkProtocol::translate_transmit_buffer()
     if (translation_mode == 0)
         return transmitBuffer->length();
 
-    #ifdef BUILD_ATARI
-    util_replaceAll(*transmitBuffer, STR_ATASCII_BUZZER, STR_ASCII_BELL);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_DEL, STR_ASCII_BACKSPACE);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_TAB, STR_ASCII_TAB);
-    #endif
-
     switch (translation_mode)
     {
     case TRANSLATION_MODE_CR:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CR);
+        translate_tx<TRANSLATION_MODE_CR>(transmitBuffer);
         break;
     case TRANSLATION_MODE_LF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_LF);
+        translate_tx<TRANSLATION_MODE_LF>(transmitBuffer);
         break;
     case TRANSLATION_MODE_CRLF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CRLF);
+        translate_tx<TRANSLATION_MODE_CRLF>(transmitBuffer);
         break;
     case TRANSLATION_MODE_PETSCII:
-        *transmitBuffer = mstr::toUTF8(*transmitBuffer);
+#ifdef BUILD_ATARI
+        translate_tx<TRANSLATION_MODE_NONE>(transmitBuffer);
+#endif
+        transmitBuffer->assign(mstr::toUTF8(transmitBuffer->str()));
+        break;
+    default:
+#ifdef BUILD_ATARI
+        translate_tx<TRANSLATION_MODE_NONE>(transmitBuffer);
+#endif
         break;
     }
 
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "bus.h"
+#include "NetworkBuffer.h"
 #include "networkStatus.h"
 #include "peoples_url_parser.h"
 
@@ -19,12 +20,12 @@ public:
     /**
      * Pointer to the receive buffer
      */
-    std::string *receiveBuffer = nullptr;
+    NetworkBuffer *receiveBuffer = nullptr;
 
     /**
      * Pointer to the transmit buffer
      */
-    std::string *transmitBuffer = nullptr;
+    NetworkBuffer *transmitBuffer = nullptr;
 
     /**
      * Pointer to the transmit buffer
@@ -42,7 +43,7 @@ public:
      * @param tx_buf pointer to transmit buffer
      * @param sp_buf pointer to special buffer
      */
-    NetworkProtocol(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf);
+    NetworkProtocol(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf);
 
     /**
      * dtor - Tear down network protocol object
@@ -12,7 +12,7 @@
 
 #define RXBUF_SIZE 65535
 
-NetworkProtocolSSH::NetworkProtocolSSH(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolSSH::NetworkProtocolSSH(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     Debug_printf("NetworkProtocolSSH::NetworkProtocolSSH(%p,%p,%p)\r\n", rx_buf, tx_buf, sp_buf);
@@ -235,7 +235,7 @@ bool NetworkProtocolSSH::write(unsigned short len)
 
     // Return success - WTF?
     error = 1;
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
 
     return err;
 }
@@ -277,7 +277,7 @@ unsigned short NetworkProtocolSSH::available()
         if (ssh_channel_is_eof(channel) == 0)
         {
             int len = ssh_channel_read(channel, rxbuf, RXBUF_SIZE, 0);
-            if (len != SSH_AGAIN)
+            if (len > 0) // not SSH_AGAIN or SSH_ERROR
             {
                 receiveBuffer->append(rxbuf, len);
                 translate_receive_buffer();
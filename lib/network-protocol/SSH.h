@@ -29,7 +29,7 @@ public:
     /**
      * ctor
      */
-    NetworkProtocolSSH(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf);
+    NetworkProtocolSSH(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf);
 
     /**
      * dtor
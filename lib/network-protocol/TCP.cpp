@@ -25,7 +25,7 @@
  * @param sp_buf pointer to special buffer
  * @return a NetworkProtocolTCP object
  */
-NetworkProtocolTCP::NetworkProtocolTCP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolTCP::NetworkProtocolTCP(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     Debug_printf("NetworkProtocolTCP::ctor\r\n");
@@ -115,7 +115,6 @@ bool NetworkProtocolTCP::close()
 bool NetworkProtocolTCP::read(unsigned short len)
 {
     unsigned short actual_len = 0;
-    std::vector<uint8_t> newData = std::vector<uint8_t>(len);
 
     Debug_printf("NetworkProtocolTCP::read(%u)\r\n", len);
 
@@ -128,8 +127,8 @@ bool NetworkProtocolTCP::read(unsigned short len)
             return true; // error
         }
 
-        // Do the read from client socket.
-        actual_len = client.read(newData.data(), len);
+        // Do the read from client socket, straight into the buffer.
+        actual_len = client.read((uint8_t *)receiveBuffer->prepare(len), len);
 
         // bail if the connection is reset.
         if (errno == ECONNRESET)
@@ -144,8 +143,8 @@ bool NetworkProtocolTCP::read(unsigned short len)
             return true;
         }
 
-        // Add new data to buffer.
-        receiveBuffer->insert(receiveBuffer->end(), newData.begin(), newData.end());
+        // Add what was actually read to the buffer.
+        receiveBuffer->commit(actual_len);
     }    
     error = 1;
     return NetworkProtocol::read(len);
@@ -190,7 +189,7 @@ bool NetworkProtocolTCP::write(unsigned short len)
 
     // Return success
     error = 1;
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
 
     return false;
 }
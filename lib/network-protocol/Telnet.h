@@ -14,7 +14,7 @@ public:
     /**
      * ctor
      */
-    NetworkProtocolTELNET(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf);
+    NetworkProtocolTELNET(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf);
 
     /**
      * dtor
@@ -38,12 +38,12 @@ public:
     /**
      * Get Receive Buffer
      */
-    std::string *getReceiveBuffer() { return receiveBuffer; }
+    NetworkBuffer *getReceiveBuffer() { return receiveBuffer; }
 
     /**
      * Get Transmit buffer
      */
-    std::string *getTransmitBuffer() { return transmitBuffer; }
+    NetworkBuffer *getTransmitBuffer() { return transmitBuffer; }
 
     /**
      * Flush output transmitBuffer
@@ -8,7 +8,7 @@
 
 #include <vector>
 
-NetworkProtocolTest::NetworkProtocolTest(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
+NetworkProtocolTest::NetworkProtocolTest(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
     : NetworkProtocol(rx_buf, tx_buf, sp_buf)
 {
     Debug_printf("NetworkProtocolTest::NetworkProtocolTest(%p,%p,%p)\r\n", rx_buf, tx_buf, sp_buf);
@@ -68,7 +68,7 @@ bool NetworkProtocolTest::read(unsigned short len)
 
     Debug_printf("NetworkProtocolTest::read(%u)\r\n", len);
     for (int i = 0; i < receiveBuffer->length(); i++)
-        Debug_printf("%02x ", (unsigned char)receiveBuffer->at(i));
+        Debug_printf("%02x ", (unsigned char)(*receiveBuffer)[i]);
     Debug_printf("\r\n");
 
     return NetworkProtocol::read(len);
@@ -80,17 +80,17 @@ bool NetworkProtocolTest::write(unsigned short len)
 
     Debug_printf("NetworkProtocolTest::write(%u) - Before translate_transmit_buffer()", len);
     for (int i = 0; i < len; i++)
-        Debug_printf("%02x ", (unsigned char)transmitBuffer->at(i));
+        Debug_printf("%02x ", (unsigned char)(*transmitBuffer)[i]);
     Debug_printf("\r\n");
 
     len = translate_transmit_buffer();
 
     Debug_printf("NetworkProtocolTest::write(%u) - After translate_transmit_buffer()", len);
     for (int i = 0; i < len; i++)
-        Debug_printf("%02x ", (unsigned char)transmitBuffer->at(i));
+        Debug_printf("%02x ", (unsigned char)(*transmitBuffer)[i]);
     Debug_printf("\r\n");
 
-    transmitBuffer->erase(0, len);
+    transmitBuffer->consume(len);
 
     return err;
 }
@@ -43,11 +43,11 @@ void atari1029::print_8bit_gfx(uint8_t c)
     // e.g., [(0)100(1)100(4)100(50)]TJ
     // lead with '0' to enter a space
     // then shift back with 133 and print each pin
-    fprintf(_file, "0");
+    pdf_printf("0");
     for (unsigned i = 0; i < 7; i++)
     {
         if ((c >> i) & 0x01)
-            fprintf(_file, ")100(%u", i + 1);
+            pdf_printf(")100(%u", i + 1);
     }
 }
 
@@ -140,14 +140,14 @@ void atari1029::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             if (epson_cmd.ctr == 2)
             {
                 charWidth = 1.2;
-                fprintf(_file, ")]TJ /F5 12 Tf [("); // set font to GFX mode
+                pdf_printf(")]TJ /F5 12 Tf [("); // set font to GFX mode
                 fontUsed[4] = true;
             }
 
             if (epson_cmd.ctr > 2)
             {
                 print_8bit_gfx(c);
-                //fprintf(_file, "]TJ [(");
+                //pdf_printf("]TJ [(");
                 if (epson_cmd.ctr == (epson_cmd.N + 2))
                 {
                     // reset font
@@ -217,7 +217,7 @@ void atari1029::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
                     }
                 if (valid)
                 {
-                    fputc(d, _file);
+                    pdf_putc(d);
                     pdf_X += charWidth; // update x position
                 }
             }
@@ -229,8 +229,8 @@ void atari1029::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             else if (c > 31 && c < 127)
             {
                 if (c == '\\' || c == '(' || c == ')')
-                    fputc('\\', _file);
-                fputc(c, _file);
+                    pdf_putc('\\');
+                pdf_putc(c);
                 pdf_X += charWidth; // update x position
             }
         }
@@ -255,7 +255,7 @@ double atari1029::epson_font_width(uint16_t code)
 
 void atari1029::epson_set_font(uint8_t F, double w)
 {
-    fprintf(_file, ")]TJ /F%u 12 Tf [(", F);
+    pdf_printf(")]TJ /F%u 12 Tf [(", F);
     charWidth = w;
     fontNumber = F;
     fontUsed[F - 1] = true;
@@ -49,7 +49,7 @@ void xdm121::xdm_set_font(uint8_t F)
 {
     double p = (charWidth - charPitch);
     back_spacing = (int)(600. * (1 + p / charPitch));
-    fprintf(_file, ")]TJ /F%u %d Tf %g Tc [(", F, (int)wheelSize, p);
+    pdf_printf(")]TJ /F%u %d Tf %g Tc [(", F, (int)wheelSize, p);
     fontNumber = F;
     fontUsed[F - 1] = true;
 }
@@ -93,7 +93,7 @@ void xdm121::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
         {
             // if (epson_font_mask & fnt_proportional)
             // {
-            //     fprintf(_file, " )%d(", (int)(280 - epson_cmd.cmd * 40));
+            //     pdf_printf(" )%d(", (int)(280 - epson_cmd.cmd * 40));
             //     pdf_X += 0.48 * (double)epson_cmd.cmd;
             // }
         case 9: // XDM absolute horizontal tab
@@ -205,7 +205,7 @@ void xdm121::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             switch (c)
             {
             case 8: // XDM Backspace. Empties printer buffer, then backspaces print head one space
-                fprintf(_file, ")%d(", back_spacing);
+                pdf_printf(")%d(", back_spacing);
                 pdf_X -= charPitch; // update x position
                 break;
             case 9: // XDM Horizontal Tabulation. Print head moves to next tab stop
@@ -286,8 +286,8 @@ void xdm121::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
                 default:
                     break;
                 }
-                fputc(d1, _file);
-                fprintf(_file, ")%d(", back_spacing); // |^ -< -> !v
+                pdf_putc(d1);
+                pdf_printf(")%d(", back_spacing); // |^ -< -> !v
                 valid = true;
             }
             else
@@ -309,9 +309,9 @@ void xdm121::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             }
             if (valid)
             {
-                fputc(d, _file);
+                pdf_putc(d);
                 if (epson_font_mask & fnt_underline)
-                    fprintf(_file, ")%d(_", back_spacing); // close text string, backspace, start new text string, write _
+                    pdf_printf(")%d(_", back_spacing); // close text string, backspace, start new text string, write _
 
                 pdf_X += charWidth; // update x position
             }
@@ -321,11 +321,11 @@ void xdm121::pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2)
             if (c == 123 || c == 125 || c == 127)
                 c = ' ';
             if (c == '\\' || c == '(' || c == ')')
-                fputc('\\', _file);
-            fputc(c, _file);
+                pdf_putc('\\');
+            pdf_putc(c);
 
             if (epson_font_mask & fnt_underline)
-                fprintf(_file, ")%d(_", back_spacing); // close text string, backspace, start new text string, write _
+                pdf_printf(")%d(_", back_spacing); // close text string, backspace, start new text string, write _
 
             pdf_X += charWidth; // update x position
         }
@@ -0,0 +1,404 @@
+#include "deflate_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+#include "../../include/debug.h"
+
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_SIZE (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_NIL 0xFFFF
+
+#define ADLER_BASE 65521
+#define ADLER_NMAX 5552 // Most bytes that can be summed before s2 could overflow 32 bits
+
+/*
+  Lookup tables, built by the compiler so they end up in flash rather than RAM
+*/
+struct crc32_tables
+{
+    // Slice-by-8: t[k][b] is the CRC of byte b followed by k zero bytes
+    uint32_t t[8][256];
+
+    constexpr crc32_tables() : t()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            uint32_t rem = i;
+            for (int j = 0; j < 8; j++)
+                rem = (rem & 1) ? (rem >> 1) ^ 0xEDB88320 : rem >> 1;
+            t[0][i] = rem;
+        }
+        for (int i = 0; i < 256; i++)
+            for (int k = 1; k < 8; k++)
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+    }
+};
+
+static constexpr crc32_tables _crc32;
+
+struct deflate_tables
+{
+    // Length 3..258 -> length symbol - 257, distance -> distance symbol
+    uint8_t length_code[256];
+    uint8_t dist_code[512]; // distances 1..256 by distance - 1, the rest by (distance - 1) >> 7
+    uint16_t length_base[29];
+    uint16_t dist_base[30];
+    uint8_t length_extra[29];
+    uint8_t dist_extra[30];
+
+    constexpr deflate_tables() : length_code(), dist_code(), length_base(), dist_base(), length_extra(), dist_extra()
+    {
+        int length = 3;
+        for (int code = 0; code < 28; code++)
+        {
+            length_extra[code] = code < 8 ? 0 : (code - 4) / 4;
+            length_base[code] = length;
+            for (int i = 0; i < (1 << length_extra[code]); i++)
+                length_code[length++ - 3] = code;
+        }
+        // 258 has a symbol of its own, and would otherwise be coded by 284 + 31
+        length_extra[28] = 0;
+        length_base[28] = 258;
+        length_code[255] = 28;
+
+        int dist = 1;
+        for (int code = 0; code < 30; code++)
+        {
+            dist_extra[code] = code < 4 ? 0 : (code - 2) / 2;
+            dist_base[code] = dist;
+            for (int i = 0; i < (1 << dist_extra[code]); i++, dist++)
+            {
+                if (dist <= 256)
+                    dist_code[dist - 1] = code;
+                else
+                    dist_code[256 + ((dist - 1) >> 7)] = code;
+            }
+        }
+    }
+};
+
+static constexpr deflate_tables _deflate;
+
+static inline uint32_t _le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+    crc = ~crc;
+
+    // Eight bytes per step through eight tables instead of one at a time through one
+    while (len >= 8)
+    {
+        uint32_t one = _le32(buf) ^ crc;
+        uint32_t two = _le32(buf + 4);
+        crc = _crc32.t[7][one & 0xFF] ^
+              _crc32.t[6][(one >> 8) & 0xFF] ^
+              _crc32.t[5][(one >> 16) & 0xFF] ^
+              _crc32.t[4][one >> 24] ^
+              _crc32.t[3][two & 0xFF] ^
+              _crc32.t[2][(two >> 8) & 0xFF] ^
+              _crc32.t[1][(two >> 16) & 0xFF] ^
+              _crc32.t[0][two >> 24];
+        buf += 8;
+        len -= 8;
+    }
+    while (len-- > 0)
+        crc = (crc >> 8) ^ _crc32.t[0][(crc ^ *buf++) & 0xFF];
+
+    return ~crc;
+}
+
+uint32_t adler32_update(uint32_t adler, const uint8_t *buf, size_t len)
+{
+    uint32_t s1 = adler & 0xFFFF;
+    uint32_t s2 = adler >> 16;
+
+    // Sums can run for ADLER_NMAX bytes before the modulo is needed
+    while (len > 0)
+    {
+        size_t n = len < ADLER_NMAX ? len : ADLER_NMAX;
+        len -= n;
+        while (n >= 8)
+        {
+            s1 += buf[0]; s2 += s1;
+            s1 += buf[1]; s2 += s1;
+            s1 += buf[2]; s2 += s1;
+            s1 += buf[3]; s2 += s1;
+            s1 += buf[4]; s2 += s1;
+            s1 += buf[5]; s2 += s1;
+            s1 += buf[6]; s2 += s1;
+            s1 += buf[7]; s2 += s1;
+            buf += 8;
+            n -= 8;
+        }
+        while (n-- > 0)
+        {
+            s1 += *buf++;
+            s2 += s1;
+        }
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+    }
+
+    return (s2 << 16) | s1;
+}
+
+static inline uint32_t _reverse_bits(uint32_t code, int count)
+{
+    uint32_t r = 0;
+    while (count-- > 0)
+    {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+static inline uint32_t _hash(const uint8_t *p)
+{
+    return ((((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+bool deflateStream::begin(output_fn output, void *arg)
+{
+    end();
+
+    size_t size = 2 * DEFLATE_WINDOW_SIZE + (DEFLATE_HASH_SIZE + DEFLATE_WINDOW_SIZE) * sizeof(uint16_t);
+#ifdef ESP_PLATFORM
+    _window = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+#else
+    _window = (uint8_t *)malloc(size);
+#endif
+    if (_window == nullptr)
+    {
+        Debug_println("deflateStream: not enough memory for the window");
+        return false;
+    }
+    _head = (uint16_t *)(_window + 2 * DEFLATE_WINDOW_SIZE);
+    _prev = _head + DEFLATE_HASH_SIZE;
+    for (int i = 0; i < DEFLATE_HASH_SIZE; i++)
+        _head[i] = DEFLATE_NIL;
+
+    _output = output;
+    _output_arg = arg;
+    _fill = 0;
+    _pos = 0;
+    _adler = 1;
+    _bits = 0;
+    _bitcount = 0;
+    _out_len = 0;
+
+    // zlib header: deflate with the window size, "fast" level, check bits making it a multiple of 31
+    uint8_t cmf = 0x08 | ((DEFLATE_WINDOW_BITS - 8) << 4);
+    uint8_t flg = 1 << 6;
+    flg += 31 - ((cmf * 256 + flg) % 31);
+    put_bits(cmf, 8);
+    put_bits(flg, 8);
+
+    // Everything goes in one fixed Huffman block, which has no length limit: BFINAL = 1, BTYPE = 01
+    put_bits(1, 1);
+    put_bits(1, 2);
+
+    return true;
+}
+
+void deflateStream::end()
+{
+    free(_window);
+    _window = nullptr;
+    _head = nullptr;
+    _prev = nullptr;
+    _output = nullptr;
+}
+
+void deflateStream::flush_out()
+{
+    if (_out_len > 0 && _output != nullptr)
+        _output(_output_arg, _out, _out_len);
+    _out_len = 0;
+}
+
+// Bits go out least significant first, as deflate packs them
+void deflateStream::put_bits(uint32_t value, int count)
+{
+    _bits |= value << _bitcount;
+    _bitcount += count;
+    while (_bitcount >= 8)
+    {
+        _out[_out_len++] = (uint8_t)_bits;
+        if (_out_len == DEFLATE_OUT_SIZE)
+            flush_out();
+        _bits >>= 8;
+        _bitcount -= 8;
+    }
+}
+
+// Fixed literal/length code (RFC 1951 3.2.6). Huffman codes are sent most significant bit first.
+void deflateStream::put_code(int symbol)
+{
+    if (symbol < 144)
+        put_bits(_reverse_bits(0x30 + symbol, 8), 8);
+    else if (symbol < 256)
+        put_bits(_reverse_bits(0x190 + symbol - 144, 9), 9);
+    else if (symbol < 280)
+        put_bits(_reverse_bits(symbol - 256, 7), 7);
+    else
+        put_bits(_reverse_bits(0xC0 + symbol - 280, 8), 8);
+}
+
+void deflateStream::put_match(int length, int distance)
+{
+    int lcode = _deflate.length_code[length - DEFLATE_MIN_MATCH];
+    put_code(257 + lcode);
+    if (_deflate.length_extra[lcode] > 0)
+        put_bits(length - _deflate.length_base[lcode], _deflate.length_extra[lcode]);
+
+    int dcode = distance <= 256 ? _deflate.dist_code[distance - 1] : _deflate.dist_code[256 + ((distance - 1) >> 7)];
+    put_bits(_reverse_bits(dcode, 5), 5);
+    if (_deflate.dist_extra[dcode] > 0)
+        put_bits(distance - _deflate.dist_base[dcode], _deflate.dist_extra[dcode]);
+}
+
+void deflateStream::insert_hash(size_t pos)
+{
+    if (pos + DEFLATE_MIN_MATCH > _fill)
+        return;
+    uint32_t h = _hash(_window + pos);
+    _prev[pos & (DEFLATE_WINDOW_SIZE - 1)] = _head[h];
+    _head[h] = (uint16_t)pos;
+}
+
+/*
+  Longest earlier string matching the one at pos, no more than DEFLATE_MAX_CHAIN candidates back.
+  Returns its length (0 if under DEFLATE_MIN_MATCH) and sets distance.
+*/
+int deflateStream::longest_match(size_t pos, int &distance)
+{
+    size_t avail = _fill - pos;
+    int limit = avail < DEFLATE_MAX_MATCH ? (int)avail : DEFLATE_MAX_MATCH;
+    if (limit < DEFLATE_MIN_MATCH)
+        return 0;
+
+    const uint8_t *cur = _window + pos;
+    int best = DEFLATE_MIN_MATCH - 1;
+    uint16_t cand = _head[_hash(cur)];
+
+    for (int chain = DEFLATE_MAX_CHAIN; chain > 0 && cand != DEFLATE_NIL && cand < pos; chain--)
+    {
+        size_t dist = pos - cand;
+        if (dist > DEFLATE_WINDOW_SIZE)
+            break;
+
+        const uint8_t *m = _window + cand;
+        // Can't beat the best so far unless the byte that would extend it matches too
+        if (m[best] == cur[best] && m[0] == cur[0] && m[1] == cur[1])
+        {
+            int len = 2;
+            while (len < limit && m[len] == cur[len])
+                len++;
+            if (len > best)
+            {
+                best = len;
+                distance = (int)dist;
+                if (len == limit)
+                    break;
+            }
+        }
+        cand = _prev[cand & (DEFLATE_WINDOW_SIZE - 1)];
+    }
+
+    return best >= DEFLATE_MIN_MATCH ? best : 0;
+}
+
+// Drops the older half of the window, keeping DEFLATE_WINDOW_SIZE bytes of history behind _pos
+void deflateStream::slide()
+{
+    memmove(_window, _window + DEFLATE_WINDOW_SIZE, _fill - DEFLATE_WINDOW_SIZE);
+    _fill -= DEFLATE_WINDOW_SIZE;
+    _pos -= DEFLATE_WINDOW_SIZE;
+
+    for (int i = 0; i < DEFLATE_HASH_SIZE; i++)
+        _head[i] = (_head[i] != DEFLATE_NIL && _head[i] >= DEFLATE_WINDOW_SIZE) ? _head[i] - DEFLATE_WINDOW_SIZE : DEFLATE_NIL;
+    for (int i = 0; i < DEFLATE_WINDOW_SIZE; i++)
+        _prev[i] = (_prev[i] != DEFLATE_NIL && _prev[i] >= DEFLATE_WINDOW_SIZE) ? _prev[i] - DEFLATE_WINDOW_SIZE : DEFLATE_NIL;
+}
+
+/*
+  Codes the window up to the last DEFLATE_MAX_MATCH bytes, which are kept back so a match
+  isn't cut short by data that hasn't arrived yet - or all of it when finishing
+*/
+void deflateStream::compress(bool finish)
+{
+    while (_pos < _fill)
+    {
+        if (!finish && _fill - _pos < DEFLATE_MAX_MATCH)
+            break;
+
+        int distance = 0;
+        int len = longest_match(_pos, distance);
+        if (len == 0)
+        {
+            put_code(_window[_pos]);
+            insert_hash(_pos);
+            _pos++;
+            continue;
+        }
+
+        put_match(len, distance);
+        for (int i = 0; i < len; i++)
+            insert_hash(_pos++);
+    }
+}
+
+void deflateStream::write(const uint8_t *data, size_t len)
+{
+    if (_window == nullptr)
+        return;
+
+    _adler = adler32_update(_adler, data, len);
+
+    while (len > 0)
+    {
+        if (_fill == 2 * DEFLATE_WINDOW_SIZE)
+        {
+            compress(false);
+            slide();
+        }
+        size_t n = 2 * DEFLATE_WINDOW_SIZE - _fill;
+        if (n > len)
+            n = len;
+        memcpy(_window + _fill, data, n);
+        _fill += n;
+        data += n;
+        len -= n;
+    }
+    compress(false);
+}
+
+void deflateStream::finish()
+{
+    if (_window == nullptr)
+        return;
+
+    compress(true);
+    put_code(256); // end of block
+
+    // Pad to a byte boundary, then the Adler-32 of the uncompressed data, most significant byte first
+    if (_bitcount > 0)
+        put_bits(0, 8 - _bitcount);
+    put_bits((_adler >> 24) & 0xFF, 8);
+    put_bits((_adler >> 16) & 0xFF, 8);
+    put_bits((_adler >> 8) & 0xFF, 8);
+    put_bits(_adler & 0xFF, 8);
+
+    flush_out();
+    end();
+}
@@ -0,0 +1,69 @@
+#ifndef DEFLATE_STREAM_H
+#define DEFLATE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Streaming zlib (RFC 1950/1951) compressor for the PNG printer.
+
+  Greedy LZ77 over a small sliding window, coded with the fixed Huffman
+  tables so no block has to be buffered to build its own. Input can be
+  fed in any amount; compressed output collects in a fixed buffer that is
+  handed to the owner whenever it fills, so memory use doesn't depend on
+  the image size.
+*/
+
+#define DEFLATE_WINDOW_BITS 12
+#define DEFLATE_WINDOW_SIZE (1 << DEFLATE_WINDOW_BITS) // 4 KB, more than ten 320 pixel rows
+#define DEFLATE_HASH_BITS 11
+#define DEFLATE_MAX_CHAIN 32 // Match candidates tried per position
+#define DEFLATE_OUT_SIZE 4096
+
+// Running checksums; pass 0 / 1 respectively to start
+uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t len);
+uint32_t adler32_update(uint32_t adler, const uint8_t *buf, size_t len);
+
+class deflateStream
+{
+public:
+    // Receives each full output buffer, and the rest at finish()
+    typedef void (*output_fn)(void *arg, const uint8_t *data, size_t len);
+
+private:
+    output_fn _output = nullptr;
+    void *_output_arg = nullptr;
+
+    uint8_t *_window = nullptr; // 2 * DEFLATE_WINDOW_SIZE, input being matched against
+    uint16_t *_head = nullptr;  // last position for each hash
+    uint16_t *_prev = nullptr;  // previous position with the same hash, by position in the window
+    size_t _fill = 0;           // bytes in _window
+    size_t _pos = 0;            // next byte to code
+
+    uint32_t _adler = 1;
+    uint32_t _bits = 0;
+    int _bitcount = 0;
+    uint8_t _out[DEFLATE_OUT_SIZE];
+    size_t _out_len = 0;
+
+    void put_bits(uint32_t value, int count);
+    void put_code(int symbol);
+    void put_match(int length, int distance);
+    void flush_out();
+    void insert_hash(size_t pos);
+    int longest_match(size_t pos, int &distance);
+    void slide();
+    void compress(bool finish);
+
+public:
+    ~deflateStream() { end(); };
+
+    // Allocates the window and writes the zlib header. Returns false if out of memory.
+    bool begin(output_fn output, void *arg);
+    void write(const uint8_t *data, size_t len);
+    // Codes what's left, closes the stream and hands out the last of the output
+    void finish();
+    void end();
+};
+
+#endif // DEFLATE_STREAM_H
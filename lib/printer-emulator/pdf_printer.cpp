@@ -1,7 +1,10 @@
 #include "pdf_printer.h"
 
+#include <stdarg.h>
+
 #include "../../include/debug.h"
 
+
 #include "fsFlash.h"
 
 #include "utils.h"
@@ -12,10 +15,14 @@ void pdfPrinter::pdf_header()
     pdf_Y = 0;
     pdf_X = 0;
     pdf_pageCounter = 0;
+    pageObjects.clear();
+    objLocations.clear();
+    pageContent.clear();
+    pageOpen = false;
     fprintf(_file, "%%PDF-1.4\n");
     // first object: catalog of pages
     pdf_objCtr = 1;
-    objLocations[pdf_objCtr] = ftell(_file);
+    pdf_set_location(pdf_objCtr);
     fprintf(_file, "1 0 obj\n<</Type /Catalog /Pages 2 0 R>>\nendobj\n");
     // object 2 0 R is printed by pdf_page_resource() before xref
     // object 3 0 R is printed at pdf_font_resource() before xref
@@ -24,7 +31,7 @@ void pdfPrinter::pdf_header()
 
 void pdfPrinter::pdf_page_resource()
 {
-    objLocations[2] = ftell(_file); // hard code page catalog as object #2
+    pdf_set_location(2); // hard code page catalog as object #2
     fprintf(_file, "2 0 obj\n<</Type /Pages /Kids [ ");
     for (int i = 0; i < pdf_pageCounter; i++)
     {
@@ -36,7 +43,7 @@ void pdfPrinter::pdf_page_resource()
 void pdfPrinter::pdf_font_resource()
 {
     int fntCtr = 0;
-    objLocations[3] = ftell(_file);
+    pdf_set_location(3);
     // font catalog
     fprintf(_file, "3 0 obj\n<</Font <<");
     for (int i = 0; i < MAXFONTS; i++)
@@ -87,80 +94,52 @@ void pdfPrinter::pdf_add_fonts() // pdfFont_t *fonts[],
             fgetc(fff); // 'd'
             fp++;
             pdf_objCtr++; // = 6;
-            objLocations[pdf_objCtr] = ftell(_file);
+            pdf_set_location(pdf_objCtr);
             fprintf(_file, "%d", pdf_objCtr); // 6
-            while (fp < fontObjPos[0])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
+            pdf_copy_font(fff, fp, fontObjPos[0]);
             fgetc(fff); // '%'
             fp++;
             fgetc(fff); // 'd'
             fp++;
             fprintf(_file, "%d", pdf_objCtr + 1); // 7
-            while (fp < fontObjPos[1])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
+            pdf_copy_font(fff, fp, fontObjPos[1]);
             fgetc(fff); // '%'
             fp++;
             fgetc(fff); // 'd'
             fp++;
             fprintf(_file, "%d", pdf_objCtr + 3); // 9
-            while (fp < fontObjPos[2])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
+            pdf_copy_font(fff, fp, fontObjPos[2]);
             fgetc(fff); // '%'
             fp++;
             fgetc(fff); // 'd'
             fp++;
             pdf_objCtr++; // = 7;
-            objLocations[pdf_objCtr] = ftell(_file);
+            pdf_set_location(pdf_objCtr);
             fprintf(_file, "%d", pdf_objCtr); // 7
-            while (fp < fontObjPos[3])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
+            pdf_copy_font(fff, fp, fontObjPos[3]);
             fgetc(fff); // '%'
             fp++;
             fgetc(fff); // 'd'
             fp++;
             fprintf(_file, "%d", pdf_objCtr + 1); // 8
-            while (fp < fontObjPos[4])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
+            pdf_copy_font(fff, fp, fontObjPos[4]);
             fgetc(fff); // '%'
             fp++;
             fgetc(fff); // 'd'
             fp++;
             pdf_objCtr++; // = 8;
-            objLocations[pdf_objCtr] = ftell(_file);
+            pdf_set_location(pdf_objCtr);
             fprintf(_file, "%d", pdf_objCtr); // 8
-            while (fp < fontObjPos[5])
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
+            pdf_copy_font(fff, fp, fontObjPos[5]);
             fgetc(fff); // '%'
             fp++;
             fgetc(fff); // 'd'
             fp++;
             pdf_objCtr++; // = 9;
-            objLocations[pdf_objCtr] = ftell(_file);
+            pdf_set_location(pdf_objCtr);
             fprintf(_file, "%d", pdf_objCtr); // 9
             // insert rest of file
-            while (fp < fontObjPos[6]) //(fff.available())
-            {
-                fputc(fgetc(fff), _file);
-                fp++;
-            }
+            pdf_copy_font(fff, fp, fontObjPos[6]);
             fclose(fff);
             fputc('\n', _file); // make sure there's a seperator
         }
@@ -176,19 +155,17 @@ void pdfPrinter::pdf_new_page()
 { // open a new page
     Debug_println("pdf new page");
     pdf_objCtr++;
-    pageObjects[pdf_pageCounter] = pdf_objCtr;
-    objLocations[pdf_objCtr] = ftell(_file);
+    pageObjects.push_back(pdf_objCtr);
+    pdf_set_location(pdf_objCtr);
     fprintf(_file, "%d 0 obj\n<</Type /Page /Parent 2 0 R /Resources 3 0 R /MediaBox [0 0 %g %g] /Contents [ ", pdf_objCtr, pageWidth, pageHeight);
     pdf_objCtr++; // increment for the contents stream object
     fprintf(_file, "%d 0 R ", pdf_objCtr);
     fprintf(_file, "]>>\nendobj\n");
 
-    // open content stream
-    objLocations[pdf_objCtr] = ftell(_file);
-    fprintf(_file, "%d 0 obj\n<</Length ", pdf_objCtr);
-    idx_stream_length = ftell(_file);
-    fprintf(_file, "0000000000 >>\nstream\n");
-    idx_stream_start = ftell(_file);
+    // open content stream, written out by pdf_end_page()
+    pageContentObj = pdf_objCtr;
+    pageContent.clear();
+    pageOpen = true;
 
     // open new text object
     pdf_begin_text(pageHeight - topMargin);
@@ -198,10 +175,10 @@ void pdfPrinter::pdf_begin_text(double Y)
 {
     Debug_println("pdf begin text");
     // open new text object
-    fprintf(_file, "BT\n");
+    pdf_printf("BT\n");
     TOPflag = false;
-    fprintf(_file, "/F%u %g Tf %d Tz\n", fontNumber, fontSize, fontHorizScale);
-    fprintf(_file, "%g %g Td\n", leftMargin, Y);
+    pdf_printf("/F%u %g Tf %d Tz\n", fontNumber, fontSize, fontHorizScale);
+    pdf_printf("%g %g Td\n", leftMargin, Y);
     pdf_Y = Y; // reset print roller to top of page
     pdf_X = 0; // set carriage to LHS
     BOLflag = true;
@@ -213,11 +190,11 @@ void pdfPrinter::pdf_new_line()
 
     // position new line and start text string array
     if (pdf_dY != 0)
-        fprintf(_file, "0 Ts ");
+        pdf_printf("0 Ts ");
 #if !defined(BUILD_APPLE) && !defined(BUILD_RC2014)
     pdf_dY -= lineHeight;
 #endif
-    fprintf(_file, "0 %g Td [(", pdf_dY);
+    pdf_printf("0 %g Td [(", pdf_dY);
     pdf_Y += pdf_dY; // line feed
     pdf_dY = 0;
     // pdf_X = 0;              // CR over in end line()
@@ -227,7 +204,7 @@ void pdfPrinter::pdf_new_line()
 void pdfPrinter::pdf_end_line()
 {
     Debug_println("pdf end line");
-    fprintf(_file, ")]TJ\n"); // close the line
+    pdf_printf(")]TJ\n"); // close the line
     // pdf_Y -= lineHeight; // line feed - moved to new line()
     pdf_X = 0; // CR
     BOLflag = true;
@@ -237,7 +214,12 @@ void pdfPrinter::pdf_end_line()
 
 void pdfPrinter::pdf_set_rise()
 {
-    fprintf(_file, ")]TJ %g Ts [(", pdf_dY);
+    pdf_printf(")]TJ %g Ts [(", pdf_dY);
+}
+
+static void _pdf_deflate_out(void *arg, const uint8_t *data, size_t len)
+{
+    ((std::string *)arg)->append((const char *)data, len);
 }
 
 void pdfPrinter::pdf_end_page()
@@ -246,15 +228,38 @@ void pdfPrinter::pdf_end_page()
     // close text object & stream
     if (!BOLflag)
         pdf_end_line();
-    fprintf(_file, "ET\n");
-    idx_stream_stop = ftell(_file);
-    fprintf(_file, "endstream\nendobj\n");
-    size_t idx_temp = ftell(_file);
-    fflush(_file);
-    fseek(_file, idx_stream_length, SEEK_SET);
-    fprintf(_file, "%10u", (unsigned)(idx_stream_stop - idx_stream_start));
-    fflush(_file);
-    fseek(_file, idx_temp, SEEK_SET);
+    pdf_printf("ET\n");
+    pageOpen = false;
+
+    // write the whole stream at once now its length is known
+    std::string compressed;
+    if (compressStreams)
+    {
+        if (deflater == nullptr)
+            deflater = new deflateStream();
+        compressed.reserve(pageContent.size() / 2);
+        if (deflater->begin(_pdf_deflate_out, &compressed))
+        {
+            deflater->write((const uint8_t *)pageContent.data(), pageContent.size());
+            deflater->finish();
+        }
+    }
+
+    pdf_set_location(pageContentObj);
+    if (!compressed.empty())
+    {
+        fprintf(_file, "%d 0 obj\n<</Length %u /Filter /FlateDecode>>\nstream\n", pageContentObj, (unsigned)compressed.size());
+        fwrite(compressed.data(), 1, compressed.size(), _file);
+        fprintf(_file, "\nendstream\nendobj\n");
+    }
+    else
+    {
+        fprintf(_file, "%d 0 obj\n<</Length %u>>\nstream\n", pageContentObj, (unsigned)pageContent.size());
+        fwrite(pageContent.data(), 1, pageContent.size(), _file);
+        fprintf(_file, "endstream\nendobj\n");
+    }
+    pageContent.clear();
+
     // set counters
     pdf_pageCounter++;
     TOPflag = true;
@@ -267,10 +272,10 @@ void pdfPrinter::pdf_xref()
     pdf_objCtr++;
     fprintf(_file, "xref\n");
     fprintf(_file, "0 %d\n", pdf_objCtr);
-    fprintf(_file, "0000000000 65535 f\n");
+    fprintf(_file, "0000000000 65535 f \n");
     for (int i = 1; i < pdf_objCtr; i++)
     {
-        fprintf(_file, "%010u 00000 n\n", (unsigned)objLocations[i]);
+        fprintf(_file, "%010u 00000 n \n", (unsigned)(i < (int)objLocations.size() ? objLocations[i] : 0));
     }
     fprintf(_file, "trailer <</Size %d/Root 1 0 R>>\n", pdf_objCtr);
     fprintf(_file, "startxref\n");
@@ -278,6 +283,60 @@ void pdfPrinter::pdf_xref()
     fprintf(_file, "%%%%EOF\n");
 }
 
+// Records where an object starts for the cross-reference table
+void pdfPrinter::pdf_set_location(int obj)
+{
+    if ((int)objLocations.size() <= obj)
+        objLocations.resize(obj + 1, 0);
+    objLocations[obj] = ftell(_file);
+}
+
+// Copies the font file through to the output up to position 'stop'
+void pdfPrinter::pdf_copy_font(FILE *fff, size_t &fp, size_t stop)
+{
+    char buf[256];
+    while (fp < stop)
+    {
+        size_t n = stop - fp < sizeof(buf) ? stop - fp : sizeof(buf);
+        n = fread(buf, 1, n, fff);
+        if (n == 0)
+            break;
+        fwrite(buf, 1, n, _file);
+        fp += n;
+    }
+}
+
+void pdfPrinter::pdf_write(const char *data, size_t len)
+{
+    if (pageOpen)
+        pageContent.append(data, len);
+    else
+        fwrite(data, 1, len, _file);
+}
+
+void pdfPrinter::pdf_printf(const char *fmt, ...)
+{
+    char buf[128];
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len < 0)
+        return;
+    if (len < (int)sizeof(buf))
+    {
+        pdf_write(buf, len);
+        return;
+    }
+
+    std::vector<char> big(len + 1);
+    va_start(args, fmt);
+    vsnprintf(big.data(), big.size(), fmt, args);
+    va_end(args);
+    pdf_write(big.data(), len);
+}
+
 bool pdfPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
 {
     /**
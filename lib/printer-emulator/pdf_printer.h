@@ -5,10 +5,12 @@
  inherited from by other, full-fledged printer classes (e.g. Atari 820/822)
 */
 #include <string>
+#include <vector>
 
 #include "../../include/atascii.h"
 
 #include "printer_emulator.h"
+#include "deflate_stream.h"
 
 
 #define MAXFONTS 33 // maximum number of fonts can use
@@ -47,11 +49,19 @@ protected:
     bool textMode = true;
     colorMode_t colorMode = colorMode_t::off;
 
-    int pageObjects[256];
+    std::vector<int> pageObjects;
     int pdf_pageCounter = 0.;
-    size_t objLocations[256]; // reference table storage
+    std::vector<size_t> objLocations; // reference table storage
     int pdf_objCtr = 0;       // count the objects
 
+    // Content of the page being printed. It's kept in memory and written as a whole at the
+    // end of the page, so the stream length is known up front and the file never seeks back.
+    std::string pageContent;
+    bool pageOpen = false;
+    int pageContentObj = 0;
+    bool compressStreams = true; // Flate compress content streams
+    deflateStream *deflater = nullptr; // made at the first page, too big for the printer task's stack
+
     void pdf_header();
     void pdf_add_fonts(); // pdfFont_t *fonts[],
     void pdf_new_page();
@@ -63,10 +73,19 @@ protected:
     void pdf_page_resource();
     void pdf_font_resource();
     void pdf_xref();
-
-    size_t idx_stream_length = 0; // file location of stream length indictor
-    size_t idx_stream_start = 0;  // file location of start of stream
-    size_t idx_stream_stop = 0;   // file location of end of stream
+    void pdf_set_location(int obj);
+    void pdf_copy_font(FILE *fff, size_t &fp, size_t stop);
+
+    // Output for everything the emulators print: goes to the open page, otherwise to the file
+    void pdf_printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    void pdf_write(const char *data, size_t len);
+    void pdf_putc(char c)
+    {
+        if (pageOpen)
+            pageContent.push_back(c);
+        else
+            fputc(c, _file);
+    };
 
     virtual void pdf_clear_modes() = 0;
     virtual void pdf_handle_char(uint16_t c, uint8_t aux1, uint8_t aux2) = 0;
@@ -78,6 +97,7 @@ public:
 
     // virtual const char *modelname(void) = 0;
     pdfPrinter() { _paper_type = PDF; };
+    ~pdfPrinter() { delete deflater; };
 
 };
 
@@ -1,12 +1,13 @@
 #include "png_printer.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "../../include/debug.h"
 
 
 // rewrite of TinyPngOut https://www.nayuki.io/page/tiny-png-output
 
-#define DEFLATE_MAX_BLOCK_SIZE 0xFFFF
-
 void pngPrinter::uint32_to_array(uint32_t src, uint8_t dest[4])
 {
     dest[0] = (uint8_t)((src >> 24) & 0xff);
@@ -15,69 +16,6 @@ void pngPrinter::uint32_to_array(uint32_t src, uint8_t dest[4])
     dest[3] = (uint8_t)(src & 0xff);
 }
 
-uint32_t pngPrinter::update_adler32(uint32_t adler, uint8_t data)
-{
-    // https://gist.github.com/kornelski/710db9d30a64db0807c5bfbdbdecf85e
-    unsigned s1 = adler & 0xffff;
-    unsigned s2 = (adler >> 16) & 0xffff;
-
-    s1 += data;
-    s1 %= 65521;
-
-    s2 += s1;
-    s2 %= 65521;
-
-    return (s2 << 16) | s1;
-}
-
-uint32_t pngPrinter::rc_crc32(uint32_t crc, const uint8_t *buf, size_t len)
-// https://rosettacode.org/wiki/CRC-32#Implementation_2
-{
-    static uint32_t table[256];
-    static int have_table = 0;
-    uint32_t rem;
-    uint8_t octet;
-    int i, j;
-    const uint8_t *p, *q;
-
-    /* This check is not thread safe; there is no mutex. */
-    if (have_table == 0)
-    {
-        /* Calculate CRC table. */
-        for (i = 0; i < 256; i++)
-        {
-            rem = i; /* remainder from polynomial division */
-            for (j = 0; j < 8; j++)
-            {
-                if (rem & 1)
-                {
-                    rem >>= 1;
-                    rem ^= 0xedb88320;
-                }
-                else
-                    rem >>= 1;
-            }
-            table[i] = rem;
-        }
-        have_table = 1;
-    }
-
-    crc = ~crc;
-    q = buf + len;
-    for (p = buf; p < q; p++)
-    {
-        octet = *p; /* Cast to unsigned octet. */
-        crc = (crc >> 8) ^ table[(crc & 0xff) ^ octet];
-    }
-    return ~crc;
-}
-
-// uint32_t pngPrinter::rc_crc32(uint32_t crc, uint8_t c)
-// // pass a single character
-// {
-//     rc_crc32(crc, &c, 1);
-// }
-
 void pngPrinter::png_signature()
 {
     Debug_println("Writing PNG Signature.");
@@ -111,7 +49,7 @@ void pngPrinter::png_header()
         0x08,                   // 16       1 byte depth
         0x03,                   // 17       0x03 color with palette
         0x00,                   // 18       compression method always 0
-        0x00,                   // 19       no filter
+        0x00,                   // 19       filter method 0, type chosen per line
         0x00,                   // 20       no interlace
         0, 0, 0, 0,             // 21-24    IHDR CRC-32 placeholder
     };
@@ -126,8 +64,7 @@ void pngPrinter::png_header()
         chunk type code and chunk data fields, but 
         not including the length field.
     */
-    crc_value = rc_crc32(0, &header[4], 17);
-    uint32_to_array(crc_value, &header[21]);
+    uint32_to_array(crc32_update(0, &header[4], 17), &header[21]);
     fwrite(header, 1, 25, _file);
 }
 
@@ -189,8 +126,7 @@ void pngPrinter::png_palette()
     uint8_t ccc[] = {0, 0, 0, 0}; // crc placeholder
 
     uint32_to_array(768, &len[0]);
-    crc_value = rc_crc32(0, &data[0], 4 + 768);
-    uint32_to_array(crc_value, &ccc[0]);
+    uint32_to_array(crc32_update(0, &data[0], 4 + 768), &ccc[0]);
 
     fwrite(len, 1, 4, _file);
     fwrite(data, 1, 4 + 768, _file);
@@ -219,140 +155,129 @@ void pngPrinter::png_data()
     significance and can occur at any point in the compressed datastream
 */
     Debug_println("Starting PNG Image Data...");
-    uint8_t data[] = {
-        // IDAT chunk
-        0x00, 0x00, 0x00, 0x00, // 0-3      size placeholder
-        'I', 'D', 'A', 'T',     // 4-7      IDAT
-    };
-    crc_value = rc_crc32(0, &data[4], 4); // begin CRC calculation
-
-    // Compute data size
-    // imgSize = (width + 1) * height; // +1 per line for filter 0's
-    uint32_t numBlocks = imgSize / DEFLATE_MAX_BLOCK_SIZE;
-    if (imgSize % DEFLATE_MAX_BLOCK_SIZE != 0)
-        numBlocks++; // Round up
-
-    dataSize += numBlocks * 5; // 5 bytes per DEFLATE uncompressed block header
-    dataSize += 2;             // 2 bytes for zlib header
-    dataSize += 4;             // 4 bytes for zlib Adler-32 checksum
-    dataSize += imgSize;       // plus the image data
+    if (!deflater.begin(png_idat, this))
+    {
+        // Still close the image so the file is a valid PNG; the data sent for it is refused
+        Debug_println("No memory for ZLIB stream, writing blank image.");
+        deflate_failed = true;
+        png_blank_data();
+        png_end();
+        image_done = true;
+    }
+}
 
-    uint32_to_array(dataSize, &data[0]); // store the computed size
+/*
+    Writes every line as blank in a single stored (uncompressed) deflate block,
+    which needs no memory beyond the line buffer
+*/
+void pngPrinter::png_blank_data()
+{
+    const uint32_t raw = height * (1 + width); // filter type 0 and zero pixels on each line
+    uint8_t head[8 + 7];
+    uint8_t tail[8];
+
+    uint32_to_array(sizeof(head) - 8 + raw + 4, &head[0]);
+    memcpy(&head[4], "IDAT", 4);
+    head[8] = 0x78; // zlib header, deflate with 32K window
+    head[9] = 0x01;
+    head[10] = 0x01; // final block, stored
+    head[11] = raw & 0xff;
+    head[12] = (raw >> 8) & 0xff;
+    head[13] = ~raw & 0xff;
+    head[14] = (~raw >> 8) & 0xff;
+
+    uint32_t crc = crc32_update(0, &head[4], sizeof(head) - 4);
+    uint32_t adler = 1;
+    fwrite(head, 1, sizeof(head), _file);
+
+    memset(line_buffer, 0, sizeof(line_buffer));
+    for (uint32_t left = raw; left > 0;)
+    {
+        uint32_t n = left < sizeof(line_buffer) ? left : sizeof(line_buffer);
+        crc = crc32_update(crc, line_buffer, n);
+        adler = adler32_update(adler, line_buffer, n);
+        fwrite(line_buffer, 1, n, _file);
+        left -= n;
+    }
 
-    fwrite(data, 1, 8, _file); // write out the IDAT header
+    uint32_to_array(adler, &tail[0]);
+    crc = crc32_update(crc, &tail[0], 4);
+    uint32_to_array(crc, &tail[4]);
+    fwrite(tail, 1, sizeof(tail), _file);
 }
 
-void pngPrinter::png_add_data(uint8_t *buf, uint32_t n)
+// Hands each full buffer of the zlib stream out as an IDAT chunk, so no length has to be known up front
+void pngPrinter::png_idat(void *arg, const uint8_t *data, size_t len)
 {
-    uint8_t c = 0;
-    // Deflate-compressed datastreams within PNG are stored in the “zlib” format
-    // https://tools.ietf.org/html/rfc1950#page-4
+    pngPrinter *p = (pngPrinter *)arg;
+    p->png_chunk("IDAT", data, len);
+}
 
-    if (img_pos == 0)
-    {
-        Debug_println("Writing ZLIB header.");
-        // write out a ZLIB header
-        // Compression method/flags code: 1 byte (For PNG compression method 0, the zlib compression method/flags code must specify method code 8 (“deflate” compression))
-        c = 0x08; // ZLIB "Deflate" compression scheme
-        crc_value = rc_crc32(crc_value, c);
-        fputc(c, _file);
-        //  Additional flags/check bits: 1 byte (must be such that method + flags, when viewed as a 16-bit unsigned integer stored in MSB order (CMF*256 + FLG), is a multiple of 31.)
-        c = 0x1D; // precompute so that 0x081D is divisible by 31 [ (0x800 / 31 + 1) * 31 - 0x800 ]
-        crc_value = rc_crc32(crc_value, c);
-        fputc(c, _file);
-
-        //printf("new image\r\n");
-    }
+void pngPrinter::png_chunk(const char *type, const uint8_t *data, uint32_t len)
+{
+    uint8_t head[8];
+    uint8_t ccc[4];
 
-    uint32_t idx = 0;
-    while (idx < n)
-    {
-        // at beginning of block?
-        if (blk_pos == 0)
-        {
-            blkSize = DEFLATE_MAX_BLOCK_SIZE;
-            uint8_t c = 0;
-            if (imgSize - img_pos <= (uint32_t)blkSize)
-            {
-                c = 1; // final block
-                blkSize = (uint16_t)(imgSize - img_pos);
-            }
+    uint32_to_array(len, &head[0]);
+    memcpy(&head[4], type, 4);
+    uint32_to_array(crc32_update(crc32_update(0, &head[4], 4), data, len), &ccc[0]);
 
-            Debug_println("Writing ZLIB block header.");
-            // write out block header
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-
-            // write out block size
-            c = (uint8_t)(blkSize >> 0);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)(blkSize >> 8);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)((blkSize >> 0) ^ 0xFF);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-            c = (uint8_t)((blkSize >> 8) ^ 0xFF);
-            crc_value = rc_crc32(crc_value, c);
-            fputc(c, _file);
-
-            //printf("new block\r\n");
-        }
+    fwrite(head, 1, 8, _file);
+    fwrite(data, 1, len, _file);
+    fwrite(ccc, 1, 4, _file);
+}
 
-        //at beginning of a line?
-        if (Xpos == 0)
-        {
-            Debug_printf("Starting PNG line %d ... ",Ypos);
-            c = 0;
-            crc_value = rc_crc32(crc_value, c);
-            adler_value = update_adler32(adler_value, c);
-            fputc(c, _file);
-            //printf("\nnew line %d ", c);
-
-            img_pos++;
-            blk_pos++;
-        }
+/*
+    https://www.w3.org/TR/REC-png.pdf
+    6.6 Filter selection
+    Tries Sub and Up on the line as well as None and picks the one with the smallest
+    sum of absolute differences, the usual guess at what will compress best
+*/
+const uint8_t *pngPrinter::png_filter(const uint8_t *line)
+{
+    uint8_t *none = filter_buffer[0];
+    uint8_t *sub = filter_buffer[1];
+    uint8_t *up = filter_buffer[2];
+    uint32_t sum_none = 0, sum_sub = 0, sum_up = 0;
+
+    none[0] = 0;
+    sub[0] = 1;
+    up[0] = 2;
+    for (uint32_t x = 0; x < width; x++)
+    {
+        uint8_t left = x > 0 ? line[x - 1] : 0;
+        none[1 + x] = line[x];
+        sub[1 + x] = line[x] - left;
+        up[1 + x] = line[x] - prior_line[x];
+        sum_none += abs((int8_t)none[1 + x]);
+        sum_sub += abs((int8_t)sub[1 + x]);
+        sum_up += abs((int8_t)up[1 + x]);
+    }
+    memcpy(prior_line, line, width);
 
-        // put byte from buffer
-        c = buf[idx];
-        crc_value = rc_crc32(crc_value, c);
-        adler_value = update_adler32(adler_value, c);
-        fputc(c, _file);
-        //printf("%d ", c);
+    if (sum_up <= sum_sub && sum_up <= sum_none)
+        return up;
+    if (sum_sub < sum_none)
+        return sub;
+    return none;
+}
 
-        Xpos++;
-        idx++;
-        img_pos++;
-        blk_pos++;
+void pngPrinter::png_add_data(uint8_t *buf, uint32_t n)
+{
+    // Deflate-compressed datastreams within PNG are stored in the “zlib” format
+    // https://tools.ietf.org/html/rfc1950#page-4
+    if (image_done || n != width)
+        return;
 
-        // check for end of's
-        if (Xpos == width)
-        {
-            Debug_println("Finished PNG line.");
-            Xpos = 0;
-            Ypos++;
-        }
-        if (blk_pos == blkSize)
-        {
-            Debug_println("End of ZLIB block.");
-            blk_pos = 0;
-        }
-    };
+    deflater.write(png_filter(buf), 1 + width);
+    Ypos++;
 
-    if (img_pos == imgSize)
+    if (Ypos == height)
     {
-        Debug_println("Writing ZLIB Adler checksum and PNG data CRC.");
-        uint8_t data[] = {
-            0, 0, 0, 0, // Adler32 Check value: 4 bytes
-            0, 0, 0, 0  // CRC32: 4 bytes
-        };
-        uint32_to_array(adler_value, &data[0]);
-        for (int i = 0; i < 4; i++)
-            crc_value = rc_crc32(crc_value, data[i]); // crc_value = rc_crc32(crc_value, data[0],4); ?????????
-        uint32_to_array(crc_value, &data[4]);
-        fwrite(data, 1, 8, _file);
+        Debug_println("Finishing ZLIB stream.");
+        deflater.finish();
         png_end();
+        image_done = true;
     }
 }
 
@@ -366,14 +291,23 @@ void pngPrinter::png_end()
     fwrite(end, 1, 12, _file);
 }
 
-// TODO: Anything here?
 void pngPrinter::pre_close_file()
 {
-
+    // Fill out a short screen dump with blank lines so the file is still a valid PNG
+    memset(line_buffer, 0, sizeof(line_buffer));
+    while (!image_done)
+        png_add_data(line_buffer, width);
 }
 
 void pngPrinter::post_new_file()
 {
+    Ypos = 0;
+    image_done = false;
+    deflate_failed = false;
+    BOLflag = true;
+    line_index = 0;
+    memset(prior_line, 0, sizeof(prior_line));
+
     // call PNG header routines
     png_signature();
     png_header();
@@ -386,8 +320,11 @@ bool pngPrinter::process_buffer(uint8_t n, uint8_t aux1, uint8_t aux2)
 {
 // copy buffer[] into linebuffer[]
     Debug_printf("%d bytes rx'd by PNG printer\r\n", n);
+    if (deflate_failed)
+        return false;
+
     uint16_t i = 0;
-    while (i < n && img_pos < imgSize)
+    while (i < n && !image_done)
     {
         //Debug_println("processing buffer.");
         if (BOLflag)
@@ -4,8 +4,7 @@
 #include "printer.h"
 
 #include "printer_emulator.h"
-
-#define DEFLATE_MAX_BLOCK_SIZE 0xFFFF
+#include "deflate_stream.h"
 
 class pngPrinter : public printer_emu
 {
@@ -14,33 +13,31 @@ protected:
     const uint32_t width = 320;
     const uint32_t height = 192;
 
-    const uint32_t imgSize = (width + 1) * height; // size of image including BOL filter p's for IDAT chunk
-    uint32_t img_pos = 0;                    // serial position within image data including BOL filter p's
-    uint16_t Xpos = 0;                       // current position within image line
     uint16_t Ypos = 0;                       // current image line number
-    uint32_t dataSize = 0;                   // size of data for IDAT chunk
-    uint16_t blkSize = 0;                    // size of zlib block
-    uint16_t blk_pos = 0;                    // serial position within zlib block
-    uint32_t crc_value = 0;                  // running crc32 value
-    uint32_t adler_value = 1;                // running checksum (initilize to 1 https://en.wikipedia.org/wiki/Adler-32)
+    bool image_done = false;                 // IDAT and IEND have been written
+    bool deflate_failed = false;             // no memory for the deflater, the image was left blank
 
+    deflateStream deflater;                  // zlib stream split across IDAT chunks as it fills
     uint8_t line_buffer[320];
+    uint8_t prior_line[320];                 // previous unfiltered line, for the Up filter
+    uint8_t filter_buffer[3][1 + 320];       // the line with each filter applied, filter type first
 
     bool BOLflag = true;
     uint16_t line_index = 0;
     uint8_t rep_code = 0;
 
     void uint32_to_array(uint32_t src, uint8_t dest[4]);
-    uint32_t update_adler32(uint32_t adler, uint8_t data);
-    uint32_t rc_crc32(uint32_t crc, const uint8_t *buf, size_t len);
-    uint32_t rc_crc32(uint32_t crc, uint8_t c) { return rc_crc32(crc, &c, 1); }
 
     void png_signature();
     void png_header();
     void png_palette();
     void png_data();
+    void png_blank_data();
     void png_add_data(uint8_t *buf, uint32_t n);
     void png_end();
+    const uint8_t *png_filter(const uint8_t *line);
+    void png_chunk(const char *type, const uint8_t *data, uint32_t len);
+    static void png_idat(void *arg, const uint8_t *data, size_t len);
 
     virtual void post_new_file() override;
     virtual void pre_close_file() override;
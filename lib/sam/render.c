@@ -46,9 +46,10 @@ unsigned char sampledConsonantFlag[256]; // tab44800
 void AddInflection(unsigned char mem48, unsigned char phase1);
 unsigned char trans(unsigned char mem39212, unsigned char mem39213);
 
-// contains the final soundbuffer
+// position of the output in samples * 50
 extern int bufferpos;
-extern char *buffer;
+void WriteSample(int index, char value);
+void FlushSamples(int end);
 
 //timetable for more accurate c64 simulation
 int timetable[5][5] =
@@ -66,11 +67,13 @@ void Output8BitAry(int index, unsigned char ary[5])
     int k;
     bufferpos += timetable[oldtimetableindex][index];
     oldtimetableindex = index;
+    // nothing is written before bufferpos from here on
+    FlushSamples(bufferpos / 50);
     // write a little bit in advance
     for (k = 0; k < 5; k++)
     {
         // printf("%d %d\r\n", bufferpos,k);
-        buffer[bufferpos / 50 + k] = ary[k];
+        WriteSample(bufferpos / 50 + k, ary[k]);
     }
 }
 void Output8Bit(int index, unsigned char A)
@@ -977,14 +980,16 @@ void Render()
                 X = 26;
                 // mem[54296] = X;
                 bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
+                FlushSamples(bufferpos / 50);
+                WriteSample(bufferpos / 50, (X & 15) * 16);
             }
             else
             {
                 //mem[54296] = 6;
                 X = 6;
                 bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
+                FlushSamples(bufferpos / 50);
+                WriteSample(bufferpos / 50, (X & 15) * 16);
             }
 
             for (X = wait2; X > 0; X--)
@@ -1,8 +1,6 @@
 
 #include "sam.h"
 
-#include <esp_heap_caps.h>
-
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -43,9 +41,16 @@ unsigned char phonemeIndexOutput[60];  //tab47296
 unsigned char stressOutput[60];        //tab47365
 unsigned char phonemeLengthOutput[60]; //tab47416
 
-// contains the final soundbuffer
+// position of the output in samples * 50
 int bufferpos = 0;
-char *buffer = NULL;
+
+// Samples are handed to the output a frame at a time. Render() writes a
+// few samples past bufferpos, so the frame has room for those at the end.
+#define SAM_FRAME_AHEAD 8
+static char frame[SAM_FRAME_SIZE + SAM_FRAME_AHEAD];
+static int frame_start = 0; // sample number of frame[0]
+static sam_output_fn output_fn = NULL;
+static void *output_ctx = NULL;
 
 void SetInput(char *_input)
 {
@@ -64,9 +69,31 @@ void SetMouth(unsigned char _mouth) { mouth = _mouth; }
 void SetThroat(unsigned char _throat) { throat = _throat; }
 void EnableSingmode() { singmode = 1; }
 void DisableSingmode() { singmode = 0; }
-char *GetBuffer() { return buffer; }
-int GetBufferLength() { return bufferpos; }
-void FreeBuffer() { free(buffer); }
+void SetOutput(sam_output_fn fn, void *ctx)
+{
+    output_fn = fn;
+    output_ctx = ctx;
+}
+
+void WriteSample(int index, char value)
+{
+    index -= frame_start;
+    if (index >= 0 && index < (int)sizeof(frame))
+        frame[index] = value;
+}
+
+// Hand on the whole frames before sample number end, which Render() is done with
+void FlushSamples(int end)
+{
+    while (end - frame_start >= SAM_FRAME_SIZE)
+    {
+        if (output_fn != NULL)
+            output_fn(frame, SAM_FRAME_SIZE, output_ctx);
+        memcpy(frame, frame + SAM_FRAME_SIZE, SAM_FRAME_AHEAD);
+        memset(frame + SAM_FRAME_AHEAD, 0, SAM_FRAME_SIZE);
+        frame_start += SAM_FRAME_SIZE;
+    }
+}
 
 void Init();
 int Parser1();
@@ -98,17 +125,8 @@ void Init()
     SetMouthThroat(mouth, throat);
 
     bufferpos = 0;
-    // TODO, check for free the memory, 10 seconds of output should be more than enough
-    //buffer = (char*)ps_malloc(22050 * 5);
-    // switch to ESP-IDF equivalent
-    buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    /*
-    Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
-    The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
-    https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/mem_alloc.html
-    */
-
-    // printf("buffer pointer %d\r\n", buffer);
+    frame_start = 0;
+    memset(frame, 0, sizeof(frame));
 
     /*
     freq2data = &mem[45136];
@@ -185,6 +203,11 @@ int SAMMain()
 
     PrepareOutput();
 
+    // What's left of the last frame
+    FlushSamples(bufferpos / 50);
+    if (bufferpos / 50 > frame_start && output_fn != NULL)
+        output_fn(frame, bufferpos / 50 - frame_start, output_ctx);
+
     return 1;
 }
 
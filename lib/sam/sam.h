@@ -17,9 +17,13 @@ extern "C"
 
     int SAMMain();
 
-    char *GetBuffer();
-    int GetBufferLength();
-    void FreeBuffer();
+// Samples handed to the output at a time, about 23 ms at 22050 Hz
+#define SAM_FRAME_SIZE 512
+
+    // Receives the 8 bit samples in order while SAMMain() renders them,
+    // SAM_FRAME_SIZE at a time and what's left at the end
+    typedef void (*sam_output_fn)(const char *samples, int count, void *ctx);
+    void SetOutput(sam_output_fn fn, void *ctx);
     
     //char input[]={"/HAALAOAO MAYN NAAMAEAE IHSTT SAEBAASTTIHAAN \x9b\x9b\0"};
     //unsigned char input[]={"/HAALAOAO \x9b\0"};
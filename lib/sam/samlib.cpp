@@ -3,6 +3,8 @@
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/timers.h>
+#include <freertos/task.h>
+#include <freertos/stream_buffer.h>
 #include <driver/gpio.h>
 #ifndef CONFIG_IDF_TARGET_ESP32S3
 #include <driver/dac.h>
@@ -13,9 +15,11 @@
 
 #ifdef __cplusplus
 extern char input[256];
-extern char *buffer;
 #endif
 
+// Rendered samples waiting to be played, about 190 ms
+#define SAM_RING_SIZE 4096
+
 int debug = 0;
 const uint32_t sample_rate = 22050;//110000l;
 
@@ -63,7 +67,6 @@ void SendI2S (i2s_chan_handle_t tx_handle, char *s, size_t n)
           {
             printf ("Error sending audio data: %d", res);
           }
-          printf ("i2s write : Send %d Bytes of %d/%d Samples \n", bytes_written, samples_to_send, n);
         }
         
         free(m_tmp_frames);
@@ -75,15 +78,20 @@ void SendI2S (i2s_chan_handle_t tx_handle, char *s, size_t n)
 
 #ifndef ESP_PLATFORM
 
-void WriteWav(char *filename, char *buffer, int bufferlength)
+static void WavSamples(const char *samples, int count, void *ctx)
+{
+    fwrite(samples, count, 1, (FILE *)ctx);
+}
+
+int WriteWav(char *filename)
 {
     FILE *file = fopen(filename, "wb");
     if (file == NULL)
-        return;
-    //RIFF header
+        return 0;
+    //RIFF header, sizes filled in once the samples are written
+    unsigned int size = 0;
     fwrite("RIFF", 4, 1, file);
-    unsigned int filesize = bufferlength + 12 + 16 + 8 - 8;
-    fwrite(&filesize, 4, 1, file);
+    fwrite(&size, 4, 1, file);
     fwrite("WAVE", 4, 1, file);
 
     //format chunk
@@ -102,12 +110,23 @@ void WriteWav(char *filename, char *buffer, int bufferlength)
     unsigned short int bitspersample = 8;
     fwrite(&bitspersample, 2, 1, file);
 
-    //data chunk
+    //data chunk, written as it's rendered
     fwrite("data", 4, 1, file);
-    fwrite(&bufferlength, 4, 1, file);
-    fwrite(buffer, bufferlength, 1, file);
+    fwrite(&size, 4, 1, file);
+
+    SetOutput(WavSamples, file);
+    int result = SAMMain();
+    SetOutput(NULL, NULL);
+
+    size = ftell(file) - 44;
+    fseek(file, 40, SEEK_SET);
+    fwrite(&size, 4, 1, file);
+    size += 36;
+    fseek(file, 4, SEEK_SET);
+    fwrite(&size, 4, 1, file);
 
     fclose(file);
+    return result;
 }
 #endif // NOT ESP_PLATFORM
 
@@ -159,100 +178,43 @@ void PrintUsage()
     */
 }
 
-#ifdef USESDL
-
-int pos = 0;
-void MixAudio(void *unused, Uint8 *stream, int len)
-{
-    int bufferpos = GetBufferLength();
-    char *buffer = GetBuffer();
-    int i;
-    if (pos >= bufferpos)
-        return;
-    if ((bufferpos - pos) < len)
-        len = (bufferpos - pos);
-    for (i = 0; i < len; i++)
-    {
-        stream[i] = buffer[pos];
-        pos++;
-    }
-}
-
-void OutputSound()
-{
-    int bufferpos = GetBufferLength();
-    bufferpos /= 50;
-    SDL_AudioSpec fmt;
-
-    fmt.freq = 22050;
-    fmt.format = AUDIO_U8;
-    fmt.channels = 1;
-    fmt.samples = 2048;
-    fmt.callback = MixAudio;
-    fmt.userdata = NULL;
-
-    /* Open the audio device and start playing sound! */
-    if (SDL_OpenAudio(&fmt, NULL) < 0)
-    {
-        printf("Unable to open audio: %s\r\n", SDL_GetError());
-        exit(1);
-    }
-    SDL_PauseAudio(0);
-    //SDL_Delay((bufferpos)/7);
-
-    while (pos < bufferpos)
-    {
-        SDL_Delay(100);
-    }
-
-    SDL_CloseAudio();
-}
-
-#else //Not def USESDL
-
-void OutputSound()
-{
 #ifdef ESP_PLATFORM
 #ifndef CONFIG_IDF_TARGET_ESP32S3
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
 
+static void OutputBegin()
+{
     //fnSystem.dac_output_enable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
-    //fnSystem.dac_output_voltage(SystemManager::dac_channel_t::DAC_CHANNEL_1, 100);
-
     dac_output_enable(DAC_CHANNEL_1);
+}
 
+static void OutputSamples(char *s, int n)
+{
     for (int i = 0; i < n; i++)
     {
         //dacWrite(DAC1, s[i]);
-        // fnSystem.dac_write(PIN_DAC1, s[i]);
         dac_output_voltage(DAC_CHANNEL_1, s[i]);
-        //delayMicroseconds(40);
         fnSystem.delay_microseconds(40);
     }
+}
 
-    //fnSystem.dac_output_disable(SystemManager::dac_channel_t::DAC_CHANNEL_1);
+static void OutputEnd()
+{
     dac_output_disable(DAC_CHANNEL_1);
+}
 
-    FreeBuffer();
 #else //Defined CONFIG_IDF_TARGET_ESP32S3
 //SampleRate = 22050
 //8 Bits
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
-    //PDMOutput *audioOutput = NULL;
 
+//PDM always but I2S only if defined ESP32S3_I2S_OUT and i2sOut is true (can change with print #1;"CTRL-A X") X : 0 Disable, 1 Enable.
+//Both are open together and get each chunk in turn.
+static i2s_chan_handle_t pdm_handle = NULL;
+static i2s_chan_handle_t std_handle = NULL;
 
-
-//#ifdef ESP32S3_I2S_OUT
-//    if (!i2sOut) {
-//#endif
-
-//PDM always but I2D only if defined ESP32S3_I2S_OUT and i2sOut is true (can change with print #1;"CTRL-A X") X : 0 Disable, 1 Enable. 
-
+static void OutputBegin()
+{
 //New API
 //Init/Config
-        i2s_chan_handle_t tx_handle;
         /* Allocate an I2S tx channel */
         i2s_chan_config_t chan_cfg = //I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
                     { 
@@ -262,7 +224,7 @@ void OutputSound()
                     .dma_frame_num = 1024,//240, 
                     .auto_clear = false, 
                 };
-        i2s_new_channel(&chan_cfg, &tx_handle, NULL);
+        i2s_new_channel(&chan_cfg, &pdm_handle, NULL);
 
         /* Init the channel into PDM TX mode */
         i2s_pdm_tx_config_t pdm_tx_cfg = {
@@ -300,30 +262,18 @@ void OutputSound()
             },
         };
 
-        i2s_channel_init_pdm_tx_mode(tx_handle, &pdm_tx_cfg);
-        i2s_channel_enable(tx_handle);
-
-        SendI2S (tx_handle, s, n);
-
-        /* Have to stop the channel before deleting it */
-        i2s_channel_disable(tx_handle);
-        /* If the handle is not needed any more, delete it to release the channel resources */
-        i2s_del_channel(tx_handle);
-        
-//#ifdef ESP32S3_I2S_OUT
-//    }
-//    else //i2sOut : It need 3 Pins 
+        i2s_channel_init_pdm_tx_mode(pdm_handle, &pdm_tx_cfg);
+        i2s_channel_enable(pdm_handle);
 
 #ifdef ESP32S3_I2S_OUT
-    if (i2sOut) 
+    if (i2sOut) //i2sOut : It need 3 Pins
     {
-        i2s_chan_handle_t tx_handle;
         /* Get the default channel configuration by helper macro.
         * This helper macro is defined in 'i2s_common.h' and shared by all the i2s communication mode.
         * It can help to specify the I2S role, and port id */
         i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
         /* Allocate a new tx channel and get the handle of this channel */
-        i2s_new_channel(&chan_cfg, &tx_handle, NULL);
+        i2s_new_channel(&chan_cfg, &std_handle, NULL);
 
         /* Setting the configurations, the slot configuration and clock configuration can be generated by the macros
         * These two helper macros is defined in 'i2s_std.h' which can only be used in STD mode.
@@ -345,33 +295,104 @@ void OutputSound()
             },
         };
         /* Initialize the channel */
-        i2s_channel_init_std_mode(tx_handle, &std_cfg);
+        i2s_channel_init_std_mode(std_handle, &std_cfg);
 
         /* Before write data, start the tx channel first */
-        i2s_channel_enable(tx_handle);
+        i2s_channel_enable(std_handle);
+    }
+#endif    //ESP32S3_I2S_OUT
+}
 
-        //i2s_channel_write(tx_handle, src_buf, bytes_to_write, bytes_written, ticks_to_wait);
-        //i2s_channel_write(tx_handle, s, n, &bytes_written, 1000 / portTICK_PERIOD_MS);
-        SendI2S (tx_handle, s, n);
+static void OutputSamples(char *s, int n)
+{
+    SendI2S(pdm_handle, s, n);
+    if (std_handle != NULL)
+        SendI2S(std_handle, s, n);
+}
+
+static void OutputEnd()
+{
+    /* Have to stop the channel before deleting it */
+    i2s_channel_disable(pdm_handle);
+    /* If the handle is not needed any more, delete it to release the channel resources */
+    i2s_del_channel(pdm_handle);
+    pdm_handle = NULL;
+
+    if (std_handle != NULL)
+    {
+        i2s_channel_disable(std_handle);
+        i2s_del_channel(std_handle);
+        std_handle = NULL;
+    }
+}
+
+#endif //CONFIG_IDF_TARGET_ESP32S3
+
+struct sam_render
+{
+    StreamBufferHandle_t ring;
+    volatile bool done;
+    int result;
+};
+
+static void SendSamples(const char *samples, int count, void *ctx)
+{
+    xStreamBufferSend(((sam_render *)ctx)->ring, samples, count, portMAX_DELAY);
+}
+
+static void RenderTask(void *param)
+{
+    sam_render *r = (sam_render *)param;
+
+    SetOutput(SendSamples, r);
+    r->result = SAMMain();
+    r->done = true;
+    vTaskDelete(NULL);
+}
+
+/*
+ * Render on the other core while this task plays what's been rendered so
+ * far, a frame at a time as it turns up in the ring buffer.
+ */
+int Speak()
+{
+    static char chunk[SAM_FRAME_SIZE];
+    sam_render r;
 
-        /* Have to stop the channel before deleting it */
-        i2s_channel_disable(tx_handle);
-        /* If the handle is not needed any more, delete it to release the channel resources */
-        i2s_del_channel(tx_handle);
+    r.ring = xStreamBufferCreate(SAM_RING_SIZE, 1);
+    if (r.ring == NULL)
+        return 0;
+    r.done = false;
+    r.result = 0;
 
-// /I2S_STD
+    OutputBegin();
+    if (xTaskCreatePinnedToCore(RenderTask, "samRender", 8192, &r, 5, NULL, 0) != pdPASS)
+        r.done = true;
 
+    for (;;)
+    {
+        size_t n = xStreamBufferReceive(r.ring, chunk, sizeof(chunk), pdMS_TO_TICKS(10));
+        if (n > 0)
+            OutputSamples(chunk, n);
+        else if (r.done && xStreamBufferIsEmpty(r.ring))
+            break;
     }
-#endif    //ESP32S3_I2S_OUT
+    OutputEnd();
 
-    FreeBuffer();    
+    SetOutput(NULL, NULL);
+    vStreamBufferDelete(r.ring);
+    return r.result;
+}
 
+#else // NOT ESP_PLATFORM
 
-#endif //CONFIG_IDF_TARGET_ESP32S3
-#endif //ESP_PLATFORM
+int Speak()
+{
+    // Nothing to play it on
+    return SAMMain();
 }
 
-#endif //USESDL
+#endif // ESP_PLATFORM
 
 int sam(int argc, char **argv)
 {
@@ -498,34 +519,24 @@ int sam(int argc, char **argv)
 
         // printf("done phonetic processing\r\n");
 
-#ifdef USESDL
-    if (SDL_Init(SDL_INIT_AUDIO) < 0)
-    {
-        printf("Unable to init SDL: %s\r\n", SDL_GetError());
-        exit(1);
-    }
-    atexit(SDL_Quit);
-#endif
-
 #ifndef __cplusplus
     SetInput(input);
 #endif
 
-    // printf("right before SAMMain");
+    // Rendered and played together
+    int result;
+#ifndef ESP_PLATFORM
+    if (wavfilename != NULL)
+        result = WriteWav(wavfilename);
+    else
+#endif // ESP_PLATFORM
+        result = Speak();
 
-    if (!SAMMain())
+    if (!result)
     {
         PrintUsage();
         return 1;
     }
-    // printf("right after SAMMain");
-
-#ifndef ESP_PLATFORM
-    if (wavfilename != NULL)
-        WriteWav(wavfilename, GetBuffer(), GetBufferLength() / 50);
-    else
-#endif // ESP_PLATFORM
-        OutputSound();
 
     return 0;
 }
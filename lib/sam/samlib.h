@@ -7,11 +7,6 @@
 #include "sam.h"
 #include "samdebug.h"
 
-#ifdef USESDL
-#include <SDL.h>
-#include <SDL_audio.h>
-#endif
-
 #ifdef ESP_PLATFORM
 #include "../../include/pinmap.h"
 #endif
@@ -21,16 +16,12 @@ extern char input[256];
 #endif
 
 #ifndef ESP_PLATFORM
-void WriteWav(char *filename, char *buffer, int bufferlength);
+int WriteWav(char *filename);
 #endif // ESP_PLATFORM
 
 void PrintUsage();
 
-#ifdef USESDL
-void MixAudio(void *unused, Uint8 *stream, int len);
-void OutputSound();
-#else
-void OutputSound();
-#endif
+// Render the input and play it as it's rendered
+int Speak();
 
 int sam(int argc, char **argv);
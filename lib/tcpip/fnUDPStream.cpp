@@ -0,0 +1,258 @@
+/* Batching and reordering for the UDP stream devices (MIDIMaze/netplay)
+*/
+
+#include "fnUDPStream.h"
+
+#include "../../include/debug.h"
+
+
+void UDPStreamBatch::begin(bool numbered)
+{
+    _start = numbered ? UDPSTREAM_SEQ_SIZE : 0;
+    _len = _start;
+    // The first packet after REGISTER is number 1
+    _seq = 1;
+    if (numbered)
+    {
+        _buf[0] = _seq & 0xFF;
+        _buf[1] = _seq >> 8;
+    }
+    _gap = UDPSTREAM_BATCH_MAX_IDLE;
+    packets = 0;
+    bytes = 0;
+}
+
+bool UDPStreamBatch::add(uint8_t b, uint32_t now)
+{
+    if (_len == _start)
+        _first = now;
+    else
+    {
+        // Bytes read in one go arrive at the same time; it's the time between
+        // arrivals that says how long a quiet bus is still part of a burst
+        uint32_t interval = now - _last;
+        if (interval > 0 && interval < UDPSTREAM_BATCH_MAX_IDLE)
+            _gap = (_gap * 7 + interval) / 8;
+    }
+    _last = now;
+
+    _buf[_len++] = b;
+    return _len == UDPSTREAM_MAX_PACKET;
+}
+
+uint32_t UDPStreamBatch::idle_limit()
+{
+    uint32_t limit = _gap * 3;
+    if (limit < UDPSTREAM_BATCH_MIN_IDLE)
+        return UDPSTREAM_BATCH_MIN_IDLE;
+    if (limit > UDPSTREAM_BATCH_MAX_IDLE)
+        return UDPSTREAM_BATCH_MAX_IDLE;
+    return limit;
+}
+
+bool UDPStreamBatch::due(uint32_t now)
+{
+    if (_len == _start)
+        return false;
+    return _len == UDPSTREAM_MAX_PACKET ||
+           now - _last >= idle_limit() ||
+           now - _first >= UDPSTREAM_BATCH_MAX_HOLD;
+}
+
+void UDPStreamBatch::sent()
+{
+    packets++;
+    bytes += _len - _start;
+    _len = _start;
+    if (_start > 0)
+    {
+        _seq++;
+        _buf[0] = _seq & 0xFF;
+        _buf[1] = _seq >> 8;
+    }
+}
+
+
+UDPStreamJitter::UDPStreamJitter(uint32_t delay)
+{
+    _delay = delay;
+    for (int i = 0; i < UDPSTREAM_JITTER_SLOTS; i++)
+        _slot[i].data = _pool[i];
+    _spare = _pool[UDPSTREAM_JITTER_SLOTS];
+    _out = _pool[UDPSTREAM_JITTER_SLOTS + 1];
+    _parked_data = _pool[UDPSTREAM_JITTER_SLOTS + 2];
+    reset();
+}
+
+void UDPStreamJitter::reset()
+{
+    for (int i = 0; i < UDPSTREAM_JITTER_SLOTS; i++)
+        _slot[i].full = false;
+    _held = 0;
+    _parked = false;
+    _started = false;
+    _done = 0;
+    _fill = _delay / 2;
+}
+
+uint32_t UDPStreamJitter::delay()
+{
+    uint32_t delay = _fill * 2;
+    if (delay < UDPSTREAM_JITTER_MIN_DELAY)
+        return UDPSTREAM_JITTER_MIN_DELAY;
+    if (delay > _delay)
+        return _delay;
+    return delay;
+}
+
+// Swap the datagram in _spare into its slot
+void UDPStreamJitter::store(uint16_t seq, uint16_t len, uint32_t arrived)
+{
+    slot &s = _slot[seq % UDPSTREAM_JITTER_SLOTS];
+    uint8_t *data = s.data;
+    s.data = _spare;
+    _spare = data;
+    s.len = len;
+    s.full = true;
+    s.arrived = arrived;
+    _held++;
+}
+
+// When the packet held longest arrived
+uint32_t UDPStreamJitter::oldest()
+{
+    uint32_t arrived = 0;
+    bool found = false;
+    for (int i = 0; i < UDPSTREAM_JITTER_SLOTS; i++)
+    {
+        if (_slot[i].full && (!found || (int32_t)(_slot[i].arrived - arrived) < 0))
+        {
+            arrived = _slot[i].arrived;
+            found = true;
+        }
+    }
+    return arrived;
+}
+
+void UDPStreamJitter::advance(bool delivered)
+{
+    _done = (_done << 1) | (delivered ? 1 : 0);
+    _next++;
+}
+
+void UDPStreamJitter::put(size_t len, uint32_t now)
+{
+    if (len < UDPSTREAM_SEQ_SIZE || len > UDPSTREAM_MAX_PACKET)
+        return;
+    stats.packets_in++;
+    _fill -= _fill / 64;
+
+    // Sent little endian by UDPStreamBatch
+    uint16_t seq = _spare[0] | (_spare[1] << 8);
+    if (!_started)
+    {
+        _started = true;
+        _next = seq;
+    }
+
+    int16_t ahead = (int16_t)(seq - _next);
+    if (ahead >= UDPSTREAM_SEQ_RESTART || ahead <= -UDPSTREAM_SEQ_RESTART)
+    {
+        Debug_printf("UDPStreamJitter: sequence jumped from %u to %u, starting over\n", _next, seq);
+        stats.restarts++;
+        stats.lost += _held;
+        reset();
+        _started = true;
+        _next = seq;
+        ahead = 0;
+    }
+
+    if (ahead < 0)
+    {
+        int back = -ahead - 1;
+        if (back < 32 && (_done >> back) & 1)
+            stats.duplicates++;
+        else
+            stats.late++;
+        return;
+    }
+
+    if (ahead < UDPSTREAM_JITTER_SLOTS)
+    {
+        if (_slot[seq % UDPSTREAM_JITTER_SLOTS].full)
+        {
+            stats.duplicates++;
+            return;
+        }
+        if (ahead > 0)
+            stats.reordered++;
+        else if (_held > 0)
+        {
+            // Filling a gap: how long it held up what came after
+            uint32_t waited = now - oldest();
+            if (waited > _fill)
+                _fill = waited;
+        }
+        store(seq, len, now);
+        return;
+    }
+
+    // Beyond the slots: get() moves past the ones in the way first. Only one
+    // can wait like this, get() having been called until empty since the last.
+    if (_parked)
+    {
+        if (seq == _parked_seq)
+        {
+            stats.duplicates++;
+            return;
+        }
+        stats.lost++;
+    }
+    stats.reordered++;
+    uint8_t *data = _spare;
+    _spare = _parked_data;
+    _parked_data = data;
+    _parked = true;
+    _parked_seq = seq;
+    _parked_len = len;
+    _parked_arrived = now;
+}
+
+const uint8_t *UDPStreamJitter::get(size_t *len, uint32_t now)
+{
+    while (true)
+    {
+        if (_parked && (int16_t)(_parked_seq - _next) < UDPSTREAM_JITTER_SLOTS)
+        {
+            uint8_t *data = _spare;
+            _spare = _parked_data;
+            _parked_data = data;
+            store(_parked_seq, _parked_len, _parked_arrived);
+            _parked = false;
+        }
+
+        slot &s = _slot[_next % UDPSTREAM_JITTER_SLOTS];
+        if (s.full)
+        {
+            uint8_t *data = s.data;
+            s.data = _out;
+            _out = data;
+            s.full = false;
+            _held--;
+            advance(true);
+            stats.delivered++;
+            *len = s.len - UDPSTREAM_SEQ_SIZE;
+            return _out + UDPSTREAM_SEQ_SIZE;
+        }
+
+        if (_held == 0 && !_parked)
+            return nullptr;
+
+        // One missing: wait for it until whatever came after has waited long enough
+        if (!_parked && now - oldest() < delay())
+            return nullptr;
+
+        stats.lost++;
+        advance(false);
+    }
+}
@@ -0,0 +1,125 @@
+/* Batching and reordering for the UDP stream devices (MIDIMaze/netplay).
+   Times are in microseconds from fnSystem.micros() and may wrap.
+*/
+#ifndef _FN_UDPSTREAM_
+#define _FN_UDPSTREAM_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Largest datagram, the same as fnUDP's buffers
+#define UDPSTREAM_MAX_PACKET 1460
+// Sequence number in front of the data in server mode
+#define UDPSTREAM_SEQ_SIZE 2
+
+// A batch is sent once the bus has been quiet for a few byte times, between these
+#define UDPSTREAM_BATCH_MIN_IDLE 1500
+#define UDPSTREAM_BATCH_MAX_IDLE 5000
+// and no byte waits longer than this for the bus to go quiet
+#define UDPSTREAM_BATCH_MAX_HOLD 20000
+
+// Packets held while waiting for one missing ahead of them
+#define UDPSTREAM_JITTER_SLOTS 8
+// How long they're held before the missing one is given up on: twice as long
+// as missing ones have recently taken to turn up, between these
+#define UDPSTREAM_JITTER_MIN_DELAY 5000
+#define UDPSTREAM_JITTER_DELAY 30000
+// A jump in sequence numbers bigger than this is the sender starting over
+#define UDPSTREAM_SEQ_RESTART 1024
+
+struct udpstream_stats
+{
+    uint32_t packets_in;
+    uint32_t delivered;
+    uint32_t reordered;  // arrived ahead of one missing
+    uint32_t duplicates; // dropped, already delivered or held
+    uint32_t late;       // dropped, arrived after being given up on
+    uint32_t lost;       // given up on
+    uint32_t restarts;
+};
+
+// Collects bytes from the bus into the next datagram, sequence number in front if wanted
+class UDPStreamBatch
+{
+private:
+    uint8_t _buf[UDPSTREAM_MAX_PACKET];
+    size_t _start = 0; // UDPSTREAM_SEQ_SIZE when numbered
+    size_t _len = 0;
+    uint16_t _seq = 0;
+    uint32_t _first = 0; // first byte of the batch arrived
+    uint32_t _last = 0;  // last byte arrived
+    uint32_t _gap = UDPSTREAM_BATCH_MAX_IDLE; // average time between bytes in a burst
+
+public:
+    uint32_t packets = 0; // sent
+    uint32_t bytes = 0;
+
+    void begin(bool numbered);
+
+    // Returns true when the batch is full and has to be sent
+    bool add(uint8_t b, uint32_t now);
+    bool empty() { return _len == _start; }
+    // Time to send: the bus has gone quiet, or the first byte has waited long enough
+    bool due(uint32_t now);
+    uint32_t idle_limit();
+
+    const uint8_t *packet() { return _buf; }
+    size_t length() { return _len; }
+    uint16_t seq() { return _seq; }
+    // Start the next batch
+    void sent();
+};
+
+// Puts numbered datagrams back in order, dropping duplicates and waiting a
+// little for ones missing. Datagrams are received straight into buffer(),
+// handed to put(), then get() is called until it returns nullptr.
+class UDPStreamJitter
+{
+private:
+    struct slot
+    {
+        uint8_t *data;
+        uint16_t len;
+        bool full;
+        uint32_t arrived;
+    };
+
+    uint8_t _pool[UDPSTREAM_JITTER_SLOTS + 3][UDPSTREAM_MAX_PACKET];
+    slot _slot[UDPSTREAM_JITTER_SLOTS];
+    uint8_t *_spare; // receives the next datagram
+    uint8_t *_out;   // the last one returned by get()
+    int _held = 0;
+
+    bool _started = false;
+    uint16_t _next = 0;     // sequence number to deliver next
+    uint32_t _done = 0;     // bit n: _next - 1 - n was delivered
+
+    // Too far ahead to hold until the ones before it are out of the way
+    bool _parked = false;
+    uint8_t *_parked_data;
+    uint16_t _parked_seq = 0;
+    uint16_t _parked_len = 0;
+    uint32_t _parked_arrived = 0;
+
+    uint32_t _delay;
+    uint32_t _fill; // recent longest wait for a missing one that turned up
+
+    void store(uint16_t seq, uint16_t len, uint32_t arrived);
+    uint32_t oldest();
+    void advance(bool delivered);
+
+public:
+    udpstream_stats stats = {};
+
+    UDPStreamJitter(uint32_t delay = UDPSTREAM_JITTER_DELAY);
+
+    void reset();
+    uint32_t delay();
+    uint8_t *buffer() { return _spare; }
+    // The datagram received into buffer(), len bytes with the sequence number
+    void put(size_t len, uint32_t now);
+    // The next data in order, without the sequence number, or nullptr
+    const uint8_t *get(size_t *len, uint32_t now);
+};
+
+#endif //_FN_UDPSTREAM_
@@ -25,6 +25,7 @@
 
 #include "fsFlash.h"
 #include "fnFsSD.h"
+#include "fnFileCache.h"
 
 #include "httpService.h"
 
@@ -230,6 +231,10 @@ void main_setup(int argc, char *argv[])
     // Load our stored configuration
     Config.load();
 
+#ifndef FNIO_IS_STDIO
+    FileCache::set_max_size((uint64_t)Config.get_general_filecache_max_kb() * 1024);
+#endif
+
     // WiFi/BT auto connect moved to app_main()
 
 #ifdef BUILD_ATARI
@@ -6,6 +6,15 @@
 #include <esp32/rom/ets_sys.h>
 #include "test_pass.h"
 #include "test_networkprotocol_translation.h"
+#include "test_cachekey.h"
+#include "test_atr_writeback.h"
+#include "test_dsk_nibble.h"
+#include "test_png_deflate.h"
+#include "test_dircache.h"
+#include "test_network_buffer.h"
+#include "test_fnjson_stream.h"
+#include "test_http_range.h"
+#include "test_udpstream.h"
 #include "../lib/hardware/fnSystem.h"
 
 extern "C"
@@ -24,6 +33,19 @@ void app_main()
 
     test_pass_run();
     tests_networkprotocol_translation();
+    tests_cachekey();
+    tests_png_deflate();
+    tests_dircache();
+    tests_network_buffer();
+    tests_fnjson_stream();
+    tests_http_range();
+    tests_udpstream();
+#ifdef BUILD_ATARI
+    tests_atr_writeback();
+#endif
+#ifdef BUILD_APPLE
+    tests_dsk_nibble();
+#endif
 
     UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+/**
+ * #FujiNet Tests - ATR write-back
+ */
+
+#ifdef BUILD_ATARI
+
+#include <string.h>
+#include <stdio.h>
+#include "../lib/media/atari/diskTypeAtr.h"
+#include "../lib/FileSystem/fnFsSD.h"
+#include "test_atr_writeback.h"
+
+#define TEST_ATR_PATH "/wbtest.atr"
+#define TEST_ATR_SECTORS 720
+
+/**
+ * Creates a blank single density image and mounts it with the given write-back timeout
+ */
+static MediaTypeATR *mount_test_image(uint32_t write_back_ms, uint32_t cache_budget = 0)
+{
+    fnFile *f = fnSDFAT.fnfile_open(TEST_ATR_PATH, "wb+");
+    if (f == nullptr)
+        return nullptr;
+    MediaTypeATR::create(f, 128, TEST_ATR_SECTORS);
+    fnio::fclose(f);
+
+    f = fnSDFAT.fnfile_open(TEST_ATR_PATH, "rb+");
+    if (f == nullptr)
+        return nullptr;
+
+    MediaTypeATR *atr = new MediaTypeATR();
+    atr->_write_back_ms = write_back_ms;
+    atr->_cache_budget = cache_budget;
+    atr->mount(f, TEST_ATR_SECTORS * 128 + 16);
+    return atr;
+}
+
+static bool write_sector(MediaTypeATR *atr, uint16_t sector, uint8_t fill)
+{
+    memset(atr->_disk_sectorbuff, fill, sizeof(atr->_disk_sectorbuff));
+    return atr->write(sector, false) == false;
+}
+
+/**
+ * Tests entrypoint
+ */
+void tests_atr_writeback()
+{
+    if (!fnSDFAT.running() && !fnSDFAT.start())
+    {
+        TEST_MESSAGE("SD card not available, skipping ATR write-back tests");
+        return;
+    }
+
+    RUN_TEST(tests_atr_writeback_consistency);
+    RUN_TEST(tests_atr_writeback_cache);
+
+    fnSDFAT.remove(TEST_ATR_PATH);
+}
+
+/**
+ * Test that held sectors are read back and reach the image on flush
+ */
+void tests_atr_writeback_consistency()
+{
+    uint16_t count;
+    MediaTypeATR *atr = mount_test_image(60000);
+    TEST_ASSERT_NOT_NULL(atr);
+
+    TEST_ASSERT_TRUE(write_sector(atr, 100, 0xA5));
+    TEST_ASSERT_TRUE(write_sector(atr, 5, 0x5A));
+
+    // Served from the write-back buffer
+    memset(atr->_disk_sectorbuff, 0, sizeof(atr->_disk_sectorbuff));
+    TEST_ASSERT_FALSE(atr->read(100, &count));
+    TEST_ASSERT_EQUAL(128, count);
+    TEST_ASSERT_EQUAL_HEX8(0xA5, atr->_disk_sectorbuff[127]);
+
+    // Unmount flushes, then the data must come from the file
+    delete atr;
+
+    fnFile *f = fnSDFAT.fnfile_open(TEST_ATR_PATH, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    atr = new MediaTypeATR();
+    atr->mount(f, TEST_ATR_SECTORS * 128 + 16);
+    TEST_ASSERT_FALSE(atr->read(100, &count));
+    TEST_ASSERT_EQUAL_HEX8(0xA5, atr->_disk_sectorbuff[0]);
+    TEST_ASSERT_FALSE(atr->read(5, &count));
+    TEST_ASSERT_EQUAL_HEX8(0x5A, atr->_disk_sectorbuff[0]);
+    delete atr;
+}
+
+/**
+ * Test that a cache block read while sectors are held shows the held data, before and after flush
+ */
+void tests_atr_writeback_cache()
+{
+    uint16_t count;
+    MediaTypeATR *atr = mount_test_image(60000, 16384);
+    TEST_ASSERT_NOT_NULL(atr);
+
+    // Sector 20's track isn't cached yet when it's written
+    TEST_ASSERT_FALSE(atr->read(10, &count));
+    TEST_ASSERT_TRUE(write_sector(atr, 20, 0xC3));
+
+    // Reading its neighbour reads the track from the image, where 20 is still blank
+    TEST_ASSERT_FALSE(atr->read(21, &count));
+    TEST_ASSERT_EQUAL_HEX8(0x00, atr->_disk_sectorbuff[0]);
+
+    TEST_ASSERT_FALSE(atr->flush());
+
+    // Now served from the cache
+    TEST_ASSERT_FALSE(atr->read(20, &count));
+    TEST_ASSERT_EQUAL(128, count);
+    TEST_ASSERT_EQUAL_HEX8(0xC3, atr->_disk_sectorbuff[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xC3, atr->_disk_sectorbuff[127]);
+    delete atr;
+}
+
+#endif /* BUILD_ATARI */
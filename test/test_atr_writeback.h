@@ -0,0 +1,35 @@
+/**
+ * #FujiNet Tests - ATR write-back
+ *
+ * bench/bench_atr_writeback.cpp compares strict and write-back modes on
+ * a DOS FORMAT + file copy style workload.
+ */
+
+#ifndef TEST_ATR_WRITEBACK_H
+#define TEST_ATR_WRITEBACK_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_atr_writeback();
+
+    /**
+     * Test that held sectors are read back and reach the image on flush
+     */
+    void tests_atr_writeback_consistency();
+
+    /**
+     * Test that a cache block read while sectors are held shows the held data, before and after flush
+     */
+    void tests_atr_writeback_cache();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_ATR_WRITEBACK_H */
@@ -0,0 +1,119 @@
+/**
+ * #FujiNet Tests - Cache key derivation
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <bitset>
+#include <mbedtls/md5.h>
+#include "../lib/FileSystem/fnCacheKey.h"
+#include "test_cachekey.h"
+
+using namespace std;
+
+static const char *test_host = "TNFS://tnfs.fujinet.online/";
+static const char *test_path = "/ATARI/GAMES/Arcade/Donkey Kong (1983)(Atari)(US)[!].atr";
+
+/**
+ * Key derivation as it was done before fnCacheKey, to check the names keep their shape
+ */
+static string legacy_encode_base32(const string &data)
+{
+    static const string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+    string binary_string;
+    for (char c : data)
+        binary_string += bitset<8>(c).to_string();
+    int padding = binary_string.length() % 5;
+    if (padding != 0)
+        binary_string.append(5 - padding, '0');
+    string encoded;
+    for (size_t i = 0; i < binary_string.length(); i += 5)
+        encoded += alphabet[stoi(binary_string.substr(i, 5), nullptr, 2)];
+    while (encoded.length() % 8 != 0)
+        encoded += '=';
+    return encoded;
+}
+
+static string legacy_encode_host_path(const char *host, const char *path)
+{
+    unsigned char md5_result[16];
+    string result;
+    mbedtls_md5((const unsigned char *)host, strlen(host), md5_result);
+    result = legacy_encode_base32(string((char *)md5_result, 5)) + '-';
+    mbedtls_md5((const unsigned char *)path, strlen(path), md5_result);
+    result += legacy_encode_base32(string((char *)md5_result, 15));
+    return result;
+}
+
+/**
+ * Tests entrypoint
+ */
+void tests_cachekey()
+{
+    RUN_TEST(tests_cachekey_base32);
+    RUN_TEST(tests_cachekey_format);
+    RUN_TEST(tests_cachekey_distinct);
+}
+
+/**
+ * Test base32 encoding against RFC 4648 vectors
+ */
+void tests_cachekey_base32()
+{
+    char out[32];
+
+    TEST_ASSERT_EQUAL(0, cache_base32((const uint8_t *)"", 0, out));
+    TEST_ASSERT_EQUAL_STRING("", out);
+
+    cache_base32((const uint8_t *)"f", 1, out);
+    TEST_ASSERT_EQUAL_STRING("MY", out);
+
+    cache_base32((const uint8_t *)"fooba", 5, out);
+    TEST_ASSERT_EQUAL_STRING("MZXW6YTB", out);
+
+    cache_base32((const uint8_t *)"foobar", 6, out);
+    TEST_ASSERT_EQUAL_STRING("MZXW6YTBOI", out);
+}
+
+/**
+ * Test key length, alphabet and separator
+ */
+void tests_cachekey_format()
+{
+    char key[CACHE_KEY_LEN + 1];
+    cache_key(test_host, test_path, key);
+
+    TEST_ASSERT_EQUAL(CACHE_KEY_LEN, strlen(key));
+    TEST_ASSERT_EQUAL_CHAR('-', key[8]);
+    for (int i = 0; i < CACHE_KEY_LEN; i++)
+    {
+        if (i == 8)
+            continue;
+        TEST_ASSERT_NOT_NULL(strchr("ABCDEFGHIJKLMNOPQRSTUVWXYZ234567", key[i]));
+    }
+
+    // Same shape as the names the MD5 implementation produced
+    TEST_ASSERT_EQUAL(legacy_encode_host_path(test_host, test_path).size(), strlen(key));
+}
+
+/**
+ * Test that different hosts/paths give different keys and the same input the same key
+ */
+void tests_cachekey_distinct()
+{
+    char a[CACHE_KEY_LEN + 1];
+    char b[CACHE_KEY_LEN + 1];
+
+    cache_key(test_host, test_path, a);
+    cache_key(test_host, test_path, b);
+    TEST_ASSERT_EQUAL_STRING(a, b);
+
+    cache_key("TNFS://other.host/", test_path, b);
+    TEST_ASSERT_NOT_EQUAL(0, strncmp(a, b, 8));
+    TEST_ASSERT_EQUAL_STRING(a + 9, b + 9);
+
+    cache_key(test_host, "/ATARI/GAMES/Arcade/Donkey Kong (1983)(Atari)(US)[!].atx", b);
+    TEST_ASSERT_EQUAL_STRING_LEN(a, b, 9);
+    TEST_ASSERT_NOT_EQUAL(0, strcmp(a + 9, b + 9));
+}
@@ -0,0 +1,41 @@
+/**
+ * #FujiNet Tests - Cache key derivation
+ *
+ * Checks the SD cache key format. bench/bench_cachekey.cpp times it
+ * against the previous MD5 + std::bitset base32 implementation.
+ */
+
+#ifndef TEST_CACHEKEY_H
+#define TEST_CACHEKEY_H
+
+#include <unity.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_cachekey();
+
+    /**
+     * Test base32 encoding against RFC 4648 vectors
+     */
+    void tests_cachekey_base32();
+
+    /**
+     * Test key length, alphabet and separator
+     */
+    void tests_cachekey_format();
+
+    /**
+     * Test that different hosts/paths give different keys and the same input the same key
+     */
+    void tests_cachekey_distinct();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_CACHEKEY_H */
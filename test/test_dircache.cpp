@@ -0,0 +1,162 @@
+/**
+ * #FujiNet Tests - Directory cache
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../lib/FileSystem/fnDirCache.h"
+#include "compat_string.h"
+#include "test_dircache.h"
+
+#define TEST_LARGE_ENTRIES 5000
+
+static DirCache cache;
+
+/**
+ * Fills the cache with count entries: names mixing case and sharing long
+ * prefixes, every tenth a directory
+ */
+static void fill_cache(int count)
+{
+    static const char *prefixes[] = {"Game", "game", "GAMES", "Demo", "a", "_tool", "Utility Disk "};
+    char name[64];
+
+    cache.clear();
+    srand(1);
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(name, sizeof(name), "%s%d.%s", prefixes[rand() % 7], rand() % 1000, (i % 3) ? "ATR" : "xex");
+        cache.add_entry(name, i % 10 == 0, i, 1000000 + rand() % 5000);
+    }
+}
+
+/**
+ * Reads back the whole filtered listing and checks each entry follows the last
+ */
+static int check_order(uint16_t diropts)
+{
+    fsdir_entry prev;
+    fsdir_entry *e;
+    int count = 0;
+
+    while ((e = cache.read()) != nullptr)
+    {
+        if (count > 0)
+        {
+            // Directories first
+            TEST_ASSERT_TRUE(prev.isDir || !e->isDir);
+            if (prev.isDir == e->isDir)
+            {
+                if (diropts & DIR_OPTION_FILEDATE)
+                {
+                    if (diropts & DIR_OPTION_DESCENDING)
+                        TEST_ASSERT_TRUE(prev.modified_time <= e->modified_time);
+                    else
+                        TEST_ASSERT_TRUE(prev.modified_time >= e->modified_time);
+                }
+                else
+                {
+                    int cmp = strcasecmp(prev.filename, e->filename);
+                    TEST_ASSERT_TRUE((diropts & DIR_OPTION_DESCENDING) ? cmp >= 0 : cmp <= 0);
+                }
+            }
+        }
+        prev = *e;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Tests entrypoint
+ */
+void tests_dircache()
+{
+    RUN_TEST(tests_dircache_sort);
+    RUN_TEST(tests_dircache_filter);
+    RUN_TEST(tests_dircache_large);
+}
+
+/**
+ * Test the order of each sort option against strcasecmp and the entry times
+ */
+void tests_dircache_sort()
+{
+    fill_cache(500);
+    for (uint16_t diropts = 0; diropts < 4; diropts++)
+    {
+        cache.apply_filter(nullptr, diropts);
+        TEST_ASSERT_EQUAL(500, check_order(diropts));
+    }
+
+    // Names shorter than the sort key and differing only by case
+    cache.clear();
+    cache.add_entry("ab", false, 0, 0);
+    cache.add_entry("A", false, 0, 0);
+    cache.add_entry("abc", false, 0, 0);
+    cache.add_entry("ABCDE", false, 0, 0);
+    cache.add_entry("abcd", false, 0, 0);
+    cache.add_entry("Z", true, 0, 0);
+    cache.apply_filter("", 0);
+    TEST_ASSERT_EQUAL(6, check_order(0));
+}
+
+/**
+ * Test pattern filtering, find, tell and seek
+ */
+void tests_dircache_filter()
+{
+    cache.clear();
+    cache.add_entry("GAMES", true, 0, 0);
+    cache.add_entry("demos", true, 0, 0);
+    cache.add_entry("pacman.atr", false, 92176, 0);
+    cache.add_entry("Dig Dug.ATR", false, 133136, 0);
+    cache.add_entry("basic.xex", false, 8192, 0);
+
+    // Directories are kept unless the pattern ends in '/'
+    cache.apply_filter("*.atr", 0);
+    TEST_ASSERT_EQUAL(4, check_order(0));
+    cache.apply_filter("g*/", 0);
+    TEST_ASSERT_EQUAL_STRING("GAMES", cache.read()->filename);
+    TEST_ASSERT_NULL(cache.read());
+
+    // Same pattern again starts from the top
+    cache.apply_filter("g*/", 0);
+    TEST_ASSERT_EQUAL(0, cache.tell());
+    TEST_ASSERT_EQUAL(1, check_order(0));
+
+    cache.apply_filter("nothing/", 0);
+    TEST_ASSERT_EQUAL(FNFS_INVALID_DIRPOS, cache.tell());
+
+    cache.apply_filter(nullptr, 0);
+    TEST_ASSERT_TRUE(cache.seek(3));
+    TEST_ASSERT_EQUAL_STRING("Dig Dug.ATR", cache.read()->filename);
+    TEST_ASSERT_EQUAL(4, cache.tell());
+    TEST_ASSERT_TRUE(cache.seek(5));
+    TEST_ASSERT_NULL(cache.read());
+    TEST_ASSERT_FALSE(cache.seek(6));
+
+    const fsdir_entry *e = cache.find("pacman.atr");
+    TEST_ASSERT_NOT_NULL(e);
+    TEST_ASSERT_EQUAL(92176, e->size);
+    TEST_ASSERT_FALSE(e->isDir);
+    TEST_ASSERT_NULL(cache.find("PACMAN.ATR"));
+}
+
+/**
+ * Test filtering and sorting a few thousand entries, and filtering again with the same pattern
+ */
+void tests_dircache_large()
+{
+    fill_cache(TEST_LARGE_ENTRIES);
+    cache.apply_filter(nullptr, 0);
+    cache.apply_filter("*.xex", 0);
+    cache.apply_filter("*.xex", 0);
+
+    // Every third is a .xex, and directories aren't filtered
+    int expected = 0;
+    for (int i = 0; i < TEST_LARGE_ENTRIES; i++)
+        expected += (i % 3 == 0 || i % 10 == 0) ? 1 : 0;
+    TEST_ASSERT_EQUAL(expected, check_order(0));
+}
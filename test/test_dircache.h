@@ -0,0 +1,39 @@
+/**
+ * #FujiNet Tests - Directory cache
+ *
+ * Checks the sorted and filtered listings DirCache returns.
+ */
+
+#ifndef TEST_DIRCACHE_H
+#define TEST_DIRCACHE_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_dircache();
+
+    /**
+     * Test the order of each sort option against strcasecmp and the entry times
+     */
+    void tests_dircache_sort();
+
+    /**
+     * Test pattern filtering, find, tell and seek
+     */
+    void tests_dircache_filter();
+
+    /**
+     * Test filtering and sorting a few thousand entries, and filtering again with the same pattern
+     */
+    void tests_dircache_large();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_DIRCACHE_H */
@@ -0,0 +1,102 @@
+/**
+ * #FujiNet Tests - DSK nibblization
+ */
+
+#ifdef BUILD_APPLE
+
+#include <string.h>
+#include <stdio.h>
+#include "../lib/media/apple/mediaTypeDSK.h"
+#include "test_dsk_nibble.h"
+
+#define TEST_TRACK 17
+
+static const int phys2log[] = {0, 7, 14, 6, 13, 5, 12, 4, 11, 3, 10, 2, 9, 1, 8, 15};
+
+static uint8_t sectors[16 * 256];
+static uint8_t track[WOZ1_NUM_BLKS * 512];
+static uint8_t expected[WOZ1_NUM_BLKS * 512];
+
+/**
+ * Reads the byte starting at a bit position of a track
+ */
+static uint8_t track_byte(const uint8_t *bits, size_t position)
+{
+    size_t shift = position & 7;
+    uint8_t b = bits[position >> 3] << shift;
+    if (shift)
+        b |= bits[(position >> 3) + 1] >> (8 - shift);
+    return b;
+}
+
+/**
+ * Collects the data nibbles of a physical sector
+ */
+static void sector_nibbles(uint8_t *nibbles, const uint8_t *bits, int physical_sector)
+{
+    size_t position = DSK_GAP1_BITS + physical_sector * DSK_SECTOR_BITS + DSK_SECTOR_DATA_BITS;
+    for (int c = 0; c < 343; c++)
+        nibbles[c] = track_byte(bits, position + c * 8);
+}
+
+static void fill_sectors(uint8_t seed)
+{
+    for (size_t i = 0; i < sizeof(sectors); i++)
+        sectors[i] = (uint8_t)(i * 31 + (i >> 8) + seed);
+}
+
+/**
+ * Tests entrypoint
+ */
+void tests_dsk_nibble()
+{
+    RUN_TEST(tests_dsk_nibble_roundtrip);
+    RUN_TEST(tests_dsk_nibble_sector_patch);
+}
+
+/**
+ * Test that every sector of a nibblized track decodes back to its data
+ */
+void tests_dsk_nibble_roundtrip()
+{
+    uint8_t nibbles[343];
+    uint8_t decoded[343];
+
+    fill_sectors(0);
+    dsk_nibblize_track(track, sectors, TEST_TRACK, false);
+
+    uint16_t bit_count = track[WOZ1_TRACK_LEN + 2] | (track[WOZ1_TRACK_LEN + 3] << 8);
+    TEST_ASSERT_EQUAL(DSK_GAP1_BITS + 16 * DSK_SECTOR_BITS, bit_count);
+
+    for (int p = 0; p < 16; p++)
+    {
+        size_t position = DSK_GAP1_BITS + p * DSK_SECTOR_BITS + DSK_SECTOR_DATA_BITS;
+        TEST_ASSERT_EQUAL_HEX8(0xAD, track_byte(track, position - 8)); // data prologue
+
+        sector_nibbles(nibbles, track, p);
+        decode_6_and_2(decoded, nibbles);
+        TEST_ASSERT_EQUAL_MEMORY(&sectors[phys2log[p] * 256], decoded, 256);
+    }
+}
+
+/**
+ * Test that re-encoding one sector in place matches nibblizing the whole track
+ */
+void tests_dsk_nibble_sector_patch()
+{
+    fill_sectors(0);
+    dsk_nibblize_track(track, sectors, TEST_TRACK, false);
+
+    for (int p = 0; p < 16; p++)
+    {
+        uint8_t *sector = &sectors[phys2log[p] * 256];
+        memset(sector, p * 17, 256);
+        sector[p] = 0x55;
+        dsk_nibblize_sector(track, sector, p);
+    }
+
+    dsk_nibblize_track(expected, sectors, TEST_TRACK, false);
+    TEST_ASSERT_EQUAL_MEMORY(expected, track, sizeof(track));
+}
+
+#endif /* BUILD_APPLE */
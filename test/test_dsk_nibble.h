@@ -0,0 +1,35 @@
+/**
+ * #FujiNet Tests - DSK nibblization
+ *
+ * Round-trips tracks through the 6-and-2 encoder and decoder.
+ * bench/bench_dsk_nibble.cpp measures their throughput.
+ */
+
+#ifndef TEST_DSK_NIBBLE_H
+#define TEST_DSK_NIBBLE_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_dsk_nibble();
+
+    /**
+     * Test that every sector of a nibblized track decodes back to its data
+     */
+    void tests_dsk_nibble_roundtrip();
+
+    /**
+     * Test that re-encoding one sector in place matches nibblizing the whole track
+     */
+    void tests_dsk_nibble_sector_patch();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_DSK_NIBBLE_H */
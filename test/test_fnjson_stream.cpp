@@ -0,0 +1,223 @@
+/**
+ * #FujiNet Tests - Streaming JSON queries
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <cJSON.h>
+#include "../lib/fnjson/fnjson.h"
+#include "test_fnjson_stream.h"
+
+/**
+ * Protocol serving a JSON document in fixed size reads
+ */
+class jsonProtocol : public NetworkProtocol
+{
+private:
+    std::string pending;
+    size_t chunk;
+
+public:
+    jsonProtocol(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf, size_t chunk_size)
+        : NetworkProtocol(rx_buf, tx_buf, sp_buf), chunk(chunk_size) {}
+
+    void serve(const char *document) { pending = document; }
+
+    bool read(unsigned short len) override
+    {
+        receiveBuffer->append(pending.data(), len);
+        pending.erase(0, len);
+        return false;
+    }
+
+    bool status(NetworkStatus *status) override
+    {
+        status->rxBytesWaiting = pending.size() < chunk ? pending.size() : chunk;
+        status->connected = !pending.empty();
+        status->error = 0;
+        return false;
+    }
+};
+
+/**
+ * Parse doc and read query, streaming for it if stream is set
+ * @return the value read, "<none>" if there isn't one
+ */
+static std::string query_value(const char *doc, size_t chunk, const char *query, bool stream, bool *parsed)
+{
+    NetworkBuffer rx;
+    NetworkBuffer tx;
+    std::string sp;
+    jsonProtocol protocol(&rx, &tx, &sp, chunk);
+    protocol.serve(doc);
+
+    FNJSON json;
+    json.setLineEnding("\n");
+    json.setProtocol(&protocol);
+    json.setReadQuery(query, 0);
+    *parsed = json.parse(stream);
+    json.setReadQuery(query, 0);
+
+    std::string value(json.json_bytes_remaining, '\0');
+    if (json.readValue((uint8_t *)&value[0], value.size()))
+        return "<none>";
+    return value;
+}
+
+static const char *test_doc =
+    "{\"Name\":\"FujiNet\",\"version\":1.5,\"count\":42,"
+    " \"nested\":{\"a/b\":1,\"m~n\":\"tilde\",\"empty\":{},"
+    "  \"list\":[10, 20, {\"deep\":[true,false,null]}]},"
+    " \"escaped\\u0041key\":\"found\",\"dup\":1,\"dup\":2,"
+    " \"text\":\"line \\\"one\\\"\\nline two\",\"arr\":[],\"neg\":-3e2}";
+
+static const char *test_queries[] = {
+    "/name", "/NAME", "/version", "/count", "/nested", "/nested/a~1b", "/nested/m~0n",
+    "/nested/empty", "/nested/list", "/nested/list/1", "/nested/list/2/deep",
+    "/nested/list/2/deep/2", "/nested/list/01", "/nested/list/5", "/nested/list/x",
+    "/escapedAkey", "/dup", "/text", "/arr", "/neg", "/missing", "/missing/x", "/name/x",
+    "/nested/", "/", "no-slash"};
+
+/**
+ * Tests entrypoint
+ */
+void tests_fnjson_stream()
+{
+    RUN_TEST(tests_fnjson_stream_queries);
+    RUN_TEST(tests_fnjson_stream_malformed);
+    RUN_TEST(tests_fnjson_multiple_queries);
+}
+
+/**
+ * Test pointers, escapes, arrays and missing values against the cJSON tree
+ */
+void tests_fnjson_stream_queries()
+{
+    const size_t chunks[] = {1, 3, 64, 4096};
+
+    for (const char *query : test_queries)
+    {
+        bool dom_parsed;
+        std::string expected = query_value(test_doc, 4096, query, false, &dom_parsed);
+        TEST_ASSERT_TRUE(dom_parsed);
+
+        for (size_t chunk : chunks)
+        {
+            bool parsed;
+            std::string value = query_value(test_doc, chunk, query, true, &parsed);
+            TEST_ASSERT_TRUE(parsed);
+            TEST_ASSERT_EQUAL_STRING(expected.c_str(), value.c_str());
+        }
+    }
+
+    // A top level scalar ends with the input
+    bool parsed;
+    TEST_ASSERT_EQUAL_STRING("-12\n", query_value(" -12", 1, "no-slash", true, &parsed).c_str());
+    TEST_ASSERT_TRUE(parsed);
+
+    // Only the streamed value is kept
+    NetworkBuffer rx;
+    NetworkBuffer tx;
+    std::string sp;
+    jsonProtocol protocol(&rx, &tx, &sp, 16);
+    protocol.serve(test_doc);
+    FNJSON json;
+    json.setProtocol(&protocol);
+    json.setReadQuery("/count", 0);
+    TEST_ASSERT_TRUE(json.parse(true));
+    json.setReadQuery("/count", 0);
+    TEST_ASSERT_EQUAL(2, json.json_bytes_remaining);
+    json.setReadQuery("/version", 0);
+    TEST_ASSERT_EQUAL(0, json.json_bytes_remaining);
+
+    // A query set before a plain parse() still leaves the whole document
+    protocol.serve(test_doc);
+    FNJSON tree;
+    tree.setProtocol(&protocol);
+    tree.setReadQuery("/count", 0);
+    TEST_ASSERT_TRUE(tree.parse());
+    tree.setReadQuery("/version", 0);
+    TEST_ASSERT_EQUAL(3, tree.json_bytes_remaining);
+    tree.setReadQuery("/count", 0);
+    TEST_ASSERT_EQUAL(2, tree.json_bytes_remaining);
+}
+
+/**
+ * Test that malformed documents fail to parse
+ */
+void tests_fnjson_stream_malformed()
+{
+    const char *bad_docs[] = {"{\"a\":1,}", "{\"a\" 1}", "{\"a\":[1,2}", "{\"a\":[1,2", "[1 2]", "{a:1}", ""};
+
+    for (const char *doc : bad_docs)
+    {
+        for (bool stream : {false, true})
+        {
+            bool parsed;
+            std::string value = query_value(doc, 2, "/z", stream, &parsed);
+            TEST_ASSERT_FALSE(parsed);
+            TEST_ASSERT_EQUAL_STRING("<none>", value.c_str());
+        }
+    }
+}
+
+/**
+ * Split a setReadQueries() record into its values, "<none>" where the length is 0
+ */
+static std::vector<std::string> unpack_values(FNJSON &json)
+{
+    std::string record(json.json_bytes_remaining, '\0');
+    json.readValue((uint8_t *)&record[0], record.size());
+
+    std::vector<std::string> values;
+    size_t pos = 1;
+    for (int i = 0; i < (uint8_t)record[0]; i++)
+    {
+        size_t len = (uint8_t)record[pos] | ((uint8_t)record[pos + 1] << 8);
+        values.push_back(len == 0 ? "<none>" : record.substr(pos + 2, len));
+        pos += 2 + len;
+    }
+    TEST_ASSERT_EQUAL(record.size(), pos);
+    return values;
+}
+
+/**
+ * Test that a batch of queries returns what each query does on its own
+ */
+void tests_fnjson_multiple_queries()
+{
+    std::vector<std::string> queries(std::begin(test_queries), std::end(test_queries));
+    queries.push_back("/name"); // Twice in one batch
+
+    NetworkBuffer rx;
+    NetworkBuffer tx;
+    std::string sp;
+    jsonProtocol protocol(&rx, &tx, &sp, 64);
+    protocol.serve(test_doc);
+    FNJSON json;
+    json.setLineEnding("\n");
+    json.setProtocol(&protocol);
+    TEST_ASSERT_TRUE(json.parse());
+    TEST_ASSERT_TRUE(json.setReadQueries(queries, 0));
+
+    std::vector<std::string> values = unpack_values(json);
+    TEST_ASSERT_EQUAL(queries.size(), values.size());
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        bool parsed;
+        std::string expected = query_value(test_doc, 4096, queries[i].c_str(), false, &parsed);
+        TEST_ASSERT_EQUAL_STRING(expected.c_str(), values[i].c_str());
+    }
+
+    // Values that don't fit a 16 bit length leave nothing to read
+    std::string big = "{\"a\":\"" + std::string(40000, 'x') + "\"}";
+    protocol.serve(big.c_str());
+    TEST_ASSERT_TRUE(json.parse());
+    TEST_ASSERT_TRUE(json.setReadQueries({"/a"}, 0));
+    TEST_ASSERT_FALSE(json.setReadQueries({"/a", "/a"}, 0));
+    TEST_ASSERT_EQUAL(0, json.json_bytes_remaining);
+}
@@ -0,0 +1,43 @@
+/**
+ * #FujiNet Tests - Streaming JSON queries
+ *
+ * Checks that a query streamed by FNJSON::parse(true) gives the same value
+ * as the cJSON tree does, however the document is split up on the way in,
+ * and that a batch of queries matches the queries made one at a time.
+ * bench/bench_fnjson_stream.cpp measures memory and time for a large API
+ * response.
+ */
+
+#ifndef TEST_FNJSON_STREAM_H
+#define TEST_FNJSON_STREAM_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_fnjson_stream();
+
+    /**
+     * Test pointers, escapes, arrays and missing values against the cJSON tree
+     */
+    void tests_fnjson_stream_queries();
+
+    /**
+     * Test that malformed documents fail to parse
+     */
+    void tests_fnjson_stream_malformed();
+
+    /**
+     * Test that a batch of queries returns what each query does on its own
+     */
+    void tests_fnjson_multiple_queries();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_FNJSON_STREAM_H */
@@ -0,0 +1,161 @@
+/**
+ * #FujiNet Tests - HTTP Range file handler
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../lib/FileSystem/fnFileHTTPRange.h"
+#include "test_http_range.h"
+
+/**
+ * Handler answering Range requests from a file made up on the fly, in
+ * place of a web server
+ */
+class rangeFile : public FileHandlerHTTPRange
+{
+private:
+    long file_size;
+    long next = 0;
+    long stop = 0;
+
+protected:
+    int request(long first, long last, long *total) override
+    {
+        requests++;
+        *total = -1;
+        if (!ranges)
+            return 200;
+        if (first >= file_size)
+            return 416;
+        if (last >= file_size)
+            last = file_size - 1;
+        next = first;
+        stop = last + 1;
+        *total = file_size;
+        return 206;
+    }
+
+    int receive(uint8_t *dest, int len) override
+    {
+        int n = 0;
+        while (n < len && next < stop)
+            dest[n++] = byte_at(next++);
+        fetched += n;
+        return n;
+    }
+
+public:
+    bool ranges = true;
+    int requests = 0;
+    long fetched = 0;
+
+    rangeFile(long size) : FileHandlerHTTPRange(nullptr, "http://localhost/disk.img"), file_size(size) {}
+
+    static uint8_t byte_at(long offset) { return (uint8_t)(offset * 7 + offset / 4093); }
+};
+
+/**
+ * Checks len bytes read at offset against the file
+ */
+static void check_read(rangeFile *f, long offset, size_t len, long size)
+{
+    static uint8_t buf[4 * HTTPRANGE_BLOCK_SIZE];
+    size_t expected = offset >= size ? 0 : (offset + (long)len > size ? size - offset : len);
+
+    TEST_ASSERT_EQUAL(0, f->seek(offset, SEEK_SET));
+    TEST_ASSERT_EQUAL(expected, f->read(buf, 1, len));
+    TEST_ASSERT_EQUAL(offset + (long)expected, f->tell());
+    for (size_t i = 0; i < expected; i++)
+    {
+        if (buf[i] != rangeFile::byte_at(offset + i))
+            TEST_FAIL_MESSAGE("data differs from the file");
+    }
+}
+
+void tests_http_range()
+{
+    RUN_TEST(tests_http_range_read);
+    RUN_TEST(tests_http_range_requests);
+}
+
+/**
+ * Test random seeks and reads, block edges, the end of the file and eof()
+ */
+void tests_http_range_read()
+{
+    const long size = 100000; // not a whole number of blocks
+    uint8_t buf[512];
+
+    rangeFile *f = new rangeFile(size);
+    TEST_ASSERT_TRUE(f->open());
+    TEST_ASSERT_EQUAL(size, f->size());
+
+    srand(1);
+    for (int i = 0; i < 500; i++)
+        check_read(f, rand() % size, 1 + rand() % 10000, size);
+
+    // Around block edges
+    check_read(f, HTTPRANGE_BLOCK_SIZE - 1, 2, size);
+    check_read(f, 3 * HTTPRANGE_BLOCK_SIZE, HTTPRANGE_BLOCK_SIZE, size);
+    check_read(f, 5 * HTTPRANGE_BLOCK_SIZE - 100, 3 * HTTPRANGE_BLOCK_SIZE + 200, size);
+
+    // The end of the file
+    check_read(f, size - 10, 100, size);
+    TEST_ASSERT_EQUAL(1, f->eof());
+    check_read(f, size + 10, 100, size);
+
+    // Whole items only, as with fread
+    TEST_ASSERT_EQUAL(0, f->seek(-300, SEEK_END));
+    TEST_ASSERT_EQUAL(0, f->read(buf, 512, 1));
+    TEST_ASSERT_EQUAL(0, f->seek(-1024, SEEK_END));
+    TEST_ASSERT_EQUAL(0, f->eof());
+    TEST_ASSERT_EQUAL(2, f->read(buf, 256, 2));
+    TEST_ASSERT_EQUAL(0, f->seek(-512, SEEK_CUR));
+    TEST_ASSERT_EQUAL(size - 1024, f->tell());
+    TEST_ASSERT_EQUAL(-1, f->seek(-1, SEEK_SET));
+
+    TEST_ASSERT_EQUAL(0, f->write(buf, 1, 1));
+
+    f->close();
+}
+
+/**
+ * Test read-ahead, cache hits and a server without Range support
+ */
+void tests_http_range_requests()
+{
+    const long blocks = 2 * HTTPRANGE_CACHE_BLOCKS;
+    uint8_t buf[512];
+
+    rangeFile *f = new rangeFile(blocks * HTTPRANGE_BLOCK_SIZE);
+    TEST_ASSERT_TRUE(f->open());
+    TEST_ASSERT_EQUAL(1, f->requests);
+    TEST_ASSERT_EQUAL(HTTPRANGE_READAHEAD_BLOCKS * HTTPRANGE_BLOCK_SIZE, f->fetched);
+
+    // Reading straight through asks for a few blocks at a time
+    while (f->read(buf, 1, sizeof(buf)) == sizeof(buf))
+        ;
+    TEST_ASSERT_EQUAL(blocks / HTTPRANGE_READAHEAD_BLOCKS, f->requests);
+    TEST_ASSERT_EQUAL(blocks * HTTPRANGE_BLOCK_SIZE, f->fetched);
+
+    // The last blocks read are still there
+    f->seek((blocks - HTTPRANGE_CACHE_BLOCKS) * HTTPRANGE_BLOCK_SIZE, SEEK_SET);
+    TEST_ASSERT_EQUAL(sizeof(buf), f->read(buf, 1, sizeof(buf)));
+    TEST_ASSERT_EQUAL(blocks / HTTPRANGE_READAHEAD_BLOCKS, f->requests);
+
+    // Jumping back fetches only the block needed
+    long fetched = f->fetched;
+    f->seek(0, SEEK_SET);
+    TEST_ASSERT_EQUAL(sizeof(buf), f->read(buf, 1, sizeof(buf)));
+    TEST_ASSERT_EQUAL(blocks / HTTPRANGE_READAHEAD_BLOCKS + 1, f->requests);
+    TEST_ASSERT_EQUAL(fetched + HTTPRANGE_BLOCK_SIZE, f->fetched);
+    f->close();
+
+    // Whole file responses are for FileCache to deal with
+    f = new rangeFile(blocks * HTTPRANGE_BLOCK_SIZE);
+    f->ranges = false;
+    TEST_ASSERT_FALSE(f->open());
+    TEST_ASSERT_EQUAL(0, f->fetched);
+    f->close();
+}
@@ -0,0 +1,37 @@
+/**
+ * #FujiNet Tests - HTTP Range file handler
+ *
+ * Checks that FileHandlerHTTPRange reads the same bytes as the file it
+ * fetches, reads ahead when going forward and falls back when the server
+ * ignores Range. bench/bench_http_range.cpp measures what mounting a large
+ * image costs compared to downloading all of it.
+ */
+
+#ifndef TEST_HTTP_RANGE_H
+#define TEST_HTTP_RANGE_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_http_range();
+
+    /**
+     * Test random seeks and reads, block edges, the end of the file and eof()
+     */
+    void tests_http_range_read();
+
+    /**
+     * Test read-ahead, cache hits and a server without Range support
+     */
+    void tests_http_range_requests();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_HTTP_RANGE_H */
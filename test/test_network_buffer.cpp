@@ -0,0 +1,159 @@
+/**
+ * #FujiNet Tests - Network protocol buffer
+ */
+
+#include <string.h>
+#include <string>
+#include "../lib/network-protocol/NetworkBuffer.h"
+#include "../lib/network-protocol/HTTP.h"
+#include "test_network_buffer.h"
+
+#define TEST_HTTP_SIZE (4 * 1024 * 1024)
+#define TEST_HTTP_CHUNK 65535 // Most NetworkProtocolHTTP::status_file() reports waiting
+#define TEST_BUS_FRAME 512    // What the computer asks for per read
+
+/**
+ * Byte n of the test download
+ */
+static inline uint8_t pattern(size_t n)
+{
+    return (uint8_t)((n * 7) ^ (n >> 9));
+}
+
+/**
+ * HTTP protocol with the body coming from pattern() instead of a server
+ */
+class testHTTP : public NetworkProtocolHTTP
+{
+private:
+    size_t sent = 0;
+
+protected:
+    bool read_file_handle(uint8_t *buf, unsigned short len) override
+    {
+        for (unsigned short i = 0; i < len; i++)
+            buf[i] = pattern(sent + i);
+        sent += len;
+        return false;
+    }
+
+public:
+    testHTTP(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, std::string *sp_buf)
+        : NetworkProtocolHTTP(rx_buf, tx_buf, sp_buf)
+    {
+        fileSize = TEST_HTTP_SIZE;
+        error = 1;
+    }
+};
+
+/**
+ * Tests entrypoint
+ */
+void tests_network_buffer()
+{
+    RUN_TEST(tests_network_buffer_basic);
+    RUN_TEST(tests_network_buffer_compaction);
+    RUN_TEST(tests_network_buffer_http_read);
+}
+
+/**
+ * Test append, consume, prepare/commit and truncate
+ */
+void tests_network_buffer_basic()
+{
+    NetworkBuffer buf;
+    TEST_ASSERT_TRUE(buf.empty());
+    TEST_ASSERT_EQUAL_STRING("", buf.c_str());
+
+    buf.append("Hello, ", 7);
+    buf += std::string("World!");
+    TEST_ASSERT_EQUAL(13, buf.size());
+    TEST_ASSERT_EQUAL_STRING("Hello, World!", buf.c_str());
+
+    buf.consume(7);
+    TEST_ASSERT_EQUAL_STRING("World!", buf.c_str());
+    TEST_ASSERT_EQUAL('W', buf[0]);
+    TEST_ASSERT_EQUAL_STRING("rld", buf.substr(2, 3).c_str());
+
+    char *p = buf.prepare(4);
+    memcpy(p, " Bye", 4);
+    buf.commit(4);
+    TEST_ASSERT_EQUAL_STRING("World! Bye", buf.c_str());
+
+    buf.truncate(5);
+    TEST_ASSERT_EQUAL_STRING("World", buf.str().c_str());
+
+    // Consuming everything starts over at the beginning of the block
+    size_t capacity = buf.capacity();
+    buf.consume(100);
+    TEST_ASSERT_TRUE(buf.empty());
+    TEST_ASSERT_EQUAL(capacity, buf.capacity());
+
+    buf.assign("again");
+    TEST_ASSERT_EQUAL_STRING("again", buf.c_str());
+
+    buf.clear();
+    buf.shrink_to_fit();
+    TEST_ASSERT_EQUAL(0, buf.capacity());
+}
+
+/**
+ * Test that the data survives the buffer sliding down and growing
+ */
+void tests_network_buffer_compaction()
+{
+    NetworkBuffer buf;
+    size_t written = 0;
+    size_t read = 0;
+    uint8_t chunk[300];
+
+    // Write a little more than is read each round, so the data keeps moving and growing
+    for (int round = 0; round < 2000; round++)
+    {
+        size_t len = 100 + (round * 37) % 200;
+        for (size_t i = 0; i < len; i++)
+            chunk[i] = pattern(written + i);
+        buf.append(chunk, len);
+        written += len;
+
+        size_t take = len - (round % 3 == 0 ? 10 : 0);
+        if (take > buf.size())
+            take = buf.size();
+        for (size_t i = 0; i < take; i++)
+            TEST_ASSERT_EQUAL(pattern(read + i), (uint8_t)buf[i]);
+        buf.consume(take);
+        read += take;
+    }
+
+    TEST_ASSERT_EQUAL(written - read, buf.size());
+    TEST_ASSERT_TRUE(buf.capacity() < 4 * buf.size() + 1024);
+}
+
+/**
+ * Test a download streamed through NetworkProtocolHTTP::read and taken in bus sized frames
+ */
+void tests_network_buffer_http_read()
+{
+    NetworkBuffer rx_buf;
+    NetworkBuffer tx_buf;
+    std::string sp_buf;
+    uint8_t frame[TEST_BUS_FRAME];
+
+    // The protocol fills the buffer whenever it runs dry, the bus takes it a frame at a time
+    testHTTP *http = new testHTTP(&rx_buf, &tx_buf, &sp_buf);
+    size_t delivered = 0;
+    bool match = true;
+    while (delivered < TEST_HTTP_SIZE)
+    {
+        if (rx_buf.empty())
+            http->read(TEST_HTTP_CHUNK);
+        size_t len = rx_buf.size() < TEST_BUS_FRAME ? rx_buf.size() : TEST_BUS_FRAME;
+        memcpy(frame, rx_buf.data(), len);
+        rx_buf.consume(len);
+        match = match && frame[0] == pattern(delivered) && frame[len - 1] == pattern(delivered + len - 1);
+        delivered += len;
+    }
+    delete http;
+    TEST_ASSERT_TRUE(match);
+    TEST_ASSERT_EQUAL(TEST_HTTP_SIZE, delivered);
+}
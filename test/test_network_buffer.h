@@ -0,0 +1,42 @@
+/**
+ * #FujiNet Tests - Network protocol buffer
+ *
+ * Checks the NetworkBuffer used between the protocols and the bus, and
+ * an HTTP download streamed through NetworkProtocolHTTP::read.
+ * bench/bench_network_buffer.cpp times it against the previous
+ * std::string buffer handling.
+ */
+
+#ifndef TEST_NETWORK_BUFFER_H
+#define TEST_NETWORK_BUFFER_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_network_buffer();
+
+    /**
+     * Test append, consume, prepare/commit and truncate
+     */
+    void tests_network_buffer_basic();
+
+    /**
+     * Test that the data survives the buffer sliding down and growing
+     */
+    void tests_network_buffer_compaction();
+
+    /**
+     * Test a download streamed through NetworkProtocolHTTP::read and taken in bus sized frames
+     */
+    void tests_network_buffer_http_read();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_NETWORK_BUFFER_H */
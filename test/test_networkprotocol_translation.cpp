@@ -5,8 +5,11 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <string>
 #include "../lib/network-protocol/Protocol.h"
+#include "utils.h"
 #include "test_networkprotocol_translation.h"
 
 /**
@@ -20,10 +23,27 @@ using namespace std;
 /**
  * The Buffers
  */
-string *rx_buf;
-string *tx_buf;
+NetworkBuffer *rx_buf;
+NetworkBuffer *tx_buf;
 string *sp_buf;
 
+/**
+ * The base class translates on read but leaves write to the protocols,
+ * so writes here just translate
+ */
+class translationProtocol : public NetworkProtocol
+{
+public:
+    translationProtocol(NetworkBuffer *rx_buf, NetworkBuffer *tx_buf, string *sp_buf)
+        : NetworkProtocol(rx_buf, tx_buf, sp_buf) {}
+
+    bool write(unsigned short len) override
+    {
+        translate_transmit_buffer();
+        return false;
+    }
+};
+
 /**
  * Protocol object
  */
@@ -48,6 +68,7 @@ void tests_networkprotocol_translation()
     RUN_TEST(tests_networkprotocol_translation_tx_eol_to_cr);
     RUN_TEST(tests_networkprotocol_translation_tx_eol_to_lf);
     RUN_TEST(tests_networkprotocol_translation_tx_eol_to_crlf);
+    RUN_TEST(tests_networkprotocol_translation_reference);
 }
 
 /**
@@ -56,17 +77,15 @@ void tests_networkprotocol_translation()
 void tests_networkprotocol_translation_rx_cr_to_eol()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x01, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_cr);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->read(strlen(test_cr));
-    protocol->close();
-
     TEST_ASSERT_EQUAL_STRING(test_eol, rx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -75,17 +94,15 @@ void tests_networkprotocol_translation_rx_cr_to_eol()
 void tests_networkprotocol_translation_rx_lf_to_eol()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x02, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_lf);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->read(strlen(test_lf));
-    protocol->close();
-
     TEST_ASSERT_EQUAL_STRING(test_eol, rx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -94,17 +111,15 @@ void tests_networkprotocol_translation_rx_lf_to_eol()
 void tests_networkprotocol_translation_rx_crlf_to_eol()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x03, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_crlf);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->read(strlen(test_crlf));
-    protocol->close();
-
     TEST_ASSERT_EQUAL_STRING(test_eol, rx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -113,17 +128,15 @@ void tests_networkprotocol_translation_rx_crlf_to_eol()
 void tests_networkprotocol_translation_tx_eol_to_cr()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x01, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_eol);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->write(strlen(test_eol));
-    protocol->close();
-
     TEST_ASSERT_EQUAL_STRING(test_cr, tx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -132,17 +145,15 @@ void tests_networkprotocol_translation_tx_eol_to_cr()
 void tests_networkprotocol_translation_tx_eol_to_lf()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x02, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_eol);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->write(strlen(test_eol));
-    protocol->close();
-
     TEST_ASSERT_EQUAL_STRING(test_lf, tx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -151,17 +162,15 @@ void tests_networkprotocol_translation_tx_eol_to_lf()
 void tests_networkprotocol_translation_tx_eol_to_crlf()
 {
     cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, 0x03, 0xFF};
-    PeoplesUrlParser *url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
+    auto url = PeoplesUrlParser::parseURL("TCP://TCP:1234/");
 
     tests_networkprotocol_translation_setup(test_eol);
 
-    protocol->open(url, &cmdFrame);
+    protocol->open(url.get(), &cmdFrame);
     protocol->write(strlen(test_eol));
-    protocol->close();
-
     TEST_ASSERT_EQUAL_STRING(test_crlf, tx_buf->c_str());
+    protocol->close();
     tests_networkprotocol_translation_done();
-    delete url;
 }
 
 /**
@@ -171,11 +180,11 @@ void tests_networkprotocol_translation_tx_eol_to_crlf()
  */
 bool tests_networkprotocol_translation_setup(const char *c)
 {
-    rx_buf = nullptr;
-    tx_buf = nullptr;
-    sp_buf = nullptr;
+    rx_buf = new NetworkBuffer();
+    tx_buf = new NetworkBuffer();
+    sp_buf = new string();
 
-    protocol = new NetworkProtocol(rx_buf, tx_buf, sp_buf);
+    protocol = new translationProtocol(rx_buf, tx_buf, sp_buf);
 
     if (protocol == nullptr || rx_buf == nullptr || tx_buf == nullptr || sp_buf == nullptr)
         return false;
@@ -186,8 +195,8 @@ bool tests_networkprotocol_translation_setup(const char *c)
     sp_buf->clear();
 
     // Copy fixture into buffers
-    *rx_buf=string(c);
-    *tx_buf=string(c);
+    rx_buf->assign(c);
+    tx_buf->assign(c);
 
     return true;
 }
@@ -209,3 +218,108 @@ void tests_networkprotocol_translation_done()
     if (sp_buf != nullptr)
         delete sp_buf;
 }
+
+/**
+ * The find/replace translation NetworkProtocol used to do, for comparison
+ */
+#ifdef BUILD_APPLE
+#define REF_EOL "\x0d"
+#else
+#define REF_EOL "\x9b"
+#endif
+
+static void reference_rx(string &buf, int mode)
+{
+#ifdef BUILD_ATARI
+    replace(buf.begin(), buf.end(), '\x07', '\xfd');
+    replace(buf.begin(), buf.end(), '\x08', '\x7e');
+    replace(buf.begin(), buf.end(), '\x09', '\x7f');
+#endif
+    if (mode == 1)
+        replace(buf.begin(), buf.end(), '\x0d', REF_EOL[0]);
+    else if (mode == 2)
+        replace(buf.begin(), buf.end(), '\x0a', REF_EOL[0]);
+    else if (mode == 3)
+    {
+        replace(buf.begin(), buf.end(), '\x0d', REF_EOL[0]);
+        buf.erase(remove(buf.begin(), buf.end(), '\n'), buf.end());
+    }
+}
+
+static void reference_tx(string &buf, int mode)
+{
+#ifdef BUILD_ATARI
+    util_replaceAll(buf, "\xfd", "\x07");
+    util_replaceAll(buf, "\x7e", "\x08");
+    util_replaceAll(buf, "\x7f", "\x09");
+#endif
+    if (mode == 1)
+        util_replaceAll(buf, REF_EOL, "\x0d");
+    else if (mode == 2)
+        util_replaceAll(buf, REF_EOL, "\x0a");
+    else if (mode == 3)
+        util_replaceAll(buf, REF_EOL, "\x0d\x0a");
+}
+
+/**
+ * Text with short lines, CR/LF endings and the odd control character
+ */
+static string make_text(size_t len)
+{
+    string text;
+    text.reserve(len);
+    srand(1);
+    while (text.size() < len)
+    {
+        int words = 3 + rand() % 12;
+        for (int w = 0; w < words; w++)
+        {
+            text.append(1 + rand() % 8, 'a' + rand() % 26);
+            text += (rand() % 20 == 0) ? '\t' : ' ';
+        }
+        text += "\x0d\x0a";
+    }
+    text.resize(len);
+    return text;
+}
+
+/**
+ * Test every mode against the find/replace translation, on random bytes and on text
+ */
+void tests_networkprotocol_translation_reference()
+{
+    string samples[2];
+    samples[0] = make_text(5000);
+    for (int i = 0; i < 5000; i++)
+        samples[1] += (char)(rand() & 0xFF);
+
+    for (int s = 0; s < 2; s++)
+    {
+        for (int mode = 0; mode < 4; mode++)
+        {
+            NetworkBuffer rx;
+            NetworkBuffer tx;
+            string sp;
+            translationProtocol p(&rx, &tx, &sp);
+            cmdFrame_t cmdFrame = {0x71, 'O', 0x0C, (uint8_t)mode, 0xFF};
+            p.open(nullptr, &cmdFrame);
+
+            rx.assign(samples[s]);
+            tx.assign(samples[s]);
+            p.read(rx.size());
+            p.write(tx.size());
+
+            string expect_rx = samples[s];
+            string expect_tx = samples[s];
+            if (mode != 0)
+            {
+                reference_rx(expect_rx, mode);
+                reference_tx(expect_tx, mode);
+            }
+            TEST_ASSERT_EQUAL(expect_rx.size(), rx.size());
+            TEST_ASSERT_EQUAL_MEMORY(expect_rx.data(), rx.data(), rx.size());
+            TEST_ASSERT_EQUAL(expect_tx.size(), tx.size());
+            TEST_ASSERT_EQUAL_MEMORY(expect_tx.data(), tx.data(), tx.size());
+        }
+    }
+}
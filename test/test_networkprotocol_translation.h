@@ -2,6 +2,7 @@
  * #FujiNet Tests - NetworkProtocol Translation
  * 
  * This set of tests exercise the translation code that's in the NetworkProtocol base class.
+ * bench/bench_networkprotocol_translation.cpp times it against the find/replace translation.
  */
 
 #ifndef TEST_NETWORKPROTOCOL_TRANSLATION_H
@@ -51,6 +52,11 @@ extern "C"
      */
     void tests_networkprotocol_translation_tx_eol_to_crlf();
 
+    /**
+     * Test every mode against the find/replace translation, on random bytes and on text
+     */
+    void tests_networkprotocol_translation_reference();
+
     /**
      * Test set-up
      * @param c The test fixture to stuff into the buffer.
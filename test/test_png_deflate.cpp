@@ -0,0 +1,248 @@
+/**
+ * #FujiNet Tests - PNG printer compression
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "../lib/printer-emulator/deflate_stream.h"
+#include "test_png_deflate.h"
+
+#define TEST_SCREEN_WIDTH 320
+#define TEST_SCREEN_HEIGHT 192
+#define TEST_SCREEN_SIZE ((TEST_SCREEN_WIDTH + 1) * TEST_SCREEN_HEIGHT)
+
+static uint8_t screen[TEST_SCREEN_SIZE];
+static uint8_t compressed[TEST_SCREEN_SIZE + TEST_SCREEN_SIZE / 4];
+static uint8_t inflated[TEST_SCREEN_SIZE];
+static size_t compressed_len;
+
+static void collect(void *arg, const uint8_t *data, size_t len)
+{
+    if (compressed_len + len <= sizeof(compressed))
+        memcpy(compressed + compressed_len, data, len);
+    compressed_len += len;
+}
+
+/**
+ * Fills the screen with filter type 0 lines: 0 = text on a plain background,
+ * 1 = bars and a filled circle, 2 = noise
+ */
+static void fill_screen(int kind)
+{
+    srand(1);
+    for (int y = 0; y < TEST_SCREEN_HEIGHT; y++)
+    {
+        uint8_t *line = &screen[y * (TEST_SCREEN_WIDTH + 1)];
+        line[0] = 0;
+        for (int x = 0; x < TEST_SCREEN_WIDTH; x++)
+        {
+            uint8_t v;
+            if (kind == 0)
+            {
+                int glyph = ((x / 8) * 7 + (y / 8) * 13) % 96;
+                bool ink = ((glyph >> ((x + y) & 3)) & 1) && (x % 8 < 7) && (y % 8 < 7) && ((y / 8) % 3 != 2);
+                v = ink ? 0x0E : 0x94;
+            }
+            else if (kind == 1)
+            {
+                v = (uint8_t)(((x / 20) << 4) | ((y / 12) & 0x0F));
+                if ((x - 160) * (x - 160) + (y - 96) * (y - 96) < 3600)
+                    v = (uint8_t)(0x40 + ((x + y) >> 3));
+            }
+            else
+                v = (uint8_t)rand();
+            line[1 + x] = v;
+        }
+    }
+}
+
+/**
+ * Compresses the screen a few lines at a time, as the printer receives it
+ */
+static void compress_screen()
+{
+    deflateStream d;
+    compressed_len = 0;
+    TEST_ASSERT_TRUE(d.begin(collect, nullptr));
+    for (size_t pos = 0; pos < TEST_SCREEN_SIZE; pos += TEST_SCREEN_WIDTH + 1)
+        d.write(&screen[pos], TEST_SCREEN_WIDTH + 1);
+    d.finish();
+}
+
+/**
+ * Just enough inflate for a zlib stream of fixed Huffman blocks
+ */
+struct bit_reader
+{
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+
+    int bit()
+    {
+        if ((pos >> 3) >= len)
+            return -1;
+        int b = (data[pos >> 3] >> (pos & 7)) & 1;
+        pos++;
+        return b;
+    }
+
+    int bits(int count)
+    {
+        int v = 0;
+        for (int i = 0; i < count; i++)
+            v |= bit() << i;
+        return v;
+    }
+
+    int symbol()
+    {
+        int code = 0;
+        for (int len = 1; len <= 9; len++)
+        {
+            code = (code << 1) | bit();
+            if (len == 7 && code < 24)
+                return 256 + code;
+            if (len == 8 && code >= 0x30 && code < 0xC0)
+                return code - 0x30;
+            if (len == 8 && code >= 0xC0 && code < 0xC8)
+                return 280 + code - 0xC0;
+            if (len == 9 && code >= 0x190)
+                return 144 + code - 0x190;
+        }
+        return -1;
+    }
+};
+
+static long inflate_fixed(const uint8_t *src, size_t len, uint8_t *dest, size_t size)
+{
+    static const uint16_t length_base[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                           35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                           3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t dist_base[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                         257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                         8193, 12289, 16385, 24577};
+    static const uint8_t dist_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                         7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    if (len < 6 || (src[0] & 0x0F) != 8 || ((src[0] << 8) | src[1]) % 31 != 0)
+        return -1;
+
+    bit_reader in = {src, len - 4, 16};
+    size_t out = 0;
+    int final;
+    do
+    {
+        final = in.bit();
+        if (in.bits(2) != 1)
+            return -1;
+        while (true)
+        {
+            int sym = in.symbol();
+            if (sym < 0)
+                return -1;
+            if (sym < 256)
+            {
+                if (out >= size)
+                    return -1;
+                dest[out++] = sym;
+                continue;
+            }
+            if (sym == 256)
+                break;
+            sym -= 257;
+            if (sym >= 29)
+                return -1;
+            int length = length_base[sym] + in.bits(length_extra[sym]);
+            int dcode = 0;
+            for (int i = 0; i < 5; i++)
+                dcode = (dcode << 1) | in.bit();
+            if (dcode >= 30)
+                return -1;
+            size_t distance = dist_base[dcode] + in.bits(dist_extra[dcode]);
+            if (distance > out || out + length > size)
+                return -1;
+            for (int i = 0; i < length; i++, out++)
+                dest[out] = dest[out - distance];
+        }
+    } while (final == 0);
+
+    const uint8_t *a = src + len - 4;
+    uint32_t adler = ((uint32_t)a[0] << 24) | (a[1] << 16) | (a[2] << 8) | a[3];
+    if (adler != adler32_update(1, dest, out))
+        return -1;
+    return out;
+}
+
+/**
+ * Tests entrypoint
+ */
+void tests_png_deflate()
+{
+    RUN_TEST(tests_png_deflate_checksums);
+    RUN_TEST(tests_png_deflate_roundtrip);
+    RUN_TEST(tests_png_deflate_ratio);
+}
+
+/**
+ * Test CRC-32 and Adler-32 against known values and byte at a time versions
+ */
+void tests_png_deflate_checksums()
+{
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32_update(0, check, 9));
+    TEST_ASSERT_EQUAL_HEX32(0x091E01DE, adler32_update(1, check, 9));
+
+    fill_screen(2);
+    uint32_t crc = crc32_update(0, screen, TEST_SCREEN_SIZE);
+    uint32_t adler = adler32_update(1, screen, TEST_SCREEN_SIZE);
+
+    uint32_t crc_bytes = 0;
+    uint32_t adler_bytes = 1;
+    for (size_t i = 0; i < TEST_SCREEN_SIZE; i++)
+    {
+        crc_bytes = crc32_update(crc_bytes, &screen[i], 1);
+        adler_bytes = adler32_update(adler_bytes, &screen[i], 1);
+    }
+    TEST_ASSERT_EQUAL_HEX32(crc_bytes, crc);
+    TEST_ASSERT_EQUAL_HEX32(adler_bytes, adler);
+
+    // All 0xFF is the worst case for the deferred Adler modulo
+    memset(screen, 0xFF, TEST_SCREEN_SIZE);
+    adler_bytes = 1;
+    for (size_t i = 0; i < TEST_SCREEN_SIZE; i++)
+        adler_bytes = adler32_update(adler_bytes, &screen[i], 1);
+    TEST_ASSERT_EQUAL_HEX32(adler_bytes, adler32_update(1, screen, TEST_SCREEN_SIZE));
+}
+
+/**
+ * Test that the compressed stream inflates back to its input
+ */
+void tests_png_deflate_roundtrip()
+{
+    for (int kind = 0; kind < 3; kind++)
+    {
+        fill_screen(kind);
+        compress_screen();
+        TEST_ASSERT_TRUE(compressed_len <= sizeof(compressed));
+
+        memset(inflated, 0, sizeof(inflated));
+        long len = inflate_fixed(compressed, compressed_len, inflated, sizeof(inflated));
+        TEST_ASSERT_EQUAL(TEST_SCREEN_SIZE, len);
+        TEST_ASSERT_EQUAL_MEMORY(screen, inflated, TEST_SCREEN_SIZE);
+    }
+}
+
+/**
+ * Test that a plain screen comes out much smaller than stored blocks
+ */
+void tests_png_deflate_ratio()
+{
+    // zlib header, 5 bytes per 64K stored block, Adler-32
+    const size_t stored = 2 + 5 * ((TEST_SCREEN_SIZE + 0xFFFE) / 0xFFFF) + TEST_SCREEN_SIZE + 4;
+
+    fill_screen(0);
+    compress_screen();
+    TEST_ASSERT_TRUE(compressed_len < stored / 8);
+}
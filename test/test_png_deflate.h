@@ -0,0 +1,40 @@
+/**
+ * #FujiNet Tests - PNG printer compression
+ *
+ * Checks the checksums and the zlib stream the PNG printer writes.
+ * bench/bench_png_deflate.cpp measures output size and encode time.
+ */
+
+#ifndef TEST_PNG_DEFLATE_H
+#define TEST_PNG_DEFLATE_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_png_deflate();
+
+    /**
+     * Test CRC-32 and Adler-32 against known values and byte at a time versions
+     */
+    void tests_png_deflate_checksums();
+
+    /**
+     * Test that the compressed stream inflates back to its input
+     */
+    void tests_png_deflate_roundtrip();
+
+    /**
+     * Test that a plain screen comes out much smaller than stored blocks
+     */
+    void tests_png_deflate_ratio();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_PNG_DEFLATE_H */
@@ -0,0 +1,196 @@
+/**
+ * #FujiNet Tests - UDP stream batching and jitter buffer
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "../lib/tcpip/fnUDPStream.h"
+#include "test_udpstream.h"
+
+#define TEST_BYTE_TIME 320 // us per byte at 31250 baud
+
+/**
+ * Numbered datagram with every data byte set to the low byte of seq
+ */
+static void put_seq(UDPStreamJitter *j, uint16_t seq, size_t len, uint32_t now)
+{
+    uint8_t *buf = j->buffer();
+    buf[0] = seq & 0xFF;
+    buf[1] = seq >> 8;
+    memset(buf + UDPSTREAM_SEQ_SIZE, seq & 0xFF, len);
+    j->put(len + UDPSTREAM_SEQ_SIZE, now);
+}
+
+/**
+ * Checks the next data out is seq's
+ */
+static void expect_seq(UDPStreamJitter *j, uint16_t seq, size_t len, uint32_t now)
+{
+    size_t got_len = 0;
+    const uint8_t *data = j->get(&got_len, now);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_EQUAL(len, got_len);
+    for (size_t i = 0; i < len; i++)
+    {
+        if (data[i] != (seq & 0xFF))
+            TEST_FAIL_MESSAGE("data is not from the expected packet");
+    }
+}
+
+static void expect_none(UDPStreamJitter *j, uint32_t now)
+{
+    size_t len;
+    TEST_ASSERT_NULL(j->get(&len, now));
+}
+
+void tests_udpstream()
+{
+    RUN_TEST(tests_udpstream_batch);
+    RUN_TEST(tests_udpstream_jitter);
+}
+
+/**
+ * Test batches are numbered and sent after a pause, a hold time or when full
+ */
+void tests_udpstream_batch()
+{
+    static UDPStreamBatch b;
+    uint32_t t = 1000;
+
+    // Numbered from 1, little endian, after REGISTER
+    b.begin(true);
+    TEST_ASSERT_TRUE(b.empty());
+    TEST_ASSERT_FALSE(b.due(t));
+    for (int i = 0; i < 40; i++, t += TEST_BYTE_TIME)
+        TEST_ASSERT_FALSE(b.add(i, t));
+    TEST_ASSERT_EQUAL(40 + UDPSTREAM_SEQ_SIZE, b.length());
+    TEST_ASSERT_EQUAL(1, b.packet()[0]);
+    TEST_ASSERT_EQUAL(0, b.packet()[1]);
+    TEST_ASSERT_EQUAL(39, b.packet()[UDPSTREAM_SEQ_SIZE + 39]);
+
+    // A steady stream of bytes brings the pause needed down from the old 5 ms
+    uint32_t last = t - TEST_BYTE_TIME;
+    TEST_ASSERT_EQUAL(UDPSTREAM_BATCH_MIN_IDLE, b.idle_limit());
+    TEST_ASSERT_FALSE(b.due(last + UDPSTREAM_BATCH_MIN_IDLE - 1));
+    TEST_ASSERT_TRUE(b.due(last + UDPSTREAM_BATCH_MIN_IDLE));
+    b.sent();
+    TEST_ASSERT_TRUE(b.empty());
+    TEST_ASSERT_EQUAL(2, b.packet()[0]);
+    TEST_ASSERT_EQUAL(1, b.packets);
+    TEST_ASSERT_EQUAL(40, b.bytes);
+
+    // Bytes that never stop still go once the first has waited long enough
+    t = 100000;
+    uint32_t first = t;
+    while (!b.due(t))
+    {
+        b.add(0x55, t);
+        t += 1000;
+    }
+    TEST_ASSERT_EQUAL(first + UDPSTREAM_BATCH_MAX_HOLD, t);
+    b.sent();
+
+    // Full
+    for (int i = 0; i < UDPSTREAM_MAX_PACKET - UDPSTREAM_SEQ_SIZE - 1; i++)
+        TEST_ASSERT_FALSE(b.add(i, t));
+    TEST_ASSERT_TRUE(b.add(0, t));
+    TEST_ASSERT_TRUE(b.due(t));
+    b.sent();
+
+    // Ring mode packets are just the data
+    b.begin(false);
+    b.add(0xAA, t);
+    TEST_ASSERT_EQUAL(1, b.length());
+    TEST_ASSERT_EQUAL(0xAA, b.packet()[0]);
+    b.sent();
+    TEST_ASSERT_EQUAL(0, b.length());
+}
+
+/**
+ * Test reordering, duplicates, late and lost packets and sequence wrap
+ */
+void tests_udpstream_jitter()
+{
+    static UDPStreamJitter j(UDPSTREAM_JITTER_DELAY);
+    uint32_t t = 5000;
+
+    // In order goes straight through
+    put_seq(&j, 10, 5, t);
+    expect_seq(&j, 10, 5, t);
+    expect_none(&j, t);
+
+    // One ahead waits for the one before it
+    put_seq(&j, 12, 3, t);
+    expect_none(&j, t);
+    put_seq(&j, 11, 4, t + 1000);
+    expect_seq(&j, 11, 4, t + 1000);
+    expect_seq(&j, 12, 3, t + 1000);
+    expect_none(&j, t + 1000);
+    TEST_ASSERT_EQUAL(1, j.stats.reordered);
+
+    // Duplicates, delivered and held
+    put_seq(&j, 12, 3, t);
+    TEST_ASSERT_EQUAL(1, j.stats.duplicates);
+    put_seq(&j, 14, 3, t);
+    put_seq(&j, 14, 3, t);
+    TEST_ASSERT_EQUAL(2, j.stats.duplicates);
+
+    // 13 never comes, 14 goes after waiting
+    uint32_t delay = j.delay();
+    expect_none(&j, t + delay - 1);
+    expect_seq(&j, 14, 3, t + delay);
+    TEST_ASSERT_EQUAL(1, j.stats.lost);
+    t += delay;
+    put_seq(&j, 13, 3, t);
+    expect_none(&j, t);
+    TEST_ASSERT_EQUAL(1, j.stats.late);
+
+    // Too far ahead to hold: the ones too far behind it are given up on at
+    // once, the rest still get their wait
+    put_seq(&j, 15, 1, t);
+    put_seq(&j, 15 + UDPSTREAM_JITTER_SLOTS + 3, 2, t);
+    expect_seq(&j, 15, 1, t);
+    expect_none(&j, t);
+    TEST_ASSERT_EQUAL(1 + 3, j.stats.lost);
+    delay = j.delay();
+    expect_seq(&j, 15 + UDPSTREAM_JITTER_SLOTS + 3, 2, t + delay);
+    expect_none(&j, t + delay);
+    TEST_ASSERT_EQUAL(1 + UDPSTREAM_JITTER_SLOTS + 2, j.stats.lost);
+    t += delay;
+
+    // The sender starting over
+    put_seq(&j, 3000, 2, t);
+    expect_seq(&j, 3000, 2, t);
+    TEST_ASSERT_EQUAL(1, j.stats.restarts);
+
+    // Wrapping around
+    j.reset();
+    put_seq(&j, 65534, 1, t);
+    put_seq(&j, 0, 2, t);
+    expect_seq(&j, 65534, 1, t);
+    expect_none(&j, t);
+    put_seq(&j, 65535, 3, t);
+    put_seq(&j, 1, 4, t);
+    expect_seq(&j, 65535, 3, t);
+    expect_seq(&j, 0, 2, t);
+    expect_seq(&j, 1, 4, t);
+    expect_none(&j, t);
+    TEST_ASSERT_EQUAL(11, j.stats.delivered);
+
+    // The wait comes down while nothing turns up late, and goes back up with
+    // what does
+    j.reset();
+    TEST_ASSERT_EQUAL(UDPSTREAM_JITTER_DELAY, j.delay());
+    uint16_t seq = 100;
+    for (int i = 0; i < 500; i++, seq++, t += 1000)
+    {
+        put_seq(&j, seq, 1, t);
+        expect_seq(&j, seq, 1, t);
+    }
+    TEST_ASSERT_EQUAL(UDPSTREAM_JITTER_MIN_DELAY, j.delay());
+    put_seq(&j, seq + 1, 1, t);
+    put_seq(&j, seq, 1, t + 4000);
+    expect_seq(&j, seq, 1, t + 4000);
+    expect_seq(&j, seq + 1, 1, t + 4000);
+    TEST_ASSERT_EQUAL(8000, j.delay());
+}
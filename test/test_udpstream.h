@@ -0,0 +1,37 @@
+/**
+ * #FujiNet Tests - UDP stream batching and jitter buffer
+ *
+ * Checks that packets numbered by UDPStreamBatch come out of
+ * UDPStreamJitter in order, with duplicates and late ones dropped and
+ * missing ones given up on in time. bench/bench_udpstream.cpp measures
+ * byte latency through a simulated network.
+ */
+
+#ifndef TEST_UDPSTREAM_H
+#define TEST_UDPSTREAM_H
+
+#include <unity.h>
+
+#ifdef __cplusplus
+
+extern "C"
+{
+    /**
+     * Tests entrypoint
+     */
+    void tests_udpstream();
+
+    /**
+     * Test batches are numbered and sent after a pause, a hold time or when full
+     */
+    void tests_udpstream_batch();
+
+    /**
+     * Test reordering, duplicates, late and lost packets and sequence wrap
+     */
+    void tests_udpstream_jitter();
+}
+
+#endif /* __cplusplus */
+
+#endif /* TEST_UDPSTREAM_H */